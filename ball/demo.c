@@ -16,6 +16,7 @@
 #include <emscripten.h>
 #endif
 
+#include <SDL.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -30,6 +31,10 @@
 #include "level.h"
 #include "array.h"
 #include "dir.h"
+#include "fs_save.h"
+#include "log.h"
+#include "queue.h"
+#include "version.h"
 
 #include "game_server.h"
 #include "game_client.h"
@@ -38,11 +43,14 @@
 
 #define DEMO_MAGIC (0xAF | 'N' << 8 | 'B' << 16 | 'R' << 24)
 #define DEMO_VERSION 9
+#define DEMO_VERSION_INPUTS 10
 
 #define DATELEN sizeof ("YYYY-MM-DDTHH:MM:SS")
 
 fs_file demo_fp;
 
+static fs_file demo_input_fp;           /* Input replay in use               */
+
 /*---------------------------------------------------------------------------*/
 
 static const char *demo_path(const char *name)
@@ -75,9 +83,11 @@ static int demo_header_read(fs_file fp, struct demo *d)
 
     t = get_index(fp);
 
-    if (magic == DEMO_MAGIC && version == DEMO_VERSION && t)
+    if (magic == DEMO_MAGIC && t && (version == DEMO_VERSION ||
+                                     version == DEMO_VERSION_INPUTS))
     {
-        d->timer = t;
+        d->timer  = t;
+        d->inputs = (version == DEMO_VERSION_INPUTS);
 
         d->coins  = get_index(fp);
         d->status = get_index(fp);
@@ -123,7 +133,7 @@ static void demo_header_write(fs_file fp, struct demo *d)
     strftime(datestr, sizeof (datestr), "%Y-%m-%dT%H:%M:%S", gmtime(&d->date));
 
     put_index(fp, DEMO_MAGIC);
-    put_index(fp, DEMO_VERSION);
+    put_index(fp, d->inputs ? DEMO_VERSION_INPUTS : DEMO_VERSION);
     put_index(fp, 0);
     put_index(fp, 0);
     put_index(fp, 0);
@@ -145,6 +155,90 @@ static void demo_header_write(fs_file fp, struct demo *d)
 
 /*---------------------------------------------------------------------------*/
 
+/*
+ * Input replays are re-simulated, so after the header they store the
+ * game version, the initial goal state and the settings the server
+ * reads while it runs.
+ */
+
+static int *const demo_configs[] = {
+    &CONFIG_PHYSICS,
+    &CONFIG_MULTIBALL,
+    &CONFIG_CAMERA_1_SPEED,
+    &CONFIG_CAMERA_2_SPEED,
+    &CONFIG_CAMERA_3_SPEED,
+    &CONFIG_VIEW_DP,
+    &CONFIG_VIEW_DC,
+    &CONFIG_VIEW_DZ
+};
+
+#define DEMO_CONFIGS ((int) ARRAYSIZE(demo_configs))
+
+static int demo_config_prev[DEMO_CONFIGS];
+static int demo_config_used;
+
+static void demo_inputs_write(fs_file fp, int goal_e)
+{
+    int i;
+
+    put_string(fp, VERSION);
+    put_index(fp, goal_e);
+    put_index(fp, DEMO_CONFIGS);
+
+    for (i = 0; i < DEMO_CONFIGS; i++)
+        put_index(fp, config_get_d(*demo_configs[i]));
+}
+
+static int demo_inputs_read(fs_file fp, char *version, int len,
+                            int *goal_e, int *conf)
+{
+    int i;
+
+    get_string(fp, version, len);
+
+    *goal_e = get_index(fp);
+
+    if (get_index(fp) != DEMO_CONFIGS)
+        return 0;
+
+    for (i = 0; i < DEMO_CONFIGS; i++)
+        conf[i] = get_index(fp);
+
+    return !fs_eof(fp);
+}
+
+/*
+ * Use the recorded settings until the replay stops.
+ */
+static void demo_config_apply(const int *conf)
+{
+    int i;
+
+    for (i = 0; i < DEMO_CONFIGS; i++)
+    {
+        if (!demo_config_used)
+            demo_config_prev[i] = config_get_d(*demo_configs[i]);
+
+        config_set_d(*demo_configs[i], conf[i]);
+    }
+    demo_config_used = 1;
+}
+
+static void demo_config_restore(void)
+{
+    int i;
+
+    if (demo_config_used)
+    {
+        for (i = 0; i < DEMO_CONFIGS; i++)
+            config_set_d(*demo_configs[i], demo_config_prev[i]);
+
+        demo_config_used = 0;
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
 int demo_load(struct demo *d, const char *path)
 {
     int rc = 0;
@@ -155,6 +249,8 @@ int demo_load(struct demo *d, const char *path)
 
         memset(d, 0, sizeof (*d));
 
+        fs_save_wait(path);
+
         if ((fp = fs_open_read(path)))
         {
             SAFECPY(d->path, path);
@@ -178,6 +274,7 @@ void demo_free(struct demo *d)
 
 int demo_exists(const char *name)
 {
+    fs_save_wait(demo_path(name));
     return fs_exists(demo_path(name));
 }
 
@@ -273,9 +370,10 @@ const char *demo_format_name(const char *fmt,
 static struct demo demo_play;
 
 int demo_play_init(const char *name, const struct level *level,
-                   int mode, int scores, int balls, int times)
+                   int mode, int scores, int balls, int times, int goal_e)
 {
     struct demo *d = &demo_play;
+    fs_file fp;
 
     memset(d, 0, sizeof (*d));
 
@@ -293,9 +391,25 @@ int demo_play_init(const char *name, const struct level *level,
     d->balls = balls;
     d->times = times;
 
-    if ((demo_fp = fs_open_write(d->path)))
+    d->inputs = config_get_d(CONFIG_REPLAY_INPUTS);
+
+    /* Record to memory, and save the whole replay once it stops. */
+
+    if ((fp = fs_open_buffer()))
     {
-        demo_header_write(demo_fp, d);
+        demo_header_write(fp, d);
+
+        /* Record either the server inputs or its output. */
+
+        if (d->inputs)
+        {
+            demo_inputs_write(fp, goal_e);
+            game_server_record(fp);
+            demo_input_fp = fp;
+        }
+        else
+            demo_fp = fp;
+
         return 1;
     }
     return 0;
@@ -303,23 +417,27 @@ int demo_play_init(const char *name, const struct level *level,
 
 void demo_play_stat(int status, int coins, int timer)
 {
-    if (demo_fp)
+    fs_file fp = demo_fp ? demo_fp : demo_input_fp;
+
+    if (fp)
     {
-        long pos = fs_tell(demo_fp);
+        long pos = fs_tell(fp);
 
-        fs_seek(demo_fp, 8, SEEK_SET);
+        fs_seek(fp, 8, SEEK_SET);
 
-        put_index(demo_fp, timer);
-        put_index(demo_fp, coins);
-        put_index(demo_fp, status);
+        put_index(fp, timer);
+        put_index(fp, coins);
+        put_index(fp, status);
 
-        fs_seek(demo_fp, pos, SEEK_SET);
+        fs_seek(fp, pos, SEEK_SET);
     }
 }
 
 static void demo_refresh(void)
 {
 #ifdef __EMSCRIPTEN__
+    fs_save_wait(NULL);
+
     EM_ASM({
         Neverball.refreshReplays();
     });
@@ -327,21 +445,49 @@ static void demo_refresh(void)
     return;
 }
 
+/*
+ * Queue a recording to be saved, or discard it along with any earlier
+ * replay by the same name.
+ */
+static void demo_play_close(fs_file fp, int d)
+{
+    if (d)
+    {
+        fs_close(fp);
+        fs_save_wait(demo_play.path);
+        fs_remove(demo_play.path);
+    }
+    else
+        fs_save_commit(fp, demo_play.path);
+
+    demo_refresh();
+}
+
 void demo_play_stop(int d)
 {
-    if (demo_fp)
+    if (demo_input_fp)
     {
-        fs_close(demo_fp);
-        demo_fp = NULL;
+        game_server_record(NULL);
 
-        if (d) fs_remove(demo_play.path);
+        demo_play_close(demo_input_fp, d);
+        demo_input_fp = NULL;
+    }
 
-        demo_refresh();
+    if (demo_fp)
+    {
+        demo_play_close(demo_fp, d);
+        demo_fp = NULL;
     }
 }
 
+int demo_recording(void)
+{
+    return demo_fp || demo_input_fp;
+}
+
 int demo_saved(void)
 {
+    fs_save_wait(demo_play.path);
     return fs_exists(demo_play.path);
 }
 
@@ -353,6 +499,8 @@ void demo_rename(const char *name)
     {
         SAFECPY(path, demo_path(name));
 
+        fs_save_wait(demo_play.path);
+
         if (strcmp(demo_play.name, name) != 0 && fs_exists(demo_play.path))
         {
             fs_rename(demo_play.path, path);
@@ -396,9 +544,44 @@ static void demo_update_read(float dt)
 
 static struct lockstep update_step = { demo_update_read, DT };
 
+/*
+ * Input replays run the server one tick at a time.
+ */
+static void demo_input_step(float dt)
+{
+    game_server_step(dt);
+    game_client_sync(NULL);
+}
+
+static struct lockstep input_step = { demo_input_step, DT };
+
+/*
+ * Linked games apply one streamed update per tick, and skip ahead if
+ * the stream gets too far in front.
+ */
+
+#define LINK_BEHIND 3
+
+static int demo_link;
+
+static void demo_link_step(float dt)
+{
+    int n = game_proxy_pending();
+
+    while (game_proxy_step() && --n > LINK_BEHIND)
+        ;
+
+    game_client_sync(NULL);
+}
+
+static struct lockstep link_step = { demo_link_step, DT };
+
 float demo_replay_blend(void)
 {
-    return lockstep_blend(&update_step);
+    if (demo_link)
+        return lockstep_blend(&link_step);
+
+    return lockstep_blend(demo_input_fp ? &input_step : &update_step);
 }
 
 /*---------------------------------------------------------------------------*/
@@ -410,9 +593,49 @@ const char *curr_demo(void)
     return demo_replay.path;
 }
 
+/*
+ * Start the server on an input replay. Its first batch of commands
+ * syncs the client.
+ */
+static int demo_input_init(fs_file fp, int g)
+{
+    char version[MAXSTR];
+    int conf[DEMO_CONFIGS];
+    int goal_e;
+
+    if (demo_inputs_read(fp, version, sizeof (version), &goal_e, conf))
+    {
+        if (strcmp(version, VERSION) != 0)
+            log_printf("Replay %s was recorded with version %s\n",
+                       demo_replay.name, version);
+
+        demo_config_apply(conf);
+
+        if (game_server_init(demo_replay.file, demo_replay.time,
+                             goal_e, demo_replay.mode))
+        {
+            game_server_replay(fp);
+            game_client_sync(NULL);
+
+            if (!g)
+            {
+                union cmd cmd;
+                cmd.type = CMD_GOAL_OPEN;
+                game_proxy_enq(&cmd);
+            }
+            return 1;
+        }
+        demo_config_restore();
+    }
+    return 0;
+}
+
 int demo_replay_init(const char *path, int *g, int *m, int *b, int *s, int *tt)
 {
     lockstep_clr(&update_step);
+    lockstep_clr(&input_step);
+
+    fs_save_wait(path);
 
     if ((demo_fp = fs_open_read(path)))
     {
@@ -438,7 +661,19 @@ int demo_replay_init(const char *path, int *g, int *m, int *b, int *s, int *tt)
 
                 if (game_client_init(demo_replay.file))
                 {
-                    if (g)
+                    if (demo_replay.inputs)
+                    {
+                        if (g)
+                            audio_music_fade_to(0.5f, level.song);
+
+                        if (demo_input_init(demo_fp, g != NULL))
+                        {
+                            demo_input_fp = demo_fp;
+                            demo_fp = NULL;
+                            return 1;
+                        }
+                    }
+                    else if (g)
                     {
                         audio_music_fade_to(0.5f, level.song);
                     }
@@ -449,10 +684,13 @@ int demo_replay_init(const char *path, int *g, int *m, int *b, int *s, int *tt)
                         game_proxy_enq(&cmd);
                     }
 
-                    demo_update_read(0);
+                    if (!demo_replay.inputs)
+                    {
+                        demo_update_read(0);
 
-                    if (!fs_eof(demo_fp))
-                        return 1;
+                        if (!fs_eof(demo_fp))
+                            return 1;
+                    }
                 }
             }
         }
@@ -466,6 +704,18 @@ int demo_replay_init(const char *path, int *g, int *m, int *b, int *s, int *tt)
 
 int demo_replay_step(float dt)
 {
+    if (demo_link)
+    {
+        lockstep_run(&link_step, dt);
+        return game_proxy_pending() >= 0;
+    }
+
+    if (demo_input_fp)
+    {
+        lockstep_run(&input_step, dt);
+        return game_server_replaying();
+    }
+
     if (demo_fp)
     {
         lockstep_run(&update_step, dt);
@@ -476,6 +726,21 @@ int demo_replay_step(float dt)
 
 void demo_replay_stop(int d)
 {
+    if (demo_link)
+    {
+        game_proxy_close();
+        demo_link = 0;
+    }
+
+    if (demo_input_fp)
+    {
+        game_server_replay(NULL);
+        demo_config_restore();
+
+        demo_fp = demo_input_fp;
+        demo_input_fp = NULL;
+    }
+
     if (demo_fp)
     {
         fs_close(demo_fp);
@@ -490,7 +755,210 @@ void demo_replay_stop(int d)
 void demo_replay_speed(int speed)
 {
     if (SPEED_NONE <= speed && speed < SPEED_MAX)
+    {
         lockstep_scl(&update_step, SPEED_FACTORS[speed]);
+        lockstep_scl(&input_step,  SPEED_FACTORS[speed]);
+    }
 }
 
 /*---------------------------------------------------------------------------*/
+
+#define LINK_WAIT 5000
+
+/*
+ * Watch the game a server process streams from ADDR. It plays like a
+ * replay, from the level named in the first update.
+ */
+int demo_link_init(const char *addr)
+{
+    Uint32 t0 = SDL_GetTicks();
+
+    lockstep_clr(&link_step);
+
+    if (!game_proxy_connect(addr))
+        return 0;
+
+    while (game_proxy_pending() == 0 && SDL_GetTicks() - t0 < LINK_WAIT)
+        SDL_Delay(10);
+
+    memset(&demo_replay, 0, sizeof (demo_replay));
+    SAFECPY(demo_replay.name, addr);
+
+    if (game_proxy_step())
+    {
+        Queue q = queue_new();
+        union cmd *cmdp;
+
+        /* Hold the first update until the client has the level. */
+
+        while ((cmdp = game_proxy_deq()))
+        {
+            if (cmdp->type == CMD_MAP && !demo_replay.file[0])
+                SAFECPY(demo_replay.file, cmdp->map.name);
+
+            queue_enq(q, cmdp);
+        }
+
+        if (demo_replay.file[0] && game_client_init(demo_replay.file))
+            demo_link = 1;
+
+        /* Queued copies take over any strings. */
+
+        while ((cmdp = queue_deq(q)))
+        {
+            if (demo_link)
+            {
+                game_proxy_enq(cmdp);
+                free(cmdp);
+            }
+            else
+                cmd_free(cmdp);
+        }
+        queue_free(q);
+
+        if (demo_link)
+        {
+            game_client_sync(NULL);
+            return 1;
+        }
+    }
+
+    log_printf("No game received from %s\n", addr);
+    game_proxy_close();
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+#define VERIFY_TICKS (UPS * 60 * 60)
+
+/*
+ * Start the server on an input replay with no client, returning the
+ * open replay on success.
+ */
+static fs_file demo_resim_init(const char *path, struct demo *d)
+{
+    char version[MAXSTR];
+    int conf[DEMO_CONFIGS];
+    int goal_e;
+    fs_file fp;
+
+    fs_save_wait(path);
+
+    if (!(fp = fs_open_read(path)))
+    {
+        log_printf("%s: failure to open\n", path);
+        return NULL;
+    }
+
+    memset(d, 0, sizeof (*d));
+
+    if (!demo_header_read(fp, d) || !d->inputs)
+        log_printf("%s: not an input replay\n", path);
+
+    else if (!demo_inputs_read(fp, version, sizeof (version), &goal_e, conf))
+        log_printf("%s: bad replay header\n", path);
+
+    else if (strcmp(version, VERSION) != 0)
+        log_printf("%s: recorded with version %s\n", path, version);
+
+    else
+    {
+        demo_config_apply(conf);
+
+        if (game_server_init(d->file, d->time, goal_e, d->mode))
+        {
+            game_server_replay(fp);
+            return fp;
+        }
+
+        log_printf("%s: failure to load %s\n", path, d->file);
+
+        demo_config_restore();
+    }
+
+    fs_close(fp);
+    return NULL;
+}
+
+static void demo_resim_stop(fs_file fp)
+{
+    game_server_replay(NULL);
+    game_server_free(NULL);
+
+    demo_config_restore();
+
+    fs_close(fp);
+}
+
+/*
+ * Re-simulate an input replay without a client and check that some
+ * player ends with the result stored in its header.
+ */
+int demo_verify(const char *path)
+{
+    struct demo d;
+    int rc = 0;
+    fs_file fp;
+
+    if ((fp = demo_resim_init(path, &d)))
+    {
+        int status = 0, coins = 0, timer = 0;
+        int n, p;
+
+        for (n = 0; n < VERIFY_TICKS && game_server_replaying(); n++)
+        {
+            game_server_step(DT);
+            game_proxy_clr();
+        }
+
+        for (p = 0; p < game_server_players() && !rc; p++)
+        {
+            game_server_stat(p, &status, &coins, &timer);
+
+            rc = (status == d.status &&
+                  coins  == d.coins  &&
+                  timer  == d.timer);
+        }
+
+        if (rc)
+            log_printf("%s: ok\n", path);
+        else
+            log_printf("%s: mismatch (status %d/%d, coins %d/%d, "
+                       "time %d/%d)\n", path,
+                       status, d.status, coins, d.coins, timer, d.timer);
+
+        demo_resim_stop(fp);
+    }
+    return rc;
+}
+
+/*
+ * Re-simulate an input replay in real time, for a linked client.
+ */
+int demo_serve(const char *path)
+{
+    struct demo d;
+    fs_file fp;
+
+    if ((fp = demo_resim_init(path, &d)))
+    {
+        Uint32 t0 = SDL_GetTicks();
+        Uint32 n;
+
+        for (n = 0; game_server_replaying() && game_proxy_pending() >= 0; n++)
+        {
+            Uint32 t = t0 + n * 1000 / UPS;
+            Uint32 now = SDL_GetTicks();
+
+            if (t > now)
+                SDL_Delay(t - now);
+
+            game_server_step(DT);
+        }
+
+        demo_resim_stop(fp);
+        return 1;
+    }
+    return 0;
+}
@@ -31,6 +31,7 @@ struct demo
     int    balls;                       /* Number of balls                   */
     int    times;                       /* Total time                        */
 
+    int    inputs;                      /* Recorded as inputs, not commands  */
 };
 
 /*---------------------------------------------------------------------------*/
@@ -46,11 +47,13 @@ const char *demo_format_name(const char *fmt,
 
 /*---------------------------------------------------------------------------*/
 
-int  demo_play_init(const char *, const struct level *, int, int, int, int);
+int  demo_play_init(const char *, const struct level *, int, int, int, int, int);
 void demo_play_step(void);
 void demo_play_stat(int, int, int);
 void demo_play_stop(int);
 
+int  demo_recording(void);
+
 int  demo_saved (void);
 void demo_rename(const char *);
 
@@ -67,6 +70,11 @@ const char *curr_demo(void);
 
 void demo_replay_speed(int);
 
+int  demo_link_init(const char *);
+
+int  demo_verify(const char *);
+int  demo_serve (const char *);
+
 /*---------------------------------------------------------------------------*/
 
 extern fs_file demo_fp;
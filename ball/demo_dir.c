@@ -21,6 +21,7 @@
 #include "demo.h"
 #include "demo_dir.h"
 #include "fs.h"
+#include "fs_save.h"
 
 /*---------------------------------------------------------------------------*/
 
@@ -74,6 +75,10 @@ Array demo_dir_scan(void)
 {
     Array items;
 
+    /* List replays still being saved, too. */
+
+    fs_save_wait(NULL);
+
     if ((items = fs_dir_scan("Replays", scan_item)))
         array_sort(items, cmp_items);
 
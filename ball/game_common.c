@@ -207,30 +207,6 @@ void game_view_fly(struct game_view *view, const struct s_vary *vary, float k)
 
 /*---------------------------------------------------------------------------*/
 
-void lockstep_clr(struct lockstep *ls)
-{
-    ls->at = 0;
-    ls->ts = 1.0f;
-}
-
-void lockstep_run(struct lockstep *ls, float dt)
-{
-    ls->at += dt * ls->ts;
-
-    while (ls->at >= ls->dt)
-    {
-        ls->step(ls->dt);
-        ls->at -= ls->dt;
-    }
-}
-
-void lockstep_scl(struct lockstep *ls, float ts)
-{
-    ls->ts = ts;
-}
-
-/*---------------------------------------------------------------------------*/
-
 /* Poor man's cache. */
 
 struct s_base  game_base;
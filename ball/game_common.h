@@ -3,6 +3,7 @@
 
 #include "lang.h"
 #include "solid_vary.h"
+#include "lockstep.h"
 
 /*---------------------------------------------------------------------------*/
 
@@ -102,24 +103,7 @@ void game_view_fly(struct game_view *, const struct s_vary *, float);
 #define UPS 90
 #define DT  (1.0f / (float) UPS)
 
-/*
- * Simple fixed time step scheme.
- */
-
-struct lockstep
-{
-    void (*step)(float);
-
-    float dt;                           /* Time step length                  */
-    float at;                           /* Accumulator                       */
-    float ts;                           /* Time scale factor                 */
-};
-
-void lockstep_clr(struct lockstep *);
-void lockstep_run(struct lockstep *, float);
-void lockstep_scl(struct lockstep *, float);
-
-#define lockstep_blend(ls) ((ls)->at / (ls)->dt)
+#define MAX_STEPS (UPS / 10)            /* Max catch-up steps per frame      */
 
 /*---------------------------------------------------------------------------*/
 
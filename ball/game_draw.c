@@ -17,8 +17,10 @@
 #include "ball.h"
 #include "part.h"
 #include "geom.h"
+#include "inst.h"
 #include "config.h"
 #include "video.h"
+#include "fbo.h"
 
 #include "solid_all.h"
 #include "solid_draw.h"
@@ -288,38 +290,150 @@ static void game_draw_balls(struct s_rend *rend,
     }
 }
 
+/*
+ * Test an entity with position p and orientation e against the view.
+ * The entity is bounded by a cylinder of radius r and height h at its
+ * local position q.
+ */
+static int game_cull_entity(const struct frustum *fr,
+                            const float *p, const float *e,
+                            const float *q, float r, float h)
+{
+    float c[3], v[3];
+
+    v[0] = q[0];
+    v[1] = q[1] + h / 2;
+    v[2] = q[2];
+
+    q_rot(c, e, v);
+    v_add(c, c, p);
+
+    return frustum_test(fr, c, fsqrtf(r * r + h * h / 4));
+}
+
+/*
+ * Compute the transform of an item and return false if it is culled.
+ */
+static int game_item_M(float *M, const struct s_vary *vary,
+                       const struct frustum *fr, const struct v_item *hp)
+{
+    float item_p[3], item_e[4], u[3], a;
+    float T[16], R[16], U[16];
+
+    if (hp->t == ITEM_NONE)
+        return 0;
+
+    sol_entity_p(item_p, vary, hp->mi, hp->mj);
+    sol_entity_e(item_e, vary, hp->mi, hp->mj);
+
+    if (!game_cull_entity(fr, item_p, item_e, hp->p,
+                          ITEM_RADIUS * 2, ITEM_RADIUS * 2))
+        return 0;
+
+    q_as_axisangle(item_e, u, &a);
+
+    m_xlt(T, item_p);
+    m_rot(R, u, a);
+    m_mult(U, T, R);
+    m_xlt(T, hp->p);
+    m_mult(M, U, T);
+
+    return 1;
+}
+
+/*
+ * Draw each kind of item as a single batch of instances.
+ */
+static void game_draw_items_inst(struct s_rend *rend,
+                                 const struct s_vary *vary,
+                                 const struct frustum *fr,
+                                 const float *bill_M, float t)
+{
+    const struct s_draw *kinds[16];
+    float M[16];
+    int hi, ki, kc = 0;
+
+    /* Find the distinct item models in use. */
+
+    for (hi = 0; hi < vary->hc && kc < (int) ARRAYSIZE(kinds); hi++)
+        if (vary->hv[hi].t != ITEM_NONE)
+        {
+            const struct s_draw *draw = item_file(&vary->hv[hi]);
+
+            for (ki = 0; ki < kc; ki++)
+                if (kinds[ki] == draw)
+                    break;
+
+            if (ki == kc)
+                kinds[kc++] = draw;
+        }
+
+    for (ki = 0; ki < kc; ki++)
+    {
+        const struct s_draw *draw = kinds[ki];
+        int n = 0;
+
+        inst_begin(fr->M);
+
+        for (hi = 0; hi < vary->hc; hi++)
+        {
+            const struct v_item *hp = &vary->hv[hi];
+
+            if (item_file(hp) != draw || !game_item_M(M, vary, fr, hp))
+                continue;
+
+            glPushMatrix();
+            {
+                glMultMatrixf(M);
+
+                if (inst_add(M, NULL))
+                {
+                    item_bill(rend, hp, bill_M, t);
+                    n++;
+                }
+                else
+                    item_draw(rend, hp, bill_M, t);
+            }
+            glPopMatrix();
+        }
+
+        if (n)
+            item_draw_inst(rend, draw);
+    }
+}
+
 static void game_draw_items(struct s_rend *rend,
                             const struct s_vary *vary,
+                            const struct frustum *fr,
                             const float *bill_M, float t)
 {
+    float M[16];
     int hi;
 
+    if (inst_ready())
+    {
+        game_draw_items_inst(rend, vary, fr, bill_M, t);
+        return;
+    }
+
     for (hi = 0; hi < vary->hc; hi++)
     {
         struct v_item *hp = &vary->hv[hi];
 
-        float item_p[3], item_e[4], u[3], a;
-
-        if (hp->t == ITEM_NONE)
+        if (!game_item_M(M, vary, fr, hp))
             continue;
 
-        sol_entity_p(item_p, vary, hp->mi, hp->mj);
-        sol_entity_e(item_e, vary, hp->mi, hp->mj);
-
-        q_as_axisangle(item_e, u, &a);
-
         glPushMatrix();
         {
-            glTranslatef(item_p[0], item_p[1], item_p[2]);
-            glRotatef(V_DEG(a), u[0], u[1], u[2]);
-            glTranslatef(hp->p[0], hp->p[1], hp->p[2]);
+            glMultMatrixf(M);
             item_draw(rend, hp, bill_M, t);
         }
         glPopMatrix();
     }
 }
 
-static void game_draw_beams(struct s_rend *rend, const struct game_draw *gd)
+static void game_draw_beams(struct s_rend *rend, const struct game_draw *gd,
+                            const struct frustum *fr)
 {
     static const GLfloat goal_c[4]       =   { 1.0f, 1.0f, 0.0f, 0.5f };
     static const GLfloat jump_c[2][4]    =  {{ 0.7f, 0.5f, 1.0f, 0.5f },
@@ -341,6 +455,10 @@ static void game_draw_beams(struct s_rend *rend, const struct game_draw *gd)
             sol_entity_p(beam_p, vary, vary->zv[i].mi, vary->zv[i].mj);
             sol_entity_e(beam_e, vary, vary->zv[i].mi, vary->zv[i].mj);
 
+            if (!game_cull_entity(fr, beam_p, beam_e, base->zv[i].p,
+                                  base->zv[i].r, gd->goal_k * 3.0f))
+                continue;
+
             q_as_axisangle(beam_e, u, &a);
 
             glPushMatrix();
@@ -357,6 +475,10 @@ static void game_draw_beams(struct s_rend *rend, const struct game_draw *gd)
         sol_entity_p(beam_p, vary, vary->jv[i].mi, vary->jv[i].mj);
         sol_entity_e(beam_e, vary, vary->jv[i].mi, vary->jv[i].mj);
 
+        if (!game_cull_entity(fr, beam_p, beam_e, base->jv[i].p,
+                              base->jv[i].r, 2.0f))
+            continue;
+
         q_as_axisangle(beam_e, u, &a);
 
         glPushMatrix();
@@ -374,6 +496,10 @@ static void game_draw_beams(struct s_rend *rend, const struct game_draw *gd)
             sol_entity_p(beam_p, vary, vary->xv[i].mi, vary->xv[i].mj);
             sol_entity_e(beam_e, vary, vary->xv[i].mi, vary->xv[i].mj);
 
+            if (!game_cull_entity(fr, beam_p, beam_e, base->xv[i].p,
+                                  base->xv[i].r, 2.0f))
+                continue;
+
             q_as_axisangle(beam_e, u, &a);
 
             glPushMatrix();
@@ -387,7 +513,8 @@ static void game_draw_beams(struct s_rend *rend, const struct game_draw *gd)
 }
 
 static void game_draw_goals(struct s_rend *rend,
-                            const struct game_draw *gd, float t)
+                            const struct game_draw *gd,
+                            const struct frustum *fr, float t)
 {
     const struct s_base *base =  gd->vary.base;
     const struct s_vary *vary = &gd->vary;
@@ -401,6 +528,10 @@ static void game_draw_goals(struct s_rend *rend,
             sol_entity_p(goal_p, vary, vary->zv[i].mi, vary->zv[i].mj);
             sol_entity_e(goal_e, vary, vary->zv[i].mi, vary->zv[i].mj);
 
+            if (!game_cull_entity(fr, goal_p, goal_e, base->zv[i].p,
+                                  base->zv[i].r, GOAL_HEIGHT))
+                continue;
+
             q_as_axisangle(goal_e, u, &a);
 
             glPushMatrix();
@@ -414,7 +545,8 @@ static void game_draw_goals(struct s_rend *rend,
 }
 
 static void game_draw_jumps(struct s_rend *rend,
-                            const struct game_draw *gd, float t)
+                            const struct game_draw *gd,
+                            const struct frustum *fr, float t)
 {
     const struct s_base *base =  gd->vary.base;
     const struct s_vary *vary = &gd->vary;
@@ -427,6 +559,10 @@ static void game_draw_jumps(struct s_rend *rend,
         sol_entity_p(jump_p, vary, vary->jv[i].mi, vary->jv[i].mj);
         sol_entity_e(jump_e, vary, vary->jv[i].mi, vary->jv[i].mj);
 
+        if (!game_cull_entity(fr, jump_p, jump_e, base->jv[i].p,
+                              base->jv[i].r, JUMP_HEIGHT))
+            continue;
+
         q_as_axisangle(jump_e, u, &a);
 
         glPushMatrix();
@@ -477,8 +613,8 @@ static void game_draw_light(const struct game_draw *gd, int d, float t)
 
     glLightfv(GL_LIGHT2, GL_POSITION, p);
 
-    glEnable(GL_LIGHT0);
-    glEnable(GL_LIGHT1);
+    light_enable(0, 1);
+    light_enable(1, 1);
 }
 
 static void game_draw_back(struct s_rend *rend,
@@ -554,6 +690,7 @@ static void game_draw_fore(struct s_rend *rend,
                            struct game_draw *gds,
                            int p_idx, int p_count,
                            int pose, const float *M,
+                           const struct frustum *fr,
                            int d, float t)
 {
     struct game_draw *gd = &gds[p_idx];
@@ -587,9 +724,12 @@ static void game_draw_fore(struct s_rend *rend,
             break;
 
         case POSE_NONE:
-            game_draw_items(rend, &gd->vary, M, t);
+            game_draw_items(rend, &gd->vary, fr, M, t);
             sol_draw(draw, rend, 0, 1);
 
+            if (config_get_d(CONFIG_SHADOW))
+                sol_shad(draw, rend, -1);
+
             if (curr_mode() == MODE_TARGET)
                 game_draw_target();
 
@@ -601,19 +741,19 @@ static void game_draw_fore(struct s_rend *rend,
         glDepthMask(GL_FALSE);
         {
             sol_bill(draw, rend, M, t);
-            game_draw_beams(rend, gd);
-            part_draw_coin(draw, rend, M, t);
+            game_draw_beams(rend, gd, fr);
+            part_draw_coin(draw, rend, M, fr->M, t);
 
-            glDisable(GL_LIGHT0);
-            glDisable(GL_LIGHT1);
-            glEnable (GL_LIGHT2);
+            light_enable(0, 0);
+            light_enable(1, 0);
+            light_enable(2, 1);
             {
-                game_draw_goals(rend, gd, t);
-                game_draw_jumps(rend, gd, t);
+                game_draw_goals(rend, gd, fr, t);
+                game_draw_jumps(rend, gd, fr, t);
             }
-            glDisable(GL_LIGHT2);
-            glEnable (GL_LIGHT1);
-            glEnable (GL_LIGHT0);
+            light_enable(2, 0);
+            light_enable(1, 1);
+            light_enable(0, 1);
         }
         glDepthMask(GL_TRUE);
 
@@ -625,29 +765,286 @@ static void game_draw_fore(struct s_rend *rend,
 
 /*---------------------------------------------------------------------------*/
 
-static void game_shadow_conf(int pose, int enable)
+/*
+ * Draw the mirrored scene directly into the stencil-masked reflective
+ * surfaces, at full resolution.
+ */
+static void game_refl_stencil(struct s_rend *rend,
+                              struct game_draw *gds,
+                              int p_idx, int p_count, int pose,
+                              const float *U, const struct frustum *fr, float t)
 {
-    if (enable && config_get_d(CONFIG_SHADOW))
+    struct game_draw *gd = &gds[p_idx];
+
+    glEnable(GL_STENCIL_TEST);
     {
-        switch (pose)
+        glStencilFunc(GL_ALWAYS, 1, 0xFFFFFFFF);
+        glStencilOp(GL_REPLACE, GL_REPLACE, GL_REPLACE);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glDepthMask(GL_FALSE);
+
+        game_refl_all(rend, gd);
+
+        glDepthMask(GL_TRUE);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+        glStencilFunc(GL_EQUAL, 1, 0xFFFFFFFF);
+
+        glFrontFace(GL_CW);
+        glPushMatrix();
         {
-        case POSE_LEVEL:
-            tex_env_active(&tex_env_default);
-            break;
+            struct frustum rf;
 
-        case POSE_BALL:
-            tex_env_select(&tex_env_pose,
-                           &tex_env_default,
-                           NULL);
-            break;
+            glScalef(+1.0f, -1.0f, +1.0f);
 
-        default:
-            tex_env_select(&tex_env_shadow_clip,
-                           &tex_env_shadow,
-                           &tex_env_default,
-                           NULL);
-            break;
+            /* Cull again for the mirrored view. */
+
+            glPushMatrix();
+            {
+                game_draw_tilt(gd, -1);
+                frustum_load(&rf);
+            }
+            glPopMatrix();
+
+            sol_cull(&gd->draw, &rf);
+
+            game_draw_light(gd, -1, t);
+
+            game_draw_back(rend, gd, pose,    -1, t);
+            game_draw_fore(rend, gds, p_idx, p_count, pose, U, &rf, -1, t);
+
+            sol_cull(&gd->draw, fr);
         }
+        glPopMatrix();
+        glFrontFace(GL_CCW);
+
+        glStencilFunc(GL_ALWAYS, 0, 0xFFFFFFFF);
+    }
+    glDisable(GL_STENCIL_TEST);
+}
+
+/*
+ * The mirrored scene may instead be drawn once into a texture at a
+ * fraction of the viewport resolution, limited to the screen area of
+ * the visible reflective surfaces, and then pasted into them.
+ */
+
+static fbo refl_fbo;
+
+void game_refl_free(void)
+{
+    fbo_delete(&refl_fbo);
+}
+
+static int game_refl_size(int w, int h)
+{
+    if (refl_fbo.framebuffer && (refl_fbo.width != w || refl_fbo.height != h))
+        fbo_delete(&refl_fbo);
+
+    if (!refl_fbo.framebuffer && !fbo_create(&refl_fbo, w, h))
+    {
+        fbo_delete(&refl_fbo);
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ * Fill the stencil-masked rectangle R, in normalized device coordinates,
+ * with the matching part of the reflection texture.
+ */
+static void game_refl_paste(struct s_rend *rend, const float *r)
+{
+    const GLfloat v[8] = {
+        r[0], r[1], r[2], r[1], r[0], r[3], r[2], r[3]
+    };
+    const GLfloat u[8] = {
+        (r[0] + 1.0f) / 2.0f, (r[1] + 1.0f) / 2.0f,
+        (r[2] + 1.0f) / 2.0f, (r[1] + 1.0f) / 2.0f,
+        (r[0] + 1.0f) / 2.0f, (r[3] + 1.0f) / 2.0f,
+        (r[2] + 1.0f) / 2.0f, (r[3] + 1.0f) / 2.0f
+    };
+
+    r_apply_mtrl(rend, default_mtrl);
+
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+    {
+        glDisable(GL_LIGHTING);
+        glDisable(GL_DEPTH_TEST);
+        glDepthMask(GL_FALSE);
+        glDisableClientState(GL_NORMAL_ARRAY);
+
+        glBindBuffer_(GL_ARRAY_BUFFER, 0);
+
+        tex_env_stage(TEX_STAGE_TEXTURE);
+        glBindTexture_(GL_TEXTURE_2D, refl_fbo.color_texture);
+
+        glVertexPointer  (2, GL_FLOAT, 0, v);
+        glTexCoordPointer(2, GL_FLOAT, 0, u);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+        glBindTexture_(GL_TEXTURE_2D, rend->curr_mtrl.o);
+
+        glEnableClientState(GL_NORMAL_ARRAY);
+        glDepthMask(GL_TRUE);
+        glEnable(GL_DEPTH_TEST);
+        glEnable(GL_LIGHTING);
+    }
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopMatrix();
+}
+
+/*
+ * Draw the reflection by way of a texture. Return false if this mode is
+ * off or unavailable.
+ */
+static int game_refl_fbo(struct s_rend *rend,
+                         struct game_draw *gds,
+                         int p_idx, int p_count, int pose,
+                         const float *U, const struct frustum *fr, float t,
+                         int vp_x, int vp_y, int vp_w, int vp_h)
+{
+    struct game_draw *gd = &gds[p_idx];
+
+    const int k = config_get_d(CONFIG_REFLECTION_SCALE);
+
+    float P[16], V[16], C[16], S[16], r[4];
+    int w, h, x0, y0, x1, y1;
+    GLint o = 0;
+
+    if (k < 1 || !gli.framebuffer_object)
+        return 0;
+
+    w = MAX(vp_w / k, 1);
+    h = MAX(vp_h / k, 1);
+
+    if (!game_refl_size(w, h))
+        return 0;
+
+    /* Find the screen area of the reflective surfaces in view. */
+
+    glGetFloatv(GL_PROJECTION_MATRIX, P);
+
+    glPushMatrix();
+    {
+        game_draw_tilt(gd, +1);
+        glGetFloatv(GL_MODELVIEW_MATRIX, V);
+    }
+    glPopMatrix();
+
+    m_mult(C, P, V);
+
+    if (!sol_refl_rect(&gd->draw, C, r))
+        return 1;
+
+    /* Draw the mirrored scene into that area of the texture. */
+
+    x0 = MAX((int) floorf((r[0] + 1.0f) * 0.5f * w) - 1, 0);
+    y0 = MAX((int) floorf((r[1] + 1.0f) * 0.5f * h) - 1, 0);
+    x1 = MIN((int) ceilf ((r[2] + 1.0f) * 0.5f * w) + 1, w);
+    y1 = MIN((int) ceilf ((r[3] + 1.0f) * 0.5f * h) + 1, h);
+
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &o);
+    glBindFramebuffer_(GL_FRAMEBUFFER, refl_fbo.framebuffer);
+    glViewport(0, 0, w, h);
+
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(x0, y0, x1 - x0, y1 - y0);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    glFrontFace(GL_CW);
+    glPushMatrix();
+    {
+        struct frustum rf;
+
+        glScalef(+1.0f, -1.0f, +1.0f);
+
+        /* Cull to the part of the mirrored view within the area. */
+
+        m_ident(S);
+
+        S[0]  = 2.0f / (r[2] - r[0]);
+        S[5]  = 2.0f / (r[3] - r[1]);
+        S[12] = -(r[2] + r[0]) / (r[2] - r[0]);
+        S[13] = -(r[3] + r[1]) / (r[3] - r[1]);
+
+        glMatrixMode(GL_PROJECTION);
+        glPushMatrix();
+        glLoadMatrixf(S);
+        glMultMatrixf(P);
+        glMatrixMode(GL_MODELVIEW);
+
+        glPushMatrix();
+        {
+            game_draw_tilt(gd, -1);
+            frustum_load(&rf);
+        }
+        glPopMatrix();
+
+        glMatrixMode(GL_PROJECTION);
+        glPopMatrix();
+        glMatrixMode(GL_MODELVIEW);
+
+        sol_cull(&gd->draw, &rf);
+
+        game_draw_light(gd, -1, t);
+
+        game_draw_back(rend, gd, pose,    -1, t);
+        game_draw_fore(rend, gds, p_idx, p_count, pose, U, &rf, -1, t);
+
+        sol_cull(&gd->draw, fr);
+    }
+    glPopMatrix();
+    glFrontFace(GL_CCW);
+
+    glDisable(GL_SCISSOR_TEST);
+
+    glBindFramebuffer_(GL_FRAMEBUFFER, o);
+    glViewport(vp_x, vp_y, vp_w, vp_h);
+
+    /* Mask the reflective surfaces and paste the texture into them. */
+
+    glEnable(GL_STENCIL_TEST);
+    {
+        glStencilFunc(GL_ALWAYS, 1, 0xFFFFFFFF);
+        glStencilOp(GL_REPLACE, GL_REPLACE, GL_REPLACE);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glDepthMask(GL_FALSE);
+
+        game_refl_all(rend, gd);
+
+        glDepthMask(GL_TRUE);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+        glStencilFunc(GL_EQUAL, 1, 0xFFFFFFFF);
+
+        game_refl_paste(rend, r);
+
+        glStencilFunc(GL_ALWAYS, 0, 0xFFFFFFFF);
+    }
+    glDisable(GL_STENCIL_TEST);
+
+    return 1;
+}
+
+/*
+ * Ball shadows are drawn in a separate pass, see sol_shad. Only the
+ * ball pose still uses a shadow texture stage on the level itself.
+ */
+static void game_shadow_conf(int pose, int enable)
+{
+    if (enable && config_get_d(CONFIG_SHADOW) && pose == POSE_BALL)
+    {
+        tex_env_select(&tex_env_pose,
+                       &tex_env_default,
+                       NULL);
     }
     else
     {
@@ -680,6 +1077,8 @@ void game_draw(struct game_draw *gds, int p_idx, int p_count, int pose, float t,
             {
                 float T[16], U[16], M[16], v[3];
 
+                struct frustum fr;
+
                 v[0] = +view->p[0];
                 v[1] = -view->p[1];
                 v[2] = +view->p[2];
@@ -695,40 +1094,24 @@ void game_draw(struct game_draw *gds, int p_idx, int p_count, int pose, float t,
                 glMultMatrixf(M);
                 glTranslatef(-view->c[0], -view->c[1], -view->c[2]);
 
-                game_draw_back(&rend, gd, pose, +1, t);
+                /* Compute the view frustum in tilted level space. */
 
-                if (gd->draw.reflective && config_get_d(CONFIG_REFLECTION))
+                glPushMatrix();
                 {
-                    glEnable(GL_STENCIL_TEST);
-                    {
-                        glStencilFunc(GL_ALWAYS, 1, 0xFFFFFFFF);
-                        glStencilOp(GL_REPLACE, GL_REPLACE, GL_REPLACE);
-                        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
-                        glDepthMask(GL_FALSE);
-
-                        game_refl_all(&rend, gd);
-
-                        glDepthMask(GL_TRUE);
-                        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
-                        glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
-                        glStencilFunc(GL_EQUAL, 1, 0xFFFFFFFF);
-
-                        glFrontFace(GL_CW);
-                        glPushMatrix();
-                        {
-                            glScalef(+1.0f, -1.0f, +1.0f);
+                    game_draw_tilt(gd, +1);
+                    frustum_load(&fr);
+                }
+                glPopMatrix();
 
-                            game_draw_light(gd, -1, t);
+                sol_cull(&gd->draw, &fr);
 
-                            game_draw_back(&rend, gd, pose,    -1, t);
-                            game_draw_fore(&rend, gds, p_idx, p_count, pose, U, -1, t);
-                        }
-                        glPopMatrix();
-                        glFrontFace(GL_CCW);
+                game_draw_back(&rend, gd, pose, +1, t);
 
-                        glStencilFunc(GL_ALWAYS, 0, 0xFFFFFFFF);
-                    }
-                    glDisable(GL_STENCIL_TEST);
+                if (gd->draw.reflective && config_get_d(CONFIG_REFLECTION))
+                {
+                    if (!game_refl_fbo(&rend, gds, p_idx, p_count, pose, U, &fr, t,
+                                       vp_x, vp_y, vp_w, vp_h))
+                        game_refl_stencil(&rend, gds, p_idx, p_count, pose, U, &fr, t);
                 }
 
                 game_draw_light(gd, 1, t);
@@ -745,7 +1128,9 @@ void game_draw(struct game_draw *gds, int p_idx, int p_count, int pose, float t,
                 }
 
                 game_refl_all (&rend, gd);
-                game_draw_fore(&rend, gds, p_idx, p_count, pose, T, +1, t);
+                game_draw_fore(&rend, gds, p_idx, p_count, pose, T, &fr, +1, t);
+
+                sol_cull(&gd->draw, NULL);
             }
             glPopMatrix();
             video_pop_matrix();
@@ -35,6 +35,7 @@ struct game_draw
 #include "game_client.h"
 
 void game_draw(struct game_draw *gds, int p_idx, int p_count, int pose, float t, int x, int y, int w, int h);
+void game_refl_free(void);
 
 /*---------------------------------------------------------------------------*/
 
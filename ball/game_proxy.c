@@ -12,14 +12,50 @@
  * General Public License for more details.
  */
 
+#if !defined(_WIN32) && !defined(__EMSCRIPTEN__)
+#define _POSIX_C_SOURCE 200112L
+#define PROXY_SOCKETS 1
+#endif
+
+#include <SDL.h>
 #include <stdlib.h>
+#include <string.h>
+
+#ifdef PROXY_SOCKETS
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <signal.h>
+#include <unistd.h>
+#endif
 
 #include "game_proxy.h"
+#include "common.h"
 #include "queue.h"
 #include "cmd.h"
+#include "log.h"
+#include "fs.h"
 
 static Queue cmd_queue;
 
+/*
+ * Socket link.  A server process may send its commands to a client in
+ * another process instead of queueing them.  The stream uses the same
+ * framing as replay files, flushed at each end of update.
+ */
+
+static fs_file     link_fp;
+static int         link_fd = -1;
+static int         link_send;           /* Commands go out, not in           */
+static SDL_Thread *link_thread;
+static SDL_mutex  *link_mutex;
+static Queue       link_queue;          /* Commands received                 */
+static int         link_count;          /* Complete updates received         */
+static int         link_done;           /* Stream has ended                  */
+
 /*
  * Command filtering.
  */
@@ -43,6 +79,21 @@ void game_proxy_enq(const union cmd *src)
     if (!FILTER(src))
         return;
 
+    /* Send the command to the linked client instead. */
+
+    if (link_fp && link_send)
+    {
+        if (cmd_put(link_fp, src) && src->type == CMD_END_OF_UPDATE)
+        {
+            if (fs_flush(link_fp) != 0)
+            {
+                log_printf("Link closed by client\n");
+                game_proxy_close();
+            }
+        }
+        return;
+    }
+
     /*
      * Create the queue.  This is done only once during the life time
      * of the program.  For simplicity's sake, the queue is never
@@ -82,3 +133,306 @@ void game_proxy_clr(void)
     while ((cmdp = game_proxy_deq()))
         cmd_free(cmdp);
 }
+
+/*---------------------------------------------------------------------------*/
+
+#ifdef PROXY_SOCKETS
+
+/*
+ * Open a stream socket to or from ADDR, given as "unix:path" or
+ * "host:port". A listening socket waits for a single peer.
+ */
+static int link_socket(const char *addr, int listening)
+{
+    int fd = -1;
+
+    if (strncmp(addr, "unix:", 5) == 0)
+    {
+        struct sockaddr_un sa;
+
+        memset(&sa, 0, sizeof (sa));
+        sa.sun_family = AF_UNIX;
+        SAFECPY(sa.sun_path, addr + 5);
+
+        if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+            return -1;
+
+        if (listening)
+        {
+            int peer = -1;
+
+            unlink(sa.sun_path);
+
+            if (bind(fd, (struct sockaddr *) &sa, sizeof (sa)) == 0 &&
+                listen(fd, 1) == 0)
+                peer = accept(fd, NULL, NULL);
+
+            close(fd);
+            unlink(sa.sun_path);
+
+            fd = peer;
+        }
+        else if (connect(fd, (struct sockaddr *) &sa, sizeof (sa)) != 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+    else
+    {
+        struct addrinfo hints, *res, *ai;
+        char host[MAXSTR];
+        char *port;
+
+        SAFECPY(host, addr);
+
+        if (!(port = strrchr(host, ':')))
+            return -1;
+
+        *port++ = 0;
+
+        memset(&hints, 0, sizeof (hints));
+        hints.ai_family   = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags    = listening ? AI_PASSIVE : 0;
+
+        if (getaddrinfo(host[0] ? host : NULL, port, &hints, &res) != 0)
+            return -1;
+
+        for (ai = res; ai && fd < 0; ai = ai->ai_next)
+        {
+            int one = 1;
+
+            if ((fd = socket(ai->ai_family, ai->ai_socktype,
+                             ai->ai_protocol)) < 0)
+                continue;
+
+            if (listening)
+            {
+                int peer = -1;
+
+                setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof (one));
+
+                if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 &&
+                    listen(fd, 1) == 0)
+                    peer = accept(fd, NULL, NULL);
+
+                close(fd);
+                fd = peer;
+            }
+            else if (connect(fd, ai->ai_addr, ai->ai_addrlen) != 0)
+            {
+                close(fd);
+                fd = -1;
+            }
+
+            /* Updates are flushed whole, so don't hold them back. */
+
+            if (fd >= 0)
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof (one));
+        }
+        freeaddrinfo(res);
+    }
+    return fd;
+}
+
+#else
+
+static int link_socket(const char *addr, int listening)
+{
+    return -1;
+}
+
+#endif
+
+/*
+ * Read commands from the stream until it ends.
+ */
+static int link_func(void *data)
+{
+    union cmd *cmdp;
+
+    while ((cmdp = calloc(1, sizeof (*cmdp))))
+    {
+        if (!cmd_get(link_fp, cmdp))
+        {
+            free(cmdp);
+            break;
+        }
+
+        if (cmdp->type == CMD_NONE)
+        {
+            free(cmdp);
+            continue;
+        }
+
+        SDL_LockMutex(link_mutex);
+        {
+            queue_enq(link_queue, cmdp);
+
+            if (cmdp->type == CMD_END_OF_UPDATE)
+                link_count++;
+        }
+        SDL_UnlockMutex(link_mutex);
+    }
+
+    SDL_LockMutex(link_mutex);
+    link_done = 1;
+    SDL_UnlockMutex(link_mutex);
+
+    return 0;
+}
+
+/*
+ * Wait for a client at ADDR, then send it all commands.
+ */
+int game_proxy_listen(const char *addr)
+{
+    int fd;
+
+    game_proxy_close();
+
+    log_printf("Waiting for a client at %s\n", addr);
+
+#ifdef PROXY_SOCKETS
+    signal(SIGPIPE, SIG_IGN);
+#endif
+
+    if ((fd = link_socket(addr, 1)) >= 0 && (link_fp = fs_open_fd(fd, "wb")))
+    {
+        link_fd   = fd;
+        link_send = 1;
+        link_done = 0;
+        return 1;
+    }
+
+    log_printf("Failure to listen at %s\n", addr);
+    return 0;
+}
+
+/*
+ * Connect to a server at ADDR and receive its commands in the
+ * background.
+ */
+int game_proxy_connect(const char *addr)
+{
+    int fd;
+
+    game_proxy_close();
+
+    if ((fd = link_socket(addr, 0)) >= 0 && (link_fp = fs_open_fd(fd, "rb")))
+    {
+        link_fd    = fd;
+        link_send  = 0;
+        link_done  = 0;
+        link_count = 0;
+        link_queue = queue_new();
+        link_mutex = SDL_CreateMutex();
+
+        if (link_queue && link_mutex &&
+            (link_thread = SDL_CreateThread(link_func, "game_proxy", NULL)))
+            return 1;
+
+        game_proxy_close();
+    }
+
+    log_printf("Failure to connect to %s\n", addr);
+    return 0;
+}
+
+/*
+ * Move the next complete update received into the command queue.
+ */
+int game_proxy_step(void)
+{
+    union cmd *cmdp = NULL;
+    int n = 0;
+
+    if (!link_mutex)
+        return 0;
+
+    SDL_LockMutex(link_mutex);
+    {
+        if (link_count > 0)
+        {
+            while ((cmdp = queue_deq(link_queue)))
+            {
+                if (!cmd_queue)
+                    cmd_queue = queue_new();
+
+                queue_enq(cmd_queue, cmdp);
+                n++;
+
+                if (cmdp->type == CMD_END_OF_UPDATE)
+                    break;
+            }
+            link_count--;
+        }
+    }
+    SDL_UnlockMutex(link_mutex);
+
+    return n > 0;
+}
+
+/*
+ * Return the number of complete updates waiting, or -1 if the stream
+ * has ended and none are left.
+ */
+int game_proxy_pending(void)
+{
+    int n = -1;
+
+    if (link_mutex)
+    {
+        SDL_LockMutex(link_mutex);
+        n = (link_count || !link_done) ? link_count : -1;
+        SDL_UnlockMutex(link_mutex);
+    }
+    else if (link_fp)
+        n = 0;
+
+    return n;
+}
+
+void game_proxy_close(void)
+{
+    /* Shut the socket down to wake the reader, then close it. */
+
+    if (link_thread)
+    {
+#ifdef PROXY_SOCKETS
+        shutdown(link_fd, SHUT_RDWR);
+#endif
+        SDL_WaitThread(link_thread, NULL);
+        link_thread = NULL;
+    }
+
+    if (link_fp)
+    {
+        fs_close(link_fp);
+        link_fp = NULL;
+        link_fd = -1;
+    }
+
+    if (link_queue)
+    {
+        union cmd *cmdp;
+
+        while ((cmdp = queue_deq(link_queue)))
+            cmd_free(cmdp);
+
+        queue_free(link_queue);
+        link_queue = NULL;
+    }
+
+    if (link_mutex)
+    {
+        SDL_DestroyMutex(link_mutex);
+        link_mutex = NULL;
+    }
+
+    link_send  = 0;
+    link_count = 0;
+}
+
+/*---------------------------------------------------------------------------*/
@@ -8,4 +8,10 @@ void       game_proxy_enq(const union cmd *);
 union cmd *game_proxy_deq(void);
 void       game_proxy_clr(void);
 
+int        game_proxy_listen(const char *);
+int        game_proxy_connect(const char *);
+int        game_proxy_step(void);
+int        game_proxy_pending(void);
+void       game_proxy_close(void);
+
 #endif
@@ -15,6 +15,7 @@
 #include <SDL.h>
 #include <math.h>
 #include <assert.h>
+#include <string.h>
 
 #include "vec3.h"
 #include "geom.h"
@@ -218,6 +219,148 @@ static int input_get_action(int p)
 
 /*---------------------------------------------------------------------------*/
 
+/*
+ * Input replays hold the input changes at each server tick and the
+ * events the server receives from outside, rather than its output.
+ * Each record is a tick delta, a code (type, plus player in the high
+ * nibble) and a value.
+ */
+
+enum
+{
+    INPUT_NONE = 0,
+    INPUT_S,
+    INPUT_X,
+    INPUT_Z,
+    INPUT_R,
+    INPUT_C,
+    INPUT_ACTION,
+    INPUT_GOAL,
+    INPUT_RESPAWN,
+    INPUT_END
+};
+
+#define INPUT_DELTA_MAX 32767
+
+static fs_file input_rec_fp;
+static fs_file input_rep_fp;
+
+static struct input input_prev[MAX_PLAYERS];
+
+static int input_tick;                  /* Ticks run since server init       */
+static int input_last;                  /* Tick of the last record           */
+static int input_next;                  /* Tick of the pending record        */
+static int input_code;                  /* Code of the pending record        */
+static int input_step;                  /* Inside the server step            */
+
+static void input_put(int code, int p)
+{
+    fs_file fp = input_rec_fp;
+
+    while (input_tick - input_last > INPUT_DELTA_MAX)
+    {
+        put_short(fp, INPUT_DELTA_MAX);
+        fs_putc(INPUT_NONE, fp);
+        input_last += INPUT_DELTA_MAX;
+    }
+
+    put_short(fp, (short) (input_tick - input_last));
+    fs_putc(code | (p << 4), fp);
+
+    input_last = input_tick;
+}
+
+static void input_reset(void)
+{
+    memcpy(input_prev, input_players, sizeof (input_prev));
+
+    input_tick =  0;
+    input_last =  0;
+    input_next = -1;
+}
+
+/*
+ * Record the inputs that changed since the last tick.
+ */
+static void input_record(void)
+{
+    fs_file fp = input_rec_fp;
+    int p;
+
+    for (p = 0; p < player_count; p++)
+    {
+        const struct input *a = input_players + p;
+        const struct input *b = input_prev    + p;
+
+        if (a->s != b->s) { input_put(INPUT_S, p); put_float(fp, a->s); }
+        if (a->x != b->x) { input_put(INPUT_X, p); put_float(fp, a->x); }
+        if (a->z != b->z) { input_put(INPUT_Z, p); put_float(fp, a->z); }
+        if (a->r != b->r) { input_put(INPUT_R, p); put_float(fp, a->r); }
+
+        if (a->c != b->c)
+        {
+            input_put(INPUT_C, p);
+            put_short(fp, (short) a->c);
+        }
+        if (a->action != b->action)
+        {
+            input_put(INPUT_ACTION, p);
+            put_short(fp, (short) a->action);
+        }
+
+        input_prev[p] = *a;
+    }
+}
+
+/*
+ * Apply the recorded inputs and events due at this tick.
+ */
+static void input_replay(void)
+{
+    fs_file fp;
+
+    while ((fp = input_rep_fp))
+    {
+        int p;
+
+        if (input_next < 0)
+        {
+            input_next = input_last + get_short(fp);
+            input_code = fs_getc(fp);
+
+            if (input_code < 0 || fs_eof(fp))
+                input_code = INPUT_END;
+        }
+
+        if (input_next > input_tick)
+            break;
+
+        input_last = input_next;
+        input_next = -1;
+
+        p = CLAMP(0, input_code >> 4, MAX_PLAYERS - 1);
+
+        switch (input_code & 0xf)
+        {
+        case INPUT_NONE:                                              break;
+        case INPUT_S:      input_players[p].s      = get_float(fp);  break;
+        case INPUT_X:      input_players[p].x      = get_float(fp);  break;
+        case INPUT_Z:      input_players[p].z      = get_float(fp);  break;
+        case INPUT_R:      input_players[p].r      = get_float(fp);  break;
+        case INPUT_C:      input_players[p].c      = get_short(fp);  break;
+        case INPUT_ACTION: input_players[p].action = get_short(fp);  break;
+        case INPUT_GOAL:   game_set_goal(p);                          break;
+        case INPUT_RESPAWN: game_respawn(p);                          break;
+
+        default:
+            input_rep_fp = NULL;
+            break;
+        }
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
 /* Target Zones Configuration */
 static const struct target_zone zones[] = {
     {  2.0f, 500, { 1.0f, 0.0f, 0.0f, 0.5f } }, /* Red Bullseye */
@@ -761,6 +904,7 @@ int game_server_init(const char *file_name, int t, int e, int mode)
     }
 
     input_init();
+    input_reset();
 
     game_cmd_map(file_name, version.x, version.y);
     game_cmd_ups();
@@ -969,7 +1113,7 @@ static int game_update_state(int p, int bt)
 
     /* Test for an item. */
 
-    if (bt && (hi = sol_item_test(pl->sim_state, NULL, ITEM_RADIUS)) != -1)
+    if (bt && (hi = sol_item_test(pl->sim_state, pl->ball_index, ITEM_RADIUS)) != -1)
     {
         struct v_item *hp = pl->sim_state->hv + hi;
 
@@ -1039,12 +1183,12 @@ static int game_update_state(int p, int bt)
 
     /* Test for a switch. */
 
-    if (sol_swch_test(pl->sim_state, game_proxy_enq, 0) == SWCH_INSIDE)
+    if (sol_swch_test(pl->sim_state, game_proxy_enq, pl->ball_index) == SWCH_INSIDE)
         audio_play(AUD_SWITCH, 1.f);
 
     /* Test for a jump. */
 
-    if (pl->jump_e == 1 && pl->jump_b == 0 && (sol_jump_test(pl->sim_state, pl->jump_p, 0) ==
+    if (pl->jump_e == 1 && pl->jump_b == 0 && (sol_jump_test(pl->sim_state, pl->jump_p, pl->ball_index) ==
                                        JUMP_INSIDE))
     {
         pl->jump_b  = 1;
@@ -1055,7 +1199,7 @@ static int game_update_state(int p, int bt)
 
         game_cmd_jump(p, 1);
     }
-    if (pl->jump_e == 0 && pl->jump_b == 0 && (sol_jump_test(pl->sim_state, pl->jump_p, 0) ==
+    if (pl->jump_e == 0 && pl->jump_b == 0 && (sol_jump_test(pl->sim_state, pl->jump_p, pl->ball_index) ==
                                        JUMP_OUTSIDE))
     {
         pl->jump_e = 1;
@@ -1064,7 +1208,7 @@ static int game_update_state(int p, int bt)
 
     /* Test for a goal. */
 
-    if (bt && pl->goal_e && (zp = sol_goal_test(pl->sim_state, NULL, 0)))
+    if (bt && pl->goal_e && (zp = sol_goal_test(pl->sim_state, NULL, pl->ball_index)))
     {
         audio_play(AUD_GOAL, 1.0f);
         return GAME_GOAL;
@@ -1500,17 +1644,14 @@ static int game_step(int p, const float g[3], float dt, int bt)
                     game_cmd_upd_all_balls(p);
                 }
 
-                for (i = 0; i < pl->sim_state->uc; i++)
+                float b = sol_step_all(pl->sim_state, game_proxy_enq, h, dt, &i);
+
+                if (b > 0.5f && i >= 0)
                 {
-                    float b = sol_step(pl->sim_state, game_proxy_enq, h, dt, i, NULL);
-
-                    if (b > 0.5f)
-                    {
-                        float k = (b - 0.5f) * 2.0f;
-                        if      (pl->sim_state->uv[i].r > pl->sim_state->uv[i].sizes[1]) audio_play(AUD_BUMPL, k);
-                        else if (pl->sim_state->uv[i].r < pl->sim_state->uv[i].sizes[1]) audio_play(AUD_BUMPS, k);
-                        else                                                             audio_play(AUD_BUMPM, k);
-                    }
+                    float k = (b - 0.5f) * 2.0f;
+                    if      (pl->sim_state->uv[i].r > pl->sim_state->uv[i].sizes[1]) audio_play(AUD_BUMPL, k);
+                    else if (pl->sim_state->uv[i].r < pl->sim_state->uv[i].sizes[1]) audio_play(AUD_BUMPS, k);
+                    else                                                             audio_play(AUD_BUMPM, k);
                 }
             }
         }
@@ -1529,6 +1670,23 @@ static int game_step(int p, const float g[3], float dt, int bt)
 static void game_server_iter(float dt)
 {
     int p;
+
+    if (input_rec_fp) input_record();
+
+    if (input_rep_fp)
+    {
+        input_replay();
+
+        /* The recording ended before this tick. */
+
+        if (!input_rep_fp)
+            return;
+    }
+
+    /* Events raised by the step itself recur on playback: don't record. */
+
+    input_step = 1;
+
     for (p = 0; p < player_count; p++)
     {
         switch (players[p].status)
@@ -1547,10 +1705,14 @@ static void game_server_iter(float dt)
         }
     }
 
+    input_step = 0;
+
     game_cmd_eou();
+
+    input_tick++;
 }
 
-static struct lockstep server_step = { game_server_iter, DT };
+static struct lockstep server_step = { game_server_iter, DT, 0.0f, 1.0f, MAX_STEPS };
 
 void game_server_step(float dt)
 {
@@ -1569,6 +1731,9 @@ void game_set_goal(int p)
     audio_play(AUD_SWITCH, 1.0f);
     if (p >= 0 && p < MAX_PLAYERS)
     {
+        if (input_rec_fp && !input_step)
+            input_put(INPUT_GOAL, p);
+
         players[p].goal_e = 1;
         game_cmd_goalopen(p);
     }
@@ -1579,6 +1744,9 @@ void game_respawn(int p)
     struct server_player *pl = &players[p];
     if (p >= 0 && p < MAX_PLAYERS)
     {
+        if (input_rec_fp && !input_step)
+            input_put(INPUT_RESPAWN, p);
+
         v_cpy(pl->sim_state->uv[pl->ball_index].p, pl->start_p);
         v_scl(pl->sim_state->uv[pl->ball_index].v, pl->sim_state->uv[pl->ball_index].v, 0.0f);
         v_scl(pl->sim_state->uv[pl->ball_index].w, pl->sim_state->uv[pl->ball_index].w, 0.0f);
@@ -1648,6 +1816,51 @@ void game_set_action(int a, int p)
     input_set_action(p, a);
 }
 
+/*
+ * Record inputs to the given file, or stop recording.
+ */
+void game_server_record(fs_file fp)
+{
+    if (input_rec_fp && !fp)
+        input_put(INPUT_END, 0);
+
+    input_rec_fp = fp;
+}
+
+/*
+ * Take inputs from the given recording instead of the game.
+ */
+void game_server_replay(fs_file fp)
+{
+    input_rep_fp = fp;
+    input_next   = -1;
+}
+
+int game_server_replaying(void)
+{
+    return input_rep_fp != NULL;
+}
+
+/*
+ * Report the outcome for a player as stored in replays.
+ */
+void game_server_stat(int p, int *status, int *coins, int *timer)
+{
+    if (p >= 0 && p < player_count)
+    {
+        *status = players[p].status;
+        *coins  = players[p].coins;
+        *timer  = (int) (players[p].time_elapsed * 100.0f);
+    }
+    else
+        *status = *coins = *timer = 0;
+}
+
+int game_server_players(void)
+{
+    return player_count;
+}
+
 /*---------------------------------------------------------------------------*/
 
 float curr_time_elapsed(int p)
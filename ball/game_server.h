@@ -1,6 +1,8 @@
 #ifndef GAME_SERVER_H
 #define GAME_SERVER_H
 
+#include "fs.h"
+
 /*---------------------------------------------------------------------------*/
 
 #define RESPONSE    0.05f              /* Input smoothing time               */
@@ -22,6 +24,12 @@ void  game_server_free(const char *);
 void  game_server_step(float);
 float game_server_blend(void);
 
+void  game_server_record(fs_file);
+void  game_server_replay(fs_file);
+int   game_server_replaying(void);
+void  game_server_stat(int, int *, int *, int *);
+int   game_server_players(void);
+
 void  game_set_goal(int);
 void  game_respawn(int);
 
@@ -23,11 +23,20 @@
 #include <stdio.h>
 #include <string.h>
 
+#if !defined(_WIN32) && !defined(__EMSCRIPTEN__)
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#define VERIFY_FORK 1
+#endif
+
 #include "version.h"
 #include "glext.h"
+#include "fbo.h"
 #include "config.h"
 #include "video.h"
 #include "image.h"
+#include "capture.h"
 #include "audio.h"
 #include "demo.h"
 #include "progress.h"
@@ -36,6 +45,8 @@
 #include "tilt.h"
 #include "hmd.h"
 #include "fs.h"
+#include "fs_save.h"
+#include "pool.h"
 #include "common.h"
 #include "text.h"
 #include "mtrl.h"
@@ -44,7 +55,9 @@
 #include "fetch.h"
 #include "package.h"
 #include "log.h"
+#include "log_ring.h"
 #include "game_client.h"
+#include "game_proxy.h"
 #include "strbuf/substr.h"
 #include "strbuf/joinstr.h"
 #include "lang.h"
@@ -52,6 +65,7 @@
 #include "st_conf.h"
 #include "st_title.h"
 #include "st_demo.h"
+#include "st_play.h"
 #include "st_level.h"
 #include "st_pause.h"
 #include "st_common.h"
@@ -68,6 +82,16 @@ static char *opt_replay;
 static char *opt_level;
 static char *opt_link;
 static int   opt_multiball = 1;
+static char *opt_shots;
+static int   opt_shot_w;
+static int   opt_shot_h;
+static char **opt_verify;
+static int    opt_verify_n;
+static int    opt_jobs;
+static char  *opt_serve;
+static char  *opt_connect;
+static char  *opt_export;
+static int    opt_fps = 60;
 
 #define opt_usage                                                     \
     "Usage: %s [options ...]\n"                                       \
@@ -78,7 +102,17 @@ static int   opt_multiball = 1;
     "  -r, --replay <file>       play the replay 'file'.\n"           \
     "  -l, --level <file>        load the level 'file'\n"             \
     "      --link <asset>        open the named asset\n"              \
-    "      --multiball <n>       spawn n balls (debug)\n"
+    "      --multiball <n>       spawn n balls (debug)\n"            \
+    "      --shots <set-file>    write level shots of a set and exit\n" \
+    "      --shot-size <w>x<h>   size of level shots and exported video\n" \
+    "      --verify <replay>...  check input replays and exit\n"     \
+    "      --jobs <n>            verify with n processes\n"          \
+    "      --serve <addr>        stream the replay to a client at\n"  \
+    "                            'addr' (unix:<path> or <host>:<port>)\n" \
+    "      --connect <addr>      watch a game streamed from 'addr'\n" \
+    "      --export <path>       render the replay to 'path' and exit,\n" \
+    "                            raw RGB if it ends in .rgb, else PNGs\n" \
+    "      --fps <n>             frame rate of the exported video\n"
 
 #define opt_error(option) \
     fprintf(stderr, "Option '%s' requires an argument.\n", option)
@@ -159,6 +193,106 @@ static void opt_init(int argc, char **argv)
             continue;
         }
 
+        if (strcmp(argv[i], "--shots") == 0)
+        {
+            if (i + 1 == argc)
+            {
+                opt_error(argv[i]);
+                exit(EXIT_FAILURE);
+            }
+            opt_shots = argv[++i];
+            continue;
+        }
+
+        if (strcmp(argv[i], "--shot-size") == 0)
+        {
+            if (i + 1 == argc ||
+                sscanf(argv[i + 1], "%dx%d", &opt_shot_w, &opt_shot_h) != 2 ||
+                opt_shot_w < 1 || opt_shot_h < 1)
+            {
+                opt_error(argv[i]);
+                exit(EXIT_FAILURE);
+            }
+            i++;
+            continue;
+        }
+
+        if (strcmp(argv[i], "--jobs") == 0)
+        {
+            if (i + 1 == argc)
+            {
+                opt_error(argv[i]);
+                exit(EXIT_FAILURE);
+            }
+            opt_jobs = atoi(argv[++i]);
+            continue;
+        }
+
+        if (strcmp(argv[i], "--serve") == 0)
+        {
+            if (i + 1 == argc)
+            {
+                opt_error(argv[i]);
+                exit(EXIT_FAILURE);
+            }
+            opt_serve = argv[++i];
+            continue;
+        }
+
+        if (strcmp(argv[i], "--connect") == 0)
+        {
+            if (i + 1 == argc)
+            {
+                opt_error(argv[i]);
+                exit(EXIT_FAILURE);
+            }
+            opt_connect = argv[++i];
+            continue;
+        }
+
+        if (strcmp(argv[i], "--export") == 0)
+        {
+            if (i + 1 == argc)
+            {
+                opt_error(argv[i]);
+                exit(EXIT_FAILURE);
+            }
+            opt_export = argv[++i];
+            continue;
+        }
+
+        if (strcmp(argv[i], "--fps") == 0)
+        {
+            if (i + 1 == argc || (opt_fps = atoi(argv[i + 1])) < 1)
+            {
+                opt_error(argv[i]);
+                exit(EXIT_FAILURE);
+            }
+            i++;
+            continue;
+        }
+
+        /* The arguments up to the next option are replays to verify. */
+
+        if (strcmp(argv[i], "--verify") == 0)
+        {
+            opt_verify   = argv + i + 1;
+            opt_verify_n = 0;
+
+            while (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0)
+            {
+                opt_verify_n++;
+                i++;
+            }
+
+            if (opt_verify_n == 0)
+            {
+                opt_error(argv[i]);
+                exit(EXIT_FAILURE);
+            }
+            continue;
+        }
+
         /* Perform magic on a single unrecognized argument. */
 
         if (argc == 2)
@@ -196,6 +330,11 @@ static void opt_quit(void)
     opt_replay = NULL;
     opt_level = NULL;
     opt_link = NULL;
+    opt_shots = NULL;
+    opt_verify = NULL;
+    opt_serve = NULL;
+    opt_connect = NULL;
+    opt_export = NULL;
 }
 
 /*---------------------------------------------------------------------------*/
@@ -633,14 +772,14 @@ static int loop(void)
                 break;
 
             case SDL_WINDOWEVENT_RESIZED:
-                log_printf("Resize event (%u, %dx%d)\n",
+                log_message(LOG_DEBUG, "Resize event (%u, %dx%d)\n",
                            e.window.windowID,
                            e.window.data1,
                            e.window.data2);
                 break;
 
             case SDL_WINDOWEVENT_SIZE_CHANGED:
-                log_printf("Size change event (%u, %dx%d)\n",
+                log_message(LOG_DEBUG, "Size change event (%u, %dx%d)\n",
                            e.window.windowID,
                            e.window.data1,
                            e.window.data2);
@@ -826,6 +965,23 @@ struct main_loop
     unsigned int done:1;
 };
 
+/*
+ * Pick the frame rate cap: gameplay and demo playback use the main
+ * limit, menus can be held to a lower one.
+ */
+static int pace_limit(void)
+{
+    struct state *st = curr_state();
+
+    if (st == &st_play_ready ||
+        st == &st_play_set   ||
+        st == &st_play_loop  ||
+        st == &st_demo_play)
+        return config_get_d(CONFIG_FPS_LIMIT);
+
+    return config_get_d(CONFIG_FPS_LIMIT_MENU);
+}
+
 static void step(void *data)
 {
     struct main_loop *mainloop = (struct main_loop *) data;
@@ -847,6 +1003,7 @@ static void step(void *data)
 
             hmd_step();
             st_paint(0.001f * now);
+            video_pace(pace_limit());
             video_swap();
         }
 
@@ -870,20 +1027,58 @@ static void step(void *data)
 #endif
 }
 
+/*
+ * Time spent in each startup step, logged with CONFIG_STATS.
+ */
+static Uint64 init_time;
+static char   init_times[MAXSTR];
+
+static void init_mark(const char *step)
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+    char buf[MAXSTR];
+
+    sprintf(buf, " %s %.1f ms,", step,
+            1000.0 * (double) (now - init_time) / SDL_GetPerformanceFrequency());
+    SAFECAT(init_times, buf);
+
+    init_time = now;
+}
+
 /*
  * Initialize all systems.
  */
 static int main_init(int argc, char *argv[])
 {
+    init_time = SDL_GetPerformanceCounter();
+
     if (!fs_init(argc > 0 ? argv[0] : NULL))
     {
         fprintf(stderr, "Failure to initialize file system (%s)\n", fs_error());
         return 0;
     }
 
+    pool_init();
+
     opt_init(argc, argv);
 
     config_paths(opt_data);
+
+    /*
+     * Replay verification and serving run the server alone, possibly
+     * in several processes that would otherwise share the log.
+     */
+
+    if (opt_verify || opt_serve)
+    {
+        SDL_Init(SDL_INIT_TIMER);
+
+        config_init();
+        config_load();
+        package_init();
+        return 1;
+    }
+
     log_init("Neverball " VERSION, "neverball.log");
     make_dirs_and_migrate();
 
@@ -899,17 +1094,26 @@ static int main_init(int argc, char *argv[])
         return 0;
     }
 
+    init_mark("setup");
+
     /* Intitialize configuration. */
 
     config_init();
     config_load();
 
+    log_set_level(config_get_d(CONFIG_LOG_LEVEL));
+    log_ring_init();
+
+    init_mark("config");
+
     fetch_enable(config_get_d(CONFIG_ONLINE));
 
     package_init();
 
     package_set_installed_action(handle_installed_action);
 
+    init_mark("packages");
+
     /* Enable joystick events. */
 
     joy_init();
@@ -918,20 +1122,40 @@ static int main_init(int argc, char *argv[])
 
     lang_init();
 
+    init_mark("language");
+
     /* Initialize audio. */
 
-    audio_init();
+    /* An export runs faster than real time, so it plays no sound. */
+
+    if (!opt_export)
+        audio_init();
+
     tilt_init();
 
+    init_mark("audio");
+
     /* Initialize video. */
 
+    video_set_hidden(opt_shots != NULL || opt_export != NULL);
+
     if (!video_init())
         return 0;
 
+    init_mark("video");
+
     /* Material system. */
 
     mtrl_init();
 
+    init_mark("materials");
+
+    if (config_get_d(CONFIG_STATS))
+    {
+        init_times[strlen(init_times) - 1] = 0;
+        log_printf("Startup:%s\n", init_times);
+    }
+
     return 1;
 }
 
@@ -959,12 +1183,219 @@ static void main_quit(void)
     config_quit();
     package_quit();
     fetch_enable(0);
+    fs_save_quit();
+    log_ring_quit();
     SDL_Quit();
     log_quit();
+    pool_quit();
     fs_quit();
     opt_quit();
 }
 
+/*
+ * Write a shot of each level of the named set, without entering the
+ * game loop. With SDL_VIDEODRIVER=offscreen, SDL renders through EGL
+ * and no display is needed.
+ */
+static int main_shots(const char *file)
+{
+    int w = opt_shot_w ? opt_shot_w : config_get_d(CONFIG_WIDTH);
+    int h = opt_shot_h ? opt_shot_h : config_get_d(CONFIG_HEIGHT);
+    int s, n = 0;
+
+    set_init();
+
+    if ((s = set_find(base_name(file))) >= 0)
+    {
+        char *dir = concat_string("Screenshots/shot-", set_id(s), NULL);
+
+        set_goto(s);
+
+        fs_mkdir(dir);
+
+        n = set_snap(dir, w, h);
+
+        log_printf("Wrote %d level shots (%dx%d) to %s\n", n, w, h, dir);
+
+        free(dir);
+    }
+    else log_printf("Set %s not found\n", file);
+
+    return n;
+}
+
+/*
+ * Render the replay frame by frame at a fixed rate, independent of the
+ * wall clock, and capture each frame. Return the number of frames.
+ */
+static int main_export(void)
+{
+    const float dt = 1.0f / opt_fps;
+
+    int w = opt_shot_w ? opt_shot_w : config_get_d(CONFIG_WIDTH);
+    int h = opt_shot_h ? opt_shot_h : config_get_d(CONFIG_HEIGHT);
+    int n = 0;
+
+    fbo F = { 0 };
+
+    if (!opt_replay)
+    {
+        log_printf("Nothing to export, give a replay\n");
+        return 0;
+    }
+
+    if (!(fs_add_path(dir_name(opt_replay)) &&
+          progress_replay(base_name(opt_replay))))
+    {
+        log_printf("Failure to load replay %s\n", opt_replay);
+        return 0;
+    }
+
+    if (!(gli.framebuffer_object && fbo_create(&F, w, h)))
+    {
+        log_printf("Export limited to the window size (%dx%d)\n",
+                   video.device_w, video.device_h);
+
+        w = MIN(w, video.device_w);
+        h = MIN(h, video.device_h);
+    }
+
+    /* The HUD lays itself out to the video dimensions on entry. */
+
+    video.device_w = w;
+    video.device_h = h;
+
+    if (F.framebuffer)
+        glBindFramebuffer_(GL_FRAMEBUFFER, F.framebuffer);
+
+    glViewport(0, 0, w, h);
+
+    demo_play_goto(1);
+    goto_state(&st_demo_play);
+
+    if (capture_open(opt_export, w, h))
+    {
+        while (curr_state() == &st_demo_play)
+        {
+            st_timer(dt);
+            st_paint((float) n * dt);
+
+            /* Stop at the first frame that cannot be written. */
+
+            if (!capture_frame())
+                break;
+
+            n++;
+
+            if (!F.framebuffer)
+                video_swap();
+        }
+        n = capture_close();
+    }
+
+    if (F.framebuffer)
+    {
+        glBindFramebuffer_(GL_FRAMEBUFFER, 0);
+        fbo_delete(&F);
+    }
+    return n;
+}
+
+/*
+ * Verify every K-th replay on the command line, starting at FIRST.
+ * Return the number of failures.
+ */
+static int verify_replays(int first, int k)
+{
+    int i, n = 0;
+
+    for (i = first; i < opt_verify_n; i += k)
+    {
+        char *dir = strdup(dir_name(opt_verify[i]));
+        int added = fs_add_path(dir);
+
+        if (!demo_verify(base_name(opt_verify[i])))
+            n++;
+
+        if (added)
+            fs_remove_path(dir);
+
+        free(dir);
+    }
+    return n;
+}
+
+/*
+ * Re-simulate the named input replays without a display. The server
+ * state is global, so the list is split across processes rather than
+ * threads.
+ */
+static int main_verify(void)
+{
+    int jobs = opt_jobs > 0 ? opt_jobs : SDL_GetCPUCount();
+    int fail = 0;
+
+    jobs = CLAMP(1, jobs, opt_verify_n);
+
+#ifdef VERIFY_FORK
+    if (jobs > 1)
+    {
+        int k, status;
+
+        /* A child would inherit the ring but not its drain thread. */
+
+        log_ring_quit();
+
+        fflush(stdout);
+        fflush(stderr);
+
+        for (k = 0; k < jobs; k++)
+        {
+            pid_t pid = fork();
+
+            if (pid == 0)
+                exit(MIN(verify_replays(k, jobs), 255));
+
+            if (pid < 0)
+                fail += verify_replays(k, jobs);
+        }
+
+        while (wait(&status) > 0)
+            fail += WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+    }
+    else
+#endif
+        fail = verify_replays(0, 1);
+
+    log_printf("Verified %d replays with %d jobs, %d failed\n",
+               opt_verify_n, jobs, fail);
+
+    return fail;
+}
+
+/*
+ * Re-simulate an input replay and stream it to one linked client.
+ */
+static int main_serve(void)
+{
+    int rc = 0;
+
+    if (!opt_replay)
+        log_printf("Nothing to serve, give an input replay\n");
+
+    else
+    {
+        fs_add_path(dir_name(opt_replay));
+
+        if (game_proxy_listen(opt_serve))
+        {
+            rc = demo_serve(base_name(opt_replay));
+            game_proxy_close();
+        }
+    }
+    return rc;
+}
+
 int main(int argc, char *argv[])
 {
     struct main_loop mainloop = { 0 };
@@ -974,13 +1405,55 @@ int main(int argc, char *argv[])
     if (!main_init(argc, argv))
         return 1;
 
+    if (opt_verify || opt_serve)
+    {
+        int ok = opt_verify ? !main_verify() : main_serve();
+
+        package_quit();
+        config_quit();
+        log_ring_quit();
+        SDL_Quit();
+        pool_quit();
+        fs_quit();
+        opt_quit();
+
+        return ok ? 0 : 1;
+    }
+
     /* Screen states. */
 
     init_state(&st_null);
 
+    /* Batch level shots replace the game entirely... */
+
+    if (opt_shots)
+    {
+        int n = main_shots(opt_shots);
+
+        main_quit();
+
+        return n ? 0 : 1;
+    }
+
+    /* So does rendering a replay to video. */
+
+    if (opt_export)
+    {
+        int n = main_export();
+
+        main_quit();
+
+        return n ? 0 : 1;
+    }
+
     /* Initialize demo playback or load the level. */
 
-    if (opt_replay && fs_add_path(dir_name(opt_replay)) && progress_replay(base_name(opt_replay)))
+    if (opt_connect && progress_link(opt_connect))
+    {
+        demo_play_goto(1);
+        start_state = &st_demo_play;
+    }
+    else if (opt_replay && fs_add_path(dir_name(opt_replay)) && progress_replay(base_name(opt_replay)))
     {
         demo_play_goto(1);
         start_state = &st_demo_play;
@@ -105,7 +105,8 @@ void progress_init(int m)
 static int init_level(void)
 {
     demo_play_init(USER_REPLAY_FILE, level, mode,
-                   curr[0].score, curr[0].balls, curr[0].times);
+                   curr[0].score, curr[0].balls, curr[0].times,
+                   lprog[0].goal_e);
 
     /*
      * Init both client and server, then process the first batch
@@ -303,6 +304,17 @@ int  progress_replay(const char *filename)
         return 0;
 }
 
+int  progress_link(const char *addr)
+{
+    if (demo_link_init(addr))
+    {
+        replay = 1;
+        return 1;
+    }
+    else
+        return 0;
+}
+
 int  progress_next_avail(void)
 {
     if (next)
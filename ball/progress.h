@@ -21,6 +21,7 @@ int  progress_same(void);
 void progress_rename(int);
 
 int  progress_replay(const char *);
+int  progress_link(const char *);
 
 int  progress_dead(void);
 int  progress_done(void);
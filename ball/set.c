@@ -12,6 +12,7 @@
  * General Public License for more details.
  */
 
+#include <SDL.h>
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
@@ -20,10 +21,13 @@
 #include "config.h"
 #include "video.h"
 #include "image.h"
+#include "fbo.h"
 #include "set.h"
 #include "common.h"
 #include "fs.h"
+#include "fs_save.h"
 #include "log.h"
+#include "pool.h"
 #include "lang.h"
 
 #include "game_server.h"
@@ -105,7 +109,7 @@ void set_store_hs(void)
     const struct set *s = SET_GET(sets, curr);
     fs_file fp;
 
-    if ((fp = fs_open_write(config_cheat() ? s->cheat_scores : s->user_scores)))
+    if ((fp = fs_open_buffer()))
     {
         int i;
 
@@ -130,7 +134,7 @@ void set_store_hs(void)
             put_score(fp, &l->scores[SCORE_COIN]);
         }
 
-        fs_close(fp);
+        fs_save_commit(fp, config_cheat() ? s->cheat_scores : s->user_scores);
     }
 }
 
@@ -234,9 +238,12 @@ static void set_load_hs_v2(fs_file fp, struct set *s, char *buf, int size)
 static void set_load_hs(void)
 {
     struct set *s = SET_GET(sets, curr);
+    const char *path = config_cheat() ? s->cheat_scores : s->user_scores;
     fs_file fp;
 
-    if ((fp = fs_open_read(config_cheat() ? s->cheat_scores : s->user_scores)))
+    fs_save_wait(path);
+
+    if ((fp = fs_open_read(path)))
     {
         char buf[MAXSTR];
 
@@ -366,25 +373,51 @@ static int cmp_dir_items(const void *A, const void *B)
     return strcmp(a->path, b->path);
 }
 
-static int set_is_loaded(const char *path)
+static int is_set_file(struct dir_item *item)
 {
-    return (set_find(path) >= 0);
+    return (str_starts_with(base_name(item->path), "set-") &&
+            str_ends_with(item->path, ".txt"));
 }
 
-static int is_unseen_set(struct dir_item *item)
+static int is_listed_set(Array names, int n, const char *path)
 {
-    return (str_starts_with(base_name(item->path), "set-") &&
-            str_ends_with(item->path, ".txt") &&
-            !set_is_loaded(item->path));
+    int i;
+
+    for (i = 0; i < n; i++)
+        if (strcmp(*((char **) array_get(names, i)), path) == 0)
+            return 1;
+
+    return 0;
+}
+
+/*
+ * Set files are loaded on a few threads, into slots kept in order.
+ */
+struct set_job
+{
+    Array names;
+    Array slots;
+    int  *loaded;
+};
+
+static void set_load_job(void *data, int i)
+{
+    struct set_job *job = data;
+
+    job->loaded[i] = set_load(array_get(job->slots, i),
+                              *((char **) array_get(job->names, i)));
 }
 
 int set_init(void)
 {
+    Uint32 t0 = SDL_GetTicks();
+
+    struct set_job job;
     fs_file fin;
     char *name;
 
     Array items;
-    int i;
+    int i, n;
 
     if (sets)
         set_quit();
@@ -392,21 +425,17 @@ int set_init(void)
     sets = array_new(sizeof (struct set));
     curr = 0;
 
+    job.names = array_new(sizeof (char *));
+
     /*
-     * First, load the sets listed in the set file, preserving order.
+     * First, list the sets named in the set file, preserving order.
      */
 
     if ((fin = fs_open_read(SET_FILE)))
     {
         while (read_line(&name, fin))
-        {
-            struct set *s = array_add(sets);
+            *((char **) array_add(job.names)) = name;
 
-            if (!set_load(s, name))
-                array_del(sets);
-
-            free(name);
-        }
         fs_close(fin);
     }
 
@@ -415,21 +444,54 @@ int set_init(void)
      * them after the first group in alphabetic order.
      */
 
-    if ((items = fs_dir_scan("", is_unseen_set)))
+    n = array_len(job.names);
+
+    if ((items = fs_dir_scan("", is_set_file)))
     {
         array_sort(items, cmp_dir_items);
 
         for (i = 0; i < array_len(items); i++)
         {
-            struct set *s = array_add(sets);
+            const char *path = DIR_ITEM_GET(items, i)->path;
 
-            if (!set_load(s, DIR_ITEM_GET(items, i)->path))
-                array_del(sets);
+            if (!is_listed_set(job.names, n, path))
+                *((char **) array_add(job.names)) = strdup(path);
         }
 
         fs_dir_free(items);
     }
 
+    /* Load them all, and keep those that loaded. */
+
+    n = array_len(job.names);
+
+    job.slots  = array_new(sizeof (struct set));
+    job.loaded = calloc(n, sizeof (int));
+
+    for (i = 0; i < n; i++)
+        array_add(job.slots);
+
+    if (job.loaded)
+    {
+        pool_run(n, set_load_job, &job);
+
+        for (i = 0; i < n; i++)
+            if (job.loaded[i])
+                memcpy(array_add(sets), array_get(job.slots, i),
+                       sizeof (struct set));
+    }
+
+    for (i = 0; i < n; i++)
+        free(*((char **) array_get(job.names, i)));
+
+    free(job.loaded);
+    array_free(job.slots);
+    array_free(job.names);
+
+    if (config_get_d(CONFIG_STATS))
+        log_printf("Loaded %d sets in %u ms\n", array_len(sets),
+                   (unsigned int) (SDL_GetTicks() - t0));
+
     return array_len(sets);
 }
 
@@ -613,20 +675,11 @@ void set_rename_player(int score_rank, int times_rank, const char *player)
 
 /*---------------------------------------------------------------------------*/
 
-void level_snap(int i, const char *path)
+/*
+ * Render the preview pose of level I into the current draw buffer.
+ */
+static int level_draw_snap(int i)
 {
-    char *filename;
-
-    /* Convert the level name to a PNG filename. */
-
-    filename = concat_string(path,
-                             "/",
-                             base_name_sans(level_v[i].file, ".sol"),
-                             ".png",
-                             NULL);
-
-    /* Initialize the game for a snapshot. */
-
     if (game_client_init(level_v[i].file))
     {
         union cmd cmd;
@@ -634,12 +687,30 @@ void level_snap(int i, const char *path)
         game_proxy_enq(&cmd);
         game_client_sync(NULL);
 
-        /* Render the level and grab the screen. */
-
         video_clear();
         game_client_fly(1.0f);
         game_kill_fade();
         game_client_draw(POSE_LEVEL, 0);
+        return 1;
+    }
+    return 0;
+}
+
+static char *level_snap_name(int i, const char *path)
+{
+    return concat_string(path, "/",
+                         base_name_sans(level_v[i].file, ".sol"),
+                         ".png", NULL);
+}
+
+void level_snap(int i, const char *path)
+{
+    char *filename = level_snap_name(i, path);
+
+    /* Render the level and grab the screen. */
+
+    if (level_draw_snap(i))
+    {
         video_snap(filename);
         video_swap();
     }
@@ -647,6 +718,71 @@ void level_snap(int i, const char *path)
     free(filename);
 }
 
+/*
+ * Take a W by H snapshot of each level of the current set, writing them
+ * to PATH. Levels are drawn to an off-screen framebuffer where possible,
+ * so the size is not limited by the window, and encoded in the
+ * background while the next level renders. Return the number of levels.
+ */
+int set_snap(const char *path, int w, int h)
+{
+    int device_w = video.device_w;
+    int device_h = video.device_h;
+
+    fbo F = { 0 };
+    int i, n = 0;
+
+    if (!(gli.framebuffer_object && fbo_create(&F, w, h)))
+    {
+        log_printf("Snapshots limited to the window size (%dx%d)\n",
+                   device_w, device_h);
+
+        w = MIN(w, device_w);
+        h = MIN(h, device_h);
+    }
+
+    /* The game renderer takes its viewport from the video dimensions. */
+
+    video.device_w = w;
+    video.device_h = h;
+
+    if (F.framebuffer)
+        glBindFramebuffer_(GL_FRAMEBUFFER, F.framebuffer);
+
+    for (i = 0; i < MAXLVL; i++)
+        if (level_exists(i))
+        {
+            char *filename = level_snap_name(i, path);
+
+            if (level_draw_snap(i))
+            {
+                image_snap_async(filename, w, h);
+                n++;
+            }
+            free(filename);
+
+            /* Keep the window responsive during a long batch. */
+
+            if (!F.framebuffer)
+                video_swap();
+        }
+
+    image_snap_wait();
+
+    if (F.framebuffer)
+    {
+        glBindFramebuffer_(GL_FRAMEBUFFER, 0);
+        fbo_delete(&F);
+    }
+
+    video.device_w = device_w;
+    video.device_h = device_h;
+
+    glViewport(0, 0, device_w, device_h);
+
+    return n;
+}
+
 void set_cheat(void)
 {
     int i;
@@ -42,6 +42,7 @@ void set_store_hs(void);
 struct level *get_level(int);
 
 void level_snap(int, const char *);
+int  set_snap(const char *, int, int);
 void set_cheat(void);
 
 /*---------------------------------------------------------------------------*/
@@ -18,6 +18,7 @@
 #include "geom.h"
 #include "ball.h"
 #include "part.h"
+#include "inst.h"
 #include "audio.h"
 #include "config.h"
 #include "video.h"
@@ -28,6 +29,7 @@
 #include "game_common.h"
 #include "game_client.h"
 #include "game_server.h"
+#include "game_draw.h"
 
 #include "st_conf.h"
 #include "st_title.h"
@@ -243,6 +245,8 @@ static int null_enter(struct state *st, struct state *prev, int intent)
     geom_free();
     ball_free();
     shad_free();
+    inst_free();
+    game_refl_free();
     part_free();
     mtrl_free_objects();
 
@@ -253,6 +257,7 @@ static int null_leave(struct state *st, struct state *next, int id, int intent)
 {
     mtrl_load_objects();
     part_init();
+    inst_init();
     shad_init();
     ball_init();
     geom_init();
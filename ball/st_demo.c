@@ -685,7 +685,7 @@ static int demo_end_gui(void)
 
             if (demo_paused)
                 gui_start(jd, _("Continue"), GUI_SML, DEMO_CONTINUE, 0);
-            else
+            else if (curr_demo()[0])
                 gui_state(jd, _("Repeat"),   GUI_SML, DEMO_REPLAY,   0);
         }
 
@@ -135,7 +135,7 @@ static int level_enter(struct state *st, struct state *prev, int intent)
 {
     game_client_fly(1.0f);
 
-    if (check_nodemo && !demo_fp)
+    if (check_nodemo && !demo_recording())
     {
         goto_state(&st_nodemo);
         return 0;
@@ -21,6 +21,7 @@
 #include "util.h"
 #include "common.h"
 #include "key.h"
+#include "tex_cache.h"
 
 #include "game_common.h"
 
@@ -82,6 +83,12 @@ static int set_action(int tok, int val)
     return 1;
 }
 
+static void set_prefetch(int i)
+{
+    if (set_exists(i))
+        tex_cache_prefetch(set_shot(i));
+}
+
 static void gui_set(int id, int i)
 {
     if (set_exists(i))
@@ -133,6 +140,11 @@ static int set_gui(void)
                 {
                     for (i = first; i < first + SET_STEP; i++)
                         gui_set(ld, i);
+
+                    /* Decode the other shots of this page ahead of time. */
+
+                    for (i = first + 1; i < first + SET_STEP; i++)
+                        set_prefetch(i);
                 }
             }
 
@@ -177,6 +189,9 @@ static void set_over(int i)
 {
     gui_set_image(shot_id, set_shot(i));
     gui_set_multi(desc_id, set_desc(i));
+
+    set_prefetch(i - 1);
+    set_prefetch(i + 1);
 }
 
 static void set_point(int id, int x, int y, int dx, int dy)
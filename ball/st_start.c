@@ -21,6 +21,7 @@
 #include "config.h"
 #include "common.h"
 #include "key.h"
+#include "tex_cache.h"
 
 #include "game_common.h"
 
@@ -81,6 +82,14 @@ static void gui_level(int id, int i)
     }
 }
 
+static void start_prefetch(int i)
+{
+    struct level *l = get_level(i);
+
+    if (l && (level_opened(l) || config_cheat()))
+        tex_cache_prefetch(level_shot(l));
+}
+
 static void start_over_level(int i)
 {
     struct level *l = get_level(i);
@@ -95,6 +104,13 @@ static void start_over_level(int i)
 
         if (file_id)
             gui_set_label(file_id, level_file(l));
+
+        /* Decode the neighbours in the level grid ahead of time. */
+
+        start_prefetch(i - 1);
+        start_prefetch(i + 1);
+        start_prefetch(i - 5);
+        start_prefetch(i + 5);
     }
 }
 
@@ -311,15 +327,12 @@ static int start_keybd(int c, int d)
         {
             char *dir = concat_string("Screenshots/shot-",
                                       set_id(curr_set()), NULL);
-            int i;
 
             fs_mkdir(dir);
 
-            /* Iterate over all levels, taking a screenshot of each. */
+            /* Take a screenshot of each level at the window size. */
 
-            for (i = 0; i < MAXLVL; i++)
-                if (level_exists(i))
-                    level_snap(i, dir);
+            set_snap(dir, video.device_w, video.device_h);
 
             free(dir);
         }
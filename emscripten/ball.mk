@@ -84,15 +84,19 @@ BALL_SRCS := \
 	share/base_config.c \
 	share/base_image.c \
 	share/binary.c \
+	share/capture.c \
 	share/cmd.c \
 	share/common.c \
 	share/config.c \
 	share/dir.c \
+	share/fbo.c \
 	share/fetch_emscripten.c \
 	share/font.c \
+	share/frustum.c \
 	share/fs_common.c \
 	share/fs_jpg.c \
 	share/fs_png.c \
+	share/fs_save.c \
 	share/fs_stdio.c \
 	share/miniz.c \
 	share/geom.c \
@@ -102,14 +106,20 @@ BALL_SRCS := \
 	share/gui.c \
 	share/hmd_null.c \
 	share/image.c \
+	share/image_cache.c \
+	share/inst.c \
 	share/joy.c \
 	share/lang.c \
 	share/list.c \
+	share/lockstep.c \
 	share/log.c \
+	share/log_ring.c \
 	share/mtrl.c \
 	share/package.c \
 	share/part.c \
+	share/pool.c \
 	share/queue.c \
+	share/sha256.c \
 	share/solid_all.c \
 	share/solid_base.c \
 	share/solid_draw.c \
@@ -118,6 +128,7 @@ BALL_SRCS := \
 	share/st_common.c \
 	share/st_package.c \
 	share/state.c \
+	share/tex_cache.c \
 	share/text.c \
 	share/theme.c \
 	share/tilt_null.c \
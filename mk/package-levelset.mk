@@ -53,6 +53,16 @@ manifest: package
 screenshot: package manifest
 	cp $(DATA_DIR)/$(SET_SHOT) $(PACKAGE_SCREENSHOT)
 
-.PHONY: all package screenshot manifest
+# Render a shot of every level into the user's Screenshots/shot-<set-id>
+# directory. SDL's offscreen video driver renders through EGL, so no display
+# is needed (SDL 2.0.22 or later).
+NEVERBALL ?= ./neverball
+SHOT_SIZE ?= 640x480
+SHOT_ENV ?= SDL_VIDEODRIVER=offscreen
+
+levelshots:
+	$(SHOT_ENV) $(NEVERBALL) --data $(DATA_DIR) --shots $(notdir $(SET_FILE)) --shot-size $(SHOT_SIZE)
+
+.PHONY: all package screenshot manifest levelshots
 
 GNUMAKEFLAGS = --no-print-directory
\ No newline at end of file
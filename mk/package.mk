@@ -1,6 +1,7 @@
 # Make a Neverball package. SOLs must already be compiled.
 #
-# This also creates a baseline manifest with package name, filename and size.
+# This also creates a baseline manifest with package name, filename, size and
+# SHA-256 hash. The game mounts no downloaded package without the hash.
 #
 # Usage:
 #
@@ -59,6 +60,6 @@ package: output-dir
 	rm -rf "$(PACKAGE_TMP)"
 
 manifest: output-dir package
-	printf 'package %s\nfilename %s\nsize %s\n' $(PACKAGE_ID) $(PACKAGE_ZIP) $(shell du -b $(OUTPUT_DIR)/$(PACKAGE_ZIP) | cut -f1) > $(OUTPUT_DIR)/$(PACKAGE_MANIFEST)
+	printf 'package %s\nfilename %s\nsize %s\nsha256 %s\n' $(PACKAGE_ID) $(PACKAGE_ZIP) $(shell du -b $(OUTPUT_DIR)/$(PACKAGE_ZIP) | cut -f1) $(shell sha256sum $(OUTPUT_DIR)/$(PACKAGE_ZIP) | cut -c -64) > $(OUTPUT_DIR)/$(PACKAGE_MANIFEST)
 
 .PHONY: all output-dir package manifest
\ No newline at end of file
@@ -21,6 +21,7 @@
 #include "course.h"
 #include "hole.h"
 #include "fs.h"
+#include "pool.h"
 
 /*---------------------------------------------------------------------------*/
 
@@ -73,64 +74,106 @@ static int cmp_dir_items(const void *A, const void *B)
     return strcmp(a->path, b->path);
 }
 
-static int course_is_loaded(const char *path)
+static int is_course_file(struct dir_item *item)
+{
+    return (str_starts_with(base_name(item->path), "holes-") &&
+            str_ends_with(item->path, ".txt"));
+}
+
+static int is_listed_course(Array names, int n, const char *path)
 {
     int i;
 
-    for (i = 0; i < count; i++)
-        if (strcmp(course_v[i].holes, path) == 0)
+    for (i = 0; i < n; i++)
+        if (strcmp(*((char **) array_get(names, i)), path) == 0)
             return 1;
 
     return 0;
 }
 
-static int is_unseen_course(struct dir_item *item)
+/*
+ * Course files are loaded on a few threads, into slots kept in order.
+ */
+struct course_job
 {
-    return (str_starts_with(base_name(item->path), "holes-") &&
-            str_ends_with(item->path, ".txt") &&
-            !course_is_loaded(item->path));
+    Array names;
+    struct course *slots;
+    int *loaded;
+};
+
+static void course_load_job(void *data, int i)
+{
+    struct course_job *job = data;
+
+    job->loaded[i] = course_load(job->slots + i,
+                                 *((char **) array_get(job->names, i)));
 }
 
 void course_init(void)
 {
+    struct course_job job;
     fs_file fin;
     char *line;
 
     Array items;
-    int i;
+    int i, n;
 
     if (course_state)
         course_free();
 
     count = 0;
 
+    job.names = array_new(sizeof (char *));
+
     if ((fin = fs_open_read(COURSE_FILE)))
     {
-        while (count < MAXCRS && read_line(&line, fin))
-        {
-            if (course_load(&course_v[count], line))
-                count++;
-
-            free(line);
-        }
+        while (read_line(&line, fin))
+            *((char **) array_add(job.names)) = line;
 
         fs_close(fin);
 
         course_state = 1;
     }
 
-    if ((items = fs_dir_scan("", is_unseen_course)))
+    n = array_len(job.names);
+
+    if ((items = fs_dir_scan("", is_course_file)))
     {
         array_sort(items, cmp_dir_items);
 
-        for (i = 0; i < array_len(items) && count < MAXCRS; i++)
-            if (course_load(&course_v[count], DIR_ITEM_GET(items, i)->path))
-                count++;
+        for (i = 0; i < array_len(items); i++)
+        {
+            const char *path = DIR_ITEM_GET(items, i)->path;
+
+            if (!is_listed_course(job.names, n, path))
+                *((char **) array_add(job.names)) = strdup(path);
+        }
 
         fs_dir_free(items);
 
         course_state = 1;
     }
+
+    n = array_len(job.names);
+
+    job.slots  = calloc(n, sizeof (struct course));
+    job.loaded = calloc(n, sizeof (int));
+
+    if (job.slots && job.loaded)
+    {
+        pool_run(n, course_load_job, &job);
+
+        for (i = 0; i < n && count < MAXCRS; i++)
+            if (job.loaded[i])
+                course_v[count++] = job.slots[i];
+    }
+
+    for (i = 0; i < n; i++)
+        free(*((char **) array_get(job.names, i)));
+
+    free(job.loaded);
+    free(job.slots);
+    array_free(job.names);
 }
 
 int course_exists(int i)
@@ -27,6 +27,7 @@
 #include "audio.h"
 #include "config.h"
 #include "video.h"
+#include "lockstep.h"
 
 #include "solid_draw.h"
 #include "solid_sim.h"
@@ -35,6 +36,7 @@
 /*---------------------------------------------------------------------------*/
 
 static struct s_full file;
+static struct s_lerp lerp;
 static int           ball;
 
 static int state;
@@ -57,6 +59,12 @@ static float jump_p[3];                 /* Jump destination                  */
 
 static float idle_t;                    /* Idling timeout                    */
 
+static struct lockstep putt_step;
+
+static float step_g[3];                 /* Gravity of the current frame      */
+static float step_b;                    /* Hardest bounce of the frame       */
+static int   step_s;                    /* First state change of the frame   */
+
 /*---------------------------------------------------------------------------*/
 
 static void view_init(void)
@@ -101,6 +109,9 @@ int game_init(const char *s)
         return 0;
 
     sol_init_sim(&file.vary);
+    sol_load_lerp(&lerp, &file.vary);
+
+    lockstep_clr(&putt_step);
 
     for (i = 0; i < file.base.dc; i++)
     {
@@ -120,12 +131,37 @@ int game_init(const char *s)
 
 void game_free(void)
 {
+    sol_free_lerp(&lerp);
     sol_quit_sim();
     sol_free_full(&file);
 }
 
 /*---------------------------------------------------------------------------*/
 
+/*
+ * The simulation advances in fixed ticks, so the varying state usually
+ * lags the frame by a fraction of a tick. Rendering blends the last two
+ * ticks for the duration of a frame and then restores the exact state.
+ */
+
+static void game_lerp_push(void)
+{
+    sol_lerp_apply(&lerp, lockstep_blend(&putt_step));
+}
+
+static void game_lerp_pop(void)
+{
+    sol_lerp_reset(&lerp);
+}
+
+static void game_lerp_sync(void)
+{
+    sol_lerp_store(&lerp);
+    sol_lerp_copy(&lerp);
+}
+
+/*---------------------------------------------------------------------------*/
+
 static void game_draw_vect(struct s_rend *rend, const struct s_vary *fp)
 {
     if (view_m > 0.f)
@@ -253,21 +289,6 @@ static void game_draw_beams(struct s_rend *rend, const struct s_base *bp,
 
 /*---------------------------------------------------------------------------*/
 
-static void game_shadow_conf(int enable)
-{
-    if (enable && config_get_d(CONFIG_SHADOW))
-    {
-        tex_env_select(&tex_env_shadow_clip,
-                       &tex_env_shadow,
-                       &tex_env_default,
-                       NULL);
-    }
-    else
-    {
-        tex_env_active(&tex_env_default);
-    }
-}
-
 void game_draw(int pose, float t)
 {
     const float light_p[4] = { 8.f, 32.f, 8.f, 0.f };
@@ -280,9 +301,8 @@ void game_draw(int pose, float t)
     if (!state)
         return;
 
-    fp->shadow_ui = ball;
-
-    game_shadow_conf(1);
+    game_lerp_push();
+    tex_env_active(&tex_env_default);
     r_draw_enable(&rend);
 
     if (jump_b) fov *= 2.0f * fabsf(jump_dt - 0.5f);
@@ -317,13 +337,16 @@ void game_draw(int pose, float t)
         }
         glPopMatrix();
 
-        glEnable(GL_LIGHT0);
+        light_enable(0, 1);
         glLightfv(GL_LIGHT0, GL_POSITION, light_p);
 
         /* Draw the floor. */
 
         sol_draw(fp, &rend, 0, 1);
 
+        if (config_get_d(CONFIG_SHADOW))
+            sol_shad(fp, &rend, ball);
+
         /* Draw the game elements. */
 
         glEnable(GL_BLEND);
@@ -348,7 +371,7 @@ void game_draw(int pose, float t)
     video_pop_matrix();
 
     r_draw_disable(&rend);
-    game_shadow_conf(0);
+    game_lerp_pop();
 }
 
 /*---------------------------------------------------------------------------*/
@@ -369,8 +392,10 @@ void game_update_view(float dt)
 
     /* Center the view about the ball. */
 
+    game_lerp_push();
     v_cpy(view_c, file.vary.uv[ball].p);
     v_inv(view_v, file.vary.uv[ball].v);
+    game_lerp_pop();
 
     switch (config_get_d(CONFIG_CAMERA))
     {
@@ -480,37 +505,25 @@ static int game_update_state(float dt)
 }
 
 /*
- * On  most  hardware, rendering  requires  much  more  computing power  than
- * physics.  Since  physics takes less time  than graphics, it  make sense to
- * detach  the physics update  time step  from the  graphics frame  rate.  By
- * performing multiple physics updates for  each graphics update, we get away
- * with higher quality physics with little impact on overall performance.
- *
- * Toward this  end, we establish a  baseline maximum physics  time step.  If
- * the measured  frame time  exceeds this  maximum, we cut  the time  step in
- * half, and  do two updates.  If THIS  time step exceeds the  maximum, we do
- * four updates.  And  so on.  In this way, the physics  system is allowed to
- * seek an optimal update rate independent of, yet in integral sync with, the
- * graphics frame rate.
+ * Physics runs at a fixed tick rate, decoupled from the graphics frame
+ * rate. Each tick takes the same time step regardless of the hardware,
+ * so the outcome of a shot is reproducible and the cost of a frame is
+ * bounded by the number of ticks it spans.
  */
 
-int game_step(const float g[3], float dt)
+static void game_tick(float dt)
 {
     struct s_vary *fp = &file.vary;
 
-    static float s = 0.f;
-    static float t = 0.f;
-
-    float d = 0.f;
-    float b = 0.f;
     float st = 0.f;
-    int i, n = 1, m = 0;
+    int m = 0;
 
-    if (!state)
-        return GAME_NONE;
+    /* Stop stepping at the first state change of the frame. */
 
-    s = (7.f * s + dt) / 8.f;
-    t = s;
+    if (step_s != GAME_NONE)
+        return;
+
+    sol_lerp_copy(&lerp);
 
     if (jump_b)
     {
@@ -531,30 +544,40 @@ int game_step(const float g[3], float dt)
     {
         /* Run the sim. */
 
-        while (t > MAX_DT && n < MAX_DN)
-        {
-            t /= 2;
-            n *= 2;
-        }
+        float b = sol_step(fp, NULL, step_g, dt, ball, &m);
 
-        for (i = 0; i < n; i++)
-        {
-            d = sol_step(fp, NULL, g, t, ball, &m);
+        if (step_b < b)
+            step_b = b;
+        if (m)
+            st = dt;
+    }
 
-            if (b < d)
-                b = d;
-            if (m)
-                st += t;
-        }
+    sol_lerp_store(&lerp);
 
-        /* Mix the sound of a ball bounce. */
+    step_s = game_update_state(st);
+}
 
-        if (b > 0.5f)
-            audio_play(AUD_BUMP, (b - 0.5f) * 2.0f);
-    }
+static struct lockstep putt_step = { game_tick, DT, 0.0f, 1.0f, MAX_STEPS };
+
+int game_step(const float g[3], float dt)
+{
+    if (!state)
+        return GAME_NONE;
+
+    v_cpy(step_g, g);
+
+    step_b = 0.f;
+    step_s = GAME_NONE;
+
+    lockstep_run(&putt_step, dt);
+
+    /* Mix the sound of a ball bounce. */
+
+    if (step_b > 0.5f)
+        audio_play(AUD_BUMP, (step_b - 0.5f) * 2.0f);
 
     game_update_view(dt);
-    return game_update_state(st);
+    return step_s;
 }
 
 void game_putt(void)
@@ -706,6 +729,8 @@ void game_set_pos(float p[3], float e[3][3])
     v_cpy(file.vary.uv[ball].e[0], e[0]);
     v_cpy(file.vary.uv[ball].e[1], e[1]);
     v_cpy(file.vary.uv[ball].e[2], e[2]);
+
+    game_lerp_sync();
 }
 
 /*---------------------------------------------------------------------------*/
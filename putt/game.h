@@ -22,8 +22,9 @@
 
 /*---------------------------------------------------------------------------*/
 
-#define MAX_DT  (1.0f / 60.0f)         /* Maximum physics update cycle       */
-#define MAX_DN  16                     /* Maximum subdivisions of dt         */
+#define UPS     90                     /* Physics updates per second         */
+#define DT      (1.0f / (float) UPS)   /* Physics update cycle               */
+#define MAX_STEPS (UPS / 10)           /* Max catch-up steps per frame       */
 #define FOV     50.00f                 /* Field of view                      */
 #define RESPONSE 0.05f                 /* Input smoothing time               */
 
@@ -35,8 +35,11 @@
 #include "gui.h"
 #include "hmd.h"
 #include "fs.h"
+#include "fs_save.h"
+#include "pool.h"
 #include "joy.h"
 #include "log.h"
+#include "log_ring.h"
 #include "common.h"
 #include "lang.h"
 #include "key.h"
@@ -308,6 +311,8 @@ int main(int argc, char *argv[])
         return 1;
     }
 
+    pool_init();
+
     srand((int) time(NULL));
 
     opt_parse(argc, argv);
@@ -323,6 +328,9 @@ int main(int argc, char *argv[])
         config_init();
         config_load();
 
+        log_set_level(config_get_d(CONFIG_LOG_LEVEL));
+        log_ring_init();
+
         /* Initialize localization. */
 
         lang_init();
@@ -379,6 +387,7 @@ int main(int argc, char *argv[])
                     st_timer((t1 - t0) / 1000.f);
                     hmd_step();
                     st_paint(0.001f * t1);
+                    video_pace(config_get_d(CONFIG_FPS_LIMIT));
                     video_swap();
 
                     t0 = t1;
@@ -394,8 +403,11 @@ int main(int argc, char *argv[])
 
         config_set_d(CONFIG_CAMERA, camera);
         config_save();
+        fs_save_quit();
 
         joy_quit();
+        log_ring_quit();
+        pool_quit();
 
         SDL_Quit();
     }
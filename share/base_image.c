@@ -19,6 +19,10 @@
 #include <assert.h>
 #include <setjmp.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "base_config.h"
 #include "base_image.h"
 
@@ -274,6 +278,87 @@ void *image_next2(const void *p, int w, int h, int b, int *w2, int *h2)
     return dst;
 }
 
+/*
+ * Average 2x2 pixel blocks of source rows S0 and S1 into W pixels of
+ * destination row D. O is the offset of the right pixel of each block,
+ * zero when the source is one pixel wide.
+ */
+static void image_half_row(unsigned char *d,
+                           const unsigned char *s0,
+                           const unsigned char *s1, int W, int b, int o)
+{
+    int j = 0, i;
+
+#ifdef __SSE2__
+    if (b == 4 && o == 4)
+    {
+        const __m128i z = _mm_setzero_si128();
+
+        /* Four source pixels of each row make two destination pixels. */
+
+        for (; j + 2 <= W; j += 2)
+        {
+            __m128i r0 = _mm_loadu_si128((const __m128i *) (s0 + j * 8));
+            __m128i r1 = _mm_loadu_si128((const __m128i *) (s1 + j * 8));
+
+            __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(r0, z),
+                                       _mm_unpacklo_epi8(r1, z));
+            __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(r0, z),
+                                       _mm_unpackhi_epi8(r1, z));
+
+            __m128i c = _mm_add_epi16(_mm_unpacklo_epi64(lo, hi),
+                                      _mm_unpackhi_epi64(lo, hi));
+
+            c = _mm_srli_epi16(c, 2);
+
+            _mm_storel_epi64((__m128i *) (d + j * 4), _mm_packus_epi16(c, z));
+        }
+    }
+#endif
+
+    for (; j < W; j++)
+    {
+        const unsigned char *p0 = s0 + j * b * (o ? 2 : 1);
+        const unsigned char *p1 = s1 + j * b * (o ? 2 : 1);
+
+        for (i = 0; i < b; i++)
+            d[j * b + i] = (unsigned char) ((p0[i] + p0[o + i] +
+                                             p1[i] + p1[o + i]) >> 2);
+    }
+}
+
+/*
+ * Allocate and return the next mipmap level of the given image buffer.
+ * Each dimension halves, but never drops below one.
+ */
+void *image_mip(const void *p, int w, int h, int b, int *wn, int *hn)
+{
+    const unsigned char *src = (const unsigned char *) p;
+    unsigned char *dst = NULL;
+
+    int W = w > 1 ? w / 2 : 1;
+    int H = h > 1 ? h / 2 : 1;
+
+    if ((dst = (unsigned char *) malloc(W * H * b)))
+    {
+        const int o = (w > 1 ? b : 0);
+        int r;
+
+        for (r = 0; r < H; r++)
+        {
+            const unsigned char *s0 = src + (h > 1 ? 2 * r : r) * w * b;
+            const unsigned char *s1 = s0 + (h > 1 ? w * b : 0);
+
+            image_half_row(dst + r * W * b, s0, s1, W, b, o);
+        }
+
+        if (wn) *wn = W;
+        if (hn) *hn = H;
+    }
+
+    return dst;
+}
+
 /*
  * Allocate and return a new down-sampled image buffer.
  */
@@ -285,6 +370,28 @@ void *image_scale(const void *p, int w, int h, int b, int *wn, int *hn, int n)
     int W = w / n;
     int H = h / n;
 
+    /* Power-of-two factors reduce to repeated halving. */
+
+    if (n > 1 && (n & (n - 1)) == 0 && W > 0 && H > 0)
+    {
+        if ((dst = image_mip(p, w, h, b, &w, &h)))
+        {
+            for (n /= 2; dst && n > 1; n /= 2)
+            {
+                void *q = image_mip(dst, w, h, b, &w, &h);
+                free(dst);
+                dst = q;
+            }
+
+            if (dst)
+            {
+                if (wn) *wn = w;
+                if (hn) *hn = h;
+            }
+        }
+        return dst;
+    }
+
     if ((dst = (unsigned char *) calloc(W * H * b, sizeof (unsigned char))))
     {
         int si, di;
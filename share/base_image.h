@@ -10,6 +10,7 @@ void *image_load(const char *, int *, int *, int *);
 
 void *image_next2(const void *, int, int, int, int *, int *);
 void *image_scale(const void *, int, int, int, int *, int *, int);
+void *image_mip  (const void *, int, int, int, int *, int *);
 void  image_white(      void *, int, int, int);
 void *image_flip (const void *, int, int, int, int, int);
 
@@ -0,0 +1,340 @@
+/*
+ * Copyright (C) 2003-2010 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "capture.h"
+#include "glext.h"
+#include "image.h"
+#include "pool.h"
+#include "common.h"
+#include "log.h"
+#include "fs.h"
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Frames are read back through a ring of pixel buffers, so that the
+ * copy of one frame proceeds while the next is drawn, and collected a
+ * few frames later. Encoding happens on worker threads. A path ending
+ * in ".rgb" receives a raw top-down RGB stream, anything else is made a
+ * directory of numbered PNG files.
+ */
+
+#if !ENABLE_OPENGLES && !defined(__EMSCRIPTEN__)
+#define CAPTURE_PBO 1
+#endif
+
+#define CAPTURE_PBOS    3               /* Frames in flight on the GPU       */
+#define CAPTURE_QUEUE   8               /* Frames waiting for a worker       */
+#define CAPTURE_WORKERS 4               /* Most PNG encoding threads         */
+
+struct frame
+{
+    int n;
+    unsigned char *p;
+};
+
+static char    *cap_path;
+static fs_file  cap_fp;
+static int      cap_w;
+static int      cap_h;
+static int      cap_read;
+static int      cap_done;
+static int      cap_failed;
+static Uint32   cap_t0;
+
+static void cap_func(void *);
+
+static struct worker cap_worker = { "capture", cap_func, CAPTURE_QUEUE };
+
+#ifdef CAPTURE_PBO
+static GLuint cap_pbo[CAPTURE_PBOS];
+static int    cap_mapped;
+#endif
+
+/*---------------------------------------------------------------------------*/
+
+static void cap_fail(void)
+{
+    worker_lock(&cap_worker);
+    cap_failed++;
+    worker_unlock(&cap_worker);
+}
+
+static int cap_ok(void)
+{
+    int ok;
+
+    worker_lock(&cap_worker);
+    ok = (cap_failed == 0);
+    worker_unlock(&cap_worker);
+
+    return ok;
+}
+
+/*
+ * Write a bottom-up RGBA frame.
+ */
+static void cap_write(struct frame *f)
+{
+    int ok = 1;
+
+    if (cap_fp)
+    {
+        unsigned char *row;
+        int i, j;
+
+        if ((row = malloc(cap_w * 3)))
+        {
+            for (i = cap_h - 1; ok && i >= 0; i--)
+            {
+                const unsigned char *p = f->p + i * cap_w * 4;
+
+                for (j = 0; j < cap_w; j++)
+                {
+                    row[j * 3 + 0] = p[j * 4 + 0];
+                    row[j * 3 + 1] = p[j * 4 + 1];
+                    row[j * 3 + 2] = p[j * 4 + 2];
+                }
+                ok = (fs_write(row, cap_w * 3, cap_fp) == cap_w * 3);
+            }
+            free(row);
+        }
+        else ok = 0;
+    }
+    else
+    {
+        char name[MAXSTR];
+
+        sprintf(name, "%.*s/%06d.png", MAXSTR - 16, cap_path, f->n);
+        ok = image_write(name, f->p, cap_w, cap_h);
+    }
+
+    if (!ok)
+        cap_fail();
+}
+
+static void cap_func(void *data)
+{
+    struct frame *f = data;
+
+    cap_write(f);
+
+    free(f->p);
+    free(f);
+}
+
+/*
+ * Hand a frame to the workers, or write it at once without them.
+ */
+static void cap_enq(unsigned char *p)
+{
+    struct frame *f;
+
+    if (!p || !(f = malloc(sizeof (*f))))
+    {
+        free(p);
+        cap_fail();
+        return;
+    }
+
+    f->n = cap_done++;
+    f->p = p;
+
+    worker_put(&cap_worker, f);
+}
+
+/*---------------------------------------------------------------------------*/
+
+#ifdef CAPTURE_PBO
+/*
+ * Copy out the oldest frame in flight.
+ */
+static void cap_map(void)
+{
+    const int size = cap_w * cap_h * 4;
+
+    unsigned char *p = NULL;
+    void *q;
+
+    glBindBuffer_(GL_PIXEL_PACK_BUFFER, cap_pbo[cap_mapped % CAPTURE_PBOS]);
+
+    if ((q = glMapBuffer_(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY)))
+    {
+        if ((p = malloc(size)))
+            memcpy(p, q, size);
+
+        glUnmapBuffer_(GL_PIXEL_PACK_BUFFER);
+    }
+
+    glBindBuffer_(GL_PIXEL_PACK_BUFFER, 0);
+
+    cap_mapped++;
+    cap_enq(p);
+}
+#endif
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Start capturing W by H frames to PATH in the write directory.
+ */
+int capture_open(const char *path, int w, int h)
+{
+    int n;
+
+    if (cap_path)
+        capture_close();
+
+    if (str_ends_with(path, ".rgb"))
+    {
+        if (!(cap_fp = fs_open_write(path)))
+        {
+            log_message(LOG_ERROR, "Failure to open %s\n", path);
+            return 0;
+        }
+        n = 1;
+    }
+    else
+    {
+        fs_mkdir(path);
+        n = CLAMP(1, SDL_GetCPUCount() - 1, CAPTURE_WORKERS);
+    }
+
+    cap_path   = strdup(path);
+    cap_w      = w;
+    cap_h      = h;
+    cap_read   = 0;
+    cap_done   = 0;
+    cap_failed = 0;
+    cap_t0     = SDL_GetTicks();
+
+    /* Start the encoders. */
+
+    worker_start(&cap_worker, n);
+
+    /* Set up the read-back ring. */
+
+#ifdef CAPTURE_PBO
+    cap_mapped = 0;
+
+    if (gli.pixel_buffer_object)
+    {
+        int i;
+
+        glGenBuffers_(CAPTURE_PBOS, cap_pbo);
+
+        for (i = 0; i < CAPTURE_PBOS; i++)
+        {
+            glBindBuffer_(GL_PIXEL_PACK_BUFFER, cap_pbo[i]);
+            glBufferData_(GL_PIXEL_PACK_BUFFER, w * h * 4, NULL, GL_STREAM_READ);
+        }
+        glBindBuffer_(GL_PIXEL_PACK_BUFFER, 0);
+    }
+#endif
+
+    return 1;
+}
+
+/*
+ * Read back the current read buffer as the next frame. Return false once
+ * any frame has failed to be written, so that the export can stop.
+ */
+int capture_frame(void)
+{
+    if (!cap_path || !cap_ok())
+        return 0;
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+#ifdef CAPTURE_PBO
+    if (cap_pbo[0])
+    {
+        /* Collect the oldest frame before its buffer is reused. */
+
+        if (cap_read - cap_mapped == CAPTURE_PBOS)
+            cap_map();
+
+        glBindBuffer_(GL_PIXEL_PACK_BUFFER, cap_pbo[cap_read % CAPTURE_PBOS]);
+        glReadPixels(0, 0, cap_w, cap_h, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glBindBuffer_(GL_PIXEL_PACK_BUFFER, 0);
+
+        cap_read++;
+        return 1;
+    }
+#endif
+
+    {
+        unsigned char *p;
+
+        if ((p = malloc(cap_w * cap_h * 4)))
+            glReadPixels(0, 0, cap_w, cap_h, GL_RGBA, GL_UNSIGNED_BYTE, p);
+
+        cap_read++;
+        cap_enq(p);
+    }
+    return 1;
+}
+
+/*
+ * Finish writing all frames and return the number captured, or zero if
+ * any frame failed to be written.
+ */
+int capture_close(void)
+{
+    Uint32 ms;
+    int n = cap_read;
+
+    if (!cap_path)
+        return 0;
+
+#ifdef CAPTURE_PBO
+    if (cap_pbo[0])
+    {
+        while (cap_mapped < cap_read)
+            cap_map();
+
+        glDeleteBuffers_(CAPTURE_PBOS, cap_pbo);
+        memset(cap_pbo, 0, sizeof (cap_pbo));
+    }
+#endif
+
+    worker_stop(&cap_worker, NULL);
+
+    if (cap_fp)
+    {
+        fs_close(cap_fp);
+        cap_fp = NULL;
+    }
+
+    ms = SDL_GetTicks() - cap_t0;
+
+    if (cap_failed)
+        log_message(LOG_ERROR, "Failure to write %d of %d frames to %s\n",
+                    cap_failed, n, cap_path);
+    else
+        log_printf("Captured %d frames (%dx%d) to %s in %u ms\n",
+                   n, cap_w, cap_h, cap_path, (unsigned int) ms);
+
+    free(cap_path);
+    cap_path = NULL;
+
+    return cap_failed ? 0 : n;
+}
+
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,12 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+/*---------------------------------------------------------------------------*/
+
+int  capture_open(const char *, int, int);
+int  capture_frame(void);
+int  capture_close(void);
+
+/*---------------------------------------------------------------------------*/
+
+#endif
@@ -31,6 +31,10 @@
 #include <sys/stat.h> /* stat() */
 #include <unistd.h>   /* access() */
 
+#ifdef _WIN32
+#include <windows.h>  /* MoveFileEx() */
+#endif
+
 #include "common.h"
 #include "fs.h"
 
@@ -181,13 +185,17 @@ int file_exists(const char *path)
     return (access(path, F_OK) == 0);
 }
 
+/*
+ * Rename SRC over DST, replacing DST in a single step.
+ */
 int file_rename(const char *src, const char *dst)
 {
 #ifdef _WIN32
-    if (file_exists(dst))
-        remove(dst);
-#endif
+    return MoveFileExA(src, dst, MOVEFILE_REPLACE_EXISTING |
+                                 MOVEFILE_WRITE_THROUGH) ? 0 : -1;
+#else
     return rename(src, dst);
+#endif
 }
 
 int file_size(const char *path)
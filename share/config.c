@@ -23,6 +23,7 @@
 #include "config.h"
 #include "common.h"
 #include "fs.h"
+#include "fs_save.h"
 
 /*---------------------------------------------------------------------------*/
 
@@ -38,6 +39,7 @@ int CONFIG_TEXTURES;
 int CONFIG_REFLECTION;
 int CONFIG_MULTISAMPLE;
 int CONFIG_MIPMAP;
+int CONFIG_TEXTURE_CACHE;
 int CONFIG_ANISO;
 int CONFIG_BACKGROUND;
 int CONFIG_SHADOW;
@@ -56,6 +58,8 @@ int CONFIG_MOUSE_CAMERA_L;
 int CONFIG_MOUSE_CAMERA_R;
 int CONFIG_NICE;
 int CONFIG_FPS;
+int CONFIG_FPS_LIMIT;
+int CONFIG_FPS_LIMIT_MENU;
 int CONFIG_SOUND_VOLUME;
 int CONFIG_MUSIC_VOLUME;
 int CONFIG_JOYSTICK;
@@ -124,6 +128,11 @@ int CONFIG_ONLINE;
 
 int CONFIG_MULTIBALL;
 int CONFIG_PHYSICS;
+int CONFIG_REPLAY_INPUTS;
+int CONFIG_LOG_LEVEL;
+int CONFIG_INSTANCING;
+int CONFIG_REFLECTION_SCALE;
+int CONFIG_IMAGE_CACHE;
 
 /* String options. */
 
@@ -133,6 +142,7 @@ int CONFIG_WIIMOTE_ADDR;
 int CONFIG_REPLAY_NAME;
 int CONFIG_LANGUAGE;
 int CONFIG_THEME;
+int CONFIG_PACKAGE_URL;
 
 /*---------------------------------------------------------------------------*/
 
@@ -153,6 +163,7 @@ static struct
     { &CONFIG_REFLECTION,   "reflection",   1 },
     { &CONFIG_MULTISAMPLE,  "multisample",  0 },
     { &CONFIG_MIPMAP,       "mipmap",       1 },
+    { &CONFIG_TEXTURE_CACHE, "texture_cache", 1 },
     { &CONFIG_ANISO,        "aniso",        8 },
     { &CONFIG_BACKGROUND,   "background",   1 },
     { &CONFIG_SHADOW,       "shadow",       1 },
@@ -173,6 +184,8 @@ static struct
 
     { &CONFIG_NICE,         "nice",         0 },
     { &CONFIG_FPS,          "fps",          0 },
+    { &CONFIG_FPS_LIMIT,    "fps_limit",    0 },
+    { &CONFIG_FPS_LIMIT_MENU, "fps_limit_menu", 60 },
     { &CONFIG_SOUND_VOLUME, "sound_volume", 10 },
     { &CONFIG_MUSIC_VOLUME, "music_volume", 6 },
 
@@ -244,6 +257,13 @@ static struct
 
     { &CONFIG_MULTIBALL, "multiball", 1 },
     { &CONFIG_PHYSICS,   "physics",   0 },
+
+    { &CONFIG_REPLAY_INPUTS, "replay_inputs", 0 },
+    { &CONFIG_LOG_LEVEL,     "log_level",     2 },
+    { &CONFIG_INSTANCING,    "instancing",    1 },
+
+    { &CONFIG_REFLECTION_SCALE, "reflection_scale", 2 },
+    { &CONFIG_IMAGE_CACHE,      "image_cache",      32 },
 };
 
 static struct
@@ -258,7 +278,8 @@ static struct
     { &CONFIG_WIIMOTE_ADDR, "wiimote_addr", "" },
     { &CONFIG_REPLAY_NAME,  "replay_name",  "%s-%l" },
     { &CONFIG_LANGUAGE,     "language",     "" },
-    { &CONFIG_THEME,        "theme",        "classic" }
+    { &CONFIG_THEME,        "theme",        "classic" },
+    { &CONFIG_PACKAGE_URL,  "package_url",  "" }
 };
 
 static int dirty = 0;
@@ -460,7 +481,7 @@ void config_save(void)
 
     SDL_assert(SDL_WasInit(SDL_INIT_VIDEO));
 
-    if (dirty && (fh = fs_open_write(USER_CONFIG_FILE)))
+    if (dirty && (fh = fs_open_buffer()))
     {
         int i;
 
@@ -514,7 +535,7 @@ void config_save(void)
         for (i = 0; i < ARRAYSIZE(option_s); i++)
             fs_printf(fh, "%-25s %s\n", option_s[i].name, option_s[i].cur);
 
-        fs_close(fh);
+        fs_save_commit(fh, USER_CONFIG_FILE);
     }
 
     dirty = 0;
@@ -29,6 +29,7 @@ extern int CONFIG_TEXTURES;
 extern int CONFIG_REFLECTION;
 extern int CONFIG_MULTISAMPLE;
 extern int CONFIG_MIPMAP;
+extern int CONFIG_TEXTURE_CACHE;
 extern int CONFIG_ANISO;
 extern int CONFIG_BACKGROUND;
 extern int CONFIG_SHADOW;
@@ -47,6 +48,8 @@ extern int CONFIG_MOUSE_CAMERA_L;
 extern int CONFIG_MOUSE_CAMERA_R;
 extern int CONFIG_NICE;
 extern int CONFIG_FPS;
+extern int CONFIG_FPS_LIMIT;
+extern int CONFIG_FPS_LIMIT_MENU;
 extern int CONFIG_SOUND_VOLUME;
 extern int CONFIG_MUSIC_VOLUME;
 extern int CONFIG_JOYSTICK;
@@ -115,6 +118,11 @@ extern int CONFIG_ONLINE;
 
 extern int CONFIG_MULTIBALL;
 extern int CONFIG_PHYSICS;
+extern int CONFIG_REPLAY_INPUTS;
+extern int CONFIG_LOG_LEVEL;
+extern int CONFIG_INSTANCING;
+extern int CONFIG_REFLECTION_SCALE;
+extern int CONFIG_IMAGE_CACHE;
 
 /* String options. */
 
@@ -124,6 +132,7 @@ extern int CONFIG_WIIMOTE_ADDR;
 extern int CONFIG_REPLAY_NAME;
 extern int CONFIG_LANGUAGE;
 extern int CONFIG_THEME;
+extern int CONFIG_PACKAGE_URL;
 
 /*---------------------------------------------------------------------------*/
 
@@ -131,6 +131,35 @@ Array dir_scan(const char *path,
     return items;
 }
 
+/*
+ * Remove the items rejected by FILTER, keeping the others in order.
+ */
+void dir_filter(Array items, int (*filter)(struct dir_item *))
+{
+    int i, n = 0;
+
+    for (i = 0; i < array_len(items); i++)
+    {
+        struct dir_item *item = array_get(items, i);
+
+        if (filter(item))
+        {
+            if (i != n)
+            {
+                struct dir_item *dest = array_get(items, n);
+                struct dir_item temp  = *dest;
+
+                *dest = *item;
+                *item = temp;
+            }
+            n++;
+        }
+    }
+
+    while (array_len(items) > n)
+        del_item(items);
+}
+
 /*
  * Free the Array of struct dir_item.
  */
@@ -21,6 +21,7 @@ Array dir_scan(const char *,
                int  (*filter)    (struct dir_item *),
                List (*list_files)(const char *),
                void (*free_files)(List));
+void  dir_filter(Array, int (*filter)(struct dir_item *));
 void  dir_free(Array);
 
 List dir_list_files(const char *);
@@ -15,6 +15,8 @@
 #ifndef FETCH_H
 #define FETCH_H 1
 
+#include "sha256.h"
+
 #define FETCH_MAX 5
 
 /*
@@ -32,6 +34,8 @@ struct fetch_progress
 struct fetch_done
 {
     unsigned int success:1;
+
+    char sha256[SHA256_HEX];            /* Hash of a resumable download */
 };
 
 /*
@@ -53,6 +57,10 @@ void fetch_quit(void);
 unsigned int fetch_file(const char *url,
                         const char *dst,
                         struct fetch_callback);
+unsigned int fetch_file_resume(const char *url,
+                               const char *dst,
+                               const char *sha256,
+                               struct fetch_callback);
 
 void fetch_enable(int enable);
 
@@ -48,6 +48,14 @@ struct fetch_info
     char *dest_filename;
     fs_file dest_file;
     unsigned int fetch_id;
+
+    /* Resumable transfers. */
+
+    unsigned int resume:1;
+    long offset;
+    struct sha256 sha;
+    char expect[SHA256_HEX];
+    char hex[SHA256_HEX];
 };
 
 /*
@@ -144,13 +152,18 @@ static struct fetch_progress *create_extra_progress(double total, double now)
 /*
  * Create extra_data for a done callback.
  */
-static struct fetch_done *create_extra_done(int success)
+static struct fetch_done *create_extra_done(int success, struct fetch_info *fi)
 {
     struct fetch_done *dn = calloc(sizeof (*dn), 1);
 
     if (dn)
+    {
         dn->success = !!success;
 
+        if (success && fi->resume)
+            SAFECPY(dn->sha256, fi->hex);
+    }
+
     return dn;
 }
 
@@ -362,16 +375,42 @@ static size_t fetch_write_func(void *buffer, size_t size, size_t nmemb, void *us
 
     if (fi)
     {
-        if (!fi->dest_file)
+        if (!fi->dest_file && fi->dest_filename && *fi->dest_filename)
         {
-            /* Open file on first write. TODO: write to a temporary file. */
+            /* Open file on first write. */
+
+            if (fi->offset > 0)
+            {
+                long code = 0;
+
+                curl_easy_getinfo(fi->handle, CURLINFO_RESPONSE_CODE, &code);
+
+                /* A file: URL has no response code. */
+
+                if (code != 200)
+                    fi->dest_file = fs_open_append(fi->dest_filename);
+                else
+                {
+                    /* Server ignored the range: start over. */
+
+                    log_message(LOG_DEBUG, "Transfer %u restarting from zero\n", fi->fetch_id);
+
+                    fi->offset = 0;
+                    sha256_init(&fi->sha);
+                }
+            }
 
-            if (fi->dest_filename && *fi->dest_filename)
+            if (!fi->dest_file)
                 fi->dest_file = fs_open_write(fi->dest_filename);
         }
 
         if (fi->dest_file)
+        {
+            if (fi->resume)
+                sha256_update(&fi->sha, buffer, size * nmemb);
+
             return fs_write(buffer, size * nmemb, fi->dest_file);
+        }
     }
 
     return 0;
@@ -401,6 +440,27 @@ static int fetch_progress_func(void *clientp, double dltotal, double dlnow, doub
     return 0;
 }
 
+/*
+ * Check a finished resumable transfer against the expected hash. A
+ * mismatch may come from a stale or oversized partial file, so remove it
+ * and let the next attempt start over.
+ */
+static int fetch_verify(struct fetch_info *fi)
+{
+    sha256_final(&fi->sha, fi->hex);
+
+    if (strcmp(fi->hex, fi->expect) == 0)
+        return 1;
+
+    log_message(LOG_ERROR, "Transfer %u hash mismatch\n", fi->fetch_id);
+
+    fs_remove(fi->dest_filename);
+
+    fi->hex[0] = 0;
+
+    return 0;
+}
+
 /*
  * Progress all transfers.
  */
@@ -429,12 +489,28 @@ static void fetch_step(void)
 
                     curl_easy_getinfo(handle, CURLINFO_PRIVATE, &fi);
 
-                    if (code != CURLE_OK)
+                    if (code == CURLE_HTTP_RETURNED_ERROR && fi->offset > 0)
+                    {
+                        long status = 0;
+
+                        curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &status);
+
+                        /* Nothing past the end: the partial file may be whole. */
+
+                        success = (status == 416);
+                    }
+                    else if (code == CURLE_BAD_DOWNLOAD_RESUME && fi->offset > 0)
+                    {
+                        /* Same, for a file: URL. Let the hash decide. */
+
+                        success = 1;
+                    }
+                    else if (code != CURLE_OK)
                     {
                         if (code == CURLE_ABORTED_BY_CALLBACK)
                             log_printf("Transfer %u aborted\n", fi->fetch_id);
                         else
-                            log_printf("Transfer %u error: %s\n", fi->fetch_id, curl_easy_strerror(code));
+                            log_message(LOG_ERROR, "Transfer %u error: %s\n", fi->fetch_id, curl_easy_strerror(code));
 
                         success = 0;
                     }
@@ -453,6 +529,9 @@ static void fetch_step(void)
                         fi->dest_file = NULL;
                     }
 
+                    if (success && fi->resume)
+                        success = fetch_verify(fi);
+
                     if (fi->callback.done)
                     {
                         struct fetch_event *fe = create_fetch_event();
@@ -461,13 +540,13 @@ static void fetch_step(void)
                         {
                             fe->callback = fi->callback.done;
                             fe->callback_data = fi->callback.data;
-                            fe->extra_data = create_extra_done(success);
+                            fe->extra_data = create_extra_done(success, fi);
 
                             fetch_dispatch_event(fe);
                         }
                     }
 
-                    log_printf("Stopping transfer %u\n", fi->fetch_id);
+                    log_message(LOG_DEBUG, "Stopping transfer %u\n", fi->fetch_id);
 
                     unlink_and_free_fetch_info(fi);
                 }
@@ -509,7 +588,7 @@ static int fetch_thread_main(void *data)
         }
         else
         {
-            log_printf("libcurl poll failure: %s\n", curl_multi_strerror(code));
+            log_message(LOG_ERROR, "libcurl poll failure: %s\n", curl_multi_strerror(code));
             SDL_AtomicSet(&fetch_thread_running, 0);
         }
     };
@@ -595,7 +674,7 @@ void fetch_init(void)
 
     if (!multi_handle)
     {
-        log_printf("Failure to create a CURL multi handle\n");
+        log_message(LOG_ERROR, "Failure to create a CURL multi handle\n");
         return;
     }
 
@@ -627,11 +706,38 @@ void fetch_quit(void)
 }
 
 /*
- * Download from URL into FILENAME.
+ * Hash the partial download of a resumable transfer and return its size.
  */
-unsigned int fetch_file(const char *url,
-                        const char *filename,
-                        struct fetch_callback callback)
+static long fetch_resume_offset(struct fetch_info *fi)
+{
+    unsigned char buf[8192];
+    fs_file fp;
+    long size = 0;
+    int n;
+
+    sha256_init(&fi->sha);
+
+    if ((fp = fs_open_read(fi->dest_filename)))
+    {
+        while ((n = fs_read(buf, sizeof (buf), fp)) > 0)
+        {
+            sha256_update(&fi->sha, buf, n);
+            size += n;
+        }
+        fs_close(fp);
+    }
+
+    return size;
+}
+
+/*
+ * Download from URL into FILENAME. Given the expected SHA256, resume a
+ * partial file and check the result.
+ */
+static unsigned int fetch_start(const char *url,
+                                const char *filename,
+                                struct fetch_callback callback,
+                                const char *sha256)
 {
     unsigned int fetch_id = 0;
     CURL *handle = NULL;
@@ -656,10 +762,10 @@ unsigned int fetch_file(const char *url,
 
         if (fi)
         {
-            log_printf("Starting transfer %u\n", fi->fetch_id);
+            log_message(LOG_DEBUG, "Starting transfer %u\n", fi->fetch_id);
 
-            log_printf("Downloading from %s\n", url);
-            log_printf("Saving to %s\n", filename);
+            log_message(LOG_DEBUG, "Downloading from %s\n", url);
+            log_message(LOG_DEBUG, "Saving to %s\n", filename);
 
             fi->callback = callback;
             fi->handle = handle;
@@ -680,6 +786,24 @@ unsigned int fetch_file(const char *url,
             curl_easy_setopt(handle, CURLOPT_FOLLOWLOCATION, 1);
             curl_easy_setopt(handle, CURLOPT_CONNECTTIMEOUT, 20L); /* In seconds. */
 
+            /* Never save an error page in place of the file. */
+
+            curl_easy_setopt(handle, CURLOPT_FAILONERROR, 1L);
+
+            if (sha256 && *sha256)
+            {
+                fi->resume = 1;
+
+                SAFECPY(fi->expect, sha256);
+
+                if ((fi->offset = fetch_resume_offset(fi)) > 0)
+                {
+                    log_message(LOG_DEBUG, "Resuming from byte %ld\n", fi->offset);
+
+                    curl_easy_setopt(handle, CURLOPT_RESUME_FROM_LARGE, (curl_off_t) fi->offset);
+                }
+            }
+
             #if defined(_WIN32) && defined(CURLSSLOPT_NATIVE_CA)
             curl_easy_setopt(handle, CURLOPT_SSL_OPTIONS, CURLSSLOPT_NATIVE_CA);
             #endif
@@ -697,3 +821,26 @@ unsigned int fetch_file(const char *url,
 
     return fetch_id;
 }
+
+/*
+ * Download from URL into FILENAME.
+ */
+unsigned int fetch_file(const char *url,
+                        const char *filename,
+                        struct fetch_callback callback)
+{
+    return fetch_start(url, filename, callback, NULL);
+}
+
+/*
+ * Download from URL into FILENAME, continuing from the end of FILENAME
+ * if it exists. The whole file must match SHA256, or the transfer fails
+ * and FILENAME is removed. Without a hash, start over.
+ */
+unsigned int fetch_file_resume(const char *url,
+                               const char *filename,
+                               const char *sha256,
+                               struct fetch_callback callback)
+{
+    return fetch_start(url, filename, callback, sha256);
+}
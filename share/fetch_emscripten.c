@@ -255,4 +255,13 @@ unsigned int fetch_file(const char *url, const char *dst, struct fetch_callback
     }
 
     return fetch_id;
-}
\ No newline at end of file
+}
+
+/*
+ * Transfers land in memory here, so there is nothing to resume. The
+ * caller hashes the file itself when no hash is reported.
+ */
+unsigned int fetch_file_resume(const char *url, const char *dst, const char *sha256, struct fetch_callback callback)
+{
+    return fetch_file(url, dst, callback);
+}
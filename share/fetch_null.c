@@ -33,4 +33,9 @@ void fetch_quit(void)
 unsigned int fetch_file(const char *url, const char *dst, struct fetch_callback callback)
 {
     return 0;
-}
\ No newline at end of file
+}
+
+unsigned int fetch_file_resume(const char *url, const char *dst, const char *sha256, struct fetch_callback callback)
+{
+    return 0;
+}
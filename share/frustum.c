@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2003-2010 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+#include "glext.h"
+#include "vec3.h"
+#include "frustum.h"
+
+/*---------------------------------------------------------------------------*/
+
+static int drawn;
+static int culled;
+
+/*
+ * Extract the six clip planes from the current projection and
+ * model-view matrices.
+ */
+void frustum_load(struct frustum *fr)
+{
+    float P[16], C[16];
+    int i, j;
+
+    glGetFloatv(GL_PROJECTION_MATRIX, P);
+    glGetFloatv(GL_MODELVIEW_MATRIX,  fr->M);
+
+    m_mult(C, P, fr->M);
+
+    /* Each plane is the fourth row of the clip matrix plus or minus another. */
+
+    for (i = 0; i < 3; i++)
+        for (j = 0; j < 4; j++)
+        {
+            fr->p[i * 2 + 0][j] = C[j * 4 + 3] + C[j * 4 + i];
+            fr->p[i * 2 + 1][j] = C[j * 4 + 3] - C[j * 4 + i];
+        }
+
+    /* Normalize, so that the plane equation yields distance. */
+
+    for (i = 0; i < 6; i++)
+    {
+        float k = v_len(fr->p[i]);
+
+        if (k > 0.0f)
+        {
+            fr->p[i][0] /= k;
+            fr->p[i][1] /= k;
+            fr->p[i][2] /= k;
+            fr->p[i][3] /= k;
+        }
+    }
+}
+
+/*
+ * Test a bounding sphere against the frustum. Return zero if the sphere
+ * lies entirely outside.
+ */
+int frustum_test(const struct frustum *fr, const float c[3], float r)
+{
+    int i;
+
+    if (fr)
+    {
+        for (i = 0; i < 6; i++)
+            if (v_dot(fr->p[i], c) + fr->p[i][3] < -r)
+            {
+                culled++;
+                return 0;
+            }
+
+        drawn++;
+    }
+    return 1;
+}
+
+/*
+ * Report and reset the test counters.
+ */
+void frustum_stats(int *d, int *c)
+{
+    if (d) *d = drawn;
+    if (c) *c = culled;
+
+    drawn  = 0;
+    culled = 0;
+}
+
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2003-2010 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * View frustum for bounding sphere culling. Planes face inward and are
+ * expressed in the object space current at the time of frustum_load,
+ * whose model-view matrix is kept alongside.
+ */
+
+struct frustum
+{
+    float p[6][4];
+    float M[16];
+};
+
+void frustum_load(struct frustum *);
+int  frustum_test(const struct frustum *, const float c[3], float r);
+
+void frustum_stats(int *drawn, int *culled);
+
+/*---------------------------------------------------------------------------*/
+
+#endif
@@ -12,6 +12,10 @@ const char *fs_base_dir(void);
 int         fs_add_path(const char *);
 void        fs_remove_path(const char *);
 int         fs_add_path_with_archives(const char *);
+void       *fs_open_archive(const char *);
+void        fs_close_archive(void *);
+int         fs_add_archive(const char *, void *);
+void        fs_set_lock(void (*)(int));
 int         fs_set_write_dir(const char *);
 const char *fs_get_write_dir(void);
 
@@ -22,8 +26,13 @@ int fs_rename(const char *, const char *);
 fs_file fs_open_read(const char *);
 fs_file fs_open_write(const char *);
 fs_file fs_open_append(const char *);
+fs_file fs_open_fd(int, const char *);
+fs_file fs_open_buffer(void);
+void   *fs_close_buffer(fs_file, int *size);
 int     fs_close(fs_file);
 
+int fs_save(const char *path, const void *data, int size);
+
 int  fs_read(void *data, int bytes, fs_file);
 int  fs_write(const void *data, int bytes, fs_file);
 int  fs_flush(fs_file);
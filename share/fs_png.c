@@ -29,7 +29,8 @@ void fs_png_read(png_structp readp, png_bytep data, png_size_t length)
 
 void fs_png_write(png_structp writep, png_bytep data, png_size_t length)
 {
-    fs_write(data, length, png_get_io_ptr(writep));
+    if (fs_write(data, length, png_get_io_ptr(writep)) != (int) length)
+        png_error(writep, "Write failure");
 }
 
 void fs_png_flush(png_structp writep)
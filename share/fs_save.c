@@ -0,0 +1,237 @@
+/*
+ * Copyright (C) 2003-2010 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+#include <SDL.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fs_save.h"
+#include "common.h"
+#include "pool.h"
+#include "log.h"
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Scores, settings and replays are composed in memory and handed to a
+ * writer thread, which syncs each one to disk by way of fs_save.  A file
+ * committed again while still pending replaces the older snapshot.
+ */
+
+struct save
+{
+    struct save *next;
+
+    char  *path;
+    void  *data;
+    int    size;
+    Uint32 time;
+};
+
+static struct save *save_head;          /* Queued, yet to be begun           */
+static struct save *save_tail;
+static const char  *save_busy;
+static int          save_quit;
+
+static int    save_count;
+static int    save_merged;
+static int    save_failed;
+static int    save_bytes;
+static Uint32 save_total_ms;
+static Uint32 save_max_ms;
+
+static void save_func(void *);
+
+static struct worker save_worker = { "fs_save", save_func, 0 };
+
+/*---------------------------------------------------------------------------*/
+
+static void save_free(struct save *s)
+{
+    free(s->path);
+    free(s->data);
+    free(s);
+}
+
+/*
+ * Write a snapshot and account for it. Latency counts from the first
+ * commit of the snapshot until it is safely on disk.
+ */
+static void save_write(struct save *s)
+{
+    int    ok = fs_save(s->path, s->data, s->size);
+    Uint32 ms = SDL_GetTicks() - s->time;
+
+    worker_lock(&save_worker);
+
+    save_count    += 1;
+    save_failed   += ok ? 0 : 1;
+    save_bytes    += s->size;
+    save_total_ms += ms;
+    save_max_ms    = MAX(save_max_ms, ms);
+
+    worker_unlock(&save_worker);
+}
+
+static void save_func(void *data)
+{
+    struct save *s = data;
+
+    /* Once begun, a snapshot no longer takes in newer ones. */
+
+    worker_lock(&save_worker);
+    {
+        struct save **p, *t = NULL;
+
+        for (p = &save_head; *p != s; p = &(*p)->next)
+            t = *p;
+
+        if (!(*p = s->next))
+            save_tail = t;
+
+        save_busy = s->path;
+    }
+    worker_unlock(&save_worker);
+
+    save_write(s);
+
+    worker_lock(&save_worker);
+    save_busy = NULL;
+    worker_unlock(&save_worker);
+
+    save_free(s);
+}
+
+/*
+ * Return true if a snapshot of PATH, or of anything if PATH is NULL, has
+ * yet to reach the disk.
+ */
+static int save_pending(const char *path)
+{
+    struct save *s;
+
+    if (save_busy && (!path || strcmp(save_busy, path) == 0))
+        return 1;
+
+    for (s = save_head; s; s = s->next)
+        if (!path || strcmp(s->path, path) == 0)
+            return 1;
+
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Take the contents of a buffer opened with fs_open_buffer and queue
+ * them to replace PATH in the write directory.
+ */
+void fs_save_commit(fs_file fh, const char *path)
+{
+    struct save *s;
+    void *data;
+    int   size = 0;
+
+    if (!(data = fs_close_buffer(fh, &size)))
+        return;
+
+    if (!(s = calloc(1, sizeof (*s))) || !(s->path = strdup(path)))
+    {
+        free(s);
+        free(data);
+        return;
+    }
+
+    s->data = data;
+    s->size = size;
+    s->time = SDL_GetTicks();
+
+    if (save_quit || !worker_start(&save_worker, 1))
+    {
+        save_write(s);
+        save_free(s);
+        return;
+    }
+
+    worker_lock(&save_worker);
+    {
+        struct save *t;
+
+        for (t = save_head; t; t = t->next)
+            if (strcmp(t->path, path) == 0)
+                break;
+
+        if (t)
+        {
+            free(t->data);
+
+            t->data = s->data;
+            t->size = s->size;
+            s->data = NULL;
+
+            save_merged++;
+        }
+        else
+        {
+            if (save_tail)
+                save_tail->next = s;
+            else
+                save_head = s;
+
+            save_tail = s;
+        }
+
+        if (t)
+        {
+            save_free(s);
+            s = NULL;
+        }
+    }
+    worker_unlock(&save_worker);
+
+    if (s)
+        worker_put(&save_worker, s);
+}
+
+/*
+ * Block until PATH, or everything if PATH is NULL, is written. Call this
+ * before reading back or moving a file that may have been committed.
+ */
+void fs_save_wait(const char *path)
+{
+    worker_lock(&save_worker);
+    {
+        while (save_worker.threads && save_pending(path))
+            worker_wait(&save_worker);
+    }
+    worker_unlock(&save_worker);
+}
+
+/*
+ * Finish writing everything, stop the writer thread and report.
+ */
+void fs_save_quit(void)
+{
+    worker_stop(&save_worker, NULL);
+    save_quit = 1;
+
+    if (save_count)
+        log_printf("Saves: %d files, %d bytes, %d merged, %d failed, "
+                   "%u ms average, %u ms max\n",
+                   save_count, save_bytes, save_merged, save_failed,
+                   (unsigned int) (save_total_ms / save_count),
+                   (unsigned int) save_max_ms);
+}
+
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,10 @@
+#ifndef FS_SAVE_H
+#define FS_SAVE_H
+
+#include "fs.h"
+
+void fs_save_commit(fs_file, const char *path);
+void fs_save_wait(const char *path);
+void fs_save_quit(void);
+
+#endif
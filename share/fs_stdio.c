@@ -12,12 +12,23 @@
  * General Public License for more details.
  */
 
+#if !defined(_WIN32)
+#define _POSIX_C_SOURCE 200112L         /* fdopen, fsync */
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
 #include <errno.h>
 
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
 #include "fs.h"
 #include "dir.h"
 #include "array.h"
@@ -37,15 +48,20 @@ enum fs_path_type
 {
     FS_PATH_DIRECTORY,
     FS_PATH_ZIP,
+    FS_PATH_BUFFER,
 };
 
 struct fs_file_s
 {
     FILE *handle;
 
+    /* Contents of a ZIP entry, or of a memory buffer being written. */
+
     void *zip_file_data;
     size_t zip_file_pos;
     size_t zip_file_size;
+    size_t buffer_size;
+    int    buffer_eof;
 
     enum fs_path_type path_type;
 };
@@ -93,6 +109,8 @@ static void free_path_item(struct fs_path_item *path_item)
 
 static char *fs_dir_base;
 static char *fs_dir_write;
+
+static void (*fs_lock)(int);
 static List  fs_path;
 static int   fs_logging = 1;
 
@@ -148,6 +166,22 @@ const char *fs_error(void)
     return strerror(errno);
 }
 
+/*
+ * Set a function to serialize access to the read path across threads.
+ * Only the main thread changes the path, and it holds the lock while it
+ * does. Lookups from any thread hold it while they walk the path.
+ */
+void fs_set_lock(void (*lock)(int))
+{
+    fs_lock = lock;
+}
+
+static void lock_path(int on)
+{
+    if (fs_lock)
+        fs_lock(on);
+}
+
 /*---------------------------------------------------------------------------*/
 
 const char *fs_base_dir(void)
@@ -155,77 +189,113 @@ const char *fs_base_dir(void)
     return fs_dir_base;
 }
 
-int fs_add_path(const char *path)
+static int fs_path_added(const char *path)
 {
-    struct fs_path_item *path_item;
-
     List l;
 
-    if (!(path && *path))
-        return 0;
-
     for (l = fs_path; l; l = l->next)
     {
         struct fs_path_item *test_item = l->data;
 
         if (strcmp(path, test_item->path) == 0)
-            return 0;
+            return 1;
     }
+    return 0;
+}
 
-    path_item = create_path_item();
+int fs_add_path(const char *path)
+{
+    struct fs_path_item *path_item;
 
-    if (!path_item)
+    if (!(path && *path) || fs_path_added(path))
         return 0;
 
-    if (dir_exists(path))
-    {
-        if (fs_logging)
-            log_printf("FS: reading from \"%s\" (directory)\n", path);
+    if (!dir_exists(path))
+        return fs_add_archive(path, fs_open_archive(path));
 
-        path_item->type = FS_PATH_DIRECTORY;
-        path_item->path = strdup(path);
-        path_item->data = NULL;
+    if (!(path_item = create_path_item()))
+        return 0;
 
-        fs_path = list_cons(path_item, fs_path);
+    if (fs_logging)
+        log_printf("FS: reading from \"%s\" (directory)\n", path);
 
-        return 1;
-    }
-    else
+    path_item->type = FS_PATH_DIRECTORY;
+    path_item->path = strdup(path);
+    path_item->data = NULL;
+
+    lock_path(1);
+    fs_path = list_cons(path_item, fs_path);
+    lock_path(0);
+
+    return 1;
+}
+
+/*
+ * Open the archive at PATH, ahead of adding it with fs_add_archive. This
+ * touches no shared state, so several archives may be opened at once.
+ */
+void *fs_open_archive(const char *path)
+{
+    mz_zip_archive *zip;
+
+    if ((zip = malloc(sizeof (*zip))))
     {
-        mz_zip_archive *zip;
+        mz_zip_zero_struct(zip);
 
-        if ((zip = malloc(sizeof (*zip))))
+        if (mz_zip_reader_init_file(zip, path, 0))
+            return zip;
+
+        if (fs_logging)
         {
-            mz_zip_zero_struct(zip);
+            mz_zip_error err = mz_zip_get_last_error(zip);
+            const char *str = mz_zip_get_error_string(err);
+            log_printf("FS: skipping \"%s\" (%s)\n", path, str);
+        }
 
-            if (mz_zip_reader_init_file(zip, path, 0))
-            {
-                if (fs_logging)
-                    log_printf("FS: reading from \"%s\" (zip)\n", path);
+        free(zip);
+        zip = NULL;
+    }
+    return NULL;
+}
 
-                path_item->type = FS_PATH_ZIP;
-                path_item->path = strdup(path);
-                path_item->data = zip;
+void fs_close_archive(void *data)
+{
+    mz_zip_archive *zip = data;
 
-                fs_path = list_cons(path_item, fs_path);
+    if (zip)
+    {
+        mz_zip_reader_end(zip);
+        free(zip);
+        zip = NULL;
+    }
+}
 
-                return 1;
-            }
-            else if (fs_logging)
-            {
-                mz_zip_error err = mz_zip_get_last_error(zip);
-                const char *str = mz_zip_get_error_string(err);
-                log_printf("FS: skipping \"%s\" (%s)\n", path, str);
-            }
+/*
+ * Add an archive opened at PATH to the read path. The archive is closed
+ * if it is not added.
+ */
+int fs_add_archive(const char *path, void *data)
+{
+    struct fs_path_item *path_item;
 
-            free(zip);
-            zip = NULL;
-        }
+    if (data && path && *path && !fs_path_added(path) &&
+        (path_item = create_path_item()))
+    {
+        if (fs_logging)
+            log_printf("FS: reading from \"%s\" (zip)\n", path);
+
+        path_item->type = FS_PATH_ZIP;
+        path_item->path = strdup(path);
+        path_item->data = data;
 
+        lock_path(1);
+        fs_path = list_cons(path_item, fs_path);
+        lock_path(0);
+
+        return 1;
     }
 
-    free_path_item(path_item);
-    path_item = NULL;
+    fs_close_archive(data);
 
     return 0;
 }
@@ -234,6 +304,8 @@ void fs_remove_path(const char *path)
 {
     List l, p;
 
+    lock_path(1);
+
     for (p = NULL, l = fs_path; l; p = l, l = l->next)
     {
         struct fs_path_item *path_item = l->data;
@@ -259,6 +331,8 @@ void fs_remove_path(const char *path)
             }
         }
     }
+
+    lock_path(0);
 }
 
 int fs_set_write_dir(const char *path)
@@ -387,6 +461,8 @@ static List list_files(const char *path)
     List all_files = NULL;
     List p;
 
+    lock_path(1);
+
     for (p = fs_path; p; p = p->next)
     {
         struct fs_path_item *path_item = p->data;
@@ -416,6 +492,8 @@ static List list_files(const char *path)
             zip_list_free(path_files);
     }
 
+    lock_path(0);
+
     return all_files;
 }
 
@@ -458,6 +536,8 @@ fs_file fs_open_read(const char *path)
         int opened = 0;
         List p;
 
+        lock_path(1);
+
         for (p = fs_path; p && !opened; p = p->next)
         {
             struct fs_path_item *path_item = p->data;
@@ -489,6 +569,8 @@ fs_file fs_open_read(const char *path)
             }
         }
 
+        lock_path(0);
+
         if (!opened)
         {
             free(fh);
@@ -535,6 +617,73 @@ fs_file fs_open_append(const char *path)
     return fs_open_write_flags(path, 1);
 }
 
+/*
+ * Wrap an open file descriptor, such as a connected socket.
+ */
+fs_file fs_open_fd(int fd, const char *mode)
+{
+    fs_file fh;
+
+    if ((fh = calloc(1, sizeof (*fh))))
+    {
+        if ((fh->handle = fdopen(fd, mode)))
+            fh->path_type = FS_PATH_DIRECTORY;
+        else
+        {
+            free(fh);
+            fh = NULL;
+        }
+    }
+    return fh;
+}
+
+/*
+ * Open a growable memory buffer for writing. It may be read back,
+ * seeked in, and finally taken with fs_close_buffer.
+ */
+fs_file fs_open_buffer(void)
+{
+    fs_file fh;
+
+    if ((fh = calloc(1, sizeof (*fh))))
+    {
+        fh->buffer_size = 4096;
+
+        if ((fh->zip_file_data = malloc(fh->buffer_size)))
+            fh->path_type = FS_PATH_BUFFER;
+        else
+        {
+            free(fh);
+            fh = NULL;
+        }
+    }
+    return fh;
+}
+
+/*
+ * Close a memory buffer and return its contents, which the caller must
+ * free.
+ */
+void *fs_close_buffer(fs_file fh, int *size)
+{
+    void *data = NULL;
+
+    if (fh)
+    {
+        if (fh->path_type == FS_PATH_BUFFER)
+        {
+            data = fh->zip_file_data;
+
+            if (size)
+                *size = (int) fh->zip_file_size;
+
+            fh->zip_file_data = NULL;
+        }
+        fs_close(fh);
+    }
+    return data;
+}
+
 int fs_close(fs_file fh)
 {
     int closed = 0;
@@ -609,6 +758,77 @@ int fs_remove(const char *path)
     return success;
 }
 
+/*
+ * Sync the directory holding PATH in the write directory, so that a
+ * rename into it is itself on disk. Windows makes the rename durable
+ * with MoveFileEx instead. This may run off the main thread, so it
+ * uses no static buffers.
+ */
+static void fs_sync_dir(const char *path)
+{
+#if !defined(_WIN32)
+    char *real, *sep;
+    int fd;
+
+    if ((real = path_join(fs_dir_write, path)))
+    {
+        if ((sep = (char *) path_last_sep(real)))
+            *sep = 0;
+        else
+            strcpy(real, ".");
+
+        if ((fd = open(real, O_RDONLY)) >= 0)
+        {
+            fsync(fd);
+            close(fd);
+        }
+        free(real);
+    }
+#endif
+}
+
+/*
+ * Replace PATH in the write directory with the given contents. The data
+ * goes to a temporary file that is synced to disk before being renamed
+ * over the old one, so a crash leaves either the old file or the new.
+ */
+int fs_save(const char *path, const void *data, int size)
+{
+    char *tmp;
+    int ok = 0;
+
+    if (fs_dir_write && (tmp = concat_string(path, ".tmp", NULL)))
+    {
+        fs_file fh;
+
+        if ((fh = fs_open_write(tmp)))
+        {
+            ok = ((int) fwrite(data, 1, size, fh->handle) == size &&
+                  fflush(fh->handle) == 0);
+#if defined(_WIN32)
+            ok = ok && _commit(_fileno(fh->handle)) == 0;
+#else
+            ok = ok && fsync(fileno(fh->handle)) == 0;
+#endif
+            ok = (fclose(fh->handle) == 0) && ok;
+
+            fh->handle = NULL;
+            fs_close(fh);
+        }
+
+        if (ok)
+            ok = (fs_rename(tmp, path) == 0);
+
+        if (ok)
+            fs_sync_dir(path);
+        else
+            fs_remove(tmp);
+
+        free(tmp);
+    }
+    return ok;
+}
+
 /*---------------------------------------------------------------------------*/
 
 int fs_read(void *data, int bytes, fs_file fh)
@@ -625,6 +845,9 @@ int fs_read(void *data, int bytes, fs_file fh)
 
         fh->zip_file_pos += read;
 
+        if (read < (size_t) bytes)
+            fh->buffer_eof = 1;
+
         return read;
     }
 
@@ -636,6 +859,36 @@ int fs_write(const void *data, int bytes, fs_file fh)
     if (fh->handle)
         return fwrite(data, 1, bytes, fh->handle);
 
+    if (fh->path_type == FS_PATH_BUFFER && bytes > 0)
+    {
+        size_t need = fh->zip_file_pos + bytes;
+
+        if (need > fh->buffer_size)
+        {
+            size_t size = fh->buffer_size;
+            void  *p;
+
+            while (size < need)
+                size *= 2;
+
+            if (!(p = realloc(fh->zip_file_data, size)))
+                return 0;
+
+            fh->zip_file_data = p;
+            fh->buffer_size   = size;
+        }
+
+        memcpy((unsigned char *) fh->zip_file_data + fh->zip_file_pos,
+               data, bytes);
+
+        fh->zip_file_pos += bytes;
+
+        if (fh->zip_file_size < fh->zip_file_pos)
+            fh->zip_file_size = fh->zip_file_pos;
+
+        return bytes;
+    }
+
     /* ZIP writing is not available. */
 
     return 0;
@@ -700,6 +953,10 @@ int fs_eof(fs_file fh)
     if (fh->handle)
         return feof(fh->handle);
 
+    /* A buffer, like stdio, only ends once read past the end. */
+
+    if (fh->path_type == FS_PATH_BUFFER)
+        return fh->buffer_eof;
 
     if (fh->zip_file_data)
         return fh->zip_file_pos >= fh->zip_file_size;
@@ -709,9 +966,12 @@ int fs_eof(fs_file fh)
 
 int fs_size(const char *path)
 {
+    int size = 0, found = 0;
     List p;
 
-    for (p = fs_path; p; p = p->next)
+    lock_path(1);
+
+    for (p = fs_path; p && !found; p = p->next)
     {
         struct fs_path_item *path_item = p->data;
 
@@ -723,10 +983,8 @@ int fs_size(const char *path)
             {
                 if (file_exists(real))
                 {
-                    int s = file_size(real);
-                    free(real);
-                    real = NULL;
-                    return s;
+                    size  = file_size(real);
+                    found = 1;
                 }
 
                 free(real);
@@ -743,12 +1001,17 @@ int fs_size(const char *path)
                 mz_zip_archive_file_stat file_stat;
 
                 if (mz_zip_reader_file_stat(zip, file_index, &file_stat))
-                    return file_stat.m_uncomp_size;
+                {
+                    size  = file_stat.m_uncomp_size;
+                    found = 1;
+                }
             }
         }
     }
 
-    return 0;
+    lock_path(0);
+
+    return size;
 }
 
 /*---------------------------------------------------------------------------*/
@@ -27,6 +27,7 @@
 #include "config.h"
 #include "video.h"
 #include "hmd.h"
+#include "inst.h"
 #include "log.h"
 
 #include "solid_draw.h"
@@ -48,22 +49,25 @@ const struct tex_env tex_env_default = {
     }
 };
 
+/*
+ * The shadow pipelines have no texture stage. They are only active for
+ * the duration of the shadow pass, see shad_pass_begin.
+ */
+
 const struct tex_env tex_env_shadow = {
     tex_env_conf_shadow,
-    2,
+    1,
     {
-        { GL_TEXTURE0, TEX_STAGE_SHADOW },
-        { GL_TEXTURE1, TEX_STAGE_TEXTURE }
+        { GL_TEXTURE0, TEX_STAGE_SHADOW }
     }
 };
 
 const struct tex_env tex_env_shadow_clip = {
     tex_env_conf_shadow,
-    3,
+    2,
     {
         { GL_TEXTURE0, TEX_STAGE_SHADOW },
-        { GL_TEXTURE1, TEX_STAGE_CLIP },
-        { GL_TEXTURE2, TEX_STAGE_TEXTURE }
+        { GL_TEXTURE1, TEX_STAGE_CLIP }
     }
 };
 
@@ -108,22 +112,18 @@ static void tex_env_conf_shadow(int stage, int enable)
     case TEX_STAGE_SHADOW:
         if (enable)
         {
-            glDisable(GL_TEXTURE_2D);
+            glEnable(GL_TEXTURE_2D);
 
-            /* Modulate primary color and shadow alpha. */
+            /* Output shadow alpha, to be used as a blend factor. */
 
             glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_COMBINE);
 
-            glTexEnvi(GL_TEXTURE_ENV, GL_COMBINE_RGB, GL_MODULATE);
+            glTexEnvi(GL_TEXTURE_ENV, GL_COMBINE_RGB, GL_REPLACE);
             glTexEnvi(GL_TEXTURE_ENV, GL_SRC0_RGB, GL_PREVIOUS);
-            glTexEnvi(GL_TEXTURE_ENV, GL_SRC1_RGB, GL_TEXTURE);
             glTexEnvi(GL_TEXTURE_ENV, GL_OPERAND0_RGB, GL_SRC_COLOR);
-            glTexEnvi(GL_TEXTURE_ENV, GL_OPERAND1_RGB, GL_ONE_MINUS_SRC_ALPHA);
-
-            /* Copy incoming alpha. */
 
             glTexEnvi(GL_TEXTURE_ENV, GL_COMBINE_ALPHA, GL_REPLACE);
-            glTexEnvi(GL_TEXTURE_ENV, GL_SRC0_ALPHA, GL_PREVIOUS);
+            glTexEnvi(GL_TEXTURE_ENV, GL_SRC0_ALPHA, GL_TEXTURE);
             glTexEnvi(GL_TEXTURE_ENV, GL_OPERAND0_ALPHA, GL_SRC_ALPHA);
 
             glMatrixMode(GL_TEXTURE);
@@ -139,25 +139,22 @@ static void tex_env_conf_shadow(int stage, int enable)
     case TEX_STAGE_CLIP:
         if (enable)
         {
-            glDisable(GL_TEXTURE_2D);
+            glEnable(GL_TEXTURE_2D);
+            glEnableClientState(GL_TEXTURE_COORD_ARRAY);
 
-            /* Interpolate shadowed and non-shadowed primary color. */
+            /* Mask out shadow alpha above the ball. */
 
             glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_COMBINE);
 
-            glTexEnvi(GL_TEXTURE_ENV, GL_COMBINE_RGB, GL_INTERPOLATE);
+            glTexEnvi(GL_TEXTURE_ENV, GL_COMBINE_RGB, GL_REPLACE);
             glTexEnvi(GL_TEXTURE_ENV, GL_SRC0_RGB, GL_PREVIOUS);
-            glTexEnvi(GL_TEXTURE_ENV, GL_SRC1_RGB, GL_PRIMARY_COLOR);
-            glTexEnvi(GL_TEXTURE_ENV, GL_SRC2_RGB, GL_TEXTURE);
             glTexEnvi(GL_TEXTURE_ENV, GL_OPERAND0_RGB, GL_SRC_COLOR);
-            glTexEnvi(GL_TEXTURE_ENV, GL_OPERAND1_RGB, GL_SRC_COLOR);
-            glTexEnvi(GL_TEXTURE_ENV, GL_OPERAND2_RGB, GL_SRC_ALPHA);
 
-            /* Copy incoming alpha. */
-
-            glTexEnvi(GL_TEXTURE_ENV, GL_COMBINE_ALPHA, GL_REPLACE);
+            glTexEnvi(GL_TEXTURE_ENV, GL_COMBINE_ALPHA, GL_MODULATE);
             glTexEnvi(GL_TEXTURE_ENV, GL_SRC0_ALPHA, GL_PREVIOUS);
+            glTexEnvi(GL_TEXTURE_ENV, GL_SRC1_ALPHA, GL_TEXTURE);
             glTexEnvi(GL_TEXTURE_ENV, GL_OPERAND0_ALPHA, GL_SRC_ALPHA);
+            glTexEnvi(GL_TEXTURE_ENV, GL_OPERAND1_ALPHA, GL_SRC_ALPHA);
 
             glMatrixMode(GL_TEXTURE);
             glLoadIdentity();
@@ -166,12 +163,9 @@ static void tex_env_conf_shadow(int stage, int enable)
         else
         {
             glDisable(GL_TEXTURE_2D);
+            glDisableClientState(GL_TEXTURE_COORD_ARRAY);
         }
         break;
-
-    case TEX_STAGE_TEXTURE:
-        tex_env_conf_default(TEX_STAGE_TEXTURE, enable);
-        break;
     }
 }
 
@@ -371,7 +365,7 @@ void geom_step(float dt)
 
 /*---------------------------------------------------------------------------*/
 
-static struct s_draw *item_file(const struct v_item *hp)
+struct s_draw *item_file(const struct v_item *hp)
 {
     int g = GEOM_COIN;
 
@@ -420,29 +414,64 @@ void item_color(const struct v_item *hp, float *c)
     }
 }
 
-void item_draw(struct s_rend *rend,
+void item_bill(struct s_rend *rend,
                const struct v_item *hp,
                const GLfloat *M, float t)
 {
     const GLfloat s = ITEM_RADIUS;
 
-    struct s_draw *draw = item_file(hp);
-
     glPushMatrix();
     {
         glScalef(s, s, s);
 
         glDepthMask(GL_FALSE);
         {
-            sol_bill(draw, rend, M, t);
+            sol_bill(item_file(hp), rend, M, t);
         }
         glDepthMask(GL_TRUE);
+    }
+    glPopMatrix();
+}
 
-        sol_draw(draw, rend, 0, 1);
+void item_draw(struct s_rend *rend,
+               const struct v_item *hp,
+               const GLfloat *M, float t)
+{
+    const GLfloat s = ITEM_RADIUS;
+
+    item_bill(rend, hp, M, t);
+
+    glPushMatrix();
+    {
+        glScalef(s, s, s);
+        sol_draw(item_file(hp), rend, 0, 1);
     }
     glPopMatrix();
 }
 
+/*
+ * Draw the item model once for each instance queued since inst_begin.
+ */
+void item_draw_inst(struct s_rend *rend, const struct s_draw *draw)
+{
+    const GLfloat s = ITEM_RADIUS;
+
+    if (inst_bind())
+    {
+        glPushMatrix();
+        {
+            glScalef(s, s, s);
+
+            rend->inst = 1;
+            sol_draw(draw, rend, 0, 1);
+            rend->inst = 0;
+        }
+        glPopMatrix();
+
+        inst_unbind();
+    }
+}
+
 /*---------------------------------------------------------------------------*/
 
 void back_init(const char *name)
@@ -459,7 +488,7 @@ void back_init(const char *name)
         mp->o = make_image_from_file(name, IF_MIPMAP);
 
         if (!mp->o)
-            log_printf("Failed to load background image \"%s\"\n", name);
+            log_message(LOG_WARN, "Failed to load background image \"%s\"\n", name);
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
         back_state = 1;
@@ -664,6 +693,73 @@ void shad_draw_clr(void)
     }
 }
 
+/*
+ * The shadow pass draws shadowed geometry again over itself and scales
+ * the color already in the frame buffer by one minus the shadow alpha.
+ * Each ball's shadow is then a matter of loading texture matrices.
+ */
+
+static const struct tex_env *shad_prev_env;
+static GLboolean             shad_prev_blend;
+static GLboolean             shad_prev_lighting;
+
+int shad_pass_begin(struct s_rend *rend)
+{
+    r_apply_mtrl(rend, default_mtrl);
+
+    shad_prev_env      = curr_tex_env;
+    shad_prev_blend    = glIsEnabled(GL_BLEND);
+    shad_prev_lighting = glIsEnabled(GL_LIGHTING);
+
+    tex_env_select(&tex_env_shadow_clip,
+                   &tex_env_shadow,
+                   NULL);
+
+    if (!tex_env_stage(TEX_STAGE_SHADOW))
+    {
+        tex_env_active(shad_prev_env);
+        return 0;
+    }
+
+    glBindTexture_(GL_TEXTURE_2D, shad_text);
+
+    if (tex_env_stage(TEX_STAGE_CLIP))
+        glBindTexture_(GL_TEXTURE_2D, clip_text);
+
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glDisable(GL_LIGHTING);
+    glDepthMask(GL_FALSE);
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+
+    glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+
+    return 1;
+}
+
+void shad_pass_end(struct s_rend *rend)
+{
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    if (!shad_prev_blend)
+        glDisable(GL_BLEND);
+
+    if (shad_prev_lighting)
+        glEnable(GL_LIGHTING);
+
+    glDepthMask(GL_TRUE);
+    glEnableClientState(GL_NORMAL_ARRAY);
+
+    if (tex_env_stage(TEX_STAGE_CLIP))
+        glBindTexture_(GL_TEXTURE_2D, 0);
+
+    tex_env_active(shad_prev_env);
+
+    if (tex_env_stage(TEX_STAGE_TEXTURE))
+        glBindTexture_(GL_TEXTURE_2D, rend->curr_mtrl.o);
+}
+
 /*---------------------------------------------------------------------------*/
 
 /*
@@ -709,6 +805,8 @@ static const struct light default_lights[LIGHT_MAX] = {
 static GLfloat      light_ambient[4];
 static struct light lights[LIGHT_MAX];
 
+unsigned int curr_lights;
+
 void light_reset(void)
 {
     memcpy(lights,        default_lights,  sizeof (lights));
@@ -732,6 +830,24 @@ void light_conf(void)
     }
 }
 
+/*
+ * Enable or disable light I, keeping track of the enabled lights so
+ * that they need not be queried back.
+ */
+void light_enable(int i, int enable)
+{
+    if (enable)
+    {
+        glEnable(GL_LIGHT0 + i);
+        curr_lights |=  (1u << i);
+    }
+    else
+    {
+        glDisable(GL_LIGHT0 + i);
+        curr_lights &= ~(1u << i);
+    }
+}
+
 void light_load(void)
 {
     static char buf[MAXSTR];
@@ -31,7 +31,11 @@ void vect_draw(struct s_rend *);
 void back_draw(struct s_rend *);
 
 void item_color(const struct v_item *, float *);
+struct s_draw *item_file(const struct v_item *);
+
+void item_bill(struct s_rend *, const struct v_item *, const GLfloat *, float);
 void item_draw(struct s_rend *, const struct v_item *, const GLfloat *, float);
+void item_draw_inst(struct s_rend *, const struct s_draw *);
 
 /*---------------------------------------------------------------------------*/
 
@@ -46,6 +50,9 @@ void shad_free(void);
 void shad_draw_set(void);
 void shad_draw_clr(void);
 
+int  shad_pass_begin(struct s_rend *);
+void shad_pass_end(struct s_rend *);
+
 /*---------------------------------------------------------------------------*/
 
 enum
@@ -81,9 +88,12 @@ int  tex_env_stage(int);
 
 /*---------------------------------------------------------------------------*/
 
+extern unsigned int curr_lights;
+
 void light_reset(void);
 void light_conf(void);
 void light_load(void);
+void light_enable(int, int);
 
 /*---------------------------------------------------------------------------*/
 
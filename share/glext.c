@@ -35,6 +35,8 @@ PFNGLBUFFERSUBDATA_PROC          glBufferSubData_;
 PFNGLDELETEBUFFERS_PROC          glDeleteBuffers_;
 PFNGLISBUFFER_PROC               glIsBuffer_;
 
+PFNGLDRAWRANGEELEMENTS_PROC      glDrawRangeElementsEXT_;
+
 PFNGLPOINTPARAMETERF_PROC        glPointParameterf_;
 PFNGLPOINTPARAMETERFV_PROC       glPointParameterfv_;
 
@@ -56,6 +58,15 @@ PFNGLUNIFORM1F_PROC              glUniform1f_;
 PFNGLUNIFORM2F_PROC              glUniform2f_;
 PFNGLUNIFORM3F_PROC              glUniform3f_;
 PFNGLUNIFORM4F_PROC              glUniform4f_;
+PFNGLUNIFORM1I_PROC              glUniform1i_;
+PFNGLGETATTRIBLOCATION_PROC      glGetAttribLocation_;
+PFNGLVERTEXATTRIBPOINTER_PROC    glVertexAttribPointer_;
+PFNGLENABLEVERTEXATTRIBARRAY_PROC  glEnableVertexAttribArray_;
+PFNGLDISABLEVERTEXATTRIBARRAY_PROC glDisableVertexAttribArray_;
+
+PFNGLVERTEXATTRIBDIVISOR_PROC    glVertexAttribDivisor_;
+PFNGLDRAWARRAYSINSTANCED_PROC    glDrawArraysInstanced_;
+PFNGLDRAWELEMENTSINSTANCED_PROC  glDrawElementsInstanced_;
 
 PFNGLBINDFRAMEBUFFER_PROC        glBindFramebuffer_;
 PFNGLDELETEFRAMEBUFFERS_PROC     glDeleteFramebuffers_;
@@ -63,6 +74,9 @@ PFNGLGENFRAMEBUFFERS_PROC        glGenFramebuffers_;
 PFNGLFRAMEBUFFERTEXTURE2D_PROC   glFramebufferTexture2D_;
 PFNGLCHECKFRAMEBUFFERSTATUS_PROC glCheckFramebufferStatus_;
 
+PFNGLMAPBUFFER_PROC              glMapBuffer_;
+PFNGLUNMAPBUFFER_PROC            glUnmapBuffer_;
+
 PFNGLSTRINGMARKERGREMEDY_PROC    glStringMarkerGREMEDY_;
 
 #endif
@@ -139,6 +153,13 @@ int glext_init(void)
     if (glext_check("GL_EXT_texture_filter_anisotropic"))
         gli.texture_filter_anisotropic = 1;
 
+#if ENABLE_OPENGLES || defined(__EMSCRIPTEN__)
+    if (glext_check("GL_OES_element_index_uint"))
+        gli.element_index_uint = 1;
+#else
+    gli.element_index_uint = 1;
+#endif
+
     /* Desktop init. */
 
 #if !ENABLE_OPENGLES && !defined(__EMSCRIPTEN__)
@@ -160,6 +181,9 @@ int glext_init(void)
         SDL_GL_GFPA(glIsBuffer_,            "glIsBufferARB");
     }
 
+    if (glext_check("EXT_draw_range_elements"))
+        SDL_GL_GFPA(glDrawRangeElementsEXT_, "glDrawRangeElementsEXT");
+
     if (glext_assert("ARB_point_parameters"))
     {
         SDL_GL_GFPA(glPointParameterf_,    "glPointParameterfARB");
@@ -186,10 +210,26 @@ int glext_init(void)
         SDL_GL_GFPA(glUniform2f_,          "glUniform2f");
         SDL_GL_GFPA(glUniform3f_,          "glUniform3f");
         SDL_GL_GFPA(glUniform4f_,          "glUniform4f");
+        SDL_GL_GFPA(glUniform1i_,          "glUniform1i");
+
+        SDL_GL_GFPA(glGetAttribLocation_,        "glGetAttribLocation");
+        SDL_GL_GFPA(glVertexAttribPointer_,      "glVertexAttribPointer");
+        SDL_GL_GFPA(glEnableVertexAttribArray_,  "glEnableVertexAttribArray");
+        SDL_GL_GFPA(glDisableVertexAttribArray_, "glDisableVertexAttribArray");
 
         gli.shader_objects = 1;
     }
 
+    if (gli.shader_objects && glext_check("ARB_instanced_arrays")
+                           && glext_check("ARB_draw_instanced"))
+    {
+        SDL_GL_GFPA(glVertexAttribDivisor_,   "glVertexAttribDivisorARB");
+        SDL_GL_GFPA(glDrawArraysInstanced_,   "glDrawArraysInstancedARB");
+        SDL_GL_GFPA(glDrawElementsInstanced_, "glDrawElementsInstancedARB");
+
+        gli.instanced_arrays = 1;
+    }
+
     if (glext_check("ARB_framebuffer_object"))
     {
         SDL_GL_GFPA(glBindFramebuffer_,        "glBindFramebuffer");
@@ -201,6 +241,14 @@ int glext_init(void)
         gli.framebuffer_object = 1;
     }
 
+    if (glext_check("ARB_pixel_buffer_object"))
+    {
+        SDL_GL_GFPA(glMapBuffer_,   "glMapBufferARB");
+        SDL_GL_GFPA(glUnmapBuffer_, "glUnmapBufferARB");
+
+        gli.pixel_buffer_object = 1;
+    }
+
     if (glext_check("GREMEDY_string_marker"))
         SDL_GL_GFPA(glStringMarkerGREMEDY_, "glStringMarkerGREMEDY");
 
@@ -80,6 +80,15 @@
 #ifndef GL_DYNAMIC_DRAW
 #define GL_DYNAMIC_DRAW               0x88E8
 #endif
+#ifndef GL_STREAM_READ
+#define GL_STREAM_READ                0x88E1
+#endif
+#ifndef GL_READ_ONLY
+#define GL_READ_ONLY                  0x88B8
+#endif
+#ifndef GL_PIXEL_PACK_BUFFER
+#define GL_PIXEL_PACK_BUFFER          0x88EB
+#endif
 
 #ifndef GL_POINT_SPRITE
 #define GL_POINT_SPRITE               0x8861
@@ -134,6 +143,9 @@
 #ifndef GL_FRAMEBUFFER_COMPLETE
 #define GL_FRAMEBUFFER_COMPLETE       0x8CD5
 #endif
+#ifndef GL_FRAMEBUFFER_BINDING
+#define GL_FRAMEBUFFER_BINDING        0x8CA6
+#endif
 
 #ifndef GL_VERTEX_SHADER
 #define GL_VERTEX_SHADER              0x8B31
@@ -151,6 +163,10 @@
 #define GL_INFO_LOG_LENGTH            0x8B84
 #endif
 
+#ifndef GL_UNSIGNED_INT
+#define GL_UNSIGNED_INT               0x1405
+#endif
+
 /*---------------------------------------------------------------------------*/
 
 int glext_check(const char *);
@@ -176,8 +192,17 @@ int glext_init(void);
 #define glPointParameterfv_    glPointParameterfv
 #define glPointParameterf_     glPointParameterf
 
+#define glDrawRangeElements_(mode, start, end, count, type, indices) \
+    glDrawElements((mode), (count), (type), (indices))
+
 #ifdef __EMSCRIPTEN__
 #define glOrtho_               glOrtho
+
+#define glBindFramebuffer_        glBindFramebuffer
+#define glDeleteFramebuffers_     glDeleteFramebuffers
+#define glGenFramebuffers_        glGenFramebuffers
+#define glFramebufferTexture2D_   glFramebufferTexture2D
+#define glCheckFramebufferStatus_ glCheckFramebufferStatus
 #else
 #define glOrtho_               glOrthof
 #endif
@@ -214,6 +239,19 @@ extern PFNGLBUFFERSUBDATA_PROC glBufferSubData_;
 extern PFNGLDELETEBUFFERS_PROC glDeleteBuffers_;
 extern PFNGLISBUFFER_PROC      glIsBuffer_;
 
+/*---------------------------------------------------------------------------*/
+/* EXT_draw_range_elements                                                   */
+
+typedef void (APIENTRYP PFNGLDRAWRANGEELEMENTS_PROC)(GLenum, GLuint, GLuint, GLsizei, GLenum, const GLvoid *);
+
+extern PFNGLDRAWRANGEELEMENTS_PROC glDrawRangeElementsEXT_;
+
+#define glDrawRangeElements_(mode, start, end, count, type, indices)   \
+    (glDrawRangeElementsEXT_ ?                                          \
+     glDrawRangeElementsEXT_((mode), (start), (end), (count), (type),   \
+                             (indices)) :                               \
+     glDrawElements((mode), (count), (type), (indices)))
+
 /*---------------------------------------------------------------------------*/
 /* ARB_point_parameters                                                      */
 
@@ -244,6 +282,11 @@ typedef void   (APIENTRYP PFNGLUNIFORM1F_PROC)(GLint, GLfloat);
 typedef void   (APIENTRYP PFNGLUNIFORM2F_PROC)(GLint, GLfloat, GLfloat);
 typedef void   (APIENTRYP PFNGLUNIFORM3F_PROC)(GLint, GLfloat, GLfloat, GLfloat);
 typedef void   (APIENTRYP PFNGLUNIFORM4F_PROC)(GLint, GLfloat, GLfloat, GLfloat, GLfloat);
+typedef void   (APIENTRYP PFNGLUNIFORM1I_PROC)(GLint, GLint);
+typedef GLint  (APIENTRYP PFNGLGETATTRIBLOCATION_PROC)(GLuint, const char *);
+typedef void   (APIENTRYP PFNGLVERTEXATTRIBPOINTER_PROC)(GLuint, GLint, GLenum, GLboolean, GLsizei, const GLvoid *);
+typedef void   (APIENTRYP PFNGLENABLEVERTEXATTRIBARRAY_PROC)(GLuint);
+typedef void   (APIENTRYP PFNGLDISABLEVERTEXATTRIBARRAY_PROC)(GLuint);
 
 extern PFNGLGETSHADERIV_PROC         glGetShaderiv_;
 extern PFNGLGETSHADERINFOLOG_PROC    glGetShaderInfoLog_;
@@ -263,6 +306,23 @@ extern PFNGLUNIFORM1F_PROC           glUniform1f_;
 extern PFNGLUNIFORM2F_PROC           glUniform2f_;
 extern PFNGLUNIFORM3F_PROC           glUniform3f_;
 extern PFNGLUNIFORM4F_PROC           glUniform4f_;
+extern PFNGLUNIFORM1I_PROC           glUniform1i_;
+
+extern PFNGLGETATTRIBLOCATION_PROC        glGetAttribLocation_;
+extern PFNGLVERTEXATTRIBPOINTER_PROC      glVertexAttribPointer_;
+extern PFNGLENABLEVERTEXATTRIBARRAY_PROC  glEnableVertexAttribArray_;
+extern PFNGLDISABLEVERTEXATTRIBARRAY_PROC glDisableVertexAttribArray_;
+
+/*---------------------------------------------------------------------------*/
+/* ARB_instanced_arrays, ARB_draw_instanced                                  */
+
+typedef void (APIENTRYP PFNGLVERTEXATTRIBDIVISOR_PROC)(GLuint, GLuint);
+typedef void (APIENTRYP PFNGLDRAWARRAYSINSTANCED_PROC)(GLenum, GLint, GLsizei, GLsizei);
+typedef void (APIENTRYP PFNGLDRAWELEMENTSINSTANCED_PROC)(GLenum, GLsizei, GLenum, const GLvoid *, GLsizei);
+
+extern PFNGLVERTEXATTRIBDIVISOR_PROC   glVertexAttribDivisor_;
+extern PFNGLDRAWARRAYSINSTANCED_PROC   glDrawArraysInstanced_;
+extern PFNGLDRAWELEMENTSINSTANCED_PROC glDrawElementsInstanced_;
 
 /*---------------------------------------------------------------------------*/
 /* ARB_framebuffer_object                                                    */
@@ -279,6 +339,15 @@ extern PFNGLGENFRAMEBUFFERS_PROC        glGenFramebuffers_;
 extern PFNGLFRAMEBUFFERTEXTURE2D_PROC   glFramebufferTexture2D_;
 extern PFNGLCHECKFRAMEBUFFERSTATUS_PROC glCheckFramebufferStatus_;
 
+/*---------------------------------------------------------------------------*/
+/* ARB_pixel_buffer_object                                                   */
+
+typedef void     *(APIENTRYP PFNGLMAPBUFFER_PROC)(GLenum, GLenum);
+typedef GLboolean (APIENTRYP PFNGLUNMAPBUFFER_PROC)(GLenum);
+
+extern PFNGLMAPBUFFER_PROC   glMapBuffer_;
+extern PFNGLUNMAPBUFFER_PROC glUnmapBuffer_;
+
 /*---------------------------------------------------------------------------*/
 /* GREMEDY_string_marker                                                     */
 
@@ -307,6 +376,9 @@ struct gl_info
     unsigned int texture_filter_anisotropic : 1;
     unsigned int shader_objects             : 1;
     unsigned int framebuffer_object         : 1;
+    unsigned int element_index_uint         : 1;
+    unsigned int instanced_arrays           : 1;
+    unsigned int pixel_buffer_object        : 1;
 
     unsigned int wireframe:1;
 };
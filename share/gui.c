@@ -21,6 +21,7 @@
 #include "video.h"
 #include "glext.h"
 #include "image.h"
+#include "tex_cache.h"
 #include "vec3.h"
 #include "gui.h"
 #include "common.h"
@@ -50,7 +51,7 @@ const GLubyte gui_wht2[4] = { 0xFF, 0xFF, 0xFF, 0x60 };  /* Transparent white */
 
 /*---------------------------------------------------------------------------*/
 
-#define WIDGET_MAX 256
+#define WIDGET_MIN 256
 
 #define GUI_FREE   0
 #define GUI_HARRAY 1
@@ -103,6 +104,11 @@ struct widget
     int     w, h;
     int     car;
     int     cdr;
+    int     parent;
+
+    int     req_w;
+    int     req_h;
+    int     label_w;
 
     GLuint  image;
     GLfloat scale;
@@ -124,18 +130,21 @@ struct widget
     float slide_time;
 
     unsigned int hidden:1;
+    unsigned int dirty:1;               /* Requested size is out of date */
+    unsigned int reflow:1;              /* Subtree needs to be placed    */
 };
 
 /*---------------------------------------------------------------------------*/
 
 /* GUI widget state */
 
-static struct widget widget[WIDGET_MAX];
-static int           active;
-static int           hovered;
-static int           clicked;
-static int           padding;
-static int           borders[4];
+static struct widget *widget;
+static int            widget_max;
+static int            active;
+static int            hovered;
+static int            clicked;
+static int            padding;
+static int            borders[4];
 
 /* Digit widgets for the HUD. */
 
@@ -175,6 +184,10 @@ static int gui_hot(int id)
 
 #define WIDGET_ELEM (RECT_ELEM)
 
+/* Widget count limit imposed by 16-bit element indices. */
+
+#define WIDGET_LIM (65536 / WIDGET_VERT)
+
 struct vert
 {
     GLubyte c[4];
@@ -182,9 +195,14 @@ struct vert
     GLshort p[2];
 };
 
-static struct vert vert_buf[WIDGET_MAX * WIDGET_VERT];
-static GLuint      vert_vbo = 0;
-static GLuint      vert_ebo = 0;
+static struct vert *vert_buf;
+static GLuint       vert_vbo = 0;
+static GLuint       vert_ebo = 0;
+
+/* Range of vertices modified since the last upload. */
+
+static int vert_lo = 0;
+static int vert_hi = 0;
 
 /*---------------------------------------------------------------------------*/
 
@@ -201,6 +219,44 @@ static void set_vert(struct vert *v, int x, int y,
     v->p[1] = y;
 }
 
+/*
+ * Store vertices in the shadow buffer. Only data that actually changed
+ * is scheduled for upload.
+ */
+static void set_verts(int i, const struct vert *v, int n)
+{
+    if (memcmp(vert_buf + i, v, n * sizeof (struct vert)))
+    {
+        memcpy(vert_buf + i, v, n * sizeof (struct vert));
+
+        if (vert_lo < vert_hi)
+        {
+            vert_lo = MIN(vert_lo, i);
+            vert_hi = MAX(vert_hi, i + n);
+        }
+        else
+        {
+            vert_lo = i;
+            vert_hi = i + n;
+        }
+    }
+}
+
+/*
+ * Upload all modified vertices with a single call. Assumes the VBO is bound.
+ */
+static void vert_flush(void)
+{
+    if (vert_lo < vert_hi)
+    {
+        glBufferSubData_(GL_ARRAY_BUFFER,
+                         vert_lo * sizeof (struct vert),
+                         (vert_hi - vert_lo) * sizeof (struct vert),
+                         vert_buf + vert_lo);
+        vert_lo = vert_hi = 0;
+    }
+}
+
 /*---------------------------------------------------------------------------*/
 
 static void draw_enable(GLboolean c, GLboolean u, GLboolean p)
@@ -208,6 +264,8 @@ static void draw_enable(GLboolean c, GLboolean u, GLboolean p)
     glBindBuffer_(GL_ARRAY_BUFFER,         vert_vbo);
     glBindBuffer_(GL_ELEMENT_ARRAY_BUFFER, vert_ebo);
 
+    vert_flush();
+
     if (c)
     {
         glEnableClientState(GL_COLOR_ARRAY);
@@ -272,9 +330,7 @@ static const GLushort rect_elem_base[RECT_ELEM] = {
 
 static void gui_geom_rect(int id, int x, int y, int w, int h, int f)
 {
-    GLushort rect_elem[RECT_ELEM];
-
-    struct vert *v = vert_buf + id * WIDGET_VERT;
+    struct vert v[RECT_VERT];
     struct vert *p = v;
 
     int X[4];
@@ -282,7 +338,7 @@ static void gui_geom_rect(int id, int x, int y, int w, int h, int f)
 
     int i, j;
 
-    /* Generate vertex and element data for the widget's rectangle. */
+    /* Generate vertex data for the widget's rectangle. */
 
     X[0] = x;
     X[1] = x +     ((f & GUI_W) ? borders[0] : 0);
@@ -298,28 +354,13 @@ static void gui_geom_rect(int id, int x, int y, int w, int h, int f)
         for (j = 0; j < 4; j++)
             set_vert(p++, X[i], Y[j], curr_theme.s[i], curr_theme.t[j], gui_wht);
 
-    for (i = 0; i < RECT_ELEM; i++)
-        rect_elem[i] = id * WIDGET_VERT + rect_elem_base[i];
-
-    /* Copy this off to the VBOs. */
-
-    glBindBuffer_   (GL_ARRAY_BUFFER, vert_vbo);
-    glBufferSubData_(GL_ARRAY_BUFFER,
-                     id * WIDGET_VERT * sizeof (struct vert),
-                            RECT_VERT * sizeof (struct vert), v);
-    glBindBuffer_   (GL_ARRAY_BUFFER, 0);
-
-    glBindBuffer_   (GL_ELEMENT_ARRAY_BUFFER, vert_ebo);
-    glBufferSubData_(GL_ELEMENT_ARRAY_BUFFER,
-                     id * WIDGET_ELEM * sizeof (GLushort),
-                            RECT_ELEM * sizeof (GLushort), rect_elem);
-    glBindBuffer_   (GL_ELEMENT_ARRAY_BUFFER, 0);
+    set_verts(id * WIDGET_VERT, v, RECT_VERT);
 }
 
 static void gui_geom_text(int id, int x, int y, int w, int h,
                           const GLubyte *c0, const GLubyte *c1)
 {
-    struct vert *v = vert_buf + id * WIDGET_VERT + RECT_VERT;
+    struct vert v[TEXT_VERT];
 
     /* Assume the applied texture size is rect size rounded to power-of-two. */
 
@@ -362,18 +403,12 @@ static void gui_geom_text(int id, int x, int y, int w, int h,
     }
     else memset(v, 0, TEXT_VERT * sizeof (struct vert));
 
-    /* Copy this off to the VBO. */
-
-    glBindBuffer_   (GL_ARRAY_BUFFER, vert_vbo);
-    glBufferSubData_(GL_ARRAY_BUFFER,
-                     (id * WIDGET_VERT + RECT_VERT) * sizeof (struct vert),
-                                         TEXT_VERT  * sizeof (struct vert), v);
-    glBindBuffer_   (GL_ARRAY_BUFFER, 0);
+    set_verts(id * WIDGET_VERT + RECT_VERT, v, TEXT_VERT);
 }
 
 static void gui_geom_image(int id, int x, int y, int w, int h, int f)
 {
-    struct vert *v = vert_buf + id * WIDGET_VERT + RECT_VERT;
+    struct vert v[IMAGE_VERT];
 
     int X[2];
     int Y[2];
@@ -391,13 +426,7 @@ static void gui_geom_image(int id, int x, int y, int w, int h, int f)
     set_vert(v + 2, X[1], Y[0], 1.0f, 1.0f, gui_wht);
     set_vert(v + 3, X[1], Y[1], 1.0f, 0.0f, gui_wht);
 
-    /* Copy this off to the VBO. */
-
-    glBindBuffer_   (GL_ARRAY_BUFFER, vert_vbo);
-    glBufferSubData_(GL_ARRAY_BUFFER,
-                     (id * WIDGET_VERT + RECT_VERT) * sizeof (struct vert),
-                     IMAGE_VERT * sizeof (struct vert), v);
-    glBindBuffer_   (GL_ARRAY_BUFFER, 0);
+    set_verts(id * WIDGET_VERT + RECT_VERT, v, IMAGE_VERT);
 }
 
 static void gui_geom_widget(int id, int flags)
@@ -596,6 +625,92 @@ static void gui_glyphs_free(void)
 
 /*---------------------------------------------------------------------------*/
 
+/*
+ * (Re)create the VBOs at the current widget capacity. Element data
+ * depends only on the widget ID, so it is generated once here.
+ */
+static void gui_buffers_init(void)
+{
+    GLushort *elem;
+
+    if (!vert_vbo) glGenBuffers_(1, &vert_vbo);
+    if (!vert_ebo) glGenBuffers_(1, &vert_ebo);
+
+    glBindBuffer_(GL_ARRAY_BUFFER, vert_vbo);
+    glBufferData_(GL_ARRAY_BUFFER,
+                  widget_max * WIDGET_VERT * sizeof (struct vert),
+                  vert_buf, GL_STATIC_DRAW);
+    glBindBuffer_(GL_ARRAY_BUFFER, 0);
+
+    vert_lo = vert_hi = 0;
+
+    if ((elem = malloc(widget_max * WIDGET_ELEM * sizeof (GLushort))))
+    {
+        int id, i;
+
+        for (id = 0; id < widget_max; id++)
+            for (i = 0; i < RECT_ELEM; i++)
+                elem[id * WIDGET_ELEM + i] = id * WIDGET_VERT + rect_elem_base[i];
+
+        glBindBuffer_(GL_ELEMENT_ARRAY_BUFFER, vert_ebo);
+        glBufferData_(GL_ELEMENT_ARRAY_BUFFER,
+                      widget_max * WIDGET_ELEM * sizeof (GLushort),
+                      elem, GL_STATIC_DRAW);
+        glBindBuffer_(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+        free(elem);
+    }
+}
+
+/*
+ * Double the size of the widget table, up to WIDGET_LIM.
+ */
+static int gui_grow(void)
+{
+    int n = widget_max ? MIN(widget_max * 2, WIDGET_LIM) : WIDGET_MIN;
+
+    struct widget *w;
+    struct vert   *v;
+
+    if (n <= widget_max)
+        return 0;
+
+    if (!(w = realloc(widget, n * sizeof (*w))))
+        return 0;
+
+    widget = w;
+
+    if (!(v = realloc(vert_buf, n * WIDGET_VERT * sizeof (*v))))
+        return 0;
+
+    vert_buf = v;
+
+    memset(widget   + widget_max,               0,
+           (n - widget_max) * sizeof (*w));
+    memset(vert_buf + widget_max * WIDGET_VERT, 0,
+           (n - widget_max) * WIDGET_VERT * sizeof (*v));
+
+    widget_max = n;
+
+    /* Resize the VBOs if they are live. */
+
+    if (vert_vbo)
+        gui_buffers_init();
+
+    return 1;
+}
+
+/*
+ * Mark a widget and its ancestors for layout.
+ */
+static void gui_dirty(int id)
+{
+    for (; id && !widget[id].dirty; id = widget[id].parent)
+        widget[id].dirty = 1;
+}
+
+/*---------------------------------------------------------------------------*/
+
 static void gui_widget_size(int);
 
 /*
@@ -628,7 +743,7 @@ void gui_resize(void)
 
     /* Recompute widget space requirements with the new font sizes. */
 
-    for (i = 1; i < WIDGET_MAX; ++i)
+    for (i = 1; i < widget_max; ++i)
         if (widget[i].type != GUI_FREE)
         {
             /*
@@ -653,11 +768,16 @@ void gui_resize(void)
             /* Actually compute the stuff. */
 
             gui_widget_size(i);
+
+            /* Everything needs to be laid out and rendered anew. */
+
+            widget[i].dirty   = 1;
+            widget[i].label_w = -1;
         }
 
     /* Re-do any saved layouts. Separate from above due to many inter-dependencies. */
 
-    for (i = 1; i < WIDGET_MAX; ++i)
+    for (i = 1; i < widget_max; ++i)
         if (widget[i].type != GUI_FREE && (widget[i].flags & GUI_LAYOUT))
             gui_layout(i, widget[i].layout_xd, widget[i].layout_yd);
 
@@ -666,23 +786,19 @@ void gui_resize(void)
 
 void gui_init(void)
 {
-    memset(widget, 0, sizeof (struct widget) * WIDGET_MAX);
-
-    /* Initialize the VBOs. */
+    /* The widget table persists and keeps its capacity across re-inits. */
 
-    memset(vert_buf, 0, sizeof (vert_buf));
+    if (widget_max == 0)
+        gui_grow();
+    else
+    {
+        memset(widget,   0, widget_max * sizeof (struct widget));
+        memset(vert_buf, 0, widget_max * WIDGET_VERT * sizeof (struct vert));
+    }
 
-    glGenBuffers_(1,              &vert_vbo);
-    glBindBuffer_(GL_ARRAY_BUFFER, vert_vbo);
-    glBufferData_(GL_ARRAY_BUFFER, sizeof (vert_buf), vert_buf, GL_STATIC_DRAW);
-    glBindBuffer_(GL_ARRAY_BUFFER, 0);
+    /* Initialize the VBOs. */
 
-    glGenBuffers_(1,                      &vert_ebo);
-    glBindBuffer_(GL_ELEMENT_ARRAY_BUFFER, vert_ebo);
-    glBufferData_(GL_ELEMENT_ARRAY_BUFFER,
-                  WIDGET_MAX * WIDGET_ELEM * sizeof (GLushort),
-                  NULL, GL_STATIC_DRAW);
-    glBindBuffer_(GL_ELEMENT_ARRAY_BUFFER, 0);
+    gui_buffers_init();
 
     /* Initialize window size-dependent resources. */
 
@@ -691,6 +807,23 @@ void gui_init(void)
     active = 0;
 }
 
+/*
+ * Release a widget texture. Images come from the texture cache, any
+ * other texture belongs to the widget.
+ */
+static void gui_free_image(int id)
+{
+    if (widget[id].image)
+    {
+        if (widget[id].type == GUI_IMAGE)
+            tex_cache_put(widget[id].image);
+        else
+            glDeleteTextures(1, &widget[id].image);
+
+        widget[id].image = 0;
+    }
+}
+
 void gui_free(void)
 {
     int id;
@@ -700,12 +833,14 @@ void gui_free(void)
     glDeleteBuffers_(1, &vert_vbo);
     glDeleteBuffers_(1, &vert_ebo);
 
+    vert_vbo = 0;
+    vert_ebo = 0;
+
     /* Release any remaining widget texture and display list indices. */
 
-    for (id = 1; id < WIDGET_MAX; id++)
+    for (id = 1; id < widget_max; id++)
     {
-        if (widget[id].image)
-            glDeleteTextures(1, &widget[id].image);
+        gui_free_image(id);
 
         if (widget[id].init_text)
         {
@@ -733,6 +868,10 @@ void gui_free(void)
     /* Release theme resources. */
 
     gui_theme_quit();
+
+    /* Release cached images. */
+
+    tex_cache_free();
 }
 
 /*---------------------------------------------------------------------------*/
@@ -741,9 +880,9 @@ static int gui_widget(int pd, int type)
 {
     int id;
 
-    /* Find an unused entry in the widget table. */
+    /* Find an unused entry in the widget table, growing it if full. */
 
-    for (id = 1; id < WIDGET_MAX; id++)
+    for (id = 1; id < widget_max || gui_grow(); id++)
         if (widget[id].type == GUI_FREE)
         {
             /* Set the type and default properties. */
@@ -768,6 +907,12 @@ static int gui_widget(int pd, int type)
             widget[id].trunc  = TRUNC_NONE;
             widget[id].text_w = 0;
             widget[id].text_h = 0;
+            widget[id].req_w  = 0;
+            widget[id].req_h  = 0;
+
+            widget[id].label_w = -1;
+            widget[id].dirty   = 1;
+            widget[id].reflow  = 1;
 
             widget[id].init_text = NULL;
             widget[id].init_value = 0;
@@ -788,11 +933,15 @@ static int gui_widget(int pd, int type)
 
             /* Insert the new widget into the parent's widget list. */
 
+            widget[id].parent = pd;
+
             if (pd)
             {
                 widget[id].car = 0;
                 widget[id].cdr = widget[pd].car;
                 widget[pd].car = id;
+
+                gui_dirty(pd);
             }
             else
             {
@@ -933,9 +1082,9 @@ static char *gui_truncate(const char *text,
 
 void gui_set_image(int id, const char *file)
 {
-    glDeleteTextures(1, &widget[id].image);
+    gui_free_image(id);
 
-    widget[id].image = make_image_from_file(file, IF_MIPMAP);
+    widget[id].image = tex_cache_get(file);
 }
 
 void gui_set_label(int id, const char *text)
@@ -970,6 +1119,7 @@ void gui_set_label(int id, const char *text)
     widget[id].text = full_str;
     widget[id].text_w = 0;
     widget[id].text_h = 0;
+    widget[id].label_w = widget[id].w;
 
     widget[id].image = make_image_from_font(NULL, NULL,
                                             &widget[id].text_w,
@@ -1059,17 +1209,21 @@ void gui_set_multi(int id, const char *text)
 
 void gui_set_trunc(int id, enum trunc trunc)
 {
-    widget[id].trunc = trunc;
+    widget[id].trunc   = trunc;
+    widget[id].label_w = -1;
 }
 
 void gui_set_font(int id, const char *path)
 {
-    widget[id].font = gui_font_load(path);
+    widget[id].font    = gui_font_load(path);
+    widget[id].label_w = -1;
 }
 
 void gui_set_fill(int id)
 {
     widget[id].flags |= GUI_FILL;
+
+    gui_dirty(widget[id].parent);
 }
 
 /*
@@ -1168,6 +1322,9 @@ static void gui_widget_size(int id)
             widget[id].h = 0;
             break;
     }
+
+    widget[id].req_w = widget[id].w;
+    widget[id].req_h = widget[id].h;
 }
 
 int gui_image(int pd, const char *file, int w, int h)
@@ -1178,7 +1335,7 @@ int gui_image(int pd, const char *file, int w, int h)
 
     if ((id = gui_widget(pd, GUI_IMAGE)))
     {
-        widget[id].image  = make_image_from_file(file, IF_MIPMAP);
+        widget[id].image  = tex_cache_get(file);
 
         /* Convert window pixels to integer-encoded fractions. */
 
@@ -1357,7 +1514,8 @@ int gui_multi(int pd, const char *text, int size, const GLubyte *c0,
  * The bottom-up pass determines the area of all widgets.  The minimum
  * width  and height of  a leaf  widget is  given by  the size  of its
  * contents.   Array  and  stack   widths  and  heights  are  computed
- * recursively from these.
+ * recursively from these.  Results are kept in req_w and req_h, and
+ * subtrees not marked dirty since the last pass are skipped.
  */
 
 static void gui_widget_up(int id);
@@ -1366,62 +1524,71 @@ static void gui_harray_up(int id)
 {
     int jd, c = 0;
 
+    widget[id].req_w = 0;
+    widget[id].req_h = 0;
+
     /* Find the widest child width and the highest child height. */
 
     for (jd = widget[id].car; jd; jd = widget[jd].cdr)
     {
         gui_widget_up(jd);
 
-        if (widget[id].h < widget[jd].h)
-            widget[id].h = widget[jd].h;
-        if (widget[id].w < widget[jd].w)
-            widget[id].w = widget[jd].w;
+        if (widget[id].req_h < widget[jd].req_h)
+            widget[id].req_h = widget[jd].req_h;
+        if (widget[id].req_w < widget[jd].req_w)
+            widget[id].req_w = widget[jd].req_w;
 
         c++;
     }
 
     /* Total width is the widest child width times the child count. */
 
-    widget[id].w *= c;
+    widget[id].req_w *= c;
 }
 
 static void gui_varray_up(int id)
 {
     int jd, c = 0;
 
+    widget[id].req_w = 0;
+    widget[id].req_h = 0;
+
     /* Find the widest child width and the highest child height. */
 
     for (jd = widget[id].car; jd; jd = widget[jd].cdr)
     {
         gui_widget_up(jd);
 
-        if (widget[id].h < widget[jd].h)
-            widget[id].h = widget[jd].h;
-        if (widget[id].w < widget[jd].w)
-            widget[id].w = widget[jd].w;
+        if (widget[id].req_h < widget[jd].req_h)
+            widget[id].req_h = widget[jd].req_h;
+        if (widget[id].req_w < widget[jd].req_w)
+            widget[id].req_w = widget[jd].req_w;
 
         c++;
     }
 
     /* Total height is the highest child height times the child count. */
 
-    widget[id].h *= c;
+    widget[id].req_h *= c;
 }
 
 static void gui_hstack_up(int id)
 {
     int jd;
 
+    widget[id].req_w = 0;
+    widget[id].req_h = 0;
+
     /* Find the highest child height.  Sum the child widths. */
 
     for (jd = widget[id].car; jd; jd = widget[jd].cdr)
     {
         gui_widget_up(jd);
 
-        if (widget[id].h < widget[jd].h)
-            widget[id].h = widget[jd].h;
+        if (widget[id].req_h < widget[jd].req_h)
+            widget[id].req_h = widget[jd].req_h;
 
-        widget[id].w += widget[jd].w;
+        widget[id].req_w += widget[jd].req_w;
     }
 }
 
@@ -1429,42 +1596,54 @@ static void gui_vstack_up(int id)
 {
     int jd;
 
+    widget[id].req_w = 0;
+    widget[id].req_h = 0;
+
     /* Find the widest child width.  Sum the child heights. */
 
     for (jd = widget[id].car; jd; jd = widget[jd].cdr)
     {
         gui_widget_up(jd);
 
-        if (widget[id].w < widget[jd].w)
-            widget[id].w = widget[jd].w;
+        if (widget[id].req_w < widget[jd].req_w)
+            widget[id].req_w = widget[jd].req_w;
 
-        widget[id].h += widget[jd].h;
+        widget[id].req_h += widget[jd].req_h;
     }
 }
 
 static void gui_button_up(int id)
 {
-    if (widget[id].w < widget[id].h && widget[id].w > 0)
-        widget[id].w = widget[id].h;
+    /* Start from the size of the contents. */
+
+    int w = widget[id].w;
+    int h = widget[id].h;
+
+    if (w < h && w > 0)
+        w = h;
 
     /* Padded text elements look a little nicer. */
 
-    if (widget[id].w < video.device_w)
-        widget[id].w += padding;
-    if (widget[id].h < video.device_h)
-        widget[id].h += padding;
+    if (w < video.device_w)
+        w += padding;
+    if (h < video.device_h)
+        h += padding;
 
     /* A button should be at least wide enough to accomodate the borders. */
 
-    if (widget[id].w < borders[0] + borders[1])
-        widget[id].w = borders[0] + borders[1];
-    if (widget[id].h < borders[2] + borders[3])
-        widget[id].h = borders[2] + borders[3];
+    if (w < borders[0] + borders[1])
+        w = borders[0] + borders[1];
+    if (h < borders[2] + borders[3])
+        h = borders[2] + borders[3];
+
+    widget[id].req_w = w;
+    widget[id].req_h = h;
 }
 
 static void gui_widget_up(int id)
 {
-    if (id)
+    if (id && widget[id].dirty)
+    {
         switch (widget[id].type)
         {
         case GUI_HARRAY: gui_harray_up(id); break;
@@ -1474,13 +1653,18 @@ static void gui_widget_up(int id)
         case GUI_FILLER:                    break;
         default:         gui_button_up(id); break;
         }
+
+        widget[id].dirty  = 0;
+        widget[id].reflow = 1;
+    }
 }
 
 /*---------------------------------------------------------------------------*/
 /*
  * The  top-down layout  pass distributes  available area  as computed
  * during the bottom-up pass.  Widgets  use their area and position to
- * initialize rendering state.
+ * initialize rendering state.  A subtree that was not resized and is
+ * given the same area as before keeps its previous placement.
  */
 
 static void gui_widget_dn(int id, int x, int y, int w, int h);
@@ -1552,10 +1736,10 @@ static void gui_hstack_dn(int id, int x, int y, int w, int h)
         else if (widget[jd].flags & GUI_FILL)
         {
             c  += 1;
-            jw += widget[jd].w;
+            jw += widget[jd].req_w;
         }
         else
-            jw += widget[jd].w;
+            jw += widget[jd].req_w;
 
     /* Give non-filler children their requested space.   */
     /* Distribute the rest evenly among filler children. */
@@ -1567,9 +1751,9 @@ static void gui_hstack_dn(int id, int x, int y, int w, int h)
         if (widget[jd].type == GUI_FILLER)
             gui_widget_dn(jd, jx, y, dw, h);
         else if (widget[jd].flags & GUI_FILL)
-            gui_widget_dn(jd, jx, y, widget[jd].w + dw, h);
+            gui_widget_dn(jd, jx, y, widget[jd].req_w + dw, h);
         else
-            gui_widget_dn(jd, jx, y, widget[jd].w, h);
+            gui_widget_dn(jd, jx, y, widget[jd].req_w, h);
 
         jx += widget[jd].w;
     }
@@ -1592,10 +1776,10 @@ static void gui_vstack_dn(int id, int x, int y, int w, int h)
         else if (widget[jd].flags & GUI_FILL)
         {
             c  += 1;
-            jh += widget[jd].h;
+            jh += widget[jd].req_h;
         }
         else
-            jh += widget[jd].h;
+            jh += widget[jd].req_h;
 
     /* Give non-filler children their requested space.   */
     /* Distribute the rest evenly among filler children. */
@@ -1605,9 +1789,9 @@ static void gui_vstack_dn(int id, int x, int y, int w, int h)
         if (widget[jd].type == GUI_FILLER)
             gui_widget_dn(jd, x, jy, w, (h - jh) / c);
         else if (widget[jd].flags & GUI_FILL)
-            gui_widget_dn(jd, x, jy, w, widget[jd].h + (h - jh) / c);
+            gui_widget_dn(jd, x, jy, w, widget[jd].req_h + (h - jh) / c);
         else
-            gui_widget_dn(jd, x, jy, w, widget[jd].h);
+            gui_widget_dn(jd, x, jy, w, widget[jd].req_h);
 
         jy += widget[jd].h;
     }
@@ -1633,7 +1817,15 @@ static void gui_button_dn(int id, int x, int y, int w, int h)
 
 static void gui_widget_dn(int id, int x, int y, int w, int h)
 {
+    if (id && !widget[id].reflow &&
+        widget[id].x == x && widget[id].y == y &&
+        widget[id].w == w && widget[id].h == h)
+        return;
+
     if (id)
+    {
+        widget[id].reflow = 0;
+
         switch (widget[id].type)
         {
         case GUI_HARRAY: gui_harray_dn(id, x, y, w, h); break;
@@ -1644,6 +1836,7 @@ static void gui_widget_dn(int id, int x, int y, int w, int h)
         case GUI_SPACE:  gui_filler_dn(id, x, y, w, h); break;
         default:         gui_button_dn(id, x, y, w, h); break;
         }
+    }
 }
 
 /*---------------------------------------------------------------------------*/
@@ -1767,7 +1960,10 @@ static void gui_render_text(int id)
 {
     int jd;
 
-    if (widget[id].type != GUI_FREE && widget[id].text)
+    /* Labels are only re-rendered if their truncation width changed. */
+
+    if (widget[id].type != GUI_FREE && widget[id].text &&
+        (!widget[id].image || widget[id].label_w != widget[id].w))
         gui_set_label(id, widget[id].text);
 
     for (jd = widget[id].car; jd; jd = widget[jd].cdr)
@@ -1794,8 +1990,8 @@ void gui_layout(int id, int xd, int yd)
 
     gui_widget_up(id);
 
-    w = MIN(widget[id].w, W - padding * 2);
-    h = MIN(widget[id].h, H - padding * 2);
+    w = MIN(widget[id].req_w, W - padding * 2);
+    h = MIN(widget[id].req_h, H - padding * 2);
 
     if      (xd < 0) x = 0;
     else if (xd > 0) x = (W - w);
@@ -1883,8 +2079,7 @@ int gui_delete(int id)
 
         /* Release any GL resources held by this widget. */
 
-        if (widget[id].image)
-            glDeleteTextures(1, &widget[id].image);
+        gui_free_image(id);
 
         /* Mark this widget unused. */
 
@@ -1909,38 +2104,37 @@ void gui_remove(int id)
 {
     if (id && widget[id].type != GUI_FREE)
     {
-        int pd = 0;
-        int i;
+        int pd = widget[id].parent;
 
-        for (i = 1; i < WIDGET_MAX; ++i)
-            if (widget[i].type != GUI_FREE)
-            {
-                int jd, pjd;
+        if (pd)
+        {
+            int jd, pjd;
 
-                for (pjd = 0, jd = widget[i].car; jd; pjd = jd, jd = widget[jd].cdr)
-                    if (jd == id)
-                    {
-                        /* Note the parent widget. */
+            /* Remove from the parent's linked list. */
 
-                        pd = i;
+            for (pjd = 0, jd = widget[pd].car; jd; pjd = jd, jd = widget[jd].cdr)
+                if (jd == id)
+                {
+                    if (pjd)
+                        widget[pjd].cdr = widget[jd].cdr; /* prev = next */
+                    else
+                        widget[pd].car = widget[jd].cdr; /* head = next */
 
-                        /* Remove from linked list. */
+                    break;
+                }
 
-                        if (pjd)
-                            widget[pjd].cdr = widget[jd].cdr; /* prev = next */
-                        else
-                            widget[i].car = widget[jd].cdr; /* head = next */
-                    }
-            }
+            /* Update parent widget layout. */
 
-        /* Update parent widget layout. */
+            widget[pd].reflow = 1;
 
-        if (pd)
-        {
             gui_widget_dn(pd, widget[pd].x, widget[pd].y, widget[pd].w, widget[pd].h);
             gui_geom_widget(pd, widget[pd].flags);
+
+            gui_dirty(pd);
         }
 
+        widget[id].cdr = 0;
+
         gui_delete(id);
 
         transition_remove(id);
@@ -21,36 +21,46 @@
 
 #include "glext.h"
 #include "image.h"
+#include "image_cache.h"
 #include "base_image.h"
 #include "config.h"
 #include "video.h"
 
 #include "fs.h"
 #include "fs_png.h"
+#include "pool.h"
+#include "common.h"
 
 /*---------------------------------------------------------------------------*/
 
-void image_snap(const char *filename)
+/*
+ * Write the given bottom-up RGBA pixel buffer to a PNG file. Return
+ * false if the file could not be written completely.
+ */
+int image_write(const char *filename, const unsigned char *p, int w, int h)
 {
     fs_file     filep  = NULL;
     png_structp writep = NULL;
     png_infop   infop  = NULL;
     png_bytep  *bytep  = NULL;
 
-    int w = video.device_w;
-    int h = video.device_h;
-    int i;
-
-    unsigned char *p = NULL;
+    int i, ok = 0;
 
     /* Initialize all PNG export data structures. */
 
     if (!(filep = fs_open_write(filename)))
-        return;
+        return 0;
     if (!(writep = png_create_write_struct(PNG_LIBPNG_VER_STRING, 0, 0, 0)))
-        return;
+    {
+        fs_close(filep);
+        return 0;
+    }
     if (!(infop = png_create_info_struct(writep)))
-        return;
+    {
+        png_destroy_write_struct(&writep, NULL);
+        fs_close(filep);
+        return 0;
+    }
 
     /* Enable the default PNG error handler. */
 
@@ -65,29 +75,23 @@ void image_snap(const char *filename)
                      PNG_COMPRESSION_TYPE_DEFAULT,
                      PNG_FILTER_TYPE_DEFAULT);
 
-        /* Allocate the pixel buffer and copy pixels there. */
+        /* Allocate and initialize the row pointers. */
 
-        if ((p = (unsigned char *) malloc(w * h * 4)))
+        if ((bytep = (png_bytep *) png_malloc(writep, h * sizeof (png_bytep))))
         {
-            glReadPixels(0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, p);
-
-            /* Allocate and initialize the row pointers. */
+            for (i = 0; i < h; ++i)
+                bytep[h - i - 1] = (png_bytep) (p + i * w * 4);
 
-            if ((bytep = (png_bytep *) png_malloc(writep, h * sizeof (png_bytep))))
-            {
-                for (i = 0; i < h; ++i)
-                    bytep[h - i - 1] = (png_bytep) (p + i * w * 4);
+            /* Write the PNG image file. */
 
-                /* Write the PNG image file. */
+            png_write_info(writep, infop);
+            png_set_filler(writep, 0, PNG_FILLER_AFTER);
+            png_write_image(writep, bytep);
+            png_write_end(writep, infop);
 
-                png_write_info(writep, infop);
-                png_set_filler(writep, 0, PNG_FILLER_AFTER);
-                png_write_image(writep, bytep);
-                png_write_end(writep, infop);
+            png_free(writep, bytep);
 
-                free(bytep);
-            }
-            free(p);
+            ok = (fs_flush(filep) == 0);
         }
     }
 
@@ -95,41 +99,119 @@ void image_snap(const char *filename)
 
     png_destroy_write_struct(&writep, &infop);
     fs_close(filep);
+
+    return ok;
+}
+
+/*
+ * Read back the given region of the current read buffer.
+ */
+static unsigned char *image_read(int w, int h)
+{
+    unsigned char *p;
+
+    if ((p = (unsigned char *) malloc(w * h * 4)))
+    {
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, p);
+    }
+    return p;
+}
+
+void image_snap(const char *filename)
+{
+    unsigned char *p;
+
+    if ((p = image_read(video.device_w, video.device_h)))
+    {
+        image_write(filename, p, video.device_w, video.device_h);
+        free(p);
+    }
 }
 
 /*---------------------------------------------------------------------------*/
 
 /*
- * Create an OpenGL texture object using the given image buffer.
+ * PNG encoding dominates the cost of a batch of snapshots, so the
+ * batch renderer reads back each frame and leaves the compression to
+ * a writer thread while it draws the next one.
  */
-GLuint make_texture(const void *p, int w, int h, int b, int fl)
+
+struct snap
 {
-    static const GLenum format[] =
-        { 0, GL_LUMINANCE, GL_LUMINANCE_ALPHA, GL_RGB, GL_RGBA };
+    char *filename;
+    unsigned char *p;
+    int w;
+    int h;
+};
 
-    GLuint o = 0;
+#define SNAP_QUEUE_MAX 4                /* Frames waiting to be written      */
 
-    /* Scale the image as configured, or to fit the OpenGL limitations. */
+static void snap_func(void *data)
+{
+    struct snap *s = data;
 
-#ifdef GL_TEXTURE_MAX_ANISOTROPY_EXT
-    int a = config_get_d(CONFIG_ANISO);
-#endif
-#ifdef GL_GENERATE_MIPMAP_SGIS
-    int m = (fl & IF_MIPMAP) ? config_get_d(CONFIG_MIPMAP) : 0;
-#endif
-    int k = config_get_d(CONFIG_TEXTURES);
-    int W = w;
-    int H = h;
+    image_write(s->filename, s->p, s->w, s->h);
+
+    free(s->filename);
+    free(s->p);
+    free(s);
+}
+
+static struct worker snap_worker = { "image_snap", snap_func, SNAP_QUEUE_MAX };
+
+/*
+ * Read back a W by H snapshot of the current read buffer and queue it
+ * for writing. Falls back to writing in place if no thread is available.
+ */
+void image_snap_async(const char *filename, int w, int h)
+{
+    struct snap *s;
+
+    worker_start(&snap_worker, 1);
 
-    GLint max = gli.max_texture_size;
+    if (!(s = calloc(1, sizeof (*s))))
+        return;
 
-    void *q = NULL;
+    s->filename = dupe_string(filename);
+    s->p        = image_read(w, h);
+    s->w        = w;
+    s->h        = h;
 
-    while (w / k > (int) max || h / k > (int) max)
-        k *= 2;
+    if (s->filename && s->p)
+        worker_put(&snap_worker, s);
+    else
+    {
+        free(s->filename);
+        free(s->p);
+        free(s);
+    }
+}
+
+/*
+ * Finish writing all queued snapshots and stop the writer thread.
+ */
+void image_snap_wait(void)
+{
+    worker_stop(&snap_worker, NULL);
+}
 
-    if (k > 1)
-        q = image_scale(p, w, h, b, &W, &H, k);
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Create an OpenGL texture object from the given mipmap levels.
+ */
+GLuint make_texture_mipmap(const struct mipmap *mm)
+{
+    static const GLenum format[] =
+        { 0, GL_LUMINANCE, GL_LUMINANCE_ALPHA, GL_RGB, GL_RGBA };
+
+#ifdef GL_TEXTURE_MAX_ANISOTROPY_EXT
+    int a = config_get_d(CONFIG_ANISO);
+#endif
+
+    GLuint o = 0;
+    int i;
 
     /* Generate and configure a new OpenGL texture. */
 
@@ -140,27 +222,41 @@ GLuint make_texture(const void *p, int w, int h, int b, int fl)
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                    mm->n > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
 
-#ifdef GL_GENERATE_MIPMAP_SGIS
-    if (m)
-    {
-        glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP_SGIS, GL_TRUE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
-                        GL_LINEAR_MIPMAP_LINEAR);
-    }
-#endif
 #ifdef GL_TEXTURE_MAX_ANISOTROPY_EXT
     if (a && gli.texture_filter_anisotropic) glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, a);
 #endif
 
-    /* Copy the image to an OpenGL texture. */
+    /* Copy each level to the OpenGL texture. */
 
-    glTexImage2D(GL_TEXTURE_2D, 0,
-                 format[b], W, H, 0,
-                 format[b], GL_UNSIGNED_BYTE, q ? q : p);
+    for (i = 0; i < mm->n; i++)
+        glTexImage2D(GL_TEXTURE_2D, i,
+                     format[mm->b], mm->w[i], mm->h[i], 0,
+                     format[mm->b], GL_UNSIGNED_BYTE, mm->p[i]);
 
-    if (q) free(q);
+    return o;
+}
+
+/*
+ * Create an OpenGL texture object using the given image buffer.  Scale
+ * the image as configured, or to fit the OpenGL limitations.
+ */
+GLuint make_texture(const void *p, int w, int h, int b, int fl)
+{
+    struct mipmap mm;
+
+    int k = config_get_d(CONFIG_TEXTURES);
+    int m = (fl & IF_MIPMAP) ? config_get_d(CONFIG_MIPMAP) : 0;
+
+    GLuint o = 0;
+
+    if (mipmap_make(&mm, p, w, h, b, k, gli.max_texture_size, m))
+    {
+        o = make_texture_mipmap(&mm);
+        mipmap_free(&mm);
+    }
 
     return o;
 }
@@ -170,18 +266,17 @@ GLuint make_texture(const void *p, int w, int h, int b, int fl)
  */
 GLuint make_image_from_file(const char *filename, int fl)
 {
-    void  *p;
-    int    w;
-    int    h;
-    int    b;
-    GLuint o = 0;
+    struct mipmap mm;
 
-    /* Load the image. */
+    int k = config_get_d(CONFIG_TEXTURES);
+    int m = (fl & IF_MIPMAP) ? config_get_d(CONFIG_MIPMAP) : 0;
 
-    if ((p = image_load(filename, &w, &h, &b)))
+    GLuint o = 0;
+
+    if (mipmap_load(&mm, filename, k, gli.max_texture_size, m))
     {
-        o = make_texture(p, w, h, b, fl);
-        free(p);
+        o = make_texture_mipmap(&mm);
+        mipmap_free(&mm);
     }
 
     return o;
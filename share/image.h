@@ -9,6 +9,8 @@
 
 /*---------------------------------------------------------------------------*/
 
+struct mipmap;
+
 #define IF_MIPMAP 0x01
 
 #if SDL_BYTEORDER == SDL_BIG_ENDIAN
@@ -23,7 +25,10 @@
 #define AMASK 0xFF000000
 #endif
 
+int    image_write(const char *, const unsigned char *, int, int);
 void   image_snap(const char *);
+void   image_snap_async(const char *, int, int);
+void   image_snap_wait(void);
 
 GLuint make_image_from_file(const char *, int);
 GLuint make_image_from_font(int *, int *,
@@ -31,6 +36,7 @@ GLuint make_image_from_font(int *, int *,
 void   size_image_from_font(int *, int *,
                             int *, int *, const char *, TTF_Font *);
 GLuint make_texture(const void *, int, int, int, int);
+GLuint make_texture_mipmap(const struct mipmap *);
 
 SDL_Surface *load_surface(const char *);
 
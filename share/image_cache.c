@@ -0,0 +1,295 @@
+/*
+ * Copyright (C) 2003-2010 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "image_cache.h"
+#include "base_image.h"
+#include "binary.h"
+#include "config.h"
+#include "common.h"
+#include "log.h"
+#include "fs.h"
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Decoded textures are cached in the user directory, named by a hash of
+ * the source file contents and the parameters that shaped the result.
+ */
+
+#define CACHE_DIR     "Textures"
+#define CACHE_MAGIC   0x5854424e                /* "NBTX" */
+#define CACHE_VERSION 1
+
+/* Images may be loaded off the main thread, so count atomically. */
+
+static SDL_atomic_t hit_count;
+static SDL_atomic_t miss_count;
+static SDL_atomic_t hit_ms;
+static SDL_atomic_t miss_ms;
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * 64-bit FNV-1a, split in two halves for printing.
+ */
+static void hash_bytes(unsigned int h[2], const void *data, size_t n)
+{
+    const unsigned char *p = (const unsigned char *) data;
+
+    unsigned long long x = ((unsigned long long) h[0] << 32) | h[1];
+    size_t i;
+
+    for (i = 0; i < n; i++)
+    {
+        x ^= p[i];
+        x *= 0x100000001b3ULL;
+    }
+
+    h[0] = (unsigned int) (x >> 32);
+    h[1] = (unsigned int) (x);
+}
+
+static void hash_index(unsigned int h[2], int i)
+{
+    hash_bytes(h, &i, sizeof (i));
+}
+
+/*---------------------------------------------------------------------------*/
+
+static int cache_read(struct mipmap *mm, const char *name)
+{
+    fs_file fh;
+    int i, ok = 0;
+
+    memset(mm, 0, sizeof (*mm));
+
+    if ((fh = fs_open_read(name)))
+    {
+        if (get_index(fh) == CACHE_MAGIC &&
+            get_index(fh) == CACHE_VERSION)
+        {
+            mm->b = get_index(fh);
+            mm->n = get_index(fh);
+
+            ok = (mm->b >= 1 && mm->b <= 4 &&
+                  mm->n >= 1 && mm->n <= MIPMAP_MAX);
+
+            for (i = 0; ok && i < mm->n; i++)
+            {
+                int size;
+
+                mm->w[i] = get_index(fh);
+                mm->h[i] = get_index(fh);
+
+                ok = (mm->w[i] > 0 && mm->w[i] <= 16384 &&
+                      mm->h[i] > 0 && mm->h[i] <= 16384);
+
+                if (ok)
+                {
+                    size = mm->w[i] * mm->h[i] * mm->b;
+
+                    ok = ((mm->p[i] = malloc(size)) &&
+                          fs_read(mm->p[i], size, fh) == size);
+                }
+            }
+        }
+        fs_close(fh);
+    }
+
+    if (!ok)
+        mipmap_free(mm);
+
+    return ok;
+}
+
+static void cache_write(const struct mipmap *mm, const char *name)
+{
+    char tmp[MAXSTR];
+    fs_file fh;
+    int i, ok = 0;
+
+    SAFECPY(tmp, name);
+    SAFECAT(tmp, ".tmp");
+
+    fs_mkdir(CACHE_DIR);
+
+    /* Write aside and rename, so a partial file is never read back. */
+
+    if ((fh = fs_open_write(tmp)))
+    {
+        put_index(fh, CACHE_MAGIC);
+        put_index(fh, CACHE_VERSION);
+        put_index(fh, mm->b);
+        put_index(fh, mm->n);
+
+        for (ok = 1, i = 0; ok && i < mm->n; i++)
+        {
+            int size = mm->w[i] * mm->h[i] * mm->b;
+
+            put_index(fh, mm->w[i]);
+            put_index(fh, mm->h[i]);
+
+            ok = (fs_write(mm->p[i], size, fh) == size);
+        }
+        fs_close(fh);
+    }
+
+    if (ok)
+        ok = (fs_rename(tmp, name) == 0);
+
+    if (!ok)
+        fs_remove(tmp);
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Initialize a mipmap from the given image buffer. Level zero is scaled
+ * down by K, or further as needed to fit within MAX.
+ */
+int mipmap_make(struct mipmap *mm, const void *p, int w, int h, int b,
+                int k, int max, int mips)
+{
+    memset(mm, 0, sizeof (*mm));
+
+    mm->b = b;
+
+    while (w / k > max || h / k > max)
+        k *= 2;
+
+    if (k > 1)
+    {
+        if (!(mm->p[0] = image_scale(p, w, h, b, &mm->w[0], &mm->h[0], k)))
+            return 0;
+    }
+    else
+    {
+        mm->p[0]     = (void *) p;
+        mm->w[0]     = w;
+        mm->h[0]     = h;
+        mm->borrowed = 1;
+    }
+
+    mm->n = 1;
+
+    if (mips)
+        while (mm->n < MIPMAP_MAX && (mm->w[mm->n - 1] > 1 ||
+                                      mm->h[mm->n - 1] > 1))
+        {
+            const int i = mm->n;
+
+            if (!(mm->p[i] = image_mip(mm->p[i - 1], mm->w[i - 1],
+                                       mm->h[i - 1], b,
+                                       &mm->w[i], &mm->h[i])))
+                break;
+
+            mm->n++;
+        }
+
+    return 1;
+}
+
+/*
+ * Initialize a mipmap from the named image file, from the texture cache
+ * if possible.
+ */
+int mipmap_load(struct mipmap *mm, const char *path, int k, int max, int mips)
+{
+    Uint32 t0 = SDL_GetTicks();
+
+    char name[MAXSTR] = "";
+    void *p;
+    int w, h, b, n;
+
+    /* Look for a cached copy of this image with these parameters. */
+
+    if (config_get_d(CONFIG_TEXTURE_CACHE) && (p = fs_load(path, &n)))
+    {
+        unsigned int key[2] = { 0xcbf29ce4, 0x84222325 };
+
+        hash_bytes(key, p, n);
+        hash_index(key, k);
+        hash_index(key, max);
+        hash_index(key, mips);
+
+        free(p);
+
+        sprintf(name, CACHE_DIR "/%08x%08x.tex", key[0], key[1]);
+
+        if (cache_read(mm, name))
+        {
+            SDL_AtomicAdd(&hit_count, 1);
+            SDL_AtomicAdd(&hit_ms, (int) (SDL_GetTicks() - t0));
+            return 1;
+        }
+    }
+
+    /* Decode and process the image, and cache the result. */
+
+    if (!(p = image_load(path, &w, &h, &b)))
+        return 0;
+
+    if (!mipmap_make(mm, p, w, h, b, k, max, mips))
+    {
+        free(p);
+        return 0;
+    }
+
+    if (mm->borrowed)
+        mm->borrowed = 0;
+    else
+        free(p);
+
+    if (name[0])
+        cache_write(mm, name);
+
+    SDL_AtomicAdd(&miss_count, 1);
+    SDL_AtomicAdd(&miss_ms, (int) (SDL_GetTicks() - t0));
+
+    return 1;
+}
+
+void mipmap_free(struct mipmap *mm)
+{
+    int i;
+
+    for (i = mm->borrowed ? 1 : 0; i < MIPMAP_MAX; i++)
+        free(mm->p[i]);
+
+    memset(mm, 0, sizeof (*mm));
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Log the texture load times since the last report.
+ */
+void image_cache_report(void)
+{
+    int hits   = SDL_AtomicSet(&hit_count,  0);
+    int misses = SDL_AtomicSet(&miss_count, 0);
+    int hms    = SDL_AtomicSet(&hit_ms,     0);
+    int mms    = SDL_AtomicSet(&miss_ms,    0);
+
+    if (hits || misses)
+        log_printf("Textures: %d from cache in %d ms, %d decoded in %d ms\n",
+                   hits, hms, misses, mms);
+}
+
+/*---------------------------------------------------------------------------*/
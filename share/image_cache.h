@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2003-2010 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+#ifndef IMAGE_CACHE_H
+#define IMAGE_CACHE_H
+
+/*---------------------------------------------------------------------------*/
+
+#define MIPMAP_MAX 16
+
+/*
+ * A texture image as uploaded: level zero scaled to the texture size
+ * limits, followed by the full mipmap chain if one was requested.
+ */
+
+struct mipmap
+{
+    int b;                              /* Bytes per pixel                   */
+    int n;                              /* Number of levels                  */
+
+    int   w[MIPMAP_MAX];
+    int   h[MIPMAP_MAX];
+    void *p[MIPMAP_MAX];
+
+    unsigned int borrowed:1;            /* Level zero belongs to the caller  */
+};
+
+int  mipmap_make(struct mipmap *, const void *, int w, int h, int b,
+                 int k, int max, int mips);
+int  mipmap_load(struct mipmap *, const char *path, int k, int max, int mips);
+void mipmap_free(struct mipmap *);
+
+void image_cache_report(void);
+
+/*---------------------------------------------------------------------------*/
+
+#endif
@@ -0,0 +1,390 @@
+/*
+ * Copyright (C) 2003-2011 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "inst.h"
+#include "glsl.h"
+#include "geom.h"
+#include "vec3.h"
+#include "config.h"
+#include "common.h"
+#include "solid_draw.h"
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Instanced drawing.  Many copies of one mesh are queued with their
+ * transforms and colors, uploaded in one buffer, and drawn with a single
+ * call.  The shader reproduces the fixed-function texturing and lighting
+ * of the current state, and applies each instance transform in eye space
+ * so that anything already on the modelview stack, such as the transform
+ * of a moving body, still applies beneath it.
+ */
+
+#if ENABLE_OPENGLES || defined(__EMSCRIPTEN__)
+
+int  inst_init(void)  { return 0; }
+void inst_free(void)  { }
+int  inst_ready(void) { return 0; }
+
+void inst_begin(const float *V) { }
+int  inst_add(const float *M, const float *c) { return 0; }
+
+int  inst_bind(void)   { return 0; }
+void inst_unbind(void) { }
+
+void inst_draw_arrays(const struct s_rend *rend,
+                      GLenum mode, GLint i, GLsizei n) { }
+void inst_draw_elements(const struct s_rend *rend,
+                        GLenum mode, GLsizei n, GLenum type,
+                        const GLvoid *p) { }
+
+#else
+
+struct inst
+{
+    GLfloat M[16];                      /* Eye-space instance transform      */
+    GLfloat c[4];                       /* Instance color                    */
+};
+
+static struct inst inst_v[INST_MAX];
+static int         inst_n;
+
+static GLfloat inst_V[16];              /* View at the start of the batch    */
+static GLfloat inst_I[16];              /* ...and its inverse                */
+
+static glsl   inst_glsl;
+static GLuint inst_vbo;
+static GLint  inst_attr_M;
+static GLint  inst_attr_c;
+static GLint  inst_unif_state;
+static GLint  inst_unif_light;
+static GLint  inst_unif_tex;
+static int    inst_unit;
+
+/*---------------------------------------------------------------------------*/
+
+static const char *inst_vert[] = {
+    "#version 120\n",
+
+    "attribute mat4 inst_M;\n",
+    "attribute vec4 inst_c;\n",
+
+    "uniform vec4 inst_state;\n",
+    "uniform vec4 inst_light;\n",
+
+    "void light(int i, vec3 n, vec3 e, vec4 a, vec4 d,",
+               "inout vec4 c, inout vec4 s)\n",
+    "{\n",
+        "vec4  p = gl_LightSource[i].position;\n",
+        "vec3  l = normalize(p.w == 0.0 ? p.xyz : p.xyz - e);\n",
+        "float k = max(dot(n, l), 0.0);\n",
+
+        "c += gl_LightSource[i].ambient * a + gl_LightSource[i].diffuse * d * k;\n",
+
+        "if (k > 0.0)\n",
+        "{\n",
+            "vec3 h = normalize(l + vec3(0.0, 0.0, 1.0));\n",
+            "s += gl_LightSource[i].specular * gl_FrontMaterial.specular *",
+                 "pow(max(dot(n, h), 0.0001), gl_FrontMaterial.shininess);\n",
+        "}\n",
+    "}\n",
+
+    "void main()\n",
+    "{\n",
+        "vec4 e = inst_M * (gl_ModelViewMatrix * gl_Vertex);\n",
+        "vec4 k = gl_Color * inst_c;\n",
+
+        "gl_Position   = gl_ProjectionMatrix * e;\n",
+        "gl_ClipVertex = e;\n",
+
+        "if      (inst_state.w == 2.0) gl_TexCoord[0] = gl_MultiTexCoord2;\n",
+        "else if (inst_state.w == 1.0) gl_TexCoord[0] = gl_MultiTexCoord1;\n",
+        "else                          gl_TexCoord[0] = gl_MultiTexCoord0;\n",
+
+        "if (inst_state.x > 0.0)\n",
+        "{\n",
+            "vec3 n = normalize(mat3(inst_M) * (gl_NormalMatrix * gl_Normal));\n",
+            "vec4 a = inst_state.y > 0.0 ? k : gl_FrontMaterial.ambient;\n",
+            "vec4 d = inst_state.y > 0.0 ? k : gl_FrontMaterial.diffuse;\n",
+            "vec4 c = gl_FrontMaterial.emission + gl_LightModel.ambient * a;\n",
+            "vec4 s = vec4(0.0);\n",
+
+            "if (inst_light.x > 0.0) light(0, n, e.xyz, a, d, c, s);\n",
+            "if (inst_light.y > 0.0) light(1, n, e.xyz, a, d, c, s);\n",
+            "if (inst_light.z > 0.0) light(2, n, e.xyz, a, d, c, s);\n",
+            "if (inst_light.w > 0.0) light(3, n, e.xyz, a, d, c, s);\n",
+
+            "gl_FrontColor          = vec4(c.rgb, d.a);\n",
+            "gl_FrontSecondaryColor = vec4(s.rgb, 0.0);\n",
+        "}\n",
+        "else\n",
+        "{\n",
+            "gl_FrontColor          = k;\n",
+            "gl_FrontSecondaryColor = vec4(0.0);\n",
+        "}\n",
+    "}\n",
+};
+
+static const char *inst_frag[] = {
+    "#version 120\n",
+
+    "uniform sampler2D inst_tex;\n",
+    "uniform vec4      inst_state;\n",
+
+    "void main()\n",
+    "{\n",
+        "vec4 c = gl_Color;\n",
+
+        "if (inst_state.z > 0.0)\n",
+            "c *= texture2D(inst_tex, gl_TexCoord[0].st);\n",
+
+        "gl_FragColor = vec4(c.rgb + gl_SecondaryColor.rgb, c.a);\n",
+    "}\n",
+};
+
+/*---------------------------------------------------------------------------*/
+
+int inst_init(void)
+{
+    if (!gli.instanced_arrays || inst_glsl.program)
+        return inst_ready();
+
+    glsl_create(&inst_glsl, ARRAYSIZE(inst_vert), inst_vert,
+                            ARRAYSIZE(inst_frag), inst_frag);
+
+    if (inst_glsl.program)
+    {
+        inst_attr_M     = glGetAttribLocation_ (inst_glsl.program, "inst_M");
+        inst_attr_c     = glGetAttribLocation_ (inst_glsl.program, "inst_c");
+        inst_unif_state = glGetUniformLocation_(inst_glsl.program, "inst_state");
+        inst_unif_light = glGetUniformLocation_(inst_glsl.program, "inst_light");
+        inst_unif_tex   = glGetUniformLocation_(inst_glsl.program, "inst_tex");
+
+        if (inst_attr_M < 0 || inst_attr_c < 0)
+            glsl_delete(&inst_glsl);
+    }
+
+    if (inst_glsl.program)
+    {
+        glGenBuffers_(1, &inst_vbo);
+        glBindBuffer_(GL_ARRAY_BUFFER, inst_vbo);
+        glBufferData_(GL_ARRAY_BUFFER, sizeof (inst_v), NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer_(GL_ARRAY_BUFFER, 0);
+    }
+
+    return inst_ready();
+}
+
+void inst_free(void)
+{
+    if (inst_vbo)
+    {
+        glDeleteBuffers_(1, &inst_vbo);
+        inst_vbo = 0;
+    }
+    glsl_delete(&inst_glsl);
+}
+
+int inst_ready(void)
+{
+    return inst_glsl.program && inst_vbo && config_get_d(CONFIG_INSTANCING);
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Start a batch of instances relative to the view V, which must match
+ * the modelview at the time of drawing.
+ */
+void inst_begin(const float *V)
+{
+    memcpy(inst_V, V, sizeof (inst_V));
+
+    if (!m_inv(inst_I, inst_V))
+        m_ident(inst_I);
+
+    inst_n = 0;
+}
+
+/*
+ * Queue an instance with transform M, applied on top of the view of
+ * inst_begin, and color C. Return false if the batch is full.
+ */
+int inst_add(const float *M, const float *c)
+{
+    static const float white[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+    float T[16];
+
+    if (inst_n >= INST_MAX)
+        return 0;
+
+    m_mult(T, inst_V, M);
+    m_mult(inst_v[inst_n].M, T, inst_I);
+
+    memcpy(inst_v[inst_n].c, c ? c : white, sizeof (inst_v[inst_n].c));
+
+    inst_n++;
+
+    return 1;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Upload the batch and enable the instanced shader.
+ */
+int inst_bind(void)
+{
+    const GLsizei s = sizeof (struct inst);
+    int i;
+
+    if (inst_n == 0 || !inst_ready())
+        return 0;
+
+    glBindBuffer_(GL_ARRAY_BUFFER, inst_vbo);
+    glBufferData_(GL_ARRAY_BUFFER, sizeof (inst_v), NULL, GL_DYNAMIC_DRAW);
+    glBufferSubData_(GL_ARRAY_BUFFER, 0, inst_n * s, inst_v);
+
+    for (i = 0; i < 4; i++)
+    {
+        const GLuint a = inst_attr_M + i;
+
+        glVertexAttribPointer_(a, 4, GL_FLOAT, GL_FALSE, s,
+                               (GLvoid *) (offsetof (struct inst, M) +
+                                           i * 4 * sizeof (GLfloat)));
+        glVertexAttribDivisor_(a, 1);
+        glEnableVertexAttribArray_(a);
+    }
+
+    glVertexAttribPointer_(inst_attr_c, 4, GL_FLOAT, GL_FALSE, s,
+                           (GLvoid *) offsetof (struct inst, c));
+    glVertexAttribDivisor_(inst_attr_c, 1);
+    glEnableVertexAttribArray_(inst_attr_c);
+
+    glBindBuffer_(GL_ARRAY_BUFFER, 0);
+
+    /* Texture coordinates come from the texture stage of the pipeline. */
+
+    inst_unit = -1;
+
+    if (curr_tex_env)
+        for (i = 0; i < (int) curr_tex_env->count; i++)
+            if (curr_tex_env->stages[i].stage == TEX_STAGE_TEXTURE)
+                inst_unit = curr_tex_env->stages[i].unit - GL_TEXTURE0;
+
+    glUseProgram_(inst_glsl.program);
+    glUniform1i_(inst_unif_tex, inst_unit < 0 ? 0 : inst_unit);
+
+    return 1;
+}
+
+void inst_unbind(void)
+{
+    int i;
+
+    glUseProgram_(0);
+
+    for (i = 0; i < 5; i++)
+    {
+        const GLuint a = (i < 4 ? inst_attr_M + i : inst_attr_c);
+
+        glVertexAttribDivisor_(a, 0);
+        glDisableVertexAttribArray_(a);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Pass the fixed-function state that the shader stands in for, as
+ * tracked by the renderer. Return false if the state is beyond the
+ * shader, such as sphere mapping.
+ */
+static int inst_state(const struct s_rend *rend)
+{
+    const int fl  = rend->curr_mtrl.base.fl;
+    const int tex = inst_unit >= 0 && rend->curr_mtrl.o;
+
+    if (fl & M_ENVIRONMENT)
+        return 0;
+
+    glUniform4f_(inst_unif_state,
+                 (fl & M_LIT)     ? 1.0f : 0.0f,
+                 rend->color_mtrl ? 1.0f : 0.0f,
+                 tex              ? 1.0f : 0.0f,
+                 (GLfloat) (tex ? inst_unit : 0));
+
+    glUniform4f_(inst_unif_light,
+                 (curr_lights & 1) ? 1.0f : 0.0f,
+                 (curr_lights & 2) ? 1.0f : 0.0f,
+                 (curr_lights & 4) ? 1.0f : 0.0f,
+                 (curr_lights & 8) ? 1.0f : 0.0f);
+    return 1;
+}
+
+/*
+ * Draw each instance in turn with the fixed-function pipeline.
+ */
+static void inst_each(GLenum mode, GLint i0, GLsizei n, GLenum type,
+                      const GLvoid *p)
+{
+    float M[16], T[16];
+    int i;
+
+    glUseProgram_(0);
+    glGetFloatv(GL_MODELVIEW_MATRIX, M);
+
+    for (i = 0; i < inst_n; i++)
+    {
+        m_mult(T, inst_v[i].M, M);
+
+        glPushMatrix();
+        {
+            glLoadMatrixf(T);
+
+            if (p || type)
+                glDrawElements(mode, n, type, p);
+            else
+                glDrawArrays(mode, i0, n);
+        }
+        glPopMatrix();
+    }
+    glUseProgram_(inst_glsl.program);
+}
+
+void inst_draw_arrays(const struct s_rend *rend,
+                      GLenum mode, GLint i, GLsizei n)
+{
+    if (inst_state(rend))
+        glDrawArraysInstanced_(mode, i, n, inst_n);
+    else
+        inst_each(mode, i, n, 0, NULL);
+}
+
+void inst_draw_elements(const struct s_rend *rend,
+                        GLenum mode, GLsizei n, GLenum type, const GLvoid *p)
+{
+    if (inst_state(rend))
+        glDrawElementsInstanced_(mode, n, type, p, inst_n);
+    else
+        inst_each(mode, 0, n, type, p);
+}
+
+#endif
+
+/*---------------------------------------------------------------------------*/
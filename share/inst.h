@@ -0,0 +1,28 @@
+#ifndef INST_H
+#define INST_H
+
+#include "glext.h"
+
+/*---------------------------------------------------------------------------*/
+
+#define INST_MAX 1024
+
+struct s_rend;
+
+int  inst_init(void);
+void inst_free(void);
+int  inst_ready(void);
+
+void inst_begin(const float *);
+int  inst_add(const float *M, const float *c);
+
+int  inst_bind(void);
+void inst_unbind(void);
+
+void inst_draw_arrays(const struct s_rend *, GLenum, GLint, GLsizei);
+void inst_draw_elements(const struct s_rend *, GLenum, GLsizei, GLenum,
+                        const GLvoid *);
+
+/*---------------------------------------------------------------------------*/
+
+#endif
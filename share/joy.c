@@ -72,7 +72,7 @@ void joy_quit(void)
  */
 void joy_add(int device)
 {
-    log_printf("Joystick added (device %d)\n", device);
+    log_message(LOG_DEBUG, "Joystick added (device %d)\n", device);
 
     SDL_Joystick *joy = SDL_JoystickOpen(device);
 
@@ -86,10 +86,10 @@ void joy_add(int device)
             {
                 joysticks[i].joy = joy;
                 joysticks[i].id = SDL_JoystickInstanceID(joy);
-                log_printf("Joystick opened (instance %d)\n", joysticks[i].id);
+                log_message(LOG_DEBUG, "Joystick opened (instance %d)\n", joysticks[i].id);
 
                 joy_curr = joysticks[i].id;
-                log_printf("Joystick %d made current via device addition\n", joy_curr);
+                log_message(LOG_DEBUG, "Joystick %d made current via device addition\n", joy_curr);
 
                 break;
             }
@@ -110,7 +110,7 @@ void joy_remove(int instance)
 {
     size_t i;
 
-    log_printf("Joystick removed (instance %d)\n", instance);
+    log_message(LOG_DEBUG, "Joystick removed (instance %d)\n", instance);
 
     for (i = 0; i < ARRAYSIZE(joysticks); ++i)
     {
@@ -119,7 +119,7 @@ void joy_remove(int instance)
             SDL_JoystickClose(joysticks[i].joy);
             joysticks[i].joy = NULL;
             joysticks[i].id = -1;
-            log_printf("Joystick closed (instance %d)\n", instance);
+            log_message(LOG_DEBUG, "Joystick closed (instance %d)\n", instance);
         }
     }
 }
@@ -132,7 +132,7 @@ int joy_button(int instance, int b, int d)
     if (joy_curr != instance)
     {
         joy_curr = instance;
-        log_printf("Joystick %d made current via button press\n", joy_curr);
+        log_message(LOG_DEBUG, "Joystick %d made current via button press\n", joy_curr);
     }
     return st_buttn(b, d, instance);
 }
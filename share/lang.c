@@ -25,6 +25,7 @@
 #include "base_config.h"
 #include "fs.h"
 #include "log.h"
+#include "pool.h"
 
 /*---------------------------------------------------------------------------*/
 
@@ -126,6 +127,21 @@ const char *lang_code(const char *path)
     return base_name_sans(path, ".txt");
 }
 
+/*
+ * Copy the language code of PATH into CODE. Unlike lang_code, this uses
+ * no static buffer, as languages may be loaded on pool threads.
+ */
+static void lang_code_copy(char code[], size_t size, const char *path)
+{
+    const char *sep = path_last_sep(path);
+
+    strncpy(code, sep ? sep + 1 : path, size - 1);
+    code[size - 1] = 0;
+
+    if (str_ends_with(code, ".txt"))
+        code[strlen(code) - 4] = 0;
+}
+
 int lang_load(struct lang_desc *desc, const char *path)
 {
     if (desc && path && *path)
@@ -138,7 +154,7 @@ int lang_load(struct lang_desc *desc, const char *path)
         {
             char buf[MAXSTR];
 
-            SAFECPY(desc->code, base_name_sans(path, ".txt"));
+            lang_code_copy(desc->code, sizeof (desc->code), path);
 
             while (fs_gets(buf, sizeof (buf), fp))
             {
@@ -169,22 +185,26 @@ void lang_free(struct lang_desc *desc)
 
 static int scan_item(struct dir_item *item)
 {
-    if (str_ends_with(item->path, ".txt"))
-    {
-        struct lang_desc *desc;
+    return str_ends_with(item->path, ".txt");
+}
 
-        if ((desc = calloc(1, sizeof (*desc))))
-        {
-            if (lang_load(desc, item->path))
-            {
-                item->data = desc;
-                return 1;
-            }
+static void load_item(void *data, int i)
+{
+    struct dir_item *item = array_get(data, i);
+    struct lang_desc *desc;
 
+    if ((desc = calloc(1, sizeof (*desc))))
+    {
+        if (lang_load(desc, item->path))
+            item->data = desc;
+        else
             free(desc);
-        }
     }
-    return 0;
+}
+
+static int is_loaded_item(struct dir_item *item)
+{
+    return (item->data != NULL);
 }
 
 static void free_item(struct dir_item *item)
@@ -209,7 +229,12 @@ Array lang_dir_scan(void)
     Array items;
 
     if ((items = fs_dir_scan("lang", scan_item)))
+    {
+        pool_run(array_len(items), load_item, items);
+
+        dir_filter(items, is_loaded_item);
         array_sort(items, cmp_items);
+    }
 
     return items;
 }
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2003-2010 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+#include <math.h>
+
+#include "lockstep.h"
+
+/*---------------------------------------------------------------------------*/
+
+void lockstep_clr(struct lockstep *ls)
+{
+    ls->at = 0;
+    ls->ts = 1.0f;
+}
+
+void lockstep_run(struct lockstep *ls, float dt)
+{
+    int n = 0;
+
+    ls->at += dt * ls->ts;
+
+    while (ls->at >= ls->dt)
+    {
+        /* After a long hitch, drop the steps we cannot catch up on. */
+
+        if (ls->max && n++ == ls->max)
+        {
+            ls->at = fmodf(ls->at, ls->dt);
+            break;
+        }
+
+        ls->step(ls->dt);
+        ls->at -= ls->dt;
+    }
+}
+
+void lockstep_scl(struct lockstep *ls, float ts)
+{
+    ls->ts = ts;
+}
+
+/*---------------------------------------------------------------------------*/
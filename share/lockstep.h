@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2003-2010 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Simple fixed time step scheme.
+ */
+
+struct lockstep
+{
+    void (*step)(float);
+
+    float dt;                           /* Time step length                  */
+    float at;                           /* Accumulator                       */
+    float ts;                           /* Time scale factor                 */
+
+    int max;                            /* Max steps per run (0 = no limit)  */
+};
+
+void lockstep_clr(struct lockstep *);
+void lockstep_run(struct lockstep *, float);
+void lockstep_scl(struct lockstep *, float);
+
+#define lockstep_blend(ls) ((ls)->at / (ls)->dt)
+
+/*---------------------------------------------------------------------------*/
+
+#endif
@@ -14,6 +14,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
 
 #include "log.h"
 #include "common.h"
@@ -22,45 +23,103 @@
 static char    log_header[MAXSTR];
 static fs_file log_fp;
 
+static int log_level = LOG_INFO;
+
+static void (*log_queue)(int level, const char *str);
+
 /*---------------------------------------------------------------------------*/
 
-void log_printf(const char *fmt, ...)
+/*
+ * Write a finished message to stderr and the log file, on this thread.
+ */
+void log_write(const char *str)
 {
-    char *str;
-    int len;
+    fputs(str, stderr);
+    fflush(stderr);
 
-    va_list ap;
+    if (log_fp)
+    {
+        /* These are printfs to get us CRLF conversion. */
 
-    va_start(ap, fmt);
-    len = 1 + vsnprintf(NULL, 0, fmt, ap);
-    va_end(ap);
+        if (log_header[0])
+        {
+            fs_printf(log_fp, "%s\n", log_header);
+            log_header[0] = 0;
+        }
+
+        fs_printf(log_fp, "%s", str);
 
-    if ((str = malloc(len)))
+        fs_flush(log_fp);
+    }
+}
+
+static void log_vprintf(int level, const char *fmt, va_list ap)
+{
+    char  buf[MAXSTR * 4];
+    char *str = buf;
+    int   len;
+
+    va_list aq;
+
+    if (level > log_level)
+        return;
+
+    /* Format on the stack, unless the message is unusually long. */
+
+    va_copy(aq, ap);
+    len = 1 + vsnprintf(buf, sizeof (buf), fmt, aq);
+    va_end(aq);
+
+    if (len > (int) sizeof (buf))
     {
-        va_start(ap, fmt);
+        if (!(str = malloc(len)))
+            return;
+
         vsnprintf(str, len, fmt, ap);
-        va_end(ap);
+    }
 
-        fputs(str, stderr);
-        fflush(stderr);
+    if (log_queue)
+        log_queue(level, str);
+    else
+        log_write(str);
 
-        if (log_fp)
-        {
-            /* These are printfs to get us CRLF conversion. */
+    if (str != buf)
+        free(str);
+}
 
-            if (log_header[0])
-            {
-                fs_printf(log_fp, "%s\n", log_header);
-                log_header[0] = 0;
-            }
+void log_printf(const char *fmt, ...)
+{
+    va_list ap;
 
-            fs_printf(log_fp, "%s", str);
+    va_start(ap, fmt);
+    log_vprintf(LOG_INFO, fmt, ap);
+    va_end(ap);
+}
 
-            fs_flush(log_fp);
-        }
+void log_message(int level, const char *fmt, ...)
+{
+    va_list ap;
 
-        free(str);
-    }
+    va_start(ap, fmt);
+    log_vprintf(level, fmt, ap);
+    va_end(ap);
+}
+
+/*
+ * Drop messages less severe than LEVEL.
+ */
+void log_set_level(int level)
+{
+    log_level = CLAMP(LOG_ERROR, level, LOG_DEBUG);
+}
+
+/*
+ * Hand formatted messages to QUEUE instead of writing them out. The
+ * queue is expected to pass them on to log_write in its own time.
+ */
+void log_set_queue(void (*queue)(int level, const char *str))
+{
+    log_queue = queue;
 }
 
 /*---------------------------------------------------------------------------*/
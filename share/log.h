@@ -1,7 +1,20 @@
 #ifndef LOG_H
 #define LOG_H
 
+enum
+{
+    LOG_ERROR,
+    LOG_WARN,
+    LOG_INFO,
+    LOG_DEBUG
+};
+
 void log_printf(const char *fmt, ...);
+void log_message(int level, const char *fmt, ...);
+void log_write(const char *str);
+
+void log_set_level(int level);
+void log_set_queue(void (*queue)(int level, const char *str));
 
 void log_init(const char *name, const char *path);
 void log_quit(void);
@@ -0,0 +1,256 @@
+/*
+ * Copyright (C) 2014 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "log_ring.h"
+#include "log.h"
+#include "common.h"
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Any thread may log without taking a lock or touching the disk: each
+ * message is copied into a slot of a fixed ring, and a drain thread
+ * writes the slots out in order.  A slot's sequence number tells whose
+ * turn it is.  It equals the claim position when the slot is free and
+ * one more than that once the message is in.  If the ring is full the
+ * message is dropped and counted.  A message too long for its slot is
+ * copied to the heap instead.
+ */
+
+#define RING_SIZE 256                   /* Slots, a power of two             */
+#define RING_TEXT 512                   /* Longest message kept              */
+#define RING_IDLE 10                    /* Drain interval when idle, in ms   */
+
+struct slot
+{
+    SDL_atomic_t seq;
+
+    int    level;
+    Uint64 time;
+    char   text[RING_TEXT];
+    char  *big;                         /* Heap copy of a longer message     */
+};
+
+static struct slot   ring[RING_SIZE];
+static SDL_atomic_t  ring_head;
+static SDL_atomic_t  ring_dropped;
+static SDL_atomic_t  ring_stop;
+static SDL_Thread   *ring_thread;
+static unsigned int  ring_tail;
+static Uint64        ring_t0;
+
+/* Drain thread state: repeat suppression and partial lines. */
+
+static char   last_text[RING_TEXT];
+static int    last_level;
+static int    last_count;
+static Uint64 last_time;
+static int    line_open;
+
+/*---------------------------------------------------------------------------*/
+
+static void ring_queue(int level, const char *str)
+{
+    struct slot *s;
+    unsigned int pos;
+
+    for (;;)
+    {
+        int d;
+
+        pos = (unsigned int) SDL_AtomicGet(&ring_head);
+        s   = &ring[pos & (RING_SIZE - 1)];
+        d   = (int) ((unsigned int) SDL_AtomicGet(&s->seq) - pos);
+
+        if (d == 0)
+        {
+            if (SDL_AtomicCAS(&ring_head, (int) pos, (int) (pos + 1)))
+                break;
+        }
+        else if (d < 0)
+        {
+            SDL_AtomicAdd(&ring_dropped, 1);
+            return;
+        }
+    }
+
+    s->level = level;
+    s->time  = SDL_GetPerformanceCounter();
+    s->big   = NULL;
+
+    SAFECPY(s->text, str);
+
+    /* Keep all of a long message, or at least end the line. */
+
+    if (strlen(str) >= RING_TEXT && !(s->big = strdup(str)))
+        s->text[RING_TEXT - 2] = '\n';
+
+    SDL_AtomicSet(&s->seq, (int) (pos + 1));
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void ring_write(int level, Uint64 time, const char *text)
+{
+    static const char *tags[] = { "error: ", "warning: ", "", "debug: " };
+
+    char buf[64];
+
+    if (!line_open)
+    {
+        sprintf(buf, "[%9.3f] %s",
+                (double) (time - ring_t0) / SDL_GetPerformanceFrequency(),
+                tags[CLAMP(LOG_ERROR, level, LOG_DEBUG)]);
+        log_write(buf);
+    }
+
+    line_open = (text[0] && text[strlen(text) - 1] != '\n');
+
+    log_write(text);
+}
+
+static void ring_repeat(void)
+{
+    char buf[MAXSTR];
+
+    if (last_count)
+    {
+        sprintf(buf, "(last message repeated %d times)\n", last_count);
+        ring_write(last_level, last_time, buf);
+    }
+    last_count = 0;
+}
+
+/*
+ * Write out a message, holding back exact repeats of the last line.
+ */
+static void ring_emit(const struct slot *s)
+{
+    const char *text = s->big ? s->big : s->text;
+
+    if (!line_open && s->level == last_level && strcmp(text, last_text) == 0)
+    {
+        last_count += 1;
+        last_time   = s->time;
+        return;
+    }
+
+    ring_repeat();
+
+    /* A long message is never held back as a repeat. */
+
+    SAFECPY(last_text, text);
+    last_level = s->big ? -1 : s->level;
+
+    ring_write(s->level, s->time, text);
+}
+
+static int ring_drain(void)
+{
+    char buf[MAXSTR];
+    int  n = 0;
+    int  d;
+
+    for (;;)
+    {
+        struct slot *s = &ring[ring_tail & (RING_SIZE - 1)];
+
+        if ((unsigned int) SDL_AtomicGet(&s->seq) != ring_tail + 1)
+            break;
+
+        ring_emit(s);
+
+        free(s->big);
+        s->big = NULL;
+
+        SDL_AtomicSet(&s->seq, (int) (ring_tail + RING_SIZE));
+
+        ring_tail++;
+        n++;
+    }
+
+    if ((d = SDL_AtomicSet(&ring_dropped, 0)))
+    {
+        ring_repeat();
+
+        sprintf(buf, "(%d log messages dropped)\n", d);
+        ring_write(LOG_WARN, SDL_GetPerformanceCounter(), buf);
+    }
+    return n;
+}
+
+static int ring_func(void *data)
+{
+    while (!SDL_AtomicGet(&ring_stop))
+        if (!ring_drain())
+            SDL_Delay(RING_IDLE);
+
+    ring_drain();
+    ring_repeat();
+
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Route log messages through the ring. Without threads, they continue
+ * to be written out as they come.
+ */
+void log_ring_init(void)
+{
+    int i;
+
+    if (ring_thread)
+        return;
+
+    for (i = 0; i < RING_SIZE; i++)
+        SDL_AtomicSet(&ring[i].seq, i);
+
+    SDL_AtomicSet(&ring_head,    0);
+    SDL_AtomicSet(&ring_dropped, 0);
+    SDL_AtomicSet(&ring_stop,    0);
+
+    ring_tail  = 0;
+    ring_t0    = SDL_GetPerformanceCounter();
+    line_open  = 0;
+    last_count = 0;
+
+    last_text[0] = 0;
+
+    if ((ring_thread = SDL_CreateThread(ring_func, "log", NULL)))
+        log_set_queue(ring_queue);
+}
+
+/*
+ * Write out whatever is queued and go back to logging directly.
+ */
+void log_ring_quit(void)
+{
+    if (ring_thread)
+    {
+        log_set_queue(NULL);
+
+        SDL_AtomicSet(&ring_stop, 1);
+        SDL_WaitThread(ring_thread, NULL);
+        ring_thread = NULL;
+    }
+}
+
+/*---------------------------------------------------------------------------*/
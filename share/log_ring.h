@@ -0,0 +1,7 @@
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+void log_ring_init(void);
+void log_ring_quit(void);
+
+#endif
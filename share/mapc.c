@@ -18,6 +18,7 @@
 #include <stdio.h>
 #include <setjmp.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "fs.h"
 #include "mapclib.h"
@@ -25,6 +26,7 @@
 int main(int argc, char *argv[])
 {
     mapc_context ctx = NULL;
+    int i;
 
     if (!fs_init(argc > 0 ? argv[0] : NULL))
     {
@@ -32,6 +34,12 @@ int main(int argc, char *argv[])
         return 1;
     }
 
+    /* Compile many maps at once. */
+
+    for (i = 1; i < argc; i++)
+        if (strcmp(argv[i], "--batch") == 0)
+            return mapc_batch(argc, argv) ? 0 : 1;
+
     mapc_init(&ctx);
 
     if (!mapc_opts(ctx, argc, argv))
@@ -19,10 +19,16 @@
 #include <stdlib.h>
 #include <stddef.h> /* offsetof */
 #include <string.h>
+#include <ctype.h>
 #include <math.h>
 #include <sys/time.h>
 #include <assert.h>
 #include <setjmp.h>
+#include <pthread.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 
 #if ENABLE_RADIANT_CONSOLE
 /*
@@ -41,6 +47,7 @@
 #include "base_config.h"
 #include "fs.h"
 #include "common.h"
+#include "array.h"
 #include "strbuf/base_name.h"
 #include "strbuf/dir_name.h"
 #include "strbuf/joinstr.h"
@@ -61,29 +68,14 @@
 
 /*---------------------------------------------------------------------------*/
 
-/* Ohhhh... arbitrary! */
-
-#define MAXM    1024
-#define MAXV    65536
-#define MAXE    131072
-#define MAXS    65536
-#define MAXT    131072
-#define MAXO    262144
-#define MAXG    65536
-#define MAXL    4096
-#define MAXN    2048
-#define MAXP    2048
-#define MAXB    1024
-#define MAXH    2048
-#define MAXZ    1024
-#define MAXJ    1024
-#define MAXX    1024
-#define MAXR    2048
-#define MAXU    1024
-#define MAXW    1024
-#define MAXD    1024
-#define MAXA    16384
-#define MAXI    262144
+/*
+ * Solid arrays start small and double as needed. Each array keeps at
+ * least one free element past its count, as much of the compiler fills
+ * in element N before incrementing the count to claim it.
+ */
+
+#define MINCAP  64
+
 
 /*
  * The following is a small  symbol table data structure.  Symbols and
@@ -116,7 +108,33 @@ struct ref
 {
     int  type;
     char name[MAXSTR];
-    int *ptr;
+
+    /* The referring int, as an offset into a growable array. */
+
+    void  **base;
+    size_t  off;
+};
+
+/*
+ * Texture mapping of each side of a map brush, parallel to the sides.
+ */
+struct plane
+{
+    float d;
+    float n[3];
+    float p[3];
+    float u[3];
+    float v[3];
+    int   f;
+    int   m;
+};
+
+/*
+ * Allocated sizes of the solid arrays.
+ */
+struct s_base_caps
+{
+    int m, v, e, s, t, o, g, l, n, p, b, h, z, j, x, r, u, w, d, a, i;
 };
 
 struct _imagedata
@@ -135,6 +153,28 @@ enum mapc_jmp
 #define MAX_BCAST_MSG 512
 #endif
 
+/*
+ * Compile passes, timed separately for the dump.
+ */
+enum
+{
+    PASS_READ,
+    PASS_LINK,
+    PASS_CLIP,
+    PASS_MOVE,
+    PASS_UNIQ,
+    PASS_SMTH,
+    PASS_SORT,
+    PASS_NODE,
+    PASS_STOR,
+
+    PASS_MAX
+};
+
+static const char *pass_names[PASS_MAX] = {
+    "read", "link", "clip", "move", "uniq", "smth", "sort", "node", "stor"
+};
+
 /*
  * Context structure to hold all global state.
  */
@@ -144,6 +184,8 @@ struct mapc_context
     const char *opt_data;
     int opt_debug;
     int opt_csv;
+    int opt_times;
+    int opt_threads;
 
     struct strbuf src_path;
     struct strbuf dst_path;
@@ -161,38 +203,44 @@ struct mapc_context
     int symc;
     int refc;
 
-    float targ_p[MAXW][3];
-    int targ_wi[MAXW];
-    int targ_ji[MAXW];
-    int targ_n;
+    float (*targ_p)[3];
+    int   *targ_wi;
+    int   *targ_ji;
+    int    targ_n;
+    int    targ_pn;
+    int    targ_wn;
+    int    targ_jn;
 
     struct _imagedata *imagedata;
     int image_n;
     int image_alloc;
 
-    float plane_d[MAXS];
-    float plane_n[MAXS][3];
-    float plane_p[MAXS][3];
-    float plane_u[MAXS][3];
-    float plane_v[MAXS][3];
-    int plane_f[MAXS];
-    int plane_m[MAXS];
+    struct plane *planes;
+
+    struct obj_model *objv;
+    int objc;
+    int obj_n;
 
     int read_dict_entries;
 
-    int mtrl_swaps[MAXM];
-    int vert_swaps[MAXV];
-    int edge_swaps[MAXE];
-    int side_swaps[MAXS];
-    int texc_swaps[MAXT];
-    int offs_swaps[MAXO];
-    int geom_swaps[MAXG];
+    int *swaps;
+    int  swap_n;
+
+    float (*bsphere)[4];
 
     struct s_base file;
+    struct s_base_caps caps;
+
+    size_t mem;
+    size_t mem_peak;
+
+    Array deps;
+    int   io_locked;
 
     jmp_buf jmpbuf;
 
     double compile_time;
+    double pass_time[PASS_MAX];
 };
 
 /*---------------------------------------------------------------------------*/
@@ -348,7 +396,66 @@ static void bcast_quit(struct mapc_context *ctx)
 
 /*---------------------------------------------------------------------------*/
 
-static void init_file(struct s_base *fp);
+/*
+ * Batch compiles run on several threads. Compile state is confined to
+ * the context, but the file system is not safe to read concurrently
+ * (archives share a single handle), so all reads are serialized.
+ */
+
+static pthread_mutex_t io_mutex  = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t out_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void io_lock(struct mapc_context *ctx)
+{
+    pthread_mutex_lock(&io_mutex);
+    ctx->io_locked = 1;
+}
+
+static void io_unlock(struct mapc_context *ctx)
+{
+    ctx->io_locked = 0;
+    pthread_mutex_unlock(&io_mutex);
+}
+
+/*
+ * Source files a compile depended on, named as the file system found
+ * them, or as first looked for if missing.
+ */
+
+struct mapc_dep
+{
+    char path[MAXSTR];
+    unsigned int hash[2];
+};
+
+static void add_dep(struct mapc_context *ctx, const char *path)
+{
+    struct mapc_dep *dp;
+    int i;
+
+    if (!ctx->deps)
+        return;
+
+    for (i = 0; i < array_len(ctx->deps); i++)
+    {
+        dp = array_get(ctx->deps, i);
+
+        if (strcmp(dp->path, path) == 0)
+            return;
+    }
+
+    if ((dp = array_add(ctx->deps)))
+    {
+        memset(dp, 0, sizeof (*dp));
+        SAFECPY(dp->path, path);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void init_file(struct mapc_context *ctx);
+static void free_objs(struct mapc_context *ctx);
+static int  cpu_count(void);
 
 int mapc_init(struct mapc_context **ctx_ptr)
 {
@@ -366,6 +473,8 @@ int mapc_init(struct mapc_context **ctx_ptr)
 
     ctx->opt_debug = 0;
     ctx->opt_csv = 0;
+    ctx->opt_times = 0;
+    ctx->opt_threads = cpu_count();
     ctx->opt_file = NULL;
     ctx->opt_data = NULL;
 
@@ -382,8 +491,6 @@ int mapc_init(struct mapc_context **ctx_ptr)
     ctx->image_alloc = 0;
     ctx->read_dict_entries = 0;
 
-    init_file(&ctx->file);
-
     *ctx_ptr = ctx;
 
     return 1;
@@ -414,6 +521,23 @@ void mapc_quit(struct mapc_context **ctx_ptr)
     ctx->image_n = 0;
     ctx->image_alloc = 0;
 
+    if (ctx->deps)
+    {
+        array_free(ctx->deps);
+        ctx->deps = NULL;
+    }
+
+    free_objs(ctx);
+
+    sol_free_base(&ctx->file);
+
+    free(ctx->planes);
+    free(ctx->swaps);
+    free(ctx->bsphere);
+    free(ctx->targ_p);
+    free(ctx->targ_wi);
+    free(ctx->targ_ji);
+
 #if ENABLE_RADIANT_CONSOLE
     bcast_quit(ctx);
 #endif
@@ -435,171 +559,145 @@ static int overflow(struct mapc_context *ctx, const char s[64u - sizeof (" overf
     return 0;
 }
 
-static int incm(struct mapc_context *ctx)
-{
-    struct s_base *fp = &ctx->file;
-    return (fp->mc < MAXM) ? fp->mc++ : overflow(ctx, "mtrl");
-}
-
-static int incv(struct mapc_context *ctx)
-{
-    struct s_base *fp = &ctx->file;
-    return (fp->vc < MAXV) ? fp->vc++ : overflow(ctx, "vert");
-}
-
-static int ince(struct mapc_context *ctx)
-{
-    struct s_base *fp = &ctx->file;
-    return (fp->ec < MAXE) ? fp->ec++ : overflow(ctx, "edge");
-}
-
-static int incs(struct mapc_context *ctx)
+/*
+ * Resize an array of elements of the given size from N to M, clearing
+ * new elements, and account for the memory used.
+ */
+static void *resize(struct mapc_context *ctx, void *p, size_t size, int n, int m,
+                    const char *name)
 {
-    struct s_base *fp = &ctx->file;
-    return (fp->sc < MAXS) ? fp->sc++ : overflow(ctx, "side");
-}
+    void *q;
 
-static int inct(struct mapc_context *ctx)
-{
-    struct s_base *fp = &ctx->file;
-    return (fp->tc < MAXT) ? fp->tc++ : overflow(ctx, "texc");
-}
+    if (m < 0 || (size_t) m > ((size_t) -1) / size)
+        overflow(ctx, name);
 
-static int inco(struct mapc_context *ctx)
-{
-    struct s_base *fp = &ctx->file;
-    return (fp->oc < MAXO) ? fp->oc++ : overflow(ctx, "offs");
-}
+    if (!(q = realloc(p, size * m)))
+        overflow(ctx, name);
 
-static int incg(struct mapc_context *ctx)
-{
-    struct s_base *fp = &ctx->file;
-    return (fp->gc < MAXG) ? fp->gc++ : overflow(ctx, "geom");
-}
+    if (m > n)
+        memset((unsigned char *) q + size * n, 0, size * (m - n));
 
-static int incl(struct mapc_context *ctx)
-{
-    struct s_base *fp = &ctx->file;
-    return (fp->lc < MAXL) ? fp->lc++ : overflow(ctx, "lump");
-}
+    ctx->mem      = ctx->mem + size * m - size * n;
+    ctx->mem_peak = MAX(ctx->mem_peak, ctx->mem);
 
-static int incn(struct mapc_context *ctx)
-{
-    struct s_base *fp = &ctx->file;
-    return (fp->nc < MAXN) ? fp->nc++ : overflow(ctx, "node");
+    return q;
 }
 
-static int incp(struct mapc_context *ctx)
+/*
+ * Free an array of N elements of the given size allocated by resize.
+ */
+static void release(struct mapc_context *ctx, void *p, size_t size, int n)
 {
-    struct s_base *fp = &ctx->file;
-    return (fp->pc < MAXP) ? fp->pc++ : overflow(ctx, "path");
+    free(p);
+    ctx->mem -= size * n;
 }
 
-static int incb(struct mapc_context *ctx)
-{
-    struct s_base *fp = &ctx->file;
-    return (fp->bc < MAXB) ? fp->bc++ : overflow(ctx, "body");
-}
+/*
+ * Ensure that array V of capacity *N has room for C elements plus one.
+ */
+#define RESERVE(ctx, v, n, c, name) do {                                 \
+        if ((c) >= (n))                                                  \
+        {                                                                \
+            int _m = MAX((n) * 2, (c) + 1);                              \
+            (v) = resize((ctx), (v), sizeof (*(v)), (n), _m, (name));    \
+            (n) = _m;                                                    \
+        }                                                                \
+    } while (0)
 
-static int inch(struct mapc_context *ctx)
-{
-    struct s_base *fp = &ctx->file;
-    return (fp->hc < MAXH) ? fp->hc++ : overflow(ctx, "item");
-}
+#define INC(ctx, x, name) do {                                           \
+        RESERVE(ctx, (ctx)->file.x##v, (ctx)->caps.x,                    \
+                (ctx)->file.x##c + 1, name);                             \
+        return (ctx)->file.x##c++;                                       \
+    } while (0)
 
-static int incz(struct mapc_context *ctx)
-{
-    struct s_base *fp = &ctx->file;
-    return (fp->zc < MAXZ) ? fp->zc++ : overflow(ctx, "goal");
-}
+static int incm(struct mapc_context *ctx) { INC(ctx, m, "mtrl"); }
+static int incv(struct mapc_context *ctx) { INC(ctx, v, "vert"); }
+static int ince(struct mapc_context *ctx) { INC(ctx, e, "edge"); }
+static int inct(struct mapc_context *ctx) { INC(ctx, t, "texc"); }
+static int inco(struct mapc_context *ctx) { INC(ctx, o, "offs"); }
+static int incg(struct mapc_context *ctx) { INC(ctx, g, "geom"); }
+static int incl(struct mapc_context *ctx) { INC(ctx, l, "lump"); }
+static int incn(struct mapc_context *ctx) { INC(ctx, n, "node"); }
+static int incp(struct mapc_context *ctx) { INC(ctx, p, "path"); }
+static int incb(struct mapc_context *ctx) { INC(ctx, b, "body"); }
+static int inch(struct mapc_context *ctx) { INC(ctx, h, "item"); }
+static int incz(struct mapc_context *ctx) { INC(ctx, z, "goal"); }
+static int incj(struct mapc_context *ctx) { INC(ctx, j, "jump"); }
+static int incx(struct mapc_context *ctx) { INC(ctx, x, "swch"); }
+static int incr(struct mapc_context *ctx) { INC(ctx, r, "bill"); }
+static int incu(struct mapc_context *ctx) { INC(ctx, u, "ball"); }
+static int incw(struct mapc_context *ctx) { INC(ctx, w, "view"); }
+static int incd(struct mapc_context *ctx) { INC(ctx, d, "dict"); }
+static int inci(struct mapc_context *ctx) { INC(ctx, i, "indx"); }
 
-static int incj(struct mapc_context *ctx)
+/*
+ * Sides carry brush planes, so grow those alongside.
+ */
+static int incs(struct mapc_context *ctx)
 {
     struct s_base *fp = &ctx->file;
-    return (fp->jc < MAXJ) ? fp->jc++ : overflow(ctx, "jump");
-}
+    int n = ctx->caps.s;
 
-static int incx(struct mapc_context *ctx)
-{
-    struct s_base *fp = &ctx->file;
-    return (fp->xc < MAXX) ? fp->xc++ : overflow(ctx, "swch");
-}
+    RESERVE(ctx, fp->sv, ctx->caps.s, fp->sc + 1, "side");
 
-static int incr(struct mapc_context *ctx)
-{
-    struct s_base *fp = &ctx->file;
-    return (fp->rc < MAXR) ? fp->rc++ : overflow(ctx, "bill");
-}
+    if (ctx->caps.s != n)
+        ctx->planes = resize(ctx, ctx->planes, sizeof (*ctx->planes),
+                             n, ctx->caps.s, "side");
 
-static int incu(struct mapc_context *ctx)
-{
-    struct s_base *fp = &ctx->file;
-    return (fp->uc < MAXU) ? fp->uc++ : overflow(ctx, "ball");
+    return fp->sc++;
 }
 
-static int incw(struct mapc_context *ctx)
-{
-    struct s_base *fp = &ctx->file;
-    return (fp->wc < MAXW) ? fp->wc++ : overflow(ctx, "view");
-}
+#undef INC
 
-static int incd(struct mapc_context *ctx)
+/*
+ * Return a swap table large enough for N elements.
+ */
+static int *get_swaps(struct mapc_context *ctx, int n)
 {
-    struct s_base *fp = &ctx->file;
-    return (fp->dc < MAXD) ? fp->dc++ : overflow(ctx, "dict");
+    RESERVE(ctx, ctx->swaps, ctx->swap_n, n, "swap");
+    return ctx->swaps;
 }
 
-static int inci(struct mapc_context *ctx)
+static void init_file(struct mapc_context *ctx)
 {
     struct s_base *fp = &ctx->file;
-    return (fp->ic < MAXI) ? fp->ic++ : overflow(ctx, "indx");
-}
-
-static void init_file(struct s_base *fp)
-{
-    fp->mc = 0;
-    fp->vc = 0;
-    fp->ec = 0;
-    fp->sc = 0;
-    fp->tc = 0;
-    fp->oc = 0;
-    fp->gc = 0;
-    fp->lc = 0;
-    fp->nc = 0;
-    fp->pc = 0;
-    fp->bc = 0;
-    fp->hc = 0;
-    fp->zc = 0;
-    fp->jc = 0;
-    fp->xc = 0;
-    fp->rc = 0;
-    fp->uc = 0;
-    fp->wc = 0;
-    fp->dc = 0;
-    fp->ac = 0;
-    fp->ic = 0;
-
-    fp->mv = (struct b_mtrl *) calloc(MAXM, sizeof (*fp->mv));
-    fp->vv = (struct b_vert *) calloc(MAXV, sizeof (*fp->vv));
-    fp->ev = (struct b_edge *) calloc(MAXE, sizeof (*fp->ev));
-    fp->sv = (struct b_side *) calloc(MAXS, sizeof (*fp->sv));
-    fp->tv = (struct b_texc *) calloc(MAXT, sizeof (*fp->tv));
-    fp->ov = (struct b_offs *) calloc(MAXO, sizeof (*fp->ov));
-    fp->gv = (struct b_geom *) calloc(MAXG, sizeof (*fp->gv));
-    fp->lv = (struct b_lump *) calloc(MAXL, sizeof (*fp->lv));
-    fp->nv = (struct b_node *) calloc(MAXN, sizeof (*fp->nv));
-    fp->pv = (struct b_path *) calloc(MAXP, sizeof (*fp->pv));
-    fp->bv = (struct b_body *) calloc(MAXB, sizeof (*fp->bv));
-    fp->hv = (struct b_item *) calloc(MAXH, sizeof (*fp->hv));
-    fp->zv = (struct b_goal *) calloc(MAXZ, sizeof (*fp->zv));
-    fp->jv = (struct b_jump *) calloc(MAXJ, sizeof (*fp->jv));
-    fp->xv = (struct b_swch *) calloc(MAXX, sizeof (*fp->xv));
-    fp->rv = (struct b_bill *) calloc(MAXR, sizeof (*fp->rv));
-    fp->uv = (struct b_ball *) calloc(MAXU, sizeof (*fp->uv));
-    fp->wv = (struct b_view *) calloc(MAXW, sizeof (*fp->wv));
-    fp->dv = (struct b_dict *) calloc(MAXD, sizeof (*fp->dv));
-    fp->av = (char *)          calloc(MAXA, sizeof (*fp->av));
-    fp->iv = (int *)           calloc(MAXI, sizeof (*fp->iv));
+    struct s_base_caps *cp = &ctx->caps;
+
+    memset(fp, 0, sizeof (*fp));
+
+    cp->m = cp->v = cp->e = cp->s = cp->t = cp->o = cp->g = 0;
+    cp->l = cp->n = cp->p = cp->b = cp->h = cp->z = cp->j = 0;
+    cp->x = cp->r = cp->u = cp->w = cp->d = cp->a = cp->i = 0;
+
+    /* Reserve the first element of each array, see above. */
+
+    RESERVE(ctx, fp->mv, cp->m, MINCAP, "mtrl");
+    RESERVE(ctx, fp->vv, cp->v, MINCAP, "vert");
+    RESERVE(ctx, fp->ev, cp->e, MINCAP, "edge");
+    RESERVE(ctx, fp->sv, cp->s, MINCAP, "side");
+    RESERVE(ctx, fp->tv, cp->t, MINCAP, "texc");
+    RESERVE(ctx, fp->ov, cp->o, MINCAP, "offs");
+    RESERVE(ctx, fp->gv, cp->g, MINCAP, "geom");
+    RESERVE(ctx, fp->lv, cp->l, MINCAP, "lump");
+    RESERVE(ctx, fp->nv, cp->n, MINCAP, "node");
+    RESERVE(ctx, fp->pv, cp->p, MINCAP, "path");
+    RESERVE(ctx, fp->bv, cp->b, MINCAP, "body");
+    RESERVE(ctx, fp->hv, cp->h, MINCAP, "item");
+    RESERVE(ctx, fp->zv, cp->z, MINCAP, "goal");
+    RESERVE(ctx, fp->jv, cp->j, MINCAP, "jump");
+    RESERVE(ctx, fp->xv, cp->x, MINCAP, "swch");
+    RESERVE(ctx, fp->rv, cp->r, MINCAP, "bill");
+    RESERVE(ctx, fp->uv, cp->u, MINCAP, "ball");
+    RESERVE(ctx, fp->wv, cp->w, MINCAP, "view");
+    RESERVE(ctx, fp->dv, cp->d, MINCAP, "dict");
+    RESERVE(ctx, fp->av, cp->a, MINCAP, "char");
+    RESERVE(ctx, fp->iv, cp->i, MINCAP, "indx");
+
+    ctx->planes = resize(ctx, NULL, sizeof (*ctx->planes), 0, cp->s, "side");
+
+    /* Unresolved targets refer to the origin. */
+
+    RESERVE(ctx, ctx->targ_p, ctx->targ_pn, 0, "target");
 }
 
 /*---------------------------------------------------------------------------*/
@@ -618,7 +716,8 @@ static void make_sym(struct mapc_context *ctx, int type, const char *name, int v
     }
 }
 
-static void make_ref(struct mapc_context *ctx, int type, const char *name, int *ptr)
+static void make_ref(struct mapc_context *ctx, int type, const char *name,
+                     void **base, const int *ptr)
 {
     if (ctx->refc < MAXSYM - 1)
     {
@@ -626,12 +725,20 @@ static void make_ref(struct mapc_context *ctx, int type, const char *name, int *
 
         ref->type = type;
         strncpy(ref->name, name, MAXSTR - 1);
-        ref->ptr = ptr;
+        ref->base = base;
+        ref->off  = (size_t) ((const unsigned char *) ptr -
+                              (const unsigned char *) *base);
 
         ctx->refc++;
     }
 }
 
+/*
+ * Refer to an int within array V, which may move before resolution.
+ */
+#define MAKE_REF(ctx, type, name, v, ptr) \
+    make_ref((ctx), (type), (name), (void **) &(v), (ptr))
+
 static void resolve(struct mapc_context *ctx)
 {
     int i, j;
@@ -644,7 +751,7 @@ static void resolve(struct mapc_context *ctx)
 
             if (ref->type == sym->type && strcmp(ref->name, sym->name) == 0)
             {
-                *(ref->ptr) = sym->val;
+                *(int *) ((unsigned char *) *ref->base + ref->off) = sym->val;
                 break;
             }
         }
@@ -718,6 +825,11 @@ static void size_image(struct mapc_context *ctx, const char *name, int *w, int *
             break;
     }
 
+    if (i == ARRAYSIZE(tex_paths))
+        CONCAT_PATH(path, &tex_paths[0], name);
+
+    add_dep(ctx, path);
+
     if (*w > 0 && *h > 0)
     {
         if (ctx->image_n + 1 >= ctx->image_alloc)
@@ -753,7 +865,7 @@ static void size_image(struct mapc_context *ctx, const char *name, int *w, int *
 
 static int read_mtrl(struct mapc_context *ctx, const char *name)
 {
-    static char buf [MAXSTR];
+    char buf[MAXSTR];
     struct s_base *fp = &ctx->file;
 
     struct b_mtrl *mp;
@@ -763,7 +875,8 @@ static int read_mtrl(struct mapc_context *ctx, const char *name)
         if (strncmp(name, fp->mv[mi].f, MAXSTR) == 0)
             return mi;
 
-    mp = fp->mv + incm(ctx);
+    mi = incm(ctx);
+    mp = fp->mv + mi;
 
     if (!mtrl_read(mp, name))
     {
@@ -774,6 +887,24 @@ static int read_mtrl(struct mapc_context *ctx, const char *name)
         WARNING(ctx, buf);
     }
 
+    if (ctx->deps)
+    {
+        int i;
+
+        for (i = 0; i < ARRAYSIZE(mtrl_paths); i++)
+        {
+            CONCAT_PATH(buf, &mtrl_paths[i], name);
+
+            if (fs_exists(buf))
+                break;
+        }
+
+        if (i == ARRAYSIZE(mtrl_paths))
+            CONCAT_PATH(buf, &mtrl_paths[0], name);
+
+        add_dep(ctx, buf);
+    }
+
     return mi;
 }
 
@@ -950,182 +1081,546 @@ static void move_file(struct mapc_context *ctx)
 /*
  * This is a basic OBJ loader.  It is by no means fully compliant with
  * the  OBJ  specification, but  it  works  well  with the  output  of
- * Wings3D.  All faces must be triangles and all vertices must include
- * normals and  texture coordinates.  Material  names are taken  to be
- * references to Neverball materials, rather than MTL definitions.
+ * Wings3D.  Polygons are split into  triangle fans and all vertices
+ * should include normals and  texture coordinates.  Material names are
+ * taken to be references to Neverball materials, rather than MTL
+ * definitions.
+ *
+ * A model is parsed once per compile, with duplicate vertices, texture
+ * coordinates and normals merged on the way in, and every reference
+ * to the same file under the same material is instanced from that.
  */
 
-static void read_vt(struct mapc_context *ctx, const char *line)
+struct obj_table
 {
-    struct s_base *fp = &ctx->file;
-    struct b_texc *tp = fp->tv + inct(ctx);
-
-    sscanf(line, "%f %f", tp->u, tp->u + 1);
-}
+    float *v;                           /* Unique rows of D floats           */
+    int    c;
+    int    n;
+    int    d;
 
-static void read_vn(struct mapc_context *ctx, const char *line)
-{
-    struct s_base *fp = &ctx->file;
-    struct b_side *sp = fp->sv + incs(ctx);
+    int   *h;                           /* Open hash of row index plus one   */
+    int    hn;
 
-    sscanf(line, "%f %f %f", sp->n, sp->n + 1, sp->n + 2);
-}
+    int   *m;                           /* OBJ element order to unique row   */
+    int    mc;
+    int    mn;
+};
 
-static void read_v(struct mapc_context *ctx, const char *line)
+struct obj_face
 {
-    struct s_base *fp = &ctx->file;
-    struct b_vert *vp = fp->vv + incv(ctx);
-
-    sscanf(line, "%f %f %f", vp->p, vp->p + 1, vp->p + 2);
-}
+    int mi;
+    int vi[3];
+    int ti[3];
+    int si[3];
+};
 
-static void read_f(struct mapc_context *ctx, const char *line,
-                   int v0, int t0, int s0, int mi)
+struct obj_model
 {
-    struct s_base *fp = &ctx->file;
-    struct b_geom *gp = fp->gv + incg(ctx);
-
-    struct b_offs *op = fp->ov + (gp->oi = inco(ctx));
-    struct b_offs *oq = fp->ov + (gp->oj = inco(ctx));
-    struct b_offs *or = fp->ov + (gp->ok = inco(ctx));
-
-    char c1;
-    char c2;
+    char name[MAXSTR];
+    int  mi;
 
-    sscanf(line, "%d%c%d%c%d %d%c%d%c%d %d%c%d%c%d",
-           &op->vi, &c1, &op->ti, &c2, &op->si,
-           &oq->vi, &c1, &oq->ti, &c2, &oq->si,
-           &or->vi, &c1, &or->ti, &c2, &or->si);
+    struct obj_table v;
+    struct obj_table t;
+    struct obj_table s;
 
-    op->vi += (v0 - 1);
-    oq->vi += (v0 - 1);
-    or->vi += (v0 - 1);
-    op->ti += (t0 - 1);
-    oq->ti += (t0 - 1);
-    or->ti += (t0 - 1);
-    op->si += (s0 - 1);
-    oq->si += (s0 - 1);
-    or->si += (s0 - 1);
+    struct obj_face *fv;
+    int              fc;
+    int              fn;
 
-    gp->mi  = mi;
-}
+    int t0;                             /* Texture coordinates and normals   */
+    int s0;                             /* are shared by all instances.      */
+};
 
-static void read_obj(struct mapc_context *ctx, const char *name, int mi)
+static unsigned int hash_row(const float *x, int d)
 {
-    struct s_base *fp = &ctx->file;
-    char line[MAXSTR];
-    char mtrl[MAXSTR];
-    fs_file fin;
+    const unsigned char *p = (const unsigned char *) x;
 
-    int v0 = fp->vc;
-    int t0 = fp->tc;
-    int s0 = fp->sc;
+    unsigned int h = 2166136261u;
+    size_t i;
 
-    if ((fin = fs_open_read(name)))
+    for (i = 0; i < d * sizeof (float); i++)
     {
-        while (fs_gets(line, MAXSTR, fin))
-        {
-            if (strncmp(line, "usemtl", 6) == 0)
-            {
-                sscanf(line + 6, "%s", mtrl);
-                mi = read_mtrl(ctx, mtrl);
-            }
-
-            else if (strncmp(line, "f", 1) == 0)
-            {
-                if (fp->mv[mi].d[3] > 0.0f)
-                    read_f(ctx, line + 1, v0, t0, s0, mi);
-            }
-
-            else if (strncmp(line, "vt", 2) == 0) read_vt(ctx, line + 2);
-            else if (strncmp(line, "vn", 2) == 0) read_vn(ctx, line + 2);
-            else if (strncmp(line, "v",  1) == 0) read_v (ctx, line + 1);
-        }
-        fs_close(fin);
+        h ^= p[i];
+        h *= 16777619u;
     }
+    return h;
 }
 
-/*---------------------------------------------------------------------------*/
-
-static void make_plane(struct mapc_context *ctx, int   pi, float x0, float y0, float      z0,
-                       float x1, float y1, float z1,
-                       float x2, float y2, float z2,
-                       float tu, float tv, float r,
-                       float su, float sv, int   fl, const char *s)
+/*
+ * Return the index of row X in the table, adding it if not yet present.
+ */
+static int table_row(struct mapc_context *ctx, struct obj_table *tp,
+                     const float *x)
 {
-    static const float base[6][3][3] = {
-        {{  0,  0,  1 }, {  1,  0,  0 }, {  0,  1,  0 }},
-        {{  0,  0, -1 }, {  1,  0,  0 }, {  0,  1,  0 }},
-        {{  1,  0,  0 }, {  0,  0, -1 }, {  0,  1,  0 }},
-        {{ -1,  0,  0 }, {  0,  0, -1 }, {  0,  1,  0 }},
-        {{  0,  1,  0 }, {  1,  0,  0 }, {  0,  0, -1 }},
-        {{  0, -1,  0 }, {  1,  0,  0 }, {  0,  0, -1 }},
-    };
+    const size_t size = tp->d * sizeof (float);
 
-    float R[16];
-    float p0[3], p1[3], p2[3];
-    float u[3],  v[3],  p[3];
-    float k, d = 0.0f;
-    int   i, n = 0;
-    int   w, h;
+    unsigned int i;
+    int k;
 
-    size_image(ctx, s, &w, &h);
+    /* Keep the hash at most half full. */
 
-    ctx->plane_f[pi] = fl ? L_DETAIL : 0;
+    if (tp->c * 2 >= tp->hn)
+    {
+        const int m = MAX(tp->hn * 2, MINCAP);
 
-    p0[0] = +x0 / SCALE;
-    p0[1] = +z0 / SCALE;
-    p0[2] = -y0 / SCALE;
+        release(ctx, tp->h, sizeof (int), tp->hn);
 
-    p1[0] = +x1 / SCALE;
-    p1[1] = +z1 / SCALE;
-    p1[2] = -y1 / SCALE;
+        tp->h  = resize(ctx, NULL, sizeof (int), 0, m, "obj");
+        tp->hn = m;
 
-    p2[0] = +x2 / SCALE;
-    p2[1] = +z2 / SCALE;
-    p2[2] = -y2 / SCALE;
+        for (k = 0; k < tp->c; k++)
+        {
+            i = hash_row(tp->v + k * tp->d, tp->d) & (m - 1);
 
-    v_sub(u, p0, p1);
-    v_sub(v, p2, p1);
+            while (tp->h[i])
+                i = (i + 1) & (m - 1);
 
-    v_crs(ctx->plane_n[pi], u, v);
-    v_nrm(ctx->plane_n[pi], ctx->plane_n[pi]);
+            tp->h[i] = k + 1;
+        }
+    }
 
-    ctx->plane_d[pi] = v_dot(ctx->plane_n[pi], p1);
+    for (i = hash_row(x, tp->d) & (tp->hn - 1); (k = tp->h[i]);
+         i = (i + 1) & (tp->hn - 1))
+        if (memcmp(tp->v + (k - 1) * tp->d, x, size) == 0)
+            return k - 1;
 
-    for (i = 0; i < 6; i++)
-        if ((k = v_dot(ctx->plane_n[pi], base[i][0])) >= d)
-        {
-            d = k;
-            n = i;
-        }
+    RESERVE(ctx, tp->v, tp->n, (tp->c + 1) * tp->d, "obj");
 
-    p[0] = 0.f;
-    p[1] = 0.f;
-    p[2] = 0.f;
+    memcpy(tp->v + tp->c * tp->d, x, size);
+    tp->h[i] = tp->c + 1;
 
-    /* Always rotate around the positive axis */
+    return tp->c++;
+}
 
-    m_rot(R, base[n - (n % 2)][0], V_RAD(r));
+/*
+ * Add an element as read from the file, in file order.
+ */
+static void table_add(struct mapc_context *ctx, struct obj_table *tp,
+                      const float *x)
+{
+    const int k = table_row(ctx, tp, x);
 
-    v_mad(p, p, base[n][1], +su * tu / SCALE);
-    v_mad(p, p, base[n][2], -sv * tv / SCALE);
+    RESERVE(ctx, tp->m, tp->mn, tp->mc, "obj");
+    tp->m[tp->mc++] = k;
+}
+
+/*
+ * Map a one-based or negative relative OBJ index to a unique row.
+ * Missing and out of range indices fall back to the first element.
+ */
+static int table_get(struct mapc_context *ctx, struct obj_table *tp, int i)
+{
+    static const float zero[4];
+
+    if (i > 0)
+        i = i - 1;
+    else if (i < 0)
+        i = i + tp->mc;
+    else
+        i = -1;
 
-    m_vxfm(ctx->plane_u[pi], R, base[n][1]);
-    m_vxfm(ctx->plane_v[pi], R, base[n][2]);
-    m_vxfm(ctx->plane_p[pi], R, p);
+    if (i >= 0 && i < tp->mc)
+        return tp->m[i];
+    if (tp->mc > 0)
+        return tp->m[0];
 
-    v_scl(ctx->plane_u[pi], ctx->plane_u[pi], 64.f / w);
-    v_scl(ctx->plane_v[pi], ctx->plane_v[pi], 64.f / h);
+    return table_row(ctx, tp, zero);
+}
 
-    v_scl(ctx->plane_u[pi], ctx->plane_u[pi], 1.f / su);
-    v_scl(ctx->plane_v[pi], ctx->plane_v[pi], 1.f / sv);
+static void table_free(struct mapc_context *ctx, struct obj_table *tp)
+{
+    release(ctx, tp->v, sizeof (float), tp->n);
+    release(ctx, tp->h, sizeof (int),   tp->hn);
+    release(ctx, tp->m, sizeof (int),   tp->mn);
 }
 
 /*---------------------------------------------------------------------------*/
 
-#define T_EOF 0
-#define T_BEG 1
+static const char *obj_space(const char *p)
+{
+    while (*p == ' ' || *p == '\t' || *p == '\r')
+        p++;
+    return p;
+}
+
+static const char *obj_line(const char *p)
+{
+    while (*p && *p != '\n')
+        p++;
+    return *p ? p + 1 : p;
+}
+
+/*
+ * Copy the next word to W, if any, and return the text after it.
+ */
+static const char *obj_word(const char *p, char *w, size_t n)
+{
+    size_t i = 0;
+
+    p = obj_space(p);
+
+    while (*p && !isspace((unsigned char) *p))
+    {
+        if (i + 1 < n)
+            w[i++] = *p;
+        p++;
+    }
+    w[i] = 0;
+
+    return p;
+}
+
+/*
+ * Read up to N floats, leaving the rest zero.
+ */
+static const char *obj_floats(const char *p, float *x, int n)
+{
+    char *e;
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        x[i] = 0.0f;
+
+        if (*(p = obj_space(p)) && *p != '\n')
+        {
+            x[i] = strtof(p, &e);
+            p = e;
+        }
+    }
+    return p;
+}
+
+/*
+ * Read a face vertex of the form V, V/T, V//N or V/T/N.
+ */
+static const char *obj_corner(const char *p, int *v, int *t, int *s)
+{
+    char *e;
+
+    *v = *t = *s = 0;
+
+    *v = (int) strtol(p, &e, 10);
+
+    if (*(p = e) == '/')
+    {
+        *t = (int) strtol(p + 1, &e, 10);
+
+        if (*(p = e) == '/')
+        {
+            *s = (int) strtol(p + 1, &e, 10);
+            p = e;
+        }
+    }
+    return p;
+}
+
+static void read_f(struct mapc_context *ctx, struct obj_model *mp,
+                   const char *p, int mi)
+{
+    int v[3], t[3], s[3], n = 0;
+
+    while (*(p = obj_space(p)) && *p != '\n')
+    {
+        const char *q = p;
+        int i = MIN(n, 2);
+
+        p = obj_corner(p, v + i, t + i, s + i);
+
+        if (p == q)
+            break;
+
+        /* Emit a triangle fan. */
+
+        if (++n >= 3)
+        {
+            struct obj_face *fp;
+            int j;
+
+            RESERVE(ctx, mp->fv, mp->fn, mp->fc, "obj");
+
+            fp = mp->fv + mp->fc++;
+            fp->mi = mi;
+
+            for (j = 0; j < 3; j++)
+            {
+                fp->vi[j] = table_get(ctx, &mp->v, v[j]);
+                fp->ti[j] = table_get(ctx, &mp->t, t[j]);
+                fp->si[j] = table_get(ctx, &mp->s, s[j]);
+            }
+
+            v[1] = v[2];
+            t[1] = t[2];
+            s[1] = s[2];
+        }
+    }
+}
+
+static void read_obj_text(struct mapc_context *ctx, struct obj_model *mp,
+                          const char *p)
+{
+    struct s_base *fp = &ctx->file;
+    char word[MAXSTR];
+    float x[3];
+    int mi = mp->mi;
+
+    while (*p)
+    {
+        const char *q = obj_word(p, word, sizeof (word));
+
+        if (strcmp(word, "v") == 0)
+        {
+            obj_floats(q, x, 3);
+            table_add(ctx, &mp->v, x);
+        }
+        else if (strcmp(word, "vt") == 0)
+        {
+            obj_floats(q, x, 2);
+            table_add(ctx, &mp->t, x);
+        }
+        else if (strcmp(word, "vn") == 0)
+        {
+            obj_floats(q, x, 3);
+            table_add(ctx, &mp->s, x);
+        }
+        else if (strcmp(word, "f") == 0)
+        {
+            if (fp->mv[mi].d[3] > 0.0f)
+                read_f(ctx, mp, q, mi);
+        }
+        else if (strcmp(word, "usemtl") == 0)
+        {
+            obj_word(q, word, sizeof (word));
+            mi = read_mtrl(ctx, word);
+        }
+
+        p = obj_line(q);
+    }
+}
+
+/*
+ * Find or parse the named model as referenced under material MI.
+ */
+static struct obj_model *load_obj(struct mapc_context *ctx,
+                                  const char *name, int mi)
+{
+    struct obj_model *mp;
+    char *text;
+    int i, n;
+
+    for (i = 0; i < ctx->objc; i++)
+        if (ctx->objv[i].mi == mi && strcmp(ctx->objv[i].name, name) == 0)
+            return ctx->objv + i;
+
+    RESERVE(ctx, ctx->objv, ctx->obj_n, ctx->objc, "obj");
+
+    mp = ctx->objv + ctx->objc++;
+
+    SAFECPY(mp->name, name);
+
+    mp->mi  = mi;
+    mp->t0  = -1;
+    mp->s0  = -1;
+    mp->v.d = 3;
+    mp->t.d = 2;
+    mp->s.d = 3;
+
+    if ((text = fs_load(name, &n)))
+    {
+        char *p;
+
+        if ((p = realloc(text, n + 1)))
+        {
+            p[n] = 0;
+            read_obj_text(ctx, mp, p);
+            text = p;
+        }
+        free(text);
+    }
+
+    /* Only the unique rows are needed from here on. */
+
+    release(ctx, mp->v.h, sizeof (int), mp->v.hn);
+    release(ctx, mp->t.h, sizeof (int), mp->t.hn);
+    release(ctx, mp->s.h, sizeof (int), mp->s.hn);
+
+    mp->v.h = mp->t.h = mp->s.h = NULL;
+    mp->v.hn = mp->t.hn = mp->s.hn = 0;
+
+    return mp;
+}
+
+static void free_objs(struct mapc_context *ctx)
+{
+    int i;
+
+    for (i = 0; i < ctx->objc; i++)
+    {
+        table_free(ctx, &ctx->objv[i].v);
+        table_free(ctx, &ctx->objv[i].t);
+        table_free(ctx, &ctx->objv[i].s);
+
+        release(ctx, ctx->objv[i].fv, sizeof (struct obj_face),
+                ctx->objv[i].fn);
+    }
+
+    release(ctx, ctx->objv, sizeof (struct obj_model), ctx->obj_n);
+
+    ctx->objv  = NULL;
+    ctx->objc  = 0;
+    ctx->obj_n = 0;
+}
+
+static void read_obj(struct mapc_context *ctx, const char *name, int mi)
+{
+    struct s_base *fp = &ctx->file;
+    struct obj_model *mp;
+    int i, j;
+
+    const int v0 = fp->vc;
+
+    add_dep(ctx, name);
+
+    mp = load_obj(ctx, name, mi);
+
+    if (mp->t0 < 0)
+    {
+        mp->t0 = fp->tc;
+
+        for (i = 0; i < mp->t.c; i++)
+        {
+            const int ti = inct(ctx);
+            memcpy(fp->tv[ti].u, mp->t.v + i * 2, sizeof (float[2]));
+        }
+    }
+
+    if (mp->s0 < 0)
+    {
+        mp->s0 = fp->sc;
+
+        for (i = 0; i < mp->s.c; i++)
+        {
+            const int si = incs(ctx);
+            v_cpy(fp->sv[si].n, mp->s.v + i * 3);
+        }
+    }
+
+    for (i = 0; i < mp->v.c; i++)
+    {
+        const int vi = incv(ctx);
+        v_cpy(fp->vv[vi].p, mp->v.v + i * 3);
+    }
+
+    for (i = 0; i < mp->fc; i++)
+    {
+        const struct obj_face *f = mp->fv + i;
+
+        /* Claim all elements before taking pointers to any. */
+
+        const int gi = incg(ctx);
+        const int oi = inco(ctx);
+        const int oj = inco(ctx);
+        const int ok = inco(ctx);
+
+        struct b_geom *gp = fp->gv + gi;
+        int o[3];
+
+        o[0] = gp->oi = oi;
+        o[1] = gp->oj = oj;
+        o[2] = gp->ok = ok;
+
+        for (j = 0; j < 3; j++)
+        {
+            fp->ov[o[j]].vi = f->vi[j] + v0;
+            fp->ov[o[j]].ti = f->ti[j] + mp->t0;
+            fp->ov[o[j]].si = f->si[j] + mp->s0;
+        }
+
+        gp->mi = f->mi;
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void make_plane(struct mapc_context *ctx, int   pi, float x0, float y0, float      z0,
+                       float x1, float y1, float z1,
+                       float x2, float y2, float z2,
+                       float tu, float tv, float r,
+                       float su, float sv, int   fl, const char *s)
+{
+    static const float base[6][3][3] = {
+        {{  0,  0,  1 }, {  1,  0,  0 }, {  0,  1,  0 }},
+        {{  0,  0, -1 }, {  1,  0,  0 }, {  0,  1,  0 }},
+        {{  1,  0,  0 }, {  0,  0, -1 }, {  0,  1,  0 }},
+        {{ -1,  0,  0 }, {  0,  0, -1 }, {  0,  1,  0 }},
+        {{  0,  1,  0 }, {  1,  0,  0 }, {  0,  0, -1 }},
+        {{  0, -1,  0 }, {  1,  0,  0 }, {  0,  0, -1 }},
+    };
+
+    float R[16];
+    float p0[3], p1[3], p2[3];
+    float u[3],  v[3],  p[3];
+    float k, d = 0.0f;
+    int   i, n = 0;
+    int   w, h;
+
+    size_image(ctx, s, &w, &h);
+
+    ctx->planes[pi].f = fl ? L_DETAIL : 0;
+
+    p0[0] = +x0 / SCALE;
+    p0[1] = +z0 / SCALE;
+    p0[2] = -y0 / SCALE;
+
+    p1[0] = +x1 / SCALE;
+    p1[1] = +z1 / SCALE;
+    p1[2] = -y1 / SCALE;
+
+    p2[0] = +x2 / SCALE;
+    p2[1] = +z2 / SCALE;
+    p2[2] = -y2 / SCALE;
+
+    v_sub(u, p0, p1);
+    v_sub(v, p2, p1);
+
+    v_crs(ctx->planes[pi].n, u, v);
+    v_nrm(ctx->planes[pi].n, ctx->planes[pi].n);
+
+    ctx->planes[pi].d = v_dot(ctx->planes[pi].n, p1);
+
+    for (i = 0; i < 6; i++)
+        if ((k = v_dot(ctx->planes[pi].n, base[i][0])) >= d)
+        {
+            d = k;
+            n = i;
+        }
+
+    p[0] = 0.f;
+    p[1] = 0.f;
+    p[2] = 0.f;
+
+    /* Always rotate around the positive axis */
+
+    m_rot(R, base[n - (n % 2)][0], V_RAD(r));
+
+    v_mad(p, p, base[n][1], +su * tu / SCALE);
+    v_mad(p, p, base[n][2], -sv * tv / SCALE);
+
+    m_vxfm(ctx->planes[pi].u, R, base[n][1]);
+    m_vxfm(ctx->planes[pi].v, R, base[n][2]);
+    m_vxfm(ctx->planes[pi].p, R, p);
+
+    v_scl(ctx->planes[pi].u, ctx->planes[pi].u, 64.f / w);
+    v_scl(ctx->planes[pi].v, ctx->planes[pi].v, 64.f / h);
+
+    v_scl(ctx->planes[pi].u, ctx->planes[pi].u, 1.f / su);
+    v_scl(ctx->planes[pi].v, ctx->planes[pi].v, 1.f / sv);
+}
+
+/*---------------------------------------------------------------------------*/
+
+#define T_EOF 0
+#define T_BEG 1
 #define T_CLP 2
 #define T_KEY 3
 #define T_END 4
@@ -1197,7 +1692,8 @@ static void read_lump(struct mapc_context *ctx, fs_file fin)
     char v[MAXSTR];
     int t;
 
-    struct b_lump *lp = fp->lv + incl(ctx);
+    const int li = incl(ctx);
+    struct b_lump *lp = fp->lv + li;
 
     lp->s0 = fp->ic;
 
@@ -1205,12 +1701,12 @@ static void read_lump(struct mapc_context *ctx, fs_file fin)
     {
         if (t == T_CLP)
         {
-            fp->sv[fp->sc].n[0] = ctx->plane_n[fp->sc][0];
-            fp->sv[fp->sc].n[1] = ctx->plane_n[fp->sc][1];
-            fp->sv[fp->sc].n[2] = ctx->plane_n[fp->sc][2];
-            fp->sv[fp->sc].d    = ctx->plane_d[fp->sc];
+            fp->sv[fp->sc].n[0] = ctx->planes[fp->sc].n[0];
+            fp->sv[fp->sc].n[1] = ctx->planes[fp->sc].n[1];
+            fp->sv[fp->sc].n[2] = ctx->planes[fp->sc].n[2];
+            fp->sv[fp->sc].d    = ctx->planes[fp->sc].d;
 
-            ctx->plane_m[fp->sc] = read_mtrl(ctx, k);
+            ctx->planes[fp->sc].m = read_mtrl(ctx, k);
 
             fp->iv[fp->ic] = fp->sc;
             inci(ctx);
@@ -1249,17 +1745,17 @@ static void make_path(struct mapc_context *ctx,
             make_sym(ctx, SYM_PATH, v[i], pi);
 
         if (strcmp(k[i], "target") == 0 || strcmp(k[i], "target1") == 0)
-            make_ref(ctx, SYM_PATH, v[i], &pp->pi);
+            MAKE_REF(ctx, SYM_PATH, v[i], fp->pv, &pp->pi);
 
         if (strcmp(k[i], "target2") == 0)
         {
-            make_ref(ctx, SYM_PATH, v[i], &pp->p0);
+            MAKE_REF(ctx, SYM_PATH, v[i], fp->pv, &pp->p0);
             pp->fl |= P_PARENTED;
         }
 
         if (strcmp(k[i], "target3") == 0)
         {
-            make_ref(ctx, SYM_PATH, v[i], &pp->p1);
+            MAKE_REF(ctx, SYM_PATH, v[i], fp->pv, &pp->p1);
             pp->fl |= P_PARENTED;
         }
 
@@ -1335,18 +1831,13 @@ static void make_dict(struct mapc_context *ctx,
                       const char *v)
 {
     struct s_base *fp = &ctx->file;
-    int space_left, space_needed, di = incd(ctx);
+    int space_needed, di = incd(ctx);
 
     struct b_dict *dp = fp->dv + di;
 
-    space_left   = MAXA - fp->ac;
     space_needed = strlen(k) + 1 + strlen(v) + 1;
 
-    if (space_needed > space_left)
-    {
-        fp->dc--;
-        return;
-    }
+    RESERVE(ctx, fp->av, ctx->caps.a, fp->ac + space_needed, "char");
 
     dp->ai = fp->ac;
     dp->aj = dp->ai + strlen(k) + 1;
@@ -1381,10 +1872,10 @@ static void make_body(struct mapc_context *ctx,
     for (i = 0; i < c; i++)
     {
         if (strcmp(k[i], "target") == 0 || strcmp(k[i], "target1") == 0)
-            make_ref(ctx, SYM_PATH, v[i], &bp->p0);
+            MAKE_REF(ctx, SYM_PATH, v[i], fp->bv, &bp->p0);
 
         else if (strcmp(k[i], "target2") == 0)
-            make_ref(ctx, SYM_PATH, v[i], &bp->p1);
+            MAKE_REF(ctx, SYM_PATH, v[i], fp->bv, &bp->p1);
 
         else if (strcmp(k[i], "material") == 0)
             mi = read_mtrl(ctx, v[i]);
@@ -1405,7 +1896,10 @@ static void make_body(struct mapc_context *ctx,
     bp->gc = fp->gc - g0;
 
     for (i = 0; i < bp->gc; i++)
-        fp->iv[inci(ctx)] = g0++;
+    {
+        const int ii = inci(ctx);
+        fp->iv[ii] = g0++;
+    }
 
     p[0] = +x / SCALE;
     p[1] = +z / SCALE;
@@ -1464,10 +1958,10 @@ static void make_item(struct mapc_context *ctx,
         }
 
         if (strcmp(k[i], "target") == 0 || strcmp(k[i], "target1") == 0)
-            make_ref(ctx, SYM_PATH, v[i], &hp->p0);
+            MAKE_REF(ctx, SYM_PATH, v[i], fp->hv, &hp->p0);
 
         else if (strcmp(k[i], "target2") == 0)
-            make_ref(ctx, SYM_PATH, v[i], &hp->p1);
+            MAKE_REF(ctx, SYM_PATH, v[i], fp->hv, &hp->p1);
     }
 }
 
@@ -1524,10 +2018,10 @@ static void make_bill(struct mapc_context *ctx,
         }
 
         if (strcmp(k[i], "target") == 0 || strcmp(k[i], "target1") == 0)
-            make_ref(ctx, SYM_PATH, v[i], &rp->p0);
+            MAKE_REF(ctx, SYM_PATH, v[i], fp->rv, &rp->p0);
 
         else if (strcmp(k[i], "target2") == 0)
-            make_ref(ctx, SYM_PATH, v[i], &rp->p1);
+            MAKE_REF(ctx, SYM_PATH, v[i], fp->rv, &rp->p1);
     }
 }
 
@@ -1564,10 +2058,10 @@ static void make_goal(struct mapc_context *ctx,
         }
 
         if (strcmp(k[i], "target") == 0 || strcmp(k[i], "target1") == 0)
-            make_ref(ctx, SYM_PATH, v[i], &zp->p0);
+            MAKE_REF(ctx, SYM_PATH, v[i], fp->zv, &zp->p0);
 
         else if (strcmp(k[i], "target2") == 0)
-            make_ref(ctx, SYM_PATH, v[i], &zp->p1);
+            MAKE_REF(ctx, SYM_PATH, v[i], fp->zv, &zp->p1);
     }
 }
 
@@ -1580,6 +2074,8 @@ static void make_view(struct mapc_context *ctx,
 
     struct b_view *wp = fp->wv + wi;
 
+    RESERVE(ctx, ctx->targ_wi, ctx->targ_wn, wi, "view");
+
     wp->p[0] = 0.f;
     wp->p[1] = 0.f;
     wp->p[2] = 0.f;
@@ -1590,7 +2086,7 @@ static void make_view(struct mapc_context *ctx,
     for (i = 0; i < c; i++)
     {
         if (strcmp(k[i], "target") == 0)
-            make_ref(ctx, SYM_TARG, v[i], ctx->targ_wi + wi);
+            MAKE_REF(ctx, SYM_TARG, v[i], ctx->targ_wi, ctx->targ_wi + wi);
 
         if (strcmp(k[i], "origin") == 0)
         {
@@ -1614,6 +2110,8 @@ static void make_jump(struct mapc_context *ctx,
 
     struct b_jump *jp = fp->jv + ji;
 
+    RESERVE(ctx, ctx->targ_ji, ctx->targ_jn, ji, "jump");
+
     jp->p[0] = 0.f;
     jp->p[1] = 0.f;
     jp->p[2] = 0.f;
@@ -1630,7 +2128,7 @@ static void make_jump(struct mapc_context *ctx,
             sscanf(v[i], "%f", &jp->r);
 
         if (strcmp(k[i], "target") == 0)
-            make_ref(ctx, SYM_TARG, v[i], ctx->targ_ji + ji);
+            MAKE_REF(ctx, SYM_TARG, v[i], ctx->targ_ji, ctx->targ_ji + ji);
 
         if (strcmp(k[i], "origin") == 0)
         {
@@ -1644,10 +2142,10 @@ static void make_jump(struct mapc_context *ctx,
         }
 
         if (strcmp(k[i], "target2") == 0)
-            make_ref(ctx, SYM_PATH, v[i], &jp->p0);
+            MAKE_REF(ctx, SYM_PATH, v[i], fp->jv, &jp->p0);
 
         if (strcmp(k[i], "target3") == 0)
-            make_ref(ctx, SYM_PATH, v[i], &jp->p1);
+            MAKE_REF(ctx, SYM_PATH, v[i], fp->jv, &jp->p1);
     }
 }
 
@@ -1677,7 +2175,7 @@ static void make_swch(struct mapc_context *ctx,
             sscanf(v[i], "%f", &xp->r);
 
         if (strcmp(k[i], "target") == 0)
-            make_ref(ctx, SYM_PATH, v[i], &xp->pi);
+            MAKE_REF(ctx, SYM_PATH, v[i], fp->xv, &xp->pi);
 
         if (strcmp(k[i], "timer") == 0)
             sscanf(v[i], "%f", &xp->t);
@@ -1700,10 +2198,10 @@ static void make_swch(struct mapc_context *ctx,
         }
 
         if (strcmp(k[i], "target2") == 0)
-            make_ref(ctx, SYM_PATH, v[i], &xp->p0);
+            MAKE_REF(ctx, SYM_PATH, v[i], fp->xv, &xp->p0);
 
         else if (strcmp(k[i], "target3") == 0)
-            make_ref(ctx, SYM_PATH, v[i], &xp->p1);
+            MAKE_REF(ctx, SYM_PATH, v[i], fp->xv, &xp->p1);
     }
 }
 
@@ -1713,6 +2211,8 @@ static void make_targ(struct mapc_context *ctx,
 {
     int i;
 
+    RESERVE(ctx, ctx->targ_p, ctx->targ_pn, ctx->targ_n, "target");
+
     ctx->targ_p[ctx->targ_n][0] = 0.f;
     ctx->targ_p[ctx->targ_n][1] = 0.f;
     ctx->targ_p[ctx->targ_n][2] = 0.f;
@@ -1734,8 +2234,7 @@ static void make_targ(struct mapc_context *ctx,
         }
     }
 
-    if (++ctx->targ_n == MAXW)
-        overflow(ctx, "target");
+    ctx->targ_n++;
 }
 
 static void make_ball(struct mapc_context *ctx,
@@ -1918,11 +2417,12 @@ static void clip_vert(struct mapc_context *ctx,
 
         if (ok_vert(fp, lp, p))
         {
-            int vi = incv(ctx);
+            const int vi = incv(ctx);
+            const int ii = inci(ctx);
 
             v_cpy(fp->vv[vi].p, p);
 
-            fp->iv[inci(ctx)] = vi;
+            fp->iv[ii] = vi;
             lp->vc++;
         }
     }
@@ -1994,10 +2494,10 @@ static void clip_geom(struct mapc_context *ctx,
             m[n] = vi;
             t[n] = inct(ctx);
 
-            v_add(v, fp->vv[vi].p, ctx->plane_p[si]);
+            v_add(v, fp->vv[vi].p, ctx->planes[si].p);
 
-            fp->tv[t[n]].u[0] = v_dot(v, ctx->plane_u[si]);
-            fp->tv[t[n]].u[1] = v_dot(v, ctx->plane_v[si]);
+            fp->tv[t[n]].u[0] = v_dot(v, ctx->planes[si].u);
+            fp->tv[t[n]].u[1] = v_dot(v, ctx->planes[si].v);
 
             if (++n >= ARRAYSIZE(m))
             {
@@ -2033,14 +2533,17 @@ static void clip_geom(struct mapc_context *ctx,
     for (i = 0; i < n - 2; i++)
     {
         const int gi = incg(ctx);
+        const int oi = inco(ctx);
+        const int oj = inco(ctx);
+        const int ok = inco(ctx);
 
         struct b_geom *gp = fp->gv + gi;
 
-        struct b_offs *op = fp->ov + (gp->oi = inco(ctx));
-        struct b_offs *oq = fp->ov + (gp->oj = inco(ctx));
-        struct b_offs *or = fp->ov + (gp->ok = inco(ctx));
+        struct b_offs *op = fp->ov + (gp->oi = oi);
+        struct b_offs *oq = fp->ov + (gp->oj = oj);
+        struct b_offs *or = fp->ov + (gp->ok = ok);
 
-        gp->mi = ctx->plane_m[si];
+        gp->mi = ctx->planes[si].m;
 
         op->ti = t[0];
         oq->ti = t[i + 1];
@@ -2094,11 +2597,11 @@ static void clip_lump(struct mapc_context *ctx, struct b_lump *lp)
     lp->gc = 0;
 
     for (i = 0; i < lp->sc; i++)
-        if (fp->mv[ctx->plane_m[fp->iv[lp->s0 + i]]].d[3] > 0.0f)
+        if (fp->mv[ctx->planes[fp->iv[lp->s0 + i]].m].d[3] > 0.0f)
             clip_geom(ctx, lp, fp->iv[lp->s0 + i]);
 
     for (i = 0; i < lp->sc; i++)
-        if (ctx->plane_f[fp->iv[lp->s0 + i]])
+        if (ctx->planes[fp->iv[lp->s0 + i]].f)
             lp->fl |= L_DETAIL;
 }
 
@@ -2244,9 +2747,9 @@ static void apply_mtrl_swaps(struct mapc_context *ctx, struct s_base *fp)
     int i;
 
     for (i = 0; i < fp->gc; i++)
-        fp->gv[i].mi = ctx->mtrl_swaps[fp->gv[i].mi];
+        fp->gv[i].mi = ctx->swaps[fp->gv[i].mi];
     for (i = 0; i < fp->rc; i++)
-        fp->rv[i].mi = ctx->mtrl_swaps[fp->rv[i].mi];
+        fp->rv[i].mi = ctx->swaps[fp->rv[i].mi];
 }
 
 
@@ -2256,16 +2759,16 @@ static void apply_vert_swaps(struct mapc_context *ctx, struct s_base *fp)
 
     for (i = 0; i < fp->ec; i++)
     {
-        fp->ev[i].vi = ctx->vert_swaps[fp->ev[i].vi];
-        fp->ev[i].vj = ctx->vert_swaps[fp->ev[i].vj];
+        fp->ev[i].vi = ctx->swaps[fp->ev[i].vi];
+        fp->ev[i].vj = ctx->swaps[fp->ev[i].vj];
     }
 
     for (i = 0; i < fp->oc; i++)
-        fp->ov[i].vi = ctx->vert_swaps[fp->ov[i].vi];
+        fp->ov[i].vi = ctx->swaps[fp->ov[i].vi];
 
     for (i = 0; i < fp->lc; i++)
         for (j = 0; j < fp->lv[i].vc; j++)
-            fp->iv[fp->lv[i].v0 + j] = ctx->vert_swaps[fp->iv[fp->lv[i].v0 + j]];
+            fp->iv[fp->lv[i].v0 + j] = ctx->swaps[fp->iv[fp->lv[i].v0 + j]];
 }
 
 static void apply_edge_swaps(struct mapc_context *ctx, struct s_base *fp)
@@ -2274,7 +2777,7 @@ static void apply_edge_swaps(struct mapc_context *ctx, struct s_base *fp)
 
     for (i = 0; i < fp->lc; i++)
         for (j = 0; j < fp->lv[i].ec; j++)
-            fp->iv[fp->lv[i].e0 + j] = ctx->edge_swaps[fp->iv[fp->lv[i].e0 + j]];
+            fp->iv[fp->lv[i].e0 + j] = ctx->swaps[fp->iv[fp->lv[i].e0 + j]];
 }
 
 static void apply_side_swaps(struct mapc_context *ctx, struct s_base *fp)
@@ -2282,13 +2785,13 @@ static void apply_side_swaps(struct mapc_context *ctx, struct s_base *fp)
     int i, j;
 
     for (i = 0; i < fp->oc; i++)
-        fp->ov[i].si = ctx->side_swaps[fp->ov[i].si];
+        fp->ov[i].si = ctx->swaps[fp->ov[i].si];
     for (i = 0; i < fp->nc; i++)
-        fp->nv[i].si = ctx->side_swaps[fp->nv[i].si];
+        fp->nv[i].si = ctx->swaps[fp->nv[i].si];
 
     for (i = 0; i < fp->lc; i++)
         for (j = 0; j < fp->lv[i].sc; j++)
-            fp->iv[fp->lv[i].s0 + j] = ctx->side_swaps[fp->iv[fp->lv[i].s0 + j]];
+            fp->iv[fp->lv[i].s0 + j] = ctx->swaps[fp->iv[fp->lv[i].s0 + j]];
 }
 
 static void apply_texc_swaps(struct mapc_context *ctx, struct s_base *fp)
@@ -2296,7 +2799,7 @@ static void apply_texc_swaps(struct mapc_context *ctx, struct s_base *fp)
     int i;
 
     for (i = 0; i < fp->oc; i++)
-        fp->ov[i].ti = ctx->texc_swaps[fp->ov[i].ti];
+        fp->ov[i].ti = ctx->swaps[fp->ov[i].ti];
 }
 
 static void apply_offs_swaps(struct mapc_context *ctx, struct s_base *fp)
@@ -2305,9 +2808,9 @@ static void apply_offs_swaps(struct mapc_context *ctx, struct s_base *fp)
 
     for (i = 0; i < fp->gc; i++)
     {
-        fp->gv[i].oi = ctx->offs_swaps[fp->gv[i].oi];
-        fp->gv[i].oj = ctx->offs_swaps[fp->gv[i].oj];
-        fp->gv[i].ok = ctx->offs_swaps[fp->gv[i].ok];
+        fp->gv[i].oi = ctx->swaps[fp->gv[i].oi];
+        fp->gv[i].oj = ctx->swaps[fp->gv[i].oj];
+        fp->gv[i].ok = ctx->swaps[fp->gv[i].ok];
     }
 }
 
@@ -2317,53 +2820,165 @@ static void apply_geom_swaps(struct mapc_context *ctx, struct s_base *fp)
 
     for (i = 0; i < fp->lc; i++)
         for (j = 0; j < fp->lv[i].gc; j++)
-            fp->iv[fp->lv[i].g0 + j] = ctx->geom_swaps[fp->iv[fp->lv[i].g0 + j]];
+            fp->iv[fp->lv[i].g0 + j] = ctx->swaps[fp->iv[fp->lv[i].g0 + j]];
 
     for (i = 0; i < fp->bc; i++)
         for (j = 0; j < fp->bv[i].gc; j++)
-            fp->iv[fp->bv[i].g0 + j] = ctx->geom_swaps[fp->iv[fp->bv[i].g0 + j]];
+            fp->iv[fp->bv[i].g0 + j] = ctx->swaps[fp->iv[fp->bv[i].g0 + j]];
 }
 
 /*---------------------------------------------------------------------------*/
 
-static void uniq_mtrl(struct mapc_context *ctx)
+/*
+ * Hash chains over the elements kept by a uniq pass, for comparisons
+ * that allow candidates to be bucketed.
+ */
+struct uniq_hash
 {
-    struct s_base *fp = &ctx->file;
-    int i, j, k = 0;
+    int *head;
+    int *next;
+    int  n;
+    int  m;
+};
 
-    for (i = 0; i < fp->mc; i++)
-    {
-        for (j = 0; j < k; j++)
-            if (comp_mtrl(fp->mv + i, fp->mv + j))
-                break;
+static void hash_init(struct mapc_context *ctx, struct uniq_hash *hp, int c)
+{
+    int i;
 
-        ctx->mtrl_swaps[i] = j;
+    hp->m = MAX(c, 1);
 
-        if (j == k)
-        {
-            if (i != k)
-                fp->mv[k] = fp->mv[i];
-            k++;
-        }
-    }
+    for (hp->n = MINCAP; hp->n < hp->m * 2; hp->n *= 2)
+        ;
 
-    apply_mtrl_swaps(ctx, fp);
+    hp->head = resize(ctx, NULL, sizeof (int), 0, hp->n, "hash");
+    hp->next = resize(ctx, NULL, sizeof (int), 0, hp->m, "hash");
 
-    fp->mc = k;
+    for (i = 0; i < hp->n; i++)
+        hp->head[i] = -1;
 }
 
-static void uniq_vert(struct mapc_context *ctx)
+static void hash_free(struct mapc_context *ctx, struct uniq_hash *hp)
 {
-    struct s_base *fp = &ctx->file;
-    int i, j, k = 0;
-
-    for (i = 0; i < fp->vc; i++)
-    {
-        for (j = 0; j < k; j++)
-            if (comp_vert(fp->vv + i, fp->vv + j))
-                break;
+    release(ctx, hp->head, sizeof (int), hp->n);
+    release(ctx, hp->next, sizeof (int), hp->m);
+}
 
-        ctx->vert_swaps[i] = j;
+static void hash_link(struct uniq_hash *hp, unsigned int h, int k)
+{
+    hp->next[k] = hp->head[h & (hp->n - 1)];
+    hp->head[h & (hp->n - 1)] = k;
+}
+
+static unsigned int hash_ints(int a, int b, int c, int d)
+{
+    return ((unsigned int) a * 73856093u) ^ ((unsigned int) b * 19349663u) ^
+           ((unsigned int) c * 83492791u) ^ ((unsigned int) d * 2654435761u);
+}
+
+/*
+ * Sides match when their normals are within a rounding error, so near
+ * unit length matches land in neighbouring cells of a grid over normal
+ * and distance. Longer normals may match anything and are kept apart.
+ */
+#define SIDE_CELL 0.0625f
+#define SIDE_LONG 1.001f
+
+static void side_cell(const struct b_side *sp, int q[4])
+{
+    q[0] = (int) floorf(sp->n[0] / SIDE_CELL);
+    q[1] = (int) floorf(sp->n[1] / SIDE_CELL);
+    q[2] = (int) floorf(sp->n[2] / SIDE_CELL);
+    q[3] = (int) floorf(CLAMP(-1.0e6f, sp->d, 1.0e6f) / SIDE_CELL);
+}
+
+static int find_side(const struct s_base *fp, const struct uniq_hash *hp,
+                     const int *longv, int longc, int i, int k)
+{
+    const struct b_side *sp = fp->sv + i;
+
+    int q[4], a, b, c, d, x, j = k;
+
+    /* Long normals are compared against everything. */
+
+    if (v_dot(sp->n, sp->n) > SIDE_LONG)
+    {
+        for (x = 0; x < k; x++)
+            if (comp_side(sp, fp->sv + x))
+                return x;
+        return k;
+    }
+
+    /* Long normals are kept in order, so the first match is the least. */
+
+    for (x = 0; x < longc; x++)
+        if (comp_side(sp, fp->sv + longv[x]))
+        {
+            j = longv[x];
+            break;
+        }
+
+    side_cell(sp, q);
+
+    for (a = -1; a <= 1; a++)
+        for (b = -1; b <= 1; b++)
+            for (c = -1; c <= 1; c++)
+                for (d = -1; d <= 1; d++)
+                {
+                    unsigned int h = hash_ints(q[0] + a, q[1] + b,
+                                               q[2] + c, q[3] + d);
+
+                    for (x = hp->head[h & (hp->n - 1)]; x >= 0; x = hp->next[x])
+                        if (x < j && comp_side(sp, fp->sv + x))
+                            j = x;
+                }
+
+    return j;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void uniq_mtrl(struct mapc_context *ctx)
+{
+    struct s_base *fp = &ctx->file;
+    int i, j, k = 0;
+
+    get_swaps(ctx, fp->mc);
+
+    for (i = 0; i < fp->mc; i++)
+    {
+        for (j = 0; j < k; j++)
+            if (comp_mtrl(fp->mv + i, fp->mv + j))
+                break;
+
+        ctx->swaps[i] = j;
+
+        if (j == k)
+        {
+            if (i != k)
+                fp->mv[k] = fp->mv[i];
+            k++;
+        }
+    }
+
+    apply_mtrl_swaps(ctx, fp);
+
+    fp->mc = k;
+}
+
+static void uniq_vert(struct mapc_context *ctx)
+{
+    struct s_base *fp = &ctx->file;
+    int i, j, k = 0;
+
+    get_swaps(ctx, fp->vc);
+
+    for (i = 0; i < fp->vc; i++)
+    {
+        for (j = 0; j < k; j++)
+            if (comp_vert(fp->vv + i, fp->vv + j))
+                break;
+
+        ctx->swaps[i] = j;
 
         if (j == k)
         {
@@ -2383,13 +2998,15 @@ static void uniq_edge(struct mapc_context *ctx)
     struct s_base *fp = &ctx->file;
     int i, j, k = 0;
 
+    get_swaps(ctx, fp->ec);
+
     for (i = 0; i < fp->ec; i++)
     {
         for (j = 0; j < k; j++)
             if (comp_edge(fp->ev + i, fp->ev + j))
                 break;
 
-        ctx->edge_swaps[i] = j;
+        ctx->swaps[i] = j;
 
         if (j == k)
         {
@@ -2407,24 +3024,37 @@ static void uniq_edge(struct mapc_context *ctx)
 static void uniq_offs(struct mapc_context *ctx)
 {
     struct s_base *fp = &ctx->file;
+    struct uniq_hash H;
     int i, j, k = 0;
 
+    get_swaps(ctx, fp->oc);
+    hash_init(ctx, &H, fp->oc);
+
     for (i = 0; i < fp->oc; i++)
     {
-        for (j = 0; j < k; j++)
-            if (comp_offs(fp->ov + i, fp->ov + j))
+        const struct b_offs *op = fp->ov + i;
+        const unsigned int h = hash_ints(op->vi, op->ti, op->si, 0);
+
+        for (j = H.head[h & (H.n - 1)]; j >= 0; j = H.next[j])
+            if (comp_offs(op, fp->ov + j))
                 break;
 
-        ctx->offs_swaps[i] = j;
+        if (j < 0)
+            j = k;
+
+        ctx->swaps[i] = j;
 
         if (j == k)
         {
             if (i != k)
                 fp->ov[k] = fp->ov[i];
+            hash_link(&H, h, k);
             k++;
         }
     }
 
+    hash_free(ctx, &H);
+
     apply_offs_swaps(ctx,fp);
 
     fp->oc = k;
@@ -2435,13 +3065,15 @@ static void uniq_geom(struct mapc_context *ctx)
     struct s_base *fp = &ctx->file;
     int i, j, k = 0;
 
+    get_swaps(ctx, fp->gc);
+
     for (i = 0; i < fp->gc; i++)
     {
         for (j = 0; j < k; j++)
             if (comp_geom(fp->gv + i, fp->gv + j))
                 break;
 
-        ctx->geom_swaps[i] = j;
+        ctx->swaps[i] = j;
 
         if (j == k)
         {
@@ -2461,13 +3093,15 @@ static void uniq_texc(struct mapc_context *ctx)
     struct s_base *fp = &ctx->file;
     int i, j, k = 0;
 
+    get_swaps(ctx, fp->tc);
+
     for (i = 0; i < fp->tc; i++)
     {
         for (j = 0; j < k; j++)
             if (comp_texc(fp->tv + i, fp->tv + j))
                 break;
 
-        ctx->texc_swaps[i] = j;
+        ctx->swaps[i] = j;
 
         if (j == k)
         {
@@ -2485,24 +3119,42 @@ static void uniq_texc(struct mapc_context *ctx)
 static void uniq_side(struct mapc_context *ctx)
 {
     struct s_base *fp = &ctx->file;
+    struct uniq_hash H;
+    int *longv, longc = 0;
     int i, j, k = 0;
 
+    get_swaps(ctx, fp->sc);
+    hash_init(ctx, &H, fp->sc);
+
+    longv = resize(ctx, NULL, sizeof (int), 0, H.m, "hash");
+
     for (i = 0; i < fp->sc; i++)
     {
-        for (j = 0; j < k; j++)
-            if (comp_side(fp->sv + i, fp->sv + j))
-                break;
+        j = find_side(fp, &H, longv, longc, i, k);
 
-        ctx->side_swaps[i] = j;
+        ctx->swaps[i] = j;
 
         if (j == k)
         {
+            int q[4];
+
             if (i != k)
                 fp->sv[k] = fp->sv[i];
+
+            if (v_dot(fp->sv[k].n, fp->sv[k].n) > SIDE_LONG)
+                longv[longc++] = k;
+            else
+            {
+                side_cell(fp->sv + k, q);
+                hash_link(&H, hash_ints(q[0], q[1], q[2], q[3]), k);
+            }
             k++;
         }
     }
 
+    release(ctx, longv, sizeof (int), H.m);
+    hash_free(ctx, &H);
+
     apply_side_swaps(ctx,fp);
 
     fp->sc = k;
@@ -2534,146 +3186,262 @@ struct b_trip
     int gi;
 };
 
-static int comp_trip(const void *p, const void *q)
+/*
+ * Result of smoothing the run of triplets starting at a given index:
+ * the index past its end and, if any normals were merged, their sum.
+ */
+struct b_span
 {
-    const struct b_trip *tp = (const struct b_trip *) p;
-    const struct b_trip *tq = (const struct b_trip *) q;
+    int   l;
+    int   acc;
+    float N[3];
+};
 
-    if (tp->vi < tq->vi) return -1;
-    if (tp->vi > tq->vi) return +1;
-    if (tp->mi < tq->mi) return -1;
-    if (tp->mi > tq->mi) return +1;
+#define SMTH_THREADS 16
+#define SMTH_SPLIT   30000
 
-    return 0;
-}
+struct smth_work
+{
+    const struct s_base *fp;
 
-static void smth_file(struct mapc_context *ctx)
+    struct b_trip *T;
+    struct b_span *R;
+
+    int i0;
+    int i1;
+};
+
+/*
+ * Smooth the triplets in [i0, i1), which holds whole groups sharing
+ * vertex and material. Only reads the file, so ranges run in parallel.
+ */
+static void smth_range(const struct s_base *fp, struct b_trip *T,
+                       struct b_span *R, int i0, int i1)
 {
-    struct s_base *fp = &ctx->file;
-    struct b_trip temp, *T;
+    struct b_trip temp;
+    int i, j, k, l;
 
-    if (ctx->opt_debug == 0)
+    for (i = i0; i < i1; i = l)
     {
-        if ((T = (struct b_trip *) malloc(fp->gc * 3 * sizeof (struct b_trip))))
+        int acc = 0;
+
+        float N[3], angle = fp->mv[T[i].mi].angle;
+        const float   *Ni = fp->sv[T[i].si].n;
+
+        /* Sort the set by side similarity to the first. */
+
+        for (j = i + 1; j < i1 && (T[j].vi == T[i].vi &&
+                                   T[j].mi == T[i].mi); ++j)
         {
-            int gi, i, j, k, l, c = 0;
+            for (k = j + 1; k < i1 && (T[k].vi == T[i].vi &&
+                                       T[k].mi == T[i].mi); ++k)
+            {
+                const float *Nj = fp->sv[T[j].si].n;
+                const float *Nk = fp->sv[T[k].si].n;
+
+                if (T[j].si != T[k].si && v_dot(Nk, Ni) > v_dot(Nj, Ni))
+                {
+                    temp = T[k];
+                    T[k] = T[j];
+                    T[j] = temp;
+                }
+            }
+        }
 
-            /* Create a list of all non-faceted vertex triplets. */
+        /* Accumulate all similar side normals. */
 
-            for (gi = 0; gi < fp->gc; ++gi)
+        N[0] = Ni[0];
+        N[1] = Ni[1];
+        N[2] = Ni[2];
+
+        for (l = i + 1; l < i1 && (T[l].vi == T[i].vi &&
+                                   T[l].mi == T[i].mi); ++l)
+            if (T[l].si != T[i].si)
             {
-                struct b_geom *gp = fp->gv + gi;
-
-                T[c].vi = fp->ov[gp->oi].vi;
-                T[c].si = fp->ov[gp->oi].si;
-                T[c].mi = gp->mi;
-                T[c].gi = gi;
-                c++;
-
-                T[c].vi = fp->ov[gp->oj].vi;
-                T[c].si = fp->ov[gp->oj].si;
-                T[c].mi = gp->mi;
-                T[c].gi = gi;
-                c++;
-
-                T[c].vi = fp->ov[gp->ok].vi;
-                T[c].si = fp->ov[gp->ok].si;
-                T[c].mi = gp->mi;
-                T[c].gi = gi;
-                c++;
+                const float *Nl = fp->sv[T[l].si].n;
+                float deg = V_DEG(facosf(v_dot(Ni, Nl)));
+
+                if (ROUND(deg * 1000.0f) > ROUND(angle * 1000.0f))
+                    break;
+
+                N[0] += Nl[0];
+                N[1] += Nl[1];
+                N[2] += Nl[2];
+
+                acc++;
             }
 
-            /* Sort all triplets by vertex index and material. */
+        R[i].l   = l;
+        R[i].acc = acc;
 
-            qsort(T, c, sizeof (struct b_trip), comp_trip);
+        v_cpy(R[i].N, N);
+    }
+}
 
-            /* For each set of triplets sharing vertex index and material... */
+static void *smth_thread(void *data)
+{
+    struct smth_work *wp = (struct smth_work *) data;
 
-            for (i = 0; i < c; i = l)
-            {
-                int acc = 0;
+    smth_range(wp->fp, wp->T, wp->R, wp->i0, wp->i1);
 
-                float N[3], angle = fp->mv[T[i].mi].angle;
-                const float   *Ni = fp->sv[T[i].si].n;
+    return NULL;
+}
 
-                /* Sort the set by side similarity to the first. */
+/*
+ * Gather geom corners into triplets grouped by vertex and material, in
+ * geom order within each group. Corners are bucketed by material and
+ * then by vertex, both stable, so this takes linear time.
+ */
+static struct b_trip *smth_trips(struct mapc_context *ctx, int *n)
+{
+    struct s_base *fp = &ctx->file;
+    struct b_trip *T, *U;
 
-                for (j = i + 1; j < c && (T[j].vi == T[i].vi &&
-                                          T[j].mi == T[i].mi); ++j)
-                {
-                    for (k = j + 1; k < c && (T[k].vi == T[i].vi &&
-                                              T[k].mi == T[i].mi); ++k)
-                    {
-                        const float *Nj = fp->sv[T[j].si].n;
-                        const float *Nk = fp->sv[T[k].si].n;
-
-                        if (T[j].si != T[k].si && v_dot(Nk, Ni) > v_dot(Nj, Ni))
-                        {
-                            temp = T[k];
-                            T[k] = T[j];
-                            T[j] = temp;
-                        }
-                    }
-                }
+    int *count;
+    int  c = fp->gc * 3;
+    int  gi, i, m;
 
-                /* Accumulate all similar side normals. */
+    T = resize(ctx, NULL, sizeof (*T), 0, c, "trip");
+    U = resize(ctx, NULL, sizeof (*U), 0, c, "trip");
 
-                N[0] = Ni[0];
-                N[1] = Ni[1];
-                N[2] = Ni[2];
+    m     = MAX(fp->vc, fp->mc) + 1;
+    count = resize(ctx, NULL, sizeof (*count), 0, m, "trip");
 
-                for (l = i + 1; l < c && (T[l].vi == T[i].vi &&
-                                          T[l].mi == T[i].mi); ++l)
-                    if (T[l].si != T[i].si)
-                    {
-                        const float *Nl = fp->sv[T[l].si].n;
-                        float deg = V_DEG(facosf(v_dot(Ni, Nl)));
+    for (gi = 0; gi < fp->gc; ++gi)
+    {
+        const struct b_geom *gp = fp->gv + gi;
+        const int o[3] = { gp->oi, gp->oj, gp->ok };
 
-                        if (ROUND(deg * 1000.0f) > ROUND(angle * 1000.0f))
-                            break;
+        for (i = 0; i < 3; i++)
+        {
+            U[gi * 3 + i].vi = fp->ov[o[i]].vi;
+            U[gi * 3 + i].si = fp->ov[o[i]].si;
+            U[gi * 3 + i].mi = gp->mi;
+            U[gi * 3 + i].gi = gi;
+        }
+    }
 
-                        N[0] += Nl[0];
-                        N[1] += Nl[1];
-                        N[2] += Nl[2];
+    /* Bucket by material, U to T. */
 
-                        acc++;
-                    }
+    memset(count, 0, sizeof (*count) * m);
 
-                /* If at least two normals have been accumulated... */
+    for (i = 0; i < c; i++) count[U[i].mi + 1]++;
+    for (i = 1; i < m; i++) count[i] += count[i - 1];
+    for (i = 0; i < c; i++) T[count[U[i].mi]++] = U[i];
 
-                if (acc)
-                {
-                    /* Store the accumulated normal as a new side. */
+    /* Bucket by vertex, T to U. */
 
-                    int ss = incs(ctx);
+    memset(count, 0, sizeof (*count) * m);
 
-                    v_nrm(fp->sv[ss].n, N);
-                    fp->sv[ss].d = 0.0f;
+    for (i = 0; i < c; i++) count[T[i].vi + 1]++;
+    for (i = 1; i < m; i++) count[i] += count[i - 1];
+    for (i = 0; i < c; i++) U[count[T[i].vi]++] = T[i];
 
-                    /* Assign the new normal to the merged triplets. */
+    release(ctx, count, sizeof (*count), m);
+    release(ctx, T, sizeof (*T), c);
 
-                    for (j = i; j < l; ++j)
-                        T[j].si = ss;
-                }
-            }
+    *n = c;
+    return U;
+}
 
-            /* Assign the remapped normals to the original geoms. */
+static void smth_geoms(struct mapc_context *ctx)
+{
+    struct s_base *fp = &ctx->file;
 
-            for (i = 0; i < c; ++i)
-            {
-                struct b_geom *gp = fp->gv + T[i].gi;
-                struct b_offs *op = fp->ov + gp->oi;
-                struct b_offs *oq = fp->ov + gp->oj;
-                struct b_offs *or = fp->ov + gp->ok;
-
-                if (op->vi == T[i].vi) op->si = T[i].si;
-                if (oq->vi == T[i].vi) oq->si = T[i].si;
-                if (or->vi == T[i].vi) or->si = T[i].si;
-            }
+    struct b_trip *T;
+    struct b_span *R;
+
+    int i, j, k, c, n = 1;
+
+    /* Create a list of all non-faceted vertex triplets. */
+
+    T = smth_trips(ctx, &c);
+    R = resize(ctx, NULL, sizeof (*R), 0, c, "trip");
+
+    /* Smooth each group, on several threads for large files. */
+
+    if (c >= SMTH_SPLIT)
+        n = CLAMP(1, ctx->opt_threads, SMTH_THREADS);
+
+    if (n > 1)
+    {
+        struct smth_work work[SMTH_THREADS];
+        pthread_t        thrd[SMTH_THREADS];
+        int              made[SMTH_THREADS];
+
+        for (i = 0, j = 0; i < n; i++)
+        {
+            k = MAX(j, (int) ((double) c * (i + 1) / n));
+
+            /* Extend each range to a group boundary. */
+
+            while (k > 0 && k < c && T[k].vi == T[k - 1].vi
+                                  && T[k].mi == T[k - 1].mi)
+                k++;
+
+            work[i].fp = fp;
+            work[i].T  = T;
+            work[i].R  = R;
+            work[i].i0 = j;
+            work[i].i1 = k;
+
+            made[i] = (pthread_create(&thrd[i], NULL, smth_thread,
+                                      work + i) == 0);
+            j = k;
+        }
+
+        for (i = 0; i < n; i++)
+        {
+            if (made[i])
+                pthread_join(thrd[i], NULL);
+            else
+                smth_thread(work + i);
+        }
+    }
+    else
+        smth_range(fp, T, R, 0, c);
+
+    /* Store each accumulated normal as a new side, in group order. */
+
+    for (i = 0; i < c; i = R[i].l)
+        if (R[i].acc)
+        {
+            int ss = incs(ctx);
+
+            v_nrm(fp->sv[ss].n, R[i].N);
+            fp->sv[ss].d = 0.0f;
 
-            free(T);
+            /* Assign the new normal to the merged triplets. */
+
+            for (j = i; j < R[i].l; ++j)
+                T[j].si = ss;
         }
 
+    /* Assign the remapped normals to the original geoms. */
+
+    for (i = 0; i < c; ++i)
+    {
+        struct b_geom *gp = fp->gv + T[i].gi;
+        struct b_offs *op = fp->ov + gp->oi;
+        struct b_offs *oq = fp->ov + gp->oj;
+        struct b_offs *or = fp->ov + gp->ok;
+
+        if (op->vi == T[i].vi) op->si = T[i].si;
+        if (oq->vi == T[i].vi) oq->si = T[i].si;
+        if (or->vi == T[i].vi) or->si = T[i].si;
+    }
+
+    release(ctx, R, sizeof (*R), c);
+    release(ctx, T, sizeof (*T), c);
+}
+
+static void smth_file(struct mapc_context *ctx)
+{
+    if (ctx->opt_debug == 0)
+    {
+        if (ctx->file.gc > 0)
+            smth_geoms(ctx);
+
         uniq_side(ctx);
         uniq_offs(ctx);
     }
@@ -2842,6 +3610,7 @@ static int node_node(struct mapc_context *ctx, int l0, int lc, float bsphere[][4
         int sj  = 0;
         int sjd = lc;
         int sjo = lc;
+        int ni, nj;
         int si;
         int li = 0, lic = 0;
         int lj = 0, ljc = 0;
@@ -2942,10 +3711,14 @@ static int node_node(struct mapc_context *ctx, int l0, int lc, float bsphere[][4
 
         i = incn(ctx);
 
-        fp->nv[i].si = sj;
-        fp->nv[i].ni = node_node(ctx, li, lic, bsphere);
+        /* Recursion may move the node array. */
+
+        ni = node_node(ctx, li, lic, bsphere);
+        nj = node_node(ctx, lk, lkc, bsphere);
 
-        fp->nv[i].nj = node_node(ctx, lk, lkc, bsphere);
+        fp->nv[i].si = sj;
+        fp->nv[i].ni = ni;
+        fp->nv[i].nj = nj;
         fp->nv[i].l0 = lj;
         fp->nv[i].lc = ljc;
 
@@ -2999,9 +3772,12 @@ static void lump_bounding_sphere(struct s_base *fp,
 static void node_file(struct mapc_context *ctx)
 {
     struct s_base *fp = &ctx->file;
-    static float bsphere[MAXL][4];
+    float (*bsphere)[4];
     int i;
 
+    ctx->bsphere = resize(ctx, ctx->bsphere, sizeof (*ctx->bsphere), 0, MAX(fp->lc, 1), "lump");
+    bsphere = ctx->bsphere;
+
     /* Compute a bounding sphere for each lump. */
 
     for (i = 0; i < fp->lc; i++)
@@ -3074,6 +3850,10 @@ void mapc_dump(struct mapc_context *ctx)
     const char *name = STR(ctx->dst_path);
     double t = ctx->compile_time;
 
+    /* Peak memory held by the solid and working arrays, in KiB. */
+
+    unsigned long mem = (unsigned long) ((ctx->mem_peak + 1023) / 1024);
+
     struct s_base *p = &ctx->file;
     int i, j;
     int c = 0;
@@ -3099,7 +3879,7 @@ void mapc_dump(struct mapc_context *ctx)
         char msg[512];
         char buf[64];
 
-        sprintf(msg, "%s (%d/$%d) %.3f\n", name, n, c, t);
+        sprintf(msg, "%s (%d/$%d) %.3f %luK\n", name, n, c, t, mem);
 
         for (i = 0; i < ARRAYSIZE(stats); i++)
         {
@@ -3113,12 +3893,18 @@ void mapc_dump(struct mapc_context *ctx)
 
     if (ctx->opt_csv)
     {
-        printf("file,n,c,t,");
+        printf("file,n,c,t,mem,");
+
+        for (i = 0; ctx->opt_times && i < PASS_MAX; i++)
+            printf("t_%s,", pass_names[i]);
 
         for (i = 0; i < ARRAYSIZE(stats); i++)
             printf("%s%s", stats[i].name, (i + 1 < ARRAYSIZE(stats) ?
                                            "," : "\n"));
-        printf("%s,%d,%d,%.3f,", name, n, c, t);
+        printf("%s,%d,%d,%.3f,%lu,", name, n, c, t, mem);
+
+        for (i = 0; ctx->opt_times && i < PASS_MAX; i++)
+            printf("%.3f,", ctx->pass_time[i]);
 
         for (i = 0; i < ARRAYSIZE(stats); i++)
             printf("%d%s", *stats[i].ptr, (i + 1 < ARRAYSIZE(stats) ?
@@ -3128,7 +3914,7 @@ void mapc_dump(struct mapc_context *ctx)
     {
         const int COLS = 11;
 
-        printf("%s (%d/$%d) %.3f\n", name, n, c, t);
+        printf("%s (%d/$%d) %.3f %luK\n", name, n, c, t, mem);
 
         for (i = 0, j = 0; i < ARRAYSIZE(stats); i++)
         {
@@ -3144,6 +3930,21 @@ void mapc_dump(struct mapc_context *ctx)
                 printf("\n");
             }
         }
+
+        /* Pass times in milliseconds. */
+
+        if (ctx->opt_times)
+        {
+            for (i = 0; i < PASS_MAX; i++)
+                printf("%6.6s", pass_names[i]);
+
+            printf("\n");
+
+            for (i = 0; i < PASS_MAX; i++)
+                printf("%6d", (int) (ctx->pass_time[i] * 1000.0 + 0.5));
+
+            printf("\n");
+        }
     }
 }
 
@@ -3181,6 +3982,10 @@ int mapc_opts(struct mapc_context *ctx, int argc, char *argv[])
             ctx->opt_csv = 1;
             fs_set_logging(0);
         }
+        else if (strcmp(argv[argi], "--times") == 0)
+        {
+            ctx->opt_times = 1;
+        }
         else if (strcmp(argv[argi], "--bcast") == 0)
         {
 #if ENABLE_RADIANT_CONSOLE
@@ -3231,7 +4036,7 @@ int mapc_opts(struct mapc_context *ctx, int argc, char *argv[])
 
     if (!(ctx->opt_file && ctx->opt_data))
     {
-        fprintf(stderr, "Usage: %s <map> <data> [--debug] [--csv] [--data <dir>]\n", argv[0]);
+        fprintf(stderr, "Usage: %s <map> <data> [--debug] [--csv] [--times] [--data <dir>]\n", argv[0]);
         return 0;
     }
 
@@ -3240,17 +4045,41 @@ int mapc_opts(struct mapc_context *ctx, int argc, char *argv[])
 
 /*---------------------------------------------------------------------------*/
 
+static double get_time(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, 0);
+
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static void run_pass(struct mapc_context *ctx, int pass,
+                     void (*func)(struct mapc_context *))
+{
+    double t0 = get_time();
+    func(ctx);
+    ctx->pass_time[pass] += get_time() - t0;
+}
+
 static void mapc_compile_internal(struct mapc_context *ctx)
 {
     const char *src = STR(ctx->src_path);
     const char *dst = STR(ctx->dst_path);
 
-    struct timeval time0, time1;
-
-    gettimeofday(&time0, 0);
+    double time0 = get_time();
+    double t;
     {
         fs_file fin;
 
+        init_file(ctx);
+
+        add_dep(ctx, src);
+
+        io_lock(ctx);
+
+        t = get_time();
+
         if ((fin = fs_open_read(src)))
         {
             read_map(ctx, fin);
@@ -3264,23 +4093,28 @@ static void mapc_compile_internal(struct mapc_context *ctx)
             return;
         }
 
-        resolve(ctx);
-        targets(ctx);
+        ctx->pass_time[PASS_READ] = get_time() - t;
+
+        io_unlock(ctx);
+
+        run_pass(ctx, PASS_LINK, resolve);
+        run_pass(ctx, PASS_LINK, targets);
 
-        clip_file(ctx);
-        move_file(ctx);
-        uniq_file(ctx);
-        smth_file(ctx);
-        sort_file(ctx);
-        node_file(ctx);
+        run_pass(ctx, PASS_CLIP, clip_file);
+        run_pass(ctx, PASS_MOVE, move_file);
+        run_pass(ctx, PASS_UNIQ, uniq_file);
+        run_pass(ctx, PASS_SMTH, smth_file);
+        run_pass(ctx, PASS_SORT, sort_file);
+        run_pass(ctx, PASS_NODE, node_file);
+
+        t = get_time();
 
         if (dst && *dst)
             sol_stor_base(&ctx->file, dst);
-    }
-    gettimeofday(&time1, 0);
 
-    ctx->compile_time = (time1.tv_sec  - time0.tv_sec) +
-                        (time1.tv_usec - time0.tv_usec) / 1000000.0;
+        ctx->pass_time[PASS_STOR] = get_time() - t;
+    }
+    ctx->compile_time = get_time() - time0;
 }
 
 int mapc_compile(struct mapc_context *ctx)
@@ -3292,7 +4126,611 @@ int mapc_compile(struct mapc_context *ctx)
         return 1;
     }
 
+    if (ctx->io_locked)
+        io_unlock(ctx);
+
     return 0;
 }
 
 /*---------------------------------------------------------------------------*/
+
+/*
+ * Batch mode compiles many maps on a pool of threads, one context per
+ * map, and skips maps whose inputs are unchanged since the last batch.
+ * The inputs of each SOL (map, models, materials and textures) and
+ * their hashes are kept in a dependency cache in the data directory.
+ * The cache begins with a hash of the compiler itself, so that a new
+ * compiler recompiles everything.
+ */
+
+#define CACHE_FILE ".mapc-cache"
+
+enum
+{
+    JOB_TODO = 0,
+    JOB_CURRENT,
+    JOB_DONE,
+    JOB_FAIL
+};
+
+struct mapc_rec
+{
+    char  dst[MAXSTR];
+    Array deps;
+    int   used;
+};
+
+struct mapc_job
+{
+    const char *file;
+
+    char src[MAXSTR];
+    char dst[MAXSTR];
+
+    struct mapc_rec *rec;
+    Array deps;
+    int   status;
+    int   dir;                          /* Added its directory to the path   */
+};
+
+struct mapc_batch
+{
+    const char *data;
+    const char *cache;
+
+    unsigned int key[2];
+
+    int opt_debug;
+    int opt_csv;
+    int opt_times;
+    int opt_force;
+
+    struct mapc_job *jobs;
+    int job_n;
+    int job_i;
+
+    Array recs;
+
+    pthread_mutex_t mutex;
+};
+
+/*---------------------------------------------------------------------------*/
+
+static int cpu_count(void)
+{
+#ifdef _SC_NPROCESSORS_ONLN
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (n > 0)
+        return (int) n;
+#endif
+    return 1;
+}
+
+static unsigned long long hash_bytes(unsigned long long x,
+                                     const unsigned char *buf, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        x ^= buf[i];
+        x *= 0x100000001b3ULL;
+    }
+    return x;
+}
+
+/*
+ * Hash the named file with 64-bit FNV-1a. A missing file hashes to zero.
+ */
+static void hash_file(const char *path, unsigned int h[2])
+{
+    unsigned long long x = 0;
+    fs_file fin;
+
+    pthread_mutex_lock(&io_mutex);
+
+    if ((fin = fs_open_read(path)))
+    {
+        unsigned char buf[4096];
+        int n;
+
+        x = 0xcbf29ce484222325ULL;
+
+        while ((n = fs_read(buf, sizeof (buf), fin)) > 0)
+            x = hash_bytes(x, buf, n);
+
+        fs_close(fin);
+    }
+
+    pthread_mutex_unlock(&io_mutex);
+
+    h[0] = (unsigned int) (x >> 32);
+    h[1] = (unsigned int) (x);
+}
+
+/*
+ * Hash the running compiler, found by its system path.
+ */
+static void hash_self(const char *argv0, unsigned int h[2])
+{
+    const char *paths[] = { "/proc/self/exe", argv0 };
+
+    unsigned long long x = 0;
+    FILE *fp = NULL;
+    int i;
+
+    for (i = 0; i < ARRAYSIZE(paths) && !fp; i++)
+        if (paths[i])
+            fp = fopen(paths[i], "rb");
+
+    if (fp)
+    {
+        unsigned char buf[4096];
+        int n;
+
+        x = 0xcbf29ce484222325ULL;
+
+        while ((n = (int) fread(buf, 1, sizeof (buf), fp)) > 0)
+            x = hash_bytes(x, buf, n);
+
+        fclose(fp);
+    }
+
+    h[0] = (unsigned int) (x >> 32);
+    h[1] = (unsigned int) (x);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void cache_free(Array recs)
+{
+    int i;
+
+    for (i = 0; i < array_len(recs); i++)
+        array_free(((struct mapc_rec *) array_get(recs, i))->deps);
+
+    array_free(recs);
+}
+
+static Array cache_read(const char *name, const unsigned int key[2])
+{
+    Array recs = array_new(sizeof (struct mapc_rec));
+    struct mapc_rec *rp = NULL;
+
+    char line[MAXSTR * 2];
+    char head[MAXSTR];
+    fs_file fin;
+
+    sprintf(head, "mapc %08x%08x", key[0], key[1]);
+
+    if ((fin = fs_open_read(name)))
+    {
+        /* Records made by another compiler are all stale. */
+
+        if (fs_gets(line, sizeof (line), fin))
+        {
+            strip_newline(line);
+
+            if (strcmp(line, head) != 0)
+            {
+                fs_close(fin);
+                return recs;
+            }
+        }
+
+        while (fs_gets(line, sizeof (line), fin))
+        {
+            struct mapc_dep *dp;
+            unsigned int h0, h1;
+
+            strip_newline(line);
+
+            /* "sol <count> <path>" begins a record... */
+
+            if (strncmp(line, "sol ", 4) == 0)
+            {
+                const char *p = strchr(line + 4, ' ');
+
+                if (p && (rp = array_add(recs)))
+                {
+                    memset(rp, 0, sizeof (*rp));
+                    SAFECPY(rp->dst, p + 1);
+                    rp->deps = array_new(sizeof (struct mapc_dep));
+                }
+            }
+
+            /* ...followed by "<hash> <path>" for each input. */
+
+            else if (rp && sscanf(line, "%8x%8x", &h0, &h1) == 2 &&
+                     strlen(line) > 17 && line[16] == ' ')
+            {
+                if ((dp = array_add(rp->deps)))
+                {
+                    SAFECPY(dp->path, line + 17);
+                    dp->hash[0] = h0;
+                    dp->hash[1] = h1;
+                }
+            }
+        }
+        fs_close(fin);
+    }
+    return recs;
+}
+
+static void cache_write_rec(fs_file fout, const char *dst, Array deps)
+{
+    int i;
+
+    fs_printf(fout, "sol %d %s\n", array_len(deps), dst);
+
+    for (i = 0; i < array_len(deps); i++)
+    {
+        const struct mapc_dep *dp = array_get(deps, i);
+
+        fs_printf(fout, "%08x%08x %s\n", dp->hash[0], dp->hash[1], dp->path);
+    }
+}
+
+static void cache_write(struct mapc_batch *b)
+{
+    char tmp[MAXSTR];
+    fs_file fout;
+    int i;
+
+    SAFECPY(tmp, b->cache);
+    SAFECAT(tmp, ".tmp");
+
+    if ((fout = fs_open_write(tmp)))
+    {
+        fs_printf(fout, "mapc %08x%08x\n", b->key[0], b->key[1]);
+
+        /* Write the records of this batch. */
+
+        for (i = 0; i < b->job_n; i++)
+        {
+            struct mapc_job *job = &b->jobs[i];
+
+            if (job->status == JOB_DONE)
+                cache_write_rec(fout, job->dst, job->deps);
+
+            if (job->status == JOB_CURRENT)
+                cache_write_rec(fout, job->dst, job->rec->deps);
+        }
+
+        /* Keep the records of maps not in this batch. */
+
+        for (i = 0; i < array_len(b->recs); i++)
+        {
+            struct mapc_rec *rp = array_get(b->recs, i);
+
+            if (!rp->used)
+                cache_write_rec(fout, rp->dst, rp->deps);
+        }
+
+        fs_close(fout);
+
+        if (fs_rename(tmp, b->cache) != 0)
+            fs_remove(tmp);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Check whether a job's output exists and its inputs are unchanged.
+ */
+static int job_current(struct mapc_job *job)
+{
+    unsigned int h[2];
+    fs_file fin;
+    int i;
+
+    if (!job->rec)
+        return 0;
+
+    pthread_mutex_lock(&io_mutex);
+    {
+        if ((fin = fs_open_read(job->dst)))
+            fs_close(fin);
+    }
+    pthread_mutex_unlock(&io_mutex);
+
+    if (!fin)
+        return 0;
+
+    for (i = 0; i < array_len(job->rec->deps); i++)
+    {
+        const struct mapc_dep *dp = array_get(job->rec->deps, i);
+
+        hash_file(dp->path, h);
+
+        if (h[0] != dp->hash[0] || h[1] != dp->hash[1])
+            return 0;
+    }
+
+    return array_len(job->rec->deps) > 0;
+}
+
+static void job_run(struct mapc_batch *b, struct mapc_job *job)
+{
+    struct mapc_context *ctx = NULL;
+    int i;
+
+    if (!b->opt_force && job_current(job))
+    {
+        job->status = JOB_CURRENT;
+        return;
+    }
+
+    if (!mapc_init(&ctx))
+    {
+        job->status = JOB_FAIL;
+        return;
+    }
+
+    ctx->opt_file  = job->file;
+    ctx->opt_data  = b->data;
+    ctx->opt_debug = b->opt_debug;
+    ctx->opt_csv   = b->opt_csv;
+    ctx->opt_times = b->opt_times;
+    ctx->opt_threads = 1;
+    ctx->src_path  = strbuf(job->src);
+    ctx->dst_path  = strbuf(job->dst);
+    ctx->deps      = array_new(sizeof (struct mapc_dep));
+
+    if (mapc_compile(ctx))
+    {
+        for (i = 0; i < array_len(ctx->deps); i++)
+        {
+            struct mapc_dep *dp = array_get(ctx->deps, i);
+            hash_file(dp->path, dp->hash);
+        }
+
+        job->deps   = ctx->deps;
+        job->status = JOB_DONE;
+
+        ctx->deps = NULL;
+
+        pthread_mutex_lock(&out_mutex);
+        {
+            mapc_dump(ctx);
+            fflush(stdout);
+        }
+        pthread_mutex_unlock(&out_mutex);
+    }
+    else
+    {
+        pthread_mutex_lock(&out_mutex);
+        {
+            fprintf(stderr, "%s: compile failed\n", job->file);
+        }
+        pthread_mutex_unlock(&out_mutex);
+
+        job->status = JOB_FAIL;
+    }
+
+    mapc_quit(&ctx);
+}
+
+static void *job_thread(void *data)
+{
+    struct mapc_batch *b = (struct mapc_batch *) data;
+
+    for (;;)
+    {
+        struct mapc_job *job = NULL;
+
+        pthread_mutex_lock(&b->mutex);
+        {
+            if (b->job_i < b->job_n)
+                job = &b->jobs[b->job_i++];
+        }
+        pthread_mutex_unlock(&b->mutex);
+
+        if (!job)
+            break;
+
+        job_run(b, job);
+    }
+    return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Name a job's map by its path within the data directory, if it is there.
+ */
+static int job_path(struct mapc_job *job, const char *data, const char *file)
+{
+    size_t n = strlen(data);
+
+    while (n > 0 && (data[n - 1] == '/' || data[n - 1] == '\\'))
+        n--;
+
+    if (strncmp(file, data, n) == 0 && (file[n] == '/' || file[n] == '\\'))
+    {
+        SAFECPY(job->src, file + n + 1);
+        SAFECPY(job->dst, job->src);
+
+        if (str_ends_with(job->dst, ".map"))
+            job->dst[strlen(job->dst) - 4] = 0;
+
+        SAFECAT(job->dst, ".sol");
+        return 1;
+    }
+    return 0;
+}
+
+static int batch_jobs(struct mapc_batch *b, char **files, int n)
+{
+    int i;
+
+    if (!(b->jobs = calloc(MAX(n, 1), sizeof (*b->jobs))))
+        return 0;
+
+    for (i = 0; i < n; i++)
+    {
+        struct mapc_job *job = &b->jobs[b->job_n];
+
+        if (!job_path(job, b->data, files[i]))
+        {
+            fprintf(stderr, "%s: not in data directory %s\n", files[i], b->data);
+            continue;
+        }
+
+        job->file = files[i];
+
+        /* Maps may refer to files next to them. Add each directory once. */
+
+        job->dir = fs_add_path(DIR_NAME(files[i]));
+
+        b->job_n++;
+    }
+    return b->job_n == n;
+}
+
+static void batch_recs(struct mapc_batch *b)
+{
+    int i, j;
+
+    b->recs = cache_read(b->cache, b->key);
+
+    for (i = 0; i < b->job_n; i++)
+        for (j = 0; j < array_len(b->recs); j++)
+        {
+            struct mapc_rec *rp = array_get(b->recs, j);
+
+            if (strcmp(rp->dst, b->jobs[i].dst) == 0)
+            {
+                b->jobs[i].rec = rp;
+                rp->used = 1;
+                break;
+            }
+        }
+}
+
+int mapc_batch(int argc, char *argv[])
+{
+    struct mapc_batch b;
+
+    pthread_t *threads;
+    char **files;
+    int jobs = 0;
+    int i, n = 0, t = 0;
+    int counts[4] = { 0, 0, 0, 0 };
+    int ok;
+
+    memset(&b, 0, sizeof (b));
+
+    b.cache = CACHE_FILE;
+
+    if (!(files = calloc(argc, sizeof (*files))))
+        return 0;
+
+    for (i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--batch") == 0)
+        {
+            if (++i < argc)
+                b.data = argv[i];
+        }
+        else if (strcmp(argv[i], "--jobs") == 0)
+        {
+            if (++i < argc)
+                jobs = atoi(argv[i]);
+        }
+        else if (strcmp(argv[i], "--cache") == 0)
+        {
+            if (++i < argc)
+                b.cache = argv[i];
+        }
+        else if (strcmp(argv[i], "--force") == 0)
+            b.opt_force = 1;
+        else if (strcmp(argv[i], "--debug") == 0)
+            b.opt_debug = 1;
+        else if (strcmp(argv[i], "--csv") == 0)
+        {
+            b.opt_csv = 1;
+            fs_set_logging(0);
+        }
+        else if (strcmp(argv[i], "--times") == 0)
+            b.opt_times = 1;
+        else if (strcmp(argv[i], "--data") == 0)
+        {
+            if (++i < argc)
+                fs_add_path(argv[i]);
+        }
+        else
+            files[n++] = argv[i];
+    }
+
+    if (!b.data)
+    {
+        fprintf(stderr, "Usage: %s --batch <data> [--jobs <n>] [--cache <file>]"
+                " [--force] [--debug] [--csv] [--times] [--data <dir>]"
+                " <map> ...\n",
+                argv[0]);
+        free(files);
+        return 0;
+    }
+
+    fs_set_write_dir(b.data);
+
+    hash_self(argv[0], b.key);
+
+    ok = batch_jobs(&b, files, n);
+
+    fs_add_path_with_archives(b.data);
+
+    batch_recs(&b);
+
+    /* Run the jobs on a pool of threads, or here if threads fail. */
+
+    if (jobs < 1)
+        jobs = cpu_count();
+
+    jobs = MIN(jobs, b.job_n);
+
+    pthread_mutex_init(&b.mutex, NULL);
+
+    if ((threads = calloc(MAX(jobs, 1), sizeof (*threads))))
+        for (t = 0; t < jobs - 1; t++)
+            if (pthread_create(&threads[t], NULL, job_thread, &b) != 0)
+                break;
+
+    job_thread(&b);
+
+    for (i = 0; i < t; i++)
+        pthread_join(threads[i], NULL);
+
+    free(threads);
+
+    pthread_mutex_destroy(&b.mutex);
+
+    /* Record the inputs of the compiled maps and summarize. */
+
+    cache_write(&b);
+
+    for (i = 0; i < b.job_n; i++)
+    {
+        counts[b.jobs[i].status]++;
+
+        if (b.jobs[i].deps)
+            array_free(b.jobs[i].deps);
+
+        if (b.jobs[i].dir)
+            fs_remove_path(DIR_NAME(b.jobs[i].file));
+    }
+
+    printf("%d compiled, %d up to date, %d failed (%d threads)\n",
+           counts[JOB_DONE], counts[JOB_CURRENT], counts[JOB_FAIL], t + 1);
+
+    cache_free(b.recs);
+    free(b.jobs);
+    free(files);
+
+    return ok && counts[JOB_FAIL] == 0;
+}
+
+/*---------------------------------------------------------------------------*/
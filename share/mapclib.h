@@ -17,4 +17,6 @@ int mapc_compile(mapc_context ctx);
 
 void mapc_dump(mapc_context ctx);
 
+int mapc_batch(int argc, char *argv[]);
+
 #endif
@@ -19,6 +19,7 @@
 #include "array.h"
 #include "common.h"
 #include "image.h"
+#include "image_cache.h"
 #include "lang.h"
 #include "log.h"
 
@@ -125,7 +126,7 @@ static void load_mtrl_objects(struct mtrl *mp)
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
     }
     else
-        log_printf("Failed to load texture \"%s\"\n", _(mp->base.f));
+        log_message(LOG_WARN, "Failed to load texture \"%s\"\n", _(mp->base.f));
 }
 
 /*
@@ -262,6 +263,8 @@ void mtrl_cache_sol(struct s_base *fp)
         for (mi = 0; mi < fp->mc; mi++)
             fp->mtrls[mi] = mtrl_cache(&fp->mv[mi]);
     }
+
+    image_cache_report();
 }
 
 /*
@@ -305,6 +308,8 @@ void mtrl_reload(void)
                 load_mtrl(mp, &base);
             }
         }
+
+        image_cache_report();
     }
 }
 
@@ -322,6 +327,8 @@ void mtrl_load_objects(void)
         if (mp->refc > 0)
             load_mtrl_objects(mp);
     }
+
+    image_cache_report();
 }
 
 /*
@@ -15,9 +15,12 @@
 #include "package.h"
 #include "array.h"
 #include "common.h"
+#include "config.h"
 #include "fetch.h"
 #include "fs.h"
 #include "lang.h"
+#include "log.h"
+#include "pool.h"
 
 enum package_image_status
 {
@@ -36,6 +39,7 @@ struct package
     char name[64];
     char desc[MAXSTR];
     char shot[64];
+    char sha256[SHA256_HEX];
 
     enum package_status status;
     enum package_image_status image_status;
@@ -58,14 +62,27 @@ static const char *get_package_url(const char *filename)
     {
         static char url[MAXSTR];
 
+        const char *base = config_get_s(CONFIG_PACKAGE_URL);
+
         memset(url, 0, sizeof (url));
 
+        if (base && *base)
+        {
+            /* Configured mirror, such as a local test server. */
+            SAFECPY(url, base);
+
+            if (url[strlen(url) - 1] != '/')
+                SAFECAT(url, "/");
+        }
+        else
+        {
 #ifdef __EMSCRIPTEN__
-        /* Same origin. */
-        SAFECPY(url, "packages/");
+            /* Same origin. */
+            SAFECPY(url, "packages/");
 #else
-        SAFECPY(url, "https://play.neverball.org/packages/");
+            SAFECPY(url, "https://play.neverball.org/packages/");
 #endif
+        }
         SAFECAT(url, filename);
 
         return url;
@@ -105,6 +122,8 @@ struct local_package
 {
     char id[64];
     char filename[MAXSTR];
+
+    void *archive;                      /* Opened ahead of mounting          */
 };
 
 static List installed_packages;
@@ -132,9 +151,9 @@ static void free_local_package(struct local_package **lpkg)
 }
 
 /*
- * Add package file to FS path.
+ * Add package file to FS path, using its ARCHIVE if opened ahead.
  */
-static int mount_package_file(const char *filename)
+static int mount_package_file(const char *filename, void *archive)
 {
     const char *write_dir = fs_get_write_dir();
     int added = 0;
@@ -145,13 +164,16 @@ static int mount_package_file(const char *filename)
 
         if (path)
         {
-            added = fs_add_path(path);
+            added = archive ? fs_add_archive(path, archive) : fs_add_path(path);
+            archive = NULL;
 
             free(path);
             path = NULL;
         }
     }
 
+    fs_close_archive(archive);
+
     return added;
 }
 
@@ -216,9 +238,12 @@ static int save_installed_packages(void);
 /*
  * Add a package to the FS path and to the list, if not yet added.
  */
-static int mount_local_package(struct local_package *lpkg)
+static int mount_local_package(struct local_package *lpkg, void *archive)
 {
-    if (lpkg && mount_package_file(lpkg->filename))
+    if (!lpkg)
+        fs_close_archive(archive);
+
+    else if (mount_package_file(lpkg->filename, archive))
     {
         installed_packages = list_cons(lpkg, installed_packages);
         unmount_duplicate_local_packages(lpkg);
@@ -229,6 +254,32 @@ static int mount_local_package(struct local_package *lpkg)
     return 0;
 }
 
+/*
+ * Open the archive of installed package I, on a pool thread.
+ */
+static void open_local_package(void *data, int i)
+{
+    const char *write_dir = fs_get_write_dir();
+
+    Array pkgs = data;
+    struct local_package *lpkg = array_get(pkgs, i);
+
+    lpkg->archive = NULL;
+
+    if (*lpkg->filename && write_dir)
+    {
+        char *path = concat_string(write_dir, "/" PACKAGE_DIR "/", lpkg->filename, NULL);
+
+        if (path)
+        {
+            lpkg->archive = fs_open_archive(path);
+
+            free(path);
+            path = NULL;
+        }
+    }
+}
+
 /*
  * Load the list of installed packages.
  */
@@ -283,12 +334,16 @@ static int load_installed_packages(void)
             }
         }
 
+        /* Read the package archives at once, then mount them in order. */
+
+        pool_run(array_len(pkgs), open_local_package, pkgs);
+
         for (i = 0, n = array_len(pkgs); i < n; ++i)
         {
             const struct local_package *src = array_get(pkgs, i);
             struct local_package *dst = create_local_package(src->id, src->filename);
 
-            if (!mount_local_package(dst))
+            if (!mount_local_package(dst, src->archive))
                 free_local_package(&dst);
         }
 
@@ -478,6 +533,11 @@ static Array load_packages_from_file(const char *filename)
                 if (pkg)
                     SAFECPY(pkg->shot, line + 5);
             }
+            else if (strncmp(line, "sha256 ", 7) == 0)
+            {
+                if (pkg)
+                    SAFECPY(pkg->sha256, line + 7);
+            }
         }
 
         fs_close(fp);
@@ -944,6 +1004,32 @@ static void package_fetch_progress(void *data, void *data2)
     }
 }
 
+/*
+ * Check a downloaded package against the manifest hash. A package
+ * without one is never mounted.
+ */
+static int package_verify(struct package_fetch_info *pfi, struct fetch_done *dn)
+{
+    char hex[SHA256_HEX];
+
+    if (!pfi->pkg->sha256[0])
+    {
+        log_printf("Package %s has no hash\n", pfi->pkg->id);
+        return 0;
+    }
+
+    /* Hash the file if the transfer did not do it on the way in. */
+
+    if (!dn->sha256[0])
+    {
+        if (!sha256_file(pfi->temp_filename, hex))
+            return 0;
+    }
+    else SAFECPY(hex, dn->sha256);
+
+    return strcmp(hex, pfi->pkg->sha256) == 0;
+}
+
 /*
  * Add downloaded package to FS.
  */
@@ -959,7 +1045,15 @@ static void package_fetch_done(void *data, void *extra_data)
         /* Always prepare for worst. */
         pkg->status = PACKAGE_ERROR;
 
-        if (dn->success)
+        if (dn->success && !package_verify(pfi, dn))
+        {
+            /* Never mount it, and don't resume from it either. */
+
+            log_printf("Package %s failed verification\n", pkg->id);
+
+            fs_remove(pfi->temp_filename);
+        }
+        else if (dn->success)
         {
             struct local_package *lpkg = create_local_package(pkg->id, pkg->filename);
 
@@ -972,7 +1066,7 @@ static void package_fetch_done(void *data, void *extra_data)
 
             if (lpkg)
             {
-                if (mount_local_package(lpkg))
+                if (mount_local_package(lpkg, NULL))
                     pkg->status = PACKAGE_INSTALLED;
                 else
                     free_local_package(&lpkg);
@@ -1015,7 +1109,13 @@ unsigned int package_fetch(int pi, struct fetch_callback callback)
                 callback.done = package_fetch_done;
                 callback.data = pfi;
 
-                fetch_id = fetch_file(url, pfi->temp_filename, callback);
+                /* Only a known hash makes a partial file safe to resume. */
+
+                if (pkg->sha256[0])
+                    fetch_id = fetch_file_resume(url, pfi->temp_filename,
+                                                 pkg->sha256, callback);
+                else
+                    fetch_id = fetch_file(url, pfi->temp_filename, callback);
 
                 if (fetch_id)
                 {
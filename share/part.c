@@ -23,6 +23,7 @@
 #include "vec3.h"
 #include "image.h"
 #include "geom.h"
+#include "inst.h"
 #include "hmd.h"
 #include "video.h"
 
@@ -220,12 +221,81 @@ void part_step(const float *g, float dt)
 
 /*---------------------------------------------------------------------------*/
 
-void part_draw_coin(const struct s_draw *draw, struct s_rend *rend, const float *M, float t)
+/*
+ * Queue the live coin particles as instances under view V. Return false
+ * if there are none or too many.
+ */
+static int part_inst_coin(const float *M, const float *V, float t)
+{
+    static const float z[3] = { 0.0f, 0.0f, 1.0f };
+    static const float k[3] = { PART_SIZE * 2.0f, PART_SIZE * 2.0f, 1.0f };
+
+    float T[16], U[16], S[16], c[4];
+    int i, n = 0;
+
+    inst_begin(V);
+
+    for (i = 0; i < PART_MAX_COIN; ++i)
+        if (coin_part[i].t > 0.0f)
+        {
+            m_xlt(T, coin_part[i].p);
+
+            if (M)
+            {
+                m_mult(U, T, M);
+                m_cpy(T, U);
+            }
+
+            m_scl(U, k);
+            m_mult(S, T, U);
+            m_rot(U, z, V_RAD(t * coin_part[i].w));
+            m_mult(T, S, U);
+
+            c[0] = coin_part[i].c[0];
+            c[1] = coin_part[i].c[1];
+            c[2] = coin_part[i].c[2];
+            c[3] = coin_part[i].t;
+
+            if (!inst_add(T, c))
+                return 0;
+
+            n++;
+        }
+
+    return n;
+}
+
+void part_draw_coin(const struct s_draw *draw, struct s_rend *rend,
+                    const float *M, const float *V, float t)
 {
     int i;
 
     r_apply_mtrl(rend, coin_mtrl);
 
+    /* Draw all coin particles at once if we can. */
+
+    if (inst_ready() && part_inst_coin(M, V, t) && inst_bind())
+    {
+        glBindBuffer_(GL_ARRAY_BUFFER, coin_vbo);
+        glBindBuffer_(GL_ELEMENT_ARRAY_BUFFER, coin_ebo);
+
+        glDisableClientState(GL_NORMAL_ARRAY);
+        {
+            glVertexPointer  (3, GL_FLOAT, sizeof (GLfloat) * 5, (GLvoid *) (                   0u));
+            glTexCoordPointer(2, GL_FLOAT, sizeof (GLfloat) * 5, (GLvoid *) (sizeof (GLfloat) * 3u));
+
+            glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+            inst_draw_elements(rend, GL_TRIANGLE_STRIP, 4, GL_UNSIGNED_SHORT, (GLvoid *) 0u);
+        }
+        glEnableClientState(GL_NORMAL_ARRAY);
+
+        glBindBuffer_(GL_ARRAY_BUFFER, 0);
+        glBindBuffer_(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+        inst_unbind();
+        return;
+    }
+
     glBindBuffer_(GL_ARRAY_BUFFER, coin_vbo);
     glBindBuffer_(GL_ELEMENT_ARRAY_BUFFER, coin_ebo);
 
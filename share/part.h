@@ -20,7 +20,8 @@ void part_free(void);
 void part_burst(const float *, const float *);
 void part_step(const float *, float);
 
-void part_draw_coin(const struct s_draw *draw, struct s_rend *rend, const float *M, float t);
+void part_draw_coin(const struct s_draw *draw, struct s_rend *rend,
+                    const float *M, const float *V, float t);
 
 void part_lerp_apply(float);
 
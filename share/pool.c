@@ -0,0 +1,290 @@
+/*
+ * Copyright (C) 2014 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+#include <SDL.h>
+
+#include "pool.h"
+#include "common.h"
+#include "fs.h"
+#include "log.h"
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * A parallel loop for loading many small files. Helper threads live only
+ * for the duration of one call. Each takes the next index in turn, and
+ * the caller keeps results by index, so that their order does not depend
+ * on which thread finished first.
+ *
+ * Once the pool is initialized, lookups and changes of the file system
+ * read path take turns at a lock. Files may then be read off the main
+ * thread anywhere, not only here.
+ */
+
+#define POOL_THREADS 4                  /* Most threads, the caller included */
+
+struct pool
+{
+    void (*func)(void *, int);
+    void  *data;
+    int    n;
+
+    SDL_atomic_t next;
+};
+
+static SDL_mutex *pool_mutex;
+
+static void pool_lock(int lock)
+{
+    if (lock)
+        SDL_LockMutex(pool_mutex);
+    else
+        SDL_UnlockMutex(pool_mutex);
+}
+
+static int pool_func(void *data)
+{
+    struct pool *pool = data;
+    int i;
+
+    while ((i = SDL_AtomicAdd(&pool->next, 1)) < pool->n)
+        pool->func(pool->data, i);
+
+    return 0;
+}
+
+void pool_init(void)
+{
+    if (!pool_mutex && (pool_mutex = SDL_CreateMutex()))
+        fs_set_lock(pool_lock);
+}
+
+void pool_quit(void)
+{
+    if (pool_mutex)
+    {
+        fs_set_lock(NULL);
+
+        SDL_DestroyMutex(pool_mutex);
+        pool_mutex = NULL;
+    }
+}
+
+/*
+ * Tell whether files may be read off the main thread.
+ */
+int pool_ready(void)
+{
+    return pool_mutex != NULL;
+}
+
+/*
+ * Call FUNC (DATA, I) for each I from 0 to N - 1, on a few threads if the
+ * pool is initialized, and return once all calls have returned.
+ */
+void pool_run(int n, void (*func)(void *, int), void *data)
+{
+    SDL_Thread *thread[POOL_THREADS - 1];
+    struct pool pool;
+    int i, m = 0;
+
+    pool.func = func;
+    pool.data = data;
+    pool.n    = n;
+
+    SDL_AtomicSet(&pool.next, 0);
+
+    if (pool_mutex)
+        for (i = 0; i < MIN(n, CLAMP(1, SDL_GetCPUCount(), POOL_THREADS)) - 1; i++)
+            if ((thread[m] = SDL_CreateThread(pool_func, "pool", &pool)))
+                m++;
+
+    pool_func(&pool);
+
+    for (i = 0; i < m; i++)
+        SDL_WaitThread(thread[i], NULL);
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * A worker is a queue of jobs and a few threads that run them, started on
+ * first use and stopped on request. If its threads cannot be started, it
+ * says so once and runs each job on the caller's thread from then on.
+ */
+
+static int worker_func(void *data)
+{
+    struct worker *w = data;
+    void *job;
+
+    for (;;)
+    {
+        SDL_LockMutex(w->mutex);
+        {
+            while (queue_empty(w->queue) && !w->stop)
+                SDL_CondWait(w->cond, w->mutex);
+
+            if ((job = queue_deq(w->queue)))
+                w->queued--;
+
+            /* Wake anyone waiting for room in the queue. */
+
+            SDL_CondBroadcast(w->cond);
+        }
+        SDL_UnlockMutex(w->mutex);
+
+        if (!job)
+            break;
+
+        w->func(job);
+
+        /* Wake anyone waiting for the result. */
+
+        SDL_LockMutex(w->mutex);
+        SDL_CondBroadcast(w->cond);
+        SDL_UnlockMutex(w->mutex);
+    }
+    return 0;
+}
+
+/*
+ * Start N threads, unless already started. Return false if jobs will be
+ * run on the caller's thread instead.
+ */
+int worker_start(struct worker *w, int n)
+{
+    int i;
+
+    if (w->threads || w->failed)
+        return w->threads > 0;
+
+    w->mutex  = SDL_CreateMutex();
+    w->cond   = SDL_CreateCond();
+    w->queue  = queue_new();
+    w->queued = 0;
+    w->stop   = 0;
+
+    if (w->mutex && w->cond && w->queue)
+        for (i = 0; i < CLAMP(1, n, WORKER_THREADS); i++)
+            if ((w->thread[w->threads] = SDL_CreateThread(worker_func,
+                                                          w->name, w)))
+                w->threads++;
+
+    if (!w->threads)
+    {
+        log_printf("Failure to start %s thread (%s)\n", w->name,
+                   SDL_GetError());
+
+        if (w->queue) queue_free(w->queue);
+        if (w->cond)  SDL_DestroyCond(w->cond);
+        if (w->mutex) SDL_DestroyMutex(w->mutex);
+
+        w->queue = NULL;
+        w->cond  = NULL;
+        w->mutex = NULL;
+
+        w->failed = 1;
+    }
+    return w->threads > 0;
+}
+
+/*
+ * Stop the threads once all jobs are done, or hand the jobs not yet begun
+ * to DISCARD if given.
+ */
+void worker_stop(struct worker *w, void (*discard)(void *))
+{
+    void *job;
+    int i;
+
+    if (!w->threads)
+        return;
+
+    SDL_LockMutex(w->mutex);
+    {
+        if (discard)
+            while ((job = queue_deq(w->queue)))
+            {
+                w->queued--;
+                discard(job);
+            }
+
+        w->stop = 1;
+        SDL_CondBroadcast(w->cond);
+    }
+    SDL_UnlockMutex(w->mutex);
+
+    for (i = 0; i < w->threads; i++)
+        SDL_WaitThread(w->thread[i], NULL);
+
+    w->threads = 0;
+
+    queue_free(w->queue);
+    SDL_DestroyCond(w->cond);
+    SDL_DestroyMutex(w->mutex);
+
+    w->queue = NULL;
+    w->cond  = NULL;
+    w->mutex = NULL;
+}
+
+/*
+ * Queue a job, first waiting for room if the worker has a limit. Without
+ * threads, run it right away.
+ */
+void worker_put(struct worker *w, void *job)
+{
+    if (w->threads)
+    {
+        SDL_LockMutex(w->mutex);
+        {
+            while (w->limit && w->queued >= w->limit)
+                SDL_CondWait(w->cond, w->mutex);
+
+            queue_enq(w->queue, job);
+            w->queued++;
+
+            SDL_CondBroadcast(w->cond);
+        }
+        SDL_UnlockMutex(w->mutex);
+    }
+    else w->func(job);
+}
+
+/*
+ * Guard state shared with jobs. These do nothing without threads.
+ */
+void worker_lock(struct worker *w)
+{
+    if (w->mutex)
+        SDL_LockMutex(w->mutex);
+}
+
+void worker_unlock(struct worker *w)
+{
+    if (w->mutex)
+        SDL_UnlockMutex(w->mutex);
+}
+
+/*
+ * With the lock held, wait until a job is taken or finished.
+ */
+void worker_wait(struct worker *w)
+{
+    if (w->cond)
+        SDL_CondWait(w->cond, w->mutex);
+}
+
+/*---------------------------------------------------------------------------*/
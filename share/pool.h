@@ -0,0 +1,52 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <SDL.h>
+
+#include "queue.h"
+
+/*---------------------------------------------------------------------------*/
+
+void pool_init(void);
+void pool_quit(void);
+int  pool_ready(void);
+
+void pool_run(int, void (*)(void *, int), void *);
+
+/*---------------------------------------------------------------------------*/
+
+#define WORKER_THREADS 4
+
+/*
+ * A queue of jobs run in the background. Set the first three fields and
+ * leave the rest zero. FUNC is given each job, and frees it.
+ */
+
+struct worker
+{
+    const char *name;
+    void      (*func)(void *);
+    int         limit;                  /* Most jobs waiting, or no limit    */
+
+    SDL_Thread *thread[WORKER_THREADS];
+    SDL_mutex  *mutex;
+    SDL_cond   *cond;
+    Queue       queue;
+
+    int threads;
+    int queued;
+    int stop;
+    int failed;                         /* Threads could not be started      */
+};
+
+int  worker_start(struct worker *, int);
+void worker_stop (struct worker *, void (*)(void *));
+void worker_put  (struct worker *, void *);
+
+void worker_lock  (struct worker *);
+void worker_unlock(struct worker *);
+void worker_wait  (struct worker *);
+
+/*---------------------------------------------------------------------------*/
+
+#endif
@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2003-2010 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stddef.h>
+
+/*---------------------------------------------------------------------------*/
+
+#define SHA256_BYTES 32
+#define SHA256_HEX   (SHA256_BYTES * 2 + 1)
+
+struct sha256
+{
+    unsigned int       h[8];
+    unsigned long long n;                       /* Bytes hashed              */
+    unsigned char      buf[64];
+};
+
+void sha256_init  (struct sha256 *);
+void sha256_update(struct sha256 *, const void *, size_t);
+void sha256_final (struct sha256 *, char hex[SHA256_HEX]);
+
+int  sha256_file(const char *path, char hex[SHA256_HEX]);
+
+/*---------------------------------------------------------------------------*/
+
+#endif
@@ -15,6 +15,10 @@
 
 /* Random code used in more than one place. */
 
+#include <limits.h>
+#include <string.h>
+#include <math.h>
+
 #include "solid_all.h"
 #include "solid_vary.h"
 
@@ -171,7 +175,26 @@ static struct vec4 get_path_rot(const struct s_vary *vary, int pi, float dt)
 }
 
 /*
- * Recalculate mover transform if necessary.
+ * Fill the look-ahead table entry of mover MI. Entries of parent movers
+ * are filled on demand, so the table is correct in any order, but the
+ * parent-first order means each entry is computed exactly once.
+ */
+static void get_move_ahead(const struct s_vary *vary, int mi, float dt)
+{
+    struct v_ahead *ap = vary->ahead;
+
+    if (!ap->done[mi])
+    {
+        ap->pos[mi]  = get_move_pos(vary, mi, dt);
+        ap->rot[mi]  = get_move_rot(vary, mi, dt);
+        ap->done[mi] = 1;
+    }
+}
+
+/*
+ * Recalculate mover transform if necessary. Transforms at the current
+ * time are cached per mover; transforms DT ahead are cached in a table
+ * keyed on DT, which the collision tests hit once per body per step.
  */
 static void get_move_transform(const struct s_vary *vary, int mi, float dt, struct vec3 *pos_out, struct vec4 *rot_out)
 {
@@ -184,10 +207,35 @@ static void get_move_transform(const struct s_vary *vary, int mi, float dt, stru
     if (mi < 0 || mi >= vary->mc)
         return;
 
-    if (dt != 0.0f)
+    if (dt != 0.0f && vary->ahead)
     {
-        /* When passed a non-zero DT, bypass cache entirely. TODO: Figure out a way to cache these. */
+        struct v_ahead *ap = vary->ahead;
+
+        if (!ap->valid || ap->dt != dt)
+        {
+            /* Table miss: recalculate all movers, parents first. */
+
+            int i;
+
+            ap->dt    = dt;
+            ap->valid = 1;
+
+            memset(ap->done, 0, vary->mc);
+
+            for (i = 0; i < vary->mc; i++)
+                get_move_ahead(vary, vary->mo[i], dt);
+        }
+
+        get_move_ahead(vary, mi, dt);
+
+        if (pos_out)
+            *pos_out = ap->pos[mi];
 
+        if (rot_out)
+            *rot_out = ap->rot[mi];
+    }
+    else if (dt != 0.0f)
+    {
         if (pos_out)
             *pos_out = get_move_pos(vary, mi, dt);
 
@@ -628,28 +676,113 @@ void sol_ball_step(struct s_vary *vary, cmd_fn cmd_func, float dt)
 
 /*---------------------------------------------------------------------------*/
 
-int sol_item_test(struct s_vary *vary, float *p, float item_r)
+static void index_sort(int *v, int n)
 {
-    float ball_r = vary->uv[0].r;
-    float ball_p[3];
+    int i, j, t;
+
+    for (i = 1; i < n; i++)
+    {
+        for (t = v[i], j = i; j > 0 && v[j - 1] > t; j--)
+            v[j] = v[j - 1];
 
-    int hi;
+        v[j] = t;
+    }
+}
 
-    for (hi = 0; hi < vary->hc; hi++)
+/*
+ * Gather into IX->qv the entities that may lie within M of the world
+ * position W on the XZ plane, in index order. Entities gathered are
+ * stamped in IX->sv.
+ */
+static int index_query(const struct s_vary *vary,
+                       struct v_index *ix, const float w[3], float m)
+{
+    int bi, x, z, i, n = 0;
+
+    if (++ix->stamp == INT_MAX)
     {
-        struct v_item *hp = vary->hv + hi;
-        float r[3];
+        memset(ix->sv, 0, ix->ec * sizeof (int));
+        ix->stamp = 1;
+    }
+
+    for (bi = 0; bi < ix->bc; bi++)
+    {
+        const struct v_bucket *bp = ix->bv + bi;
+
+        float p[3];
+        int x0, x1, z0, z1;
+
+        /* Transform ball position into bucket space and find its cells. */
 
-        /* Transform ball position into item space. */
+        sol_entity_local(p, vary, bp->mi, bp->mj, w);
 
-        sol_entity_local(ball_p, vary, hp->mi, hp->mj, vary->uv[0].p);
+        x0 = (int) floorf((p[0] - m - bp->x0) / bp->k);
+        x1 = (int) floorf((p[0] + m - bp->x0) / bp->k);
+        z0 = (int) floorf((p[2] - m - bp->z0) / bp->k);
+        z1 = (int) floorf((p[2] + m - bp->z0) / bp->k);
 
-        v_sub(r, ball_p, hp->p);
+        if (x1 < 0 || z1 < 0 || x0 >= bp->nx || z0 >= bp->nz)
+            continue;
 
-        if (hp->t != ITEM_NONE && v_len(r) < ball_r + item_r)
-            return hi;
+        x0 = MAX(x0, 0); x1 = MIN(x1, bp->nx - 1);
+        z0 = MAX(z0, 0); z1 = MIN(z1, bp->nz - 1);
+
+        for (z = z0; z <= z1; z++)
+            for (x = x0; x <= x1; x++)
+            {
+                const int c = z * bp->nx + x;
+
+                for (i = bp->cv[c]; i < bp->cv[c + 1]; i++)
+                {
+                    ix->qv[n++] = bp->ev[i];
+                    ix->sv[bp->ev[i]] = ix->stamp;
+                }
+            }
+    }
+
+    index_sort(ix->qv, n);
+
+    return n;
+}
+
+/*
+ * Test ball UI, or every ball if UI is negative, for item collection.
+ */
+int sol_item_test(struct s_vary *vary, int ui, float item_r)
+{
+    struct v_index *ix = &vary->item_index;
+
+    int u0 = (ui < 0 ? 0         : ui);
+    int u1 = (ui < 0 ? vary->uc  : ui + 1);
+    int ui_, i, n, hit = -1;
+
+    for (ui_ = u0; ui_ < u1; ui_++)
+    {
+        float ball_r = vary->uv[ui_].r;
+        float ball_p[3];
+
+        n = index_query(vary, ix, vary->uv[ui_].p, ball_r + item_r);
+
+        for (i = 0; i < n; i++)
+        {
+            struct v_item *hp = vary->hv + ix->qv[i];
+            float r[3];
+
+            /* Transform ball position into item space. */
+
+            sol_entity_local(ball_p, vary, hp->mi, hp->mj, vary->uv[ui_].p);
+
+            v_sub(r, ball_p, hp->p);
+
+            if (hp->t != ITEM_NONE && v_len(r) < ball_r + item_r)
+            {
+                if (hit < 0 || ix->qv[i] < hit)
+                    hit = ix->qv[i];
+                break;
+            }
+        }
     }
-    return -1;
+    return hit;
 }
 
 struct b_goal *sol_goal_test(struct s_vary *vary, float *p, int ui)
@@ -657,13 +790,19 @@ struct b_goal *sol_goal_test(struct s_vary *vary, float *p, int ui)
     float ball_r = vary->uv[ui].r;
     float ball_p[3];
 
-    int zi;
+    int i, n, zi;
 
-    for (zi = 0; zi < vary->base->zc; zi++)
+    n = index_query(vary, &vary->goal_index, vary->uv[ui].p,
+                    vary->goal_index.r);
+
+    for (i = 0; i < n; i++)
     {
-        struct b_goal *zp = vary->base->zv + zi;
+        struct b_goal *zp;
         float r[3];
 
+        zi = vary->goal_index.qv[i];
+        zp = vary->base->zv + zi;
+
         /* Transform ball position into goal space. */
 
         sol_entity_local(ball_p, vary, vary->zv[zi].mi, vary->zv[zi].mj, vary->uv[ui].p);
@@ -690,13 +829,19 @@ int sol_jump_test(struct s_vary *vary, float *p, int ui)
     float ball_r = vary->uv[ui].r;
     float ball_p[3];
 
-    int ji, touch = 0;
+    int i, n, ji, touch = 0;
 
-    for (ji = 0; ji < vary->base->jc; ji++)
+    n = index_query(vary, &vary->jump_index, vary->uv[ui].p,
+                    vary->jump_index.r);
+
+    for (i = 0; i < n; i++)
     {
-        struct b_jump *jp = vary->base->jv + ji;
+        struct b_jump *jp;
         float d, r[3];
 
+        ji = vary->jump_index.qv[i];
+        jp = vary->base->jv + ji;
+
         /* Transform ball position into jump space. */
 
         sol_entity_local(ball_p, vary, vary->jv[ji].mi, vary->jv[ji].mj, vary->uv[ui].p);
@@ -742,14 +887,29 @@ int sol_swch_test(struct s_vary *vary, cmd_fn cmd_func, int ui)
     float ball_r = vary->uv[ui].r;
     float ball_p[3];
 
-    int xi, rc = SWCH_OUTSIDE;
+    struct v_index *ix = &vary->swch_index;
+
+    int i, n, xi, rc = SWCH_OUTSIDE;
+
+    /* Nearby switches, and any occupied switch the ball may have left. */
+
+    n = index_query(vary, ix, vary->uv[ui].p, ix->r + ball_r);
 
     for (xi = 0; xi < vary->xc; xi++)
+        if (vary->xv[xi].e && ix->sv[xi] != ix->stamp)
+            ix->qv[n++] = xi;
+
+    index_sort(ix->qv, n);
+
+    for (i = 0; i < n; i++)
     {
-        struct v_swch *xp = vary->xv + xi;
+        struct v_swch *xp;
 
         float d, r[3];
 
+        xi = ix->qv[i];
+        xp = vary->xv + xi;
+
         sol_entity_local(ball_p, vary, xp->mi, xp->mj, vary->uv[ui].p);
 
         r[0] = ball_p[0] - xp->base->p[0];
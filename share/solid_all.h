@@ -60,7 +60,7 @@ enum
     SWCH_TOUCH
 };
 
-int            sol_item_test(struct s_vary *, float *p, float item_r);
+int            sol_item_test(struct s_vary *, int ui, float item_r);
 struct b_goal *sol_goal_test(struct s_vary *, float *p, int ui);
 int            sol_jump_test(struct s_vary *, float *p, int ui);
 int            sol_swch_test(struct s_vary *, cmd_fn, int ui);
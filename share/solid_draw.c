@@ -24,11 +24,13 @@
 #include "video.h"
 #include "vec3.h"
 #include "geom.h"
+#include "inst.h"
 #include "image.h"
 #include "base_image.h"
 #include "config.h"
 #include "base_config.h"
 #include "lang.h"
+#include "common.h"
 
 #include "solid_draw.h"
 #include "solid_all.h"
@@ -53,33 +55,26 @@ static const struct
 
 /*---------------------------------------------------------------------------*/
 
-static void sol_transform(const struct s_vary *vary,
-                          const struct v_body *bp, int ui)
+/*
+ * Load the texture matrices that project the shadow of ball UI onto
+ * the vertices of the body at MI/MJ.
+ */
+static void sol_shad_matrix(const struct s_vary *vary, int mi, int mj, int ui)
 {
-    float a;
-    float e[4];
-    float p[3];
-    float v[3];
-
-    /* Apply the body position and rotation to the model-view matrix. */
-
-    sol_body_p(p, vary, bp->mi, 0.0f);
-    sol_body_e(e, vary, bp->mj, 0.0f);
-
-    q_as_axisangle(e, v, &a);
-
-    if (!(p[0] == 0 && p[1] == 0 && p[2] == 0))
-        glTranslatef(p[0], p[1], p[2]);
-
-    if (!((v[0] == 0 && v[1] == 0 && v[2] == 0) || a == 0))
-        glRotatef(V_DEG(a), v[0], v[1], v[2]);
-
-    /* Apply the shadow transform to the texture matrix. */
-
     if (ui >= 0 && ui < vary->uc && vary->uv[ui].r > 0.0f)
     {
         struct v_ball *up = vary->uv + ui;
 
+        float a;
+        float e[4];
+        float p[3];
+        float v[3];
+
+        sol_body_p(p, vary, mi, 0.0f);
+        sol_body_e(e, vary, mj, 0.0f);
+
+        q_as_axisangle(e, v, &a);
+
         if (tex_env_stage(TEX_STAGE_SHADOW))
         {
             glMatrixMode(GL_TEXTURE);
@@ -128,6 +123,29 @@ static void sol_transform(const struct s_vary *vary,
     }
 }
 
+static void sol_transform(const struct s_vary *vary, int mi, int mj, int ui)
+{
+    float a;
+    float e[4];
+    float p[3];
+    float v[3];
+
+    /* Apply the body position and rotation to the model-view matrix. */
+
+    sol_body_p(p, vary, mi, 0.0f);
+    sol_body_e(e, vary, mj, 0.0f);
+
+    q_as_axisangle(e, v, &a);
+
+    if (!(p[0] == 0 && p[1] == 0 && p[2] == 0))
+        glTranslatef(p[0], p[1], p[2]);
+
+    if (!((v[0] == 0 && v[1] == 0 && v[2] == 0) || a == 0))
+        glRotatef(V_DEG(a), v[0], v[1], v[2]);
+
+    sol_shad_matrix(vary, mi, mj, ui);
+}
+
 /*---------------------------------------------------------------------------*/
 
 static void sol_load_bill(struct s_draw *draw)
@@ -206,37 +224,66 @@ static int sol_test_mtrl(int mi, int p)
 
 /*---------------------------------------------------------------------------*/
 
-static int sol_count_geom(const struct s_base *base, int g0, int gc, int mi)
+/*
+ * Scratch storage for building the shared vertex and element arrays.
+ */
+
+struct d_build
+{
+    const struct s_base *base;
+
+    struct d_vert *vv;                         /* Vertex data                */
+    struct d_geom *gv;                         /* Element data               */
+    int           *iv;                         /* Off to mesh vertex index   */
+    int           *ov;                         /* Vertex to off index        */
+
+    int vn;
+    int gn;
+    int lim;                                   /* Max vertices per mesh      */
+
+    const int *gk;                             /* Geom to chunk index        */
+    int        k;                              /* Chunk being built          */
+};
+
+/*
+ * Test whether a geom belongs in the chunk currently being built.
+ */
+static int sol_in_chunk(const struct d_build *bd, int gi)
+{
+    return bd->gk == NULL || bd->gk[gi] == bd->k;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void sol_count_geom(const struct d_build *bd, int g0, int gc, int *cv)
 {
-    int gi, c = 0;
+    const struct s_base *base = bd->base;
+    int gi;
 
     /* The arguments g0 and gc specify a range of the index array. These     */
-    /* indices refer to geoms. Determine how many of these geoms use the     */
-    /* given material                                                        */
+    /* indices refer to geoms. Tally how many of these geoms use each        */
+    /* material.                                                             */
 
     for (gi = 0; gi < gc; gi++)
-        if (base->gv[base->iv[g0 + gi]].mi == mi)
-            c++;
-
-    return c;
+        if (sol_in_chunk(bd, base->iv[g0 + gi]))
+            cv[base->gv[base->iv[g0 + gi]].mi]++;
 }
 
-static int sol_count_body(const struct b_body *bp,
-                          const struct s_base *base, int mi)
+static void sol_count_body(const struct b_body *bp,
+                           const struct d_build *bd, int *cv)
 {
-    int li, c = 0;
+    const struct s_base *base = bd->base;
+    int li;
 
-    /* Count all lump geoms with the given material. */
+    /* Count all lump geoms by material. */
 
     for (li = 0; li < bp->lc; li++)
-        c += sol_count_geom(base, base->lv[bp->l0 + li].g0,
-                                  base->lv[bp->l0 + li].gc, mi);
+        sol_count_geom(bd, base->lv[bp->l0 + li].g0,
+                           base->lv[bp->l0 + li].gc, cv);
 
-    /* Count all body geoms with the given material. */
+    /* Count all body geoms by material. */
 
-    c += sol_count_geom(base, bp->g0, bp->gc, mi);
-
-    return c;
+    sol_count_geom(bd, bp->g0, bp->gc, cv);
 }
 
 static int sol_count_mesh(const struct d_body *bp, int p)
@@ -252,6 +299,16 @@ static int sol_count_mesh(const struct d_body *bp, int p)
     return c;
 }
 
+/*
+ * A body is static if neither its position nor its orientation follow
+ * a path. Static bodies never move, and their geometry is merged into
+ * spatial chunks.
+ */
+static int sol_is_static(const struct s_vary *vary, int bi)
+{
+    return vary->bv[bi].mi < 0 && vary->bv[bi].mj < 0;
+}
+
 /*---------------------------------------------------------------------------*/
 
 static void sol_mesh_vert(struct d_vert *vp,
@@ -275,187 +332,241 @@ static void sol_mesh_vert(struct d_vert *vp,
     vp->t[1] = tq->u[1];
 }
 
-static void sol_mesh_geom(struct d_vert *vv,   int *vn,
-                          struct d_geom *gv,   int *gn,
-                          const struct s_base *base, int *iv, int g0, int gc, int mi)
+static void sol_mesh_open(struct d_mesh *mp, struct d_build *bd, int mtrl)
 {
-    int gi;
+    mp->mtrl = mtrl;
+    mp->v0   = bd->vn;
+    mp->e0   = bd->gn * 3;
+}
 
-    /* Insert all geoms with material mi into the vertex and element data. */
+static void sol_mesh_close(struct d_mesh *mp, struct d_build *bd)
+{
+    int i;
 
-    for (gi = 0; gi < gc; gi++)
-    {
-        const struct b_geom *gq = base->gv + base->iv[g0 + gi];
+    mp->vc = bd->vn - mp->v0;
+    mp->ec = bd->gn * 3 - mp->e0;
 
-        if (gq->mi == mi)
-        {
-            /* Insert a d_vert into the VBO data for each referenced b_off. */
+    /* Reset the index remapping for the vertices of this mesh only. */
 
-            if (iv[gq->oi] == -1)
-            {
-                iv[gq->oi] = *vn;
-                sol_mesh_vert(vv + (*vn)++, base, gq->oi);
-            }
-            if (iv[gq->oj] == -1)
-            {
-                iv[gq->oj] = *vn;
-                sol_mesh_vert(vv + (*vn)++, base, gq->oj);
-            }
-            if (iv[gq->ok] == -1)
-            {
-                iv[gq->ok] = *vn;
-                sol_mesh_vert(vv + (*vn)++, base, gq->ok);
-            }
-
-            /* Populate the EBO data using remapped b_off indices. */
+    for (i = mp->v0; i < bd->vn; i++)
+        bd->iv[bd->ov[i]] = -1;
+}
 
-            gv[*gn].i = iv[gq->oi];
-            gv[*gn].j = iv[gq->oj];
-            gv[*gn].k = iv[gq->ok];
+static GLuint sol_mesh_index(const struct d_mesh *mp, struct d_build *bd, int oi)
+{
+    /* Insert a d_vert into the VBO data for each newly referenced b_off. */
 
-            (*gn)++;
-        }
+    if (bd->iv[oi] == -1)
+    {
+        bd->iv[oi] = bd->vn - mp->v0;
+        bd->ov[bd->vn] = oi;
+        sol_mesh_vert(bd->vv + bd->vn++, bd->base, oi);
     }
+    return (GLuint) bd->iv[oi];
 }
 
-static void sol_load_mesh(struct d_mesh *mp,
-                          const struct b_body *bp,
-                          const struct s_draw *draw, int mi)
+static void sol_mesh_geom(struct d_body *bp, struct d_build *bd,
+                          int g0, int gc, int mi)
 {
-    struct d_vert *vv = 0;
-    struct d_geom *gv = 0;
-    int           *iv = 0;
-
-    int oc = draw->base->oc;
-    int vn = 0;
-    int gn = 0;
-
-    const int gc = sol_count_body(bp, draw->base, mi);
+    const struct s_base *base = bd->base;
+    int gi;
 
-    /* Get temporary storage for vertex and element array creation. */
+    /* Insert all geoms with material mi into the vertex and element data. */
 
-    if ((vv = (struct d_vert *) calloc(oc, sizeof (*vv))) &&
-        (gv = (struct d_geom *) calloc(gc, sizeof (*gv))) &&
-        (iv = (int           *) calloc(oc, sizeof (int))))
+    for (gi = 0; gi < gc; gi++)
     {
-        int li, i;
-
-        /* Initialize the index remapping. */
-
-        for (i = 0; i < oc; ++i) iv[i] = -1;
+        const struct b_geom *gq = base->gv + base->iv[g0 + gi];
 
-        /* Include all matching lump geoms in the arrays. */
+        if (gq->mi == mi && sol_in_chunk(bd, base->iv[g0 + gi]))
+        {
+            struct d_mesh *mp = bp->mv + bp->mc - 1;
+            struct d_geom *gp;
 
-        for (li = 0; li < bp->lc; li++)
-            sol_mesh_geom(vv, &vn, gv, &gn, draw->base, iv,
-                          draw->base->lv[bp->l0 + li].g0,
-                          draw->base->lv[bp->l0 + li].gc, mi);
+            /* Start another mesh if this one would overflow its indices. */
 
-        /* Include all matching body geoms in the arrays. */
+            if (bd->vn - (int) mp->v0 + 3 > bd->lim)
+            {
+                sol_mesh_close(mp, bd);
+                sol_mesh_open(mp + 1, bd, mp->mtrl);
+                bp->mc++;
+                mp++;
+            }
 
-        sol_mesh_geom(vv, &vn, gv, &gn, draw->base, iv, bp->g0, bp->gc, mi);
+            /* Populate the EBO data using mesh-relative vertex indices. */
 
-        /* Initialize buffer objects for all data. */
+            gp = bd->gv + bd->gn++;
 
-        glGenBuffers_(1, &mp->vbo);
-        glBindBuffer_(GL_ARRAY_BUFFER,         mp->vbo);
-        glBufferData_(GL_ARRAY_BUFFER,         vn * sizeof (*vv), vv,
-                      GL_STATIC_DRAW);
-        glBindBuffer_(GL_ARRAY_BUFFER,         0);
+            gp->i = sol_mesh_index(mp, bd, gq->oi);
+            gp->j = sol_mesh_index(mp, bd, gq->oj);
+            gp->k = sol_mesh_index(mp, bd, gq->ok);
+        }
+    }
+}
 
-        glGenBuffers_(1, &mp->ebo);
-        glBindBuffer_(GL_ELEMENT_ARRAY_BUFFER, mp->ebo);
-        glBufferData_(GL_ELEMENT_ARRAY_BUFFER, gn * sizeof (*gv), gv,
-                      GL_STATIC_DRAW);
-        glBindBuffer_(GL_ELEMENT_ARRAY_BUFFER, 0);
+static void sol_load_mesh(struct d_body *bp, struct d_build *bd,
+                          const struct b_body *bq, int mi)
+{
+    const struct s_base *base = bd->base;
+    int li;
 
-        /* Note cached material index. */
+    /* Include all matching lump geoms in the arrays. */
 
-        mp->mtrl = draw->base->mtrls[mi];
+    for (li = 0; li < bq->lc; li++)
+        sol_mesh_geom(bp, bd, base->lv[bq->l0 + li].g0,
+                              base->lv[bq->l0 + li].gc, mi);
 
-        mp->ebc = gn * 3;
-        mp->vbc = vn;
-    }
+    /* Include all matching body geoms in the arrays. */
 
-    free(iv);
-    free(gv);
-    free(vv);
+    sol_mesh_geom(bp, bd, bq->g0, bq->gc, mi);
 }
 
-static void sol_free_mesh(struct d_mesh *mp)
-{
-    glDeleteBuffers_(1, &mp->ebo);
-    glDeleteBuffers_(1, &mp->vbo);
-}
-
-void sol_draw_mesh(const struct d_mesh *mp, struct s_rend *rend, int p)
+static void sol_draw_mesh(const struct s_draw *draw,
+                          const struct d_mesh *mp, struct s_rend *rend, int p)
 {
     /* If this mesh has material matching the given flags... */
 
     if (sol_test_mtrl(mp->mtrl, p))
     {
         const size_t s = sizeof (struct d_vert);
+        const size_t o = mp->v0 * s;
         const GLenum T = GL_FLOAT;
 
+        const size_t z = (draw->ebo_type == GL_UNSIGNED_INT ?
+                          sizeof (GLuint) : sizeof (GLushort));
+
         /* Apply the material state. */
 
         r_apply_mtrl(rend, mp->mtrl);
 
-        /* Bind the mesh data. */
+        /* Point at the mesh range of the shared vertex data. */
 
-        glBindBuffer_(GL_ARRAY_BUFFER,         mp->vbo);
-        glBindBuffer_(GL_ELEMENT_ARRAY_BUFFER, mp->ebo);
-
-        glVertexPointer  (3, T, s, (GLvoid *) offsetof (struct d_vert, p));
-        glNormalPointer  (   T, s, (GLvoid *) offsetof (struct d_vert, n));
+        glVertexPointer  (3, T, s, (GLvoid *) (o + offsetof (struct d_vert, p)));
+        glNormalPointer  (   T, s, (GLvoid *) (o + offsetof (struct d_vert, n)));
 
         if (tex_env_stage(TEX_STAGE_SHADOW))
         {
-            glTexCoordPointer(3, T, s, (GLvoid *) offsetof (struct d_vert, p));
+            glTexCoordPointer(3, T, s, (GLvoid *) (o + offsetof (struct d_vert, p)));
 
             if (tex_env_stage(TEX_STAGE_CLIP))
-                glTexCoordPointer(3, T, s, (GLvoid *) offsetof (struct d_vert, p));
+                glTexCoordPointer(3, T, s, (GLvoid *) (o + offsetof (struct d_vert, p)));
 
             tex_env_stage(TEX_STAGE_TEXTURE);
         }
-        glTexCoordPointer(2, T, s, (GLvoid *) offsetof (struct d_vert, t));
+        glTexCoordPointer(2, T, s, (GLvoid *) (o + offsetof (struct d_vert, t)));
 
         /* Draw the mesh. */
 
-        if (rend->curr_mtrl.base.fl & M_PARTICLE)
-            glDrawArrays(GL_POINTS, 0, mp->vbc);
+        if (rend->inst)
+        {
+            if (rend->curr_mtrl.base.fl & M_PARTICLE)
+                inst_draw_arrays(rend, GL_POINTS, 0, mp->vc);
+            else
+                inst_draw_elements(rend, GL_TRIANGLES, mp->ec, draw->ebo_type,
+                                         (GLvoid *) (mp->e0 * z));
+        }
+        else if (rend->curr_mtrl.base.fl & M_PARTICLE)
+            glDrawArrays(GL_POINTS, 0, mp->vc);
         else
-            glDrawElements(GL_TRIANGLES, mp->ebc, GL_UNSIGNED_SHORT, 0);
+            glDrawRangeElements_(GL_TRIANGLES, 0, mp->vc - 1, mp->ec,
+                                 draw->ebo_type, (GLvoid *) (mp->e0 * z));
     }
 }
 
 /*---------------------------------------------------------------------------*/
 
-static void sol_load_body(struct d_body *bp,
-                          const struct b_body *bq,
-                          const struct s_draw *draw)
+static void sol_bound_body(struct d_body *bp, const struct d_build *bd)
 {
-    int mi;
+    float a[3], b[3];
+    int mi, i, n = 0;
 
-    bp->base = bq;
-    bp->mc   =  0;
+    v_zero(bp->c);
+    bp->r   = 0.0f;
+    bp->vis = 1;
 
-    /* Determine how many materials this body uses. */
+    /* Find the bounding box of the body vertices. */
 
-    for (mi = 0; mi < draw->base->mc; ++mi)
-        if (sol_count_body(bq, draw->base, mi))
-            bp->mc++;
+    for (mi = 0; mi < bp->mc; mi++)
+        for (i = 0; i < (int) bp->mv[mi].vc; i++, n++)
+        {
+            const float *p = bd->vv[bp->mv[mi].v0 + i].p;
+
+            if (n == 0)
+            {
+                v_cpy(a, p);
+                v_cpy(b, p);
+            }
+            else
+            {
+                a[0] = MIN(a[0], p[0]); b[0] = MAX(b[0], p[0]);
+                a[1] = MIN(a[1], p[1]); b[1] = MAX(b[1], p[1]);
+                a[2] = MIN(a[2], p[2]); b[2] = MAX(b[2], p[2]);
+            }
+        }
 
-    /* Allocate and initialize a mesh for each material. */
+    /* Center a sphere on the box and enclose all vertices. */
 
-    if ((bp->mv = (struct d_mesh *) calloc(bp->mc, sizeof (struct d_mesh))))
+    if (n)
     {
-        int mj = 0;
+        v_mid(bp->c, a, b);
 
-        for (mi = 0; mi < draw->base->mc; ++mi)
-            if (sol_count_body(bq, draw->base, mi))
-                sol_load_mesh(bp->mv + mj++, bq, draw, mi);
+        for (mi = 0; mi < bp->mc; mi++)
+            for (i = 0; i < (int) bp->mv[mi].vc; i++)
+            {
+                float d[3];
+
+                v_sub(d, bd->vv[bp->mv[mi].v0 + i].p, bp->c);
+
+                bp->r = MAX(bp->r, v_len(d));
+            }
     }
+}
+
+static void sol_load_body(struct d_body *bp, struct d_build *bd,
+                          const struct b_body **bqv, int bqc)
+{
+    const struct s_base *base = bd->base;
+
+    int *cv;
+    int  mi, bi, n = 0;
+
+    bp->base = (bqc == 1) ? bqv[0] : NULL;
+    bp->mc   = 0;
+
+    /* Determine how many geoms of each material these bodies use. */
+
+    if (!(cv = (int *) calloc(base->mc, sizeof (int))))
+        return;
+
+    for (bi = 0; bi < bqc; bi++)
+        sol_count_body(bqv[bi], bd, cv);
+
+    /* Reserve a mesh for each material, plus any splits it may need. */
+
+    for (mi = 0; mi < base->mc; ++mi)
+        if (cv[mi])
+            n += 1 + (cv[mi] * 3) / (bd->lim - 2);
+
+    /* Allocate and initialize the meshes, one or more per material. */
+
+    if (n && (bp->mv = (struct d_mesh *) calloc(n, sizeof (struct d_mesh))))
+    {
+        for (mi = 0; mi < base->mc; ++mi)
+            if (cv[mi])
+            {
+                sol_mesh_open(bp->mv + bp->mc++, bd, base->mtrls[mi]);
+
+                for (bi = 0; bi < bqc; bi++)
+                    sol_load_mesh(bp, bd, bqv[bi], mi);
+
+                sol_mesh_close(bp->mv + bp->mc - 1, bd);
+            }
+    }
+
+    free(cv);
+
+    /* Bound the vertices of all meshes with a sphere. */
+
+    sol_bound_body(bp, bd);
 
     /* Cache a mesh count for each pass. */
 
@@ -468,20 +579,277 @@ static void sol_load_body(struct d_body *bp,
 
 static void sol_free_body(struct d_body *bp)
 {
-    int mi;
-
-    for (mi = 0; mi < bp->mc; ++mi)
-        sol_free_mesh(bp->mv + mi);
-
     free(bp->mv);
 }
 
-static void sol_draw_body(const struct d_body *bp, struct s_rend *rend, int p)
+static void sol_draw_body(const struct s_draw *draw,
+                          const struct d_body *bp, struct s_rend *rend, int p)
 {
     int i;
 
     for (i = 0; i < bp->mc; ++i)
-        sol_draw_mesh(bp->mv + i, rend, p);
+        sol_draw_mesh(draw, bp->mv + i, rend, p);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void sol_load_buffers(struct s_draw *draw, struct d_build *bd)
+{
+    GLushort *sv = NULL;
+    int i;
+
+    /* Use 32-bit element indices only if some mesh needs them. */
+
+    draw->ebo_type = GL_UNSIGNED_SHORT;
+
+    for (i = 0; i < draw->kc; i++)
+    {
+        int mi;
+
+        for (mi = 0; mi < draw->kv[i].mc; mi++)
+            if (draw->kv[i].mv[mi].vc > 0x10000)
+                draw->ebo_type = GL_UNSIGNED_INT;
+    }
+
+    for (i = 0; i < draw->bc; i++)
+    {
+        int mi;
+
+        for (mi = 0; mi < draw->bv[i].mc; mi++)
+            if (draw->bv[i].mv[mi].vc > 0x10000)
+                draw->ebo_type = GL_UNSIGNED_INT;
+    }
+
+    /* Initialize buffer objects for all data. */
+
+    glGenBuffers_(1, &draw->vbo);
+    glBindBuffer_(GL_ARRAY_BUFFER,         draw->vbo);
+    glBufferData_(GL_ARRAY_BUFFER,         bd->vn * sizeof (*bd->vv), bd->vv,
+                  GL_STATIC_DRAW);
+    glBindBuffer_(GL_ARRAY_BUFFER,         0);
+
+    glGenBuffers_(1, &draw->ebo);
+    glBindBuffer_(GL_ELEMENT_ARRAY_BUFFER, draw->ebo);
+
+    if (draw->ebo_type == GL_UNSIGNED_INT)
+        glBufferData_(GL_ELEMENT_ARRAY_BUFFER, bd->gn * sizeof (*bd->gv), bd->gv,
+                      GL_STATIC_DRAW);
+
+    else if ((sv = (GLushort *) calloc(bd->gn * 3, sizeof (*sv))))
+    {
+        for (i = 0; i < bd->gn; i++)
+        {
+            sv[i * 3 + 0] = (GLushort) bd->gv[i].i;
+            sv[i * 3 + 1] = (GLushort) bd->gv[i].j;
+            sv[i * 3 + 2] = (GLushort) bd->gv[i].k;
+        }
+
+        glBufferData_(GL_ELEMENT_ARRAY_BUFFER, bd->gn * 3 * sizeof (*sv), sv,
+                      GL_STATIC_DRAW);
+        free(sv);
+    }
+
+    glBindBuffer_(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+/*
+ * Static geometry is split into a grid of chunks on the XZ plane so that
+ * each chunk can be culled separately.
+ */
+
+#define CHUNK_SIZE 32.0f
+#define CHUNK_MAX  8
+
+static void sol_chunk_mark(const struct s_base *base, int g0, int gc, int *gk)
+{
+    int gi;
+
+    for (gi = 0; gi < gc; gi++)
+        gk[base->iv[g0 + gi]] = 0;
+}
+
+static void sol_chunk_geom(float c[3], const struct s_base *base, int gi)
+{
+    const struct b_geom *gp = base->gv + gi;
+
+    const float *p = base->vv[base->ov[gp->oi].vi].p;
+    const float *q = base->vv[base->ov[gp->oj].vi].p;
+    const float *r = base->vv[base->ov[gp->ok].vi].p;
+
+    c[0] = (p[0] + q[0] + r[0]) / 3.0f;
+    c[1] = (p[1] + q[1] + r[1]) / 3.0f;
+    c[2] = (p[2] + q[2] + r[2]) / 3.0f;
+}
+
+/*
+ * Assign each geom of the given static bodies to a chunk. Other geoms
+ * get -1. Return the number of chunks.
+ */
+static int sol_chunk_init(const struct s_base *base, int *gk,
+                          const struct b_body **bqv, int bqc)
+{
+    float x0 = 0.0f, x1 = 0.0f, z0 = 0.0f, z1 = 0.0f, c[3];
+    int   nx, nz, gi, bi, li, n = 0;
+
+    for (gi = 0; gi < base->gc; gi++)
+        gk[gi] = -1;
+
+    for (bi = 0; bi < bqc; bi++)
+    {
+        for (li = 0; li < bqv[bi]->lc; li++)
+            sol_chunk_mark(base, base->lv[bqv[bi]->l0 + li].g0,
+                                 base->lv[bqv[bi]->l0 + li].gc, gk);
+
+        sol_chunk_mark(base, bqv[bi]->g0, bqv[bi]->gc, gk);
+    }
+
+    /* Find the horizontal extent of the static geometry. */
+
+    for (gi = 0; gi < base->gc; gi++)
+        if (gk[gi] == 0)
+        {
+            sol_chunk_geom(c, base, gi);
+
+            if (n++ == 0)
+            {
+                x0 = x1 = c[0];
+                z0 = z1 = c[2];
+            }
+            else
+            {
+                x0 = MIN(x0, c[0]); x1 = MAX(x1, c[0]);
+                z0 = MIN(z0, c[2]); z1 = MAX(z1, c[2]);
+            }
+        }
+
+    nx = MAX(1, MIN(CHUNK_MAX, (int) ceilf((x1 - x0) / CHUNK_SIZE)));
+    nz = MAX(1, MIN(CHUNK_MAX, (int) ceilf((z1 - z0) / CHUNK_SIZE)));
+
+    /* Bin each geom by its centroid. */
+
+    for (gi = 0; gi < base->gc; gi++)
+        if (gk[gi] == 0)
+        {
+            int ix = 0;
+            int iz = 0;
+
+            sol_chunk_geom(c, base, gi);
+
+            if (x1 > x0) ix = MIN(nx - 1, (int) (nx * (c[0] - x0) / (x1 - x0)));
+            if (z1 > z0) iz = MIN(nz - 1, (int) (nz * (c[2] - z0) / (z1 - z0)));
+
+            gk[gi] = iz * nx + ix;
+        }
+
+    return nx * nz;
+}
+
+static void sol_load_chunks(struct s_draw *draw, struct d_build *bd,
+                            const struct b_body **bqv, int bqc)
+{
+    int *gk;
+    int  n, k;
+
+    if ((gk = (int *) calloc(bd->base->gc + 1, sizeof (int))))
+    {
+        n = sol_chunk_init(bd->base, gk, bqv, bqc);
+
+        if ((draw->kv = (struct d_body *) calloc(n, sizeof (*draw->kv))))
+        {
+            bd->gk = gk;
+
+            for (k = 0; k < n; k++)
+            {
+                bd->k = k;
+
+                sol_load_body(draw->kv + draw->kc, bd, bqv, bqc);
+
+                /* Keep only non-empty chunks. */
+
+                if (draw->kv[draw->kc].mc)
+                    draw->kc++;
+                else
+                {
+                    free(draw->kv[draw->kc].mv);
+                    draw->kv[draw->kc].mv = NULL;
+                }
+            }
+
+            bd->gk = NULL;
+        }
+        free(gk);
+    }
+}
+
+static void sol_load_meshes(struct s_draw *draw)
+{
+    const struct s_base *base = draw->base;
+    const struct b_body **bqv;
+
+    struct d_build bd;
+
+    int i, bqc = 0, gc = 0;
+
+    memset(&bd, 0, sizeof (bd));
+
+    bd.base = base;
+    bd.lim  = gli.element_index_uint ? 0x7fffffff : 0x10000;
+
+    /* Count all geoms to bound the size of the shared arrays. */
+
+    for (i = 0; i < base->bc; i++)
+    {
+        const struct b_body *bq = base->bv + i;
+        int li;
+
+        for (li = 0; li < bq->lc; li++)
+            gc += base->lv[bq->l0 + li].gc;
+
+        gc += bq->gc;
+    }
+
+    /* Get temporary storage for vertex and element array creation. */
+
+    if ((bqv   = calloc(base->bc + 1, sizeof (*bqv)))                    &&
+        (bd.vv = (struct d_vert *) calloc(gc * 3 + 1, sizeof (*bd.vv))) &&
+        (bd.gv = (struct d_geom *) calloc(gc     + 1, sizeof (*bd.gv))) &&
+        (bd.ov = (int           *) calloc(gc * 3 + 1, sizeof (int)))    &&
+        (bd.iv = (int           *) calloc(base->oc + 1, sizeof (int))))
+    {
+        /* Initialize the index remapping. */
+
+        for (i = 0; i < base->oc; ++i) bd.iv[i] = -1;
+
+        /* Merge the meshes of all static bodies into spatial chunks. */
+
+        for (i = 0; i < draw->bc; i++)
+            if (sol_is_static(draw->vary, i))
+                bqv[bqc++] = base->bv + i;
+
+        if (bqc)
+            sol_load_chunks(draw, &bd, bqv, bqc);
+
+        /* Give each moving body meshes of its own. */
+
+        for (i = 0; i < draw->bc; i++)
+        {
+            draw->bv[i].base = base->bv + i;
+
+            if (!sol_is_static(draw->vary, i))
+            {
+                bqv[0] = base->bv + i;
+                sol_load_body(draw->bv + i, &bd, bqv, 1);
+            }
+        }
+
+        sol_load_buffers(draw, &bd);
+    }
+
+    free(bd.iv);
+    free(bd.ov);
+    free(bd.gv);
+    free(bd.vv);
+    free(bqv);
 }
 
 /*---------------------------------------------------------------------------*/
@@ -521,8 +889,7 @@ int sol_load_draw(struct s_draw *draw, struct s_vary *vary, int s)
         {
             draw->bc = draw->base->bc;
 
-            for (i = 0; i < draw->bc; i++)
-                sol_load_body(draw->bv + i, draw->base->bv + i, draw);
+            sol_load_meshes(draw);
         }
     }
 
@@ -542,24 +909,168 @@ void sol_free_draw(struct s_draw *draw)
     for (i = 0; i < draw->bc; i++)
         sol_free_body(draw->bv + i);
 
+    for (i = 0; i < draw->kc; i++)
+        sol_free_body(draw->kv + i);
+
+    free(draw->kv);
+
+    glDeleteBuffers_(1, &draw->ebo);
+    glDeleteBuffers_(1, &draw->vbo);
+
     free(draw->bv);
 }
 
 /*---------------------------------------------------------------------------*/
 
+/*
+ * Test the bounding spheres of all chunks and moving bodies against the
+ * given view. A null frustum disables culling.
+ */
+void sol_cull(struct s_draw *draw, const struct frustum *fr)
+{
+    int i;
+
+    draw->cull = fr;
+
+    for (i = 0; i < draw->kc; i++)
+        draw->kv[i].vis = frustum_test(fr, draw->kv[i].c, draw->kv[i].r);
+
+    for (i = 0; i < draw->bc; i++)
+        if (draw->bv[i].mc)
+        {
+            const struct v_body *bp = draw->vary->bv + i;
+
+            float p[3], e[4], c[3];
+
+            sol_body_p(p, draw->vary, bp->mi, 0.0f);
+            sol_body_e(e, draw->vary, bp->mj, 0.0f);
+
+            q_rot(c, e, draw->bv[i].c);
+            v_add(c, c, p);
+
+            draw->bv[i].vis = frustum_test(fr, c, draw->bv[i].r);
+        }
+}
+
+/*
+ * Grow rectangle R to cover the projection of the box around a sphere
+ * under clip matrix M. Return false if the box reaches behind the eye.
+ */
+static int sol_rect_sphere(float r[4], const float *M, const float c[3], float k)
+{
+    int i;
+
+    for (i = 0; i < 8; i++)
+    {
+        const float x = c[0] + ((i & 1) ? k : -k);
+        const float y = c[1] + ((i & 2) ? k : -k);
+        const float z = c[2] + ((i & 4) ? k : -k);
+
+        const float w = x * M[3] + y * M[7] + z * M[11] + M[15];
+
+        float u, v;
+
+        if (w < 0.001f)
+            return 0;
+
+        u = (x * M[0] + y * M[4] + z * M[8] + M[12]) / w;
+        v = (x * M[1] + y * M[5] + z * M[9] + M[13]) / w;
+
+        r[0] = MIN(r[0], u);
+        r[1] = MIN(r[1], v);
+        r[2] = MAX(r[2], u);
+        r[3] = MAX(r[3], v);
+    }
+    return 1;
+}
+
+/*
+ * Find the normalized device rectangle covering the reflective geometry
+ * that passed the last cull, given clip matrix M. Return false if there
+ * is none on screen.
+ */
+int sol_refl_rect(const struct s_draw *draw, const float *M, float *r)
+{
+    int i, ok = 1;
+
+    r[0] = r[1] = +1.0f;
+    r[2] = r[3] = -1.0f;
+
+    for (i = 0; ok && i < draw->kc; i++)
+        if (draw->kv[i].pass[PASS_REFLECTIVE] && draw->kv[i].vis)
+            ok = sol_rect_sphere(r, M, draw->kv[i].c, draw->kv[i].r);
+
+    for (i = 0; ok && i < draw->bc; i++)
+        if (draw->bv[i].pass[PASS_REFLECTIVE] && draw->bv[i].vis)
+        {
+            const struct v_body *bp = draw->vary->bv + i;
+
+            float p[3], e[4], c[3];
+
+            sol_body_p(p, draw->vary, bp->mi, 0.0f);
+            sol_body_e(e, draw->vary, bp->mj, 0.0f);
+
+            q_rot(c, e, draw->bv[i].c);
+            v_add(c, c, p);
+
+            ok = sol_rect_sphere(r, M, c, draw->bv[i].r);
+        }
+
+    /* Geometry behind the eye may cover any part of the screen. */
+
+    if (!ok)
+    {
+        r[0] = r[1] = -1.0f;
+        r[2] = r[3] = +1.0f;
+    }
+
+    r[0] = MAX(r[0], -1.0f);
+    r[1] = MAX(r[1], -1.0f);
+    r[2] = MIN(r[2], +1.0f);
+    r[3] = MIN(r[3], +1.0f);
+
+    return (r[0] < r[2] && r[1] < r[3]);
+}
+
 static void sol_draw_all(const struct s_draw *draw, struct s_rend *rend, int p)
 {
-    int bi;
+    int bi, ki, n = 0;
+
+    /* All meshes live in the shared buffer objects. */
 
-    /* Draw all meshes of all bodies matching the given material flags. */
+    glBindBuffer_(GL_ARRAY_BUFFER,         draw->vbo);
+    glBindBuffer_(GL_ELEMENT_ARRAY_BUFFER, draw->ebo);
+
+    /* Draw the visible static chunks matching the given material flags. */
+
+    for (ki = 0; ki < draw->kc; ++ki)
+        if (draw->kv[ki].pass[p] && draw->kv[ki].vis)
+            n++;
+
+    if (n)
+    {
+        glPushMatrix();
+        {
+            sol_transform(draw->vary, -1, -1, draw->shadow_ui);
+
+            for (ki = 0; ki < draw->kc; ++ki)
+                if (draw->kv[ki].pass[p] && draw->kv[ki].vis)
+                    sol_draw_body(draw, draw->kv + ki, rend, p);
+        }
+        glPopMatrix();
+    }
+
+    /* Draw all meshes of all moving bodies matching the material flags. */
 
     for (bi = 0; bi < draw->bc; ++bi)
-        if (draw->bv[bi].pass[p])
+        if (draw->bv[bi].pass[p] && draw->bv[bi].vis)
         {
+            const struct v_body *bp = draw->vary->bv + bi;
+
             glPushMatrix();
             {
-                sol_transform(draw->vary, draw->vary->bv + bi, draw->shadow_ui);
-                sol_draw_body(draw->bv + bi, rend, p);
+                sol_transform(draw->vary, bp->mi, bp->mj, draw->shadow_ui);
+                sol_draw_body(draw, draw->bv + bi, rend, p);
             }
             glPopMatrix();
         }
@@ -597,6 +1108,146 @@ void sol_draw(const struct s_draw *draw, struct s_rend *rend, int mask, int test
     rend->skip_flags = 0;
 }
 
+/*
+ * Draw the shadowed meshes of a body once more, with texture coordinates
+ * for the shadow pass.
+ */
+static void sol_shad_body(const struct s_draw *draw,
+                          const struct d_body *bp, int p)
+{
+    const size_t s = sizeof (struct d_vert);
+    const GLenum T = GL_FLOAT;
+
+    const size_t z = (draw->ebo_type == GL_UNSIGNED_INT ?
+                      sizeof (GLuint) : sizeof (GLushort));
+    int i;
+
+    for (i = 0; i < bp->mc; ++i)
+    {
+        const struct d_mesh *mp = bp->mv + i;
+        const int fl = mtrl_get(mp->mtrl)->base.fl;
+
+        /*
+         * The pass draws whole triangles without the mesh texture, so an
+         * alpha-tested mesh would be shadowed in its cut-out parts too.
+         * Likewise decals and transparent meshes, see sol_shad.
+         */
+
+        if (sol_test_mtrl(mp->mtrl, p) && (fl & M_SHADOWED) &&
+                                         !(fl & M_PARTICLE) &&
+                                         !(fl & M_ALPHA_TEST) &&
+                                         !(fl & M_DECAL) &&
+                                         !(fl & M_TRANSPARENT))
+        {
+            const size_t o = mp->v0 * s;
+
+            glVertexPointer(3, T, s, (GLvoid *) (o + offsetof (struct d_vert, p)));
+
+            if (tex_env_stage(TEX_STAGE_CLIP))
+                glTexCoordPointer(3, T, s, (GLvoid *) (o + offsetof (struct d_vert, p)));
+            if (tex_env_stage(TEX_STAGE_SHADOW))
+                glTexCoordPointer(3, T, s, (GLvoid *) (o + offsetof (struct d_vert, p)));
+
+            glDrawRangeElements_(GL_TRIANGLES, 0, mp->vc - 1, mp->ec,
+                                 draw->ebo_type, (GLvoid *) (mp->e0 * z));
+        }
+    }
+}
+
+/*
+ * Test whether a static chunk may be within the shadow of a ball. The
+ * shadow texture spans twice the ball radius and is clipped above the
+ * ball.
+ */
+static int sol_shad_test(const struct d_body *bp, const struct v_ball *up)
+{
+    const float dx = bp->c[0] - up->p[0];
+    const float dz = bp->c[2] - up->p[2];
+    const float d  = bp->r + 2.0f * up->r;
+
+    return (bp->c[1] - bp->r < up->p[1] && dx * dx + dz * dz < d * d);
+}
+
+/*
+ * Darken the visible shadowed geometry under ball UI, or under all balls
+ * if UI is negative. This follows the scene, whose depth it depends on,
+ * and leaves the material state of the scene untouched.
+ *
+ * Decals and transparent meshes are not drawn. Without their texture,
+ * they would be shadowed over the whole quad, on top of the surface
+ * behind them. Instead, surfaces are drawn with the decal offset, so
+ * that their shadow reaches over the decals on them.
+ */
+void sol_shad(const struct s_draw *draw, struct s_rend *rend, int ui)
+{
+    static const int pass[] = { PASS_OPAQUE, PASS_REFLECTIVE };
+
+    const struct s_vary *vary = draw->vary;
+
+    int u0 = 0, u1 = vary->uc;
+    int i, p, u, ki, bi;
+
+    if (ui >= 0)
+    {
+        u0 = ui;
+        u1 = MIN(ui + 1, vary->uc);
+    }
+
+    if (!draw->shadowed || u0 >= u1 || !shad_pass_begin(rend))
+        return;
+
+    glBindBuffer_(GL_ARRAY_BUFFER,         draw->vbo);
+    glBindBuffer_(GL_ELEMENT_ARRAY_BUFFER, draw->ebo);
+
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(-1.0f, -2.0f);
+
+    for (i = 0; i < ARRAYSIZE(pass); i++)
+    {
+        p = pass[i];
+
+        for (u = u0; u < u1; u++)
+        {
+            const struct v_ball *up = vary->uv + u;
+
+            if (up->r <= 0.0f)
+                continue;
+
+            /* Static chunks near the ball. */
+
+            sol_shad_matrix(vary, -1, -1, u);
+
+            for (ki = 0; ki < draw->kc; ++ki)
+                if (draw->kv[ki].pass[p] && draw->kv[ki].vis &&
+                    sol_shad_test(draw->kv + ki, up))
+                    sol_shad_body(draw, draw->kv + ki, p);
+
+            /* Moving bodies. */
+
+            for (bi = 0; bi < draw->bc; ++bi)
+                if (draw->bv[bi].pass[p] && draw->bv[bi].vis)
+                {
+                    const struct v_body *bp = vary->bv + bi;
+
+                    glPushMatrix();
+                    {
+                        sol_transform(vary, bp->mi, bp->mj, -1);
+                        sol_shad_matrix(vary, bp->mi, bp->mj, u);
+                        sol_shad_body(draw, draw->bv + bi, p);
+                    }
+                    glPopMatrix();
+                }
+        }
+    }
+
+    glDisable(GL_POLYGON_OFFSET_FILL);
+
+    glBindBuffer_(GL_ARRAY_BUFFER,         0);
+    glBindBuffer_(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    shad_pass_end(rend);
+}
+
 void sol_refl(const struct s_draw *draw, struct s_rend *rend)
 {
     /* Disable shadowed material setup if not requested. */
@@ -713,6 +1364,9 @@ void sol_bill(const struct s_draw *draw,
 
             sol_entity_world(p, draw->vary, draw->vary->rv[ri].mi, draw->vary->rv[ri].mj, rp->p);
 
+            if (!frustum_test(draw->cull, p, fsqrtf(w * w + h * h)))
+                continue;
+
             r_apply_mtrl(rend, draw->base->mtrls[rp->mi]);
 
             glPushMatrix();
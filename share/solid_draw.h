@@ -19,6 +19,7 @@
 #include "solid_base.h"
 #include "solid_vary.h"
 #include "mtrl.h"
+#include "frustum.h"
 
 /*
  * Rendered solid data.
@@ -49,21 +50,29 @@ struct d_vert
 
 struct d_geom
 {
-    GLushort i;
-    GLushort j;
-    GLushort k;
+    GLuint i;
+    GLuint j;
+    GLuint k;
 };
 
 /*---------------------------------------------------------------------------*/
 
+/*
+ * Meshes do not own buffer objects.  All meshes of a SOL share a single
+ * vertex buffer and a single element buffer, and each mesh addresses a
+ * range of both.  Element indices are relative to the first vertex of
+ * the mesh, so 16-bit indices suffice unless a single mesh exceeds 64K
+ * vertices.
+ */
+
 struct d_mesh
 {
     int mtrl;                                  /* Cached material            */
 
-    GLuint vbo;                                /* Vertex  buffer object      */
-    GLuint vbc;                                /* Vertex  buffer count       */
-    GLuint ebo;                                /* Element buffer object      */
-    GLuint ebc;                                /* Element buffer count       */
+    GLuint v0;                                 /* Vertex  range start        */
+    GLuint vc;                                 /* Vertex  range count        */
+    GLuint e0;                                 /* Element range start        */
+    GLuint ec;                                 /* Element range count        */
 };
 
 struct d_body
@@ -74,6 +83,10 @@ struct d_body
     int mc;
 
     struct d_mesh *mv;
+
+    float c[3];                                /* Bounding sphere center     */
+    float r;                                   /* Bounding sphere radius     */
+    int   vis;                                 /* Passed the last cull test  */
 };
 
 struct s_draw
@@ -85,12 +98,22 @@ struct s_draw
 
     struct d_body *bv;
 
+    int kc;
+
+    struct d_body *kv;                         /* Static geometry by chunk   */
+
+    GLuint vbo;                                /* Shared vertex  buffer      */
+    GLuint ebo;                                /* Shared element buffer      */
+    GLenum ebo_type;                           /* Element index type         */
+
     GLuint bill;
 
     unsigned int reflective:1;
     unsigned int shadowed:1;
 
     int shadow_ui;
+
+    const struct frustum *cull;                /* Current view, if culling   */
 };
 
 /*---------------------------------------------------------------------------*/
@@ -107,6 +130,7 @@ struct s_rend
     int skip_flags;                     /* Ignored material flags            */
 
     unsigned int color_mtrl:1;          /* Color material flag               */
+    unsigned int inst:1;                /* Draw queued instances             */
 };
 
 void r_draw_enable(struct s_rend *);
@@ -120,11 +144,15 @@ void r_apply_mtrl(struct s_rend *, int);
 int  sol_load_draw(struct s_draw *, struct s_vary *, int);
 void sol_free_draw(struct s_draw *);
 
+void sol_cull(struct s_draw *, const struct frustum *);
+int  sol_refl_rect(const struct s_draw *, const float *, float *);
+
 void sol_back(const struct s_draw *, struct s_rend *, float, float, float);
 void sol_refl(const struct s_draw *, struct s_rend *);
 void sol_draw(const struct s_draw *, struct s_rend *, int, int);
 void sol_bill(const struct s_draw *, struct s_rend *, const float *, float);
 void sol_fade(const struct s_draw *, struct s_rend *, float);
+void sol_shad(const struct s_draw *, struct s_rend *, int);
 
 /*---------------------------------------------------------------------------*/
 
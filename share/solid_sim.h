@@ -25,6 +25,7 @@ void sol_quit_sim(void);
 
 void  sol_move(struct s_vary *, cmd_fn, float);
 float sol_step(struct s_vary *, cmd_fn, const float *, float, int, int *);
+float sol_step_all(struct s_vary *, cmd_fn, const float *, float, int *);
 
 /*---------------------------------------------------------------------------*/
 
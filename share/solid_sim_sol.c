@@ -13,6 +13,7 @@
  */
 
 #include <math.h>
+#include <stdlib.h>
 
 #include "vec3.h"
 #include "common.h"
@@ -963,6 +964,125 @@ float sol_step(struct s_vary *vary, cmd_fn cmd_func,
     return b;
 }
 
+/*
+ * Step the physics of every ball forward DT seconds under the influence
+ * of gravity vector G. The world advances once: the earliest collision
+ * of any ball is found, everything moves to that time, and that single
+ * collision is resolved before searching again. Return the strongest
+ * bounce, and the index of the ball that took it in UI.
+ */
+
+float sol_step_all(struct s_vary *vary, cmd_fn cmd_func,
+                   const float *g, float dt, int *ui)
+{
+    float P[3], V[3], d, nt, b = 0.0f, tt = dt;
+    int i, c;
+
+    if (ui)
+        *ui = -1;
+
+    if (vary->uc == 0)
+        return b;
+
+    /* Keep the initial velocity of each ball for the pendulum. */
+
+    if (vary->ac < vary->uc)
+    {
+        float (*tv)[3] = realloc(vary->av, vary->uc * sizeof (*tv));
+
+        if (!tv)
+            return b;
+
+        vary->av = tv;
+        vary->ac = vary->uc;
+    }
+
+    for (i = 0; i < vary->uc; i++)
+    {
+        struct v_ball *up = vary->uv + i;
+
+        v_cpy(vary->av[i], up->v);
+        v_mad(up->v, up->v, g, tt);
+    }
+
+    /* Resolve collisions in time order. */
+
+    for (c = 16 * vary->uc; c > 0 && tt > 0; c--)
+    {
+        float pt;
+        int hit = -1, ball_idx = -1;
+
+        /* Avoid stepping across path changes. */
+
+        nt = pt = sol_path_time(vary, tt);
+
+        /* Miss collisions if we reach the iteration limit. */
+
+        if (c > 1)
+        {
+            for (i = 0; i < vary->uc; i++)
+            {
+                const struct v_ball *up = vary->uv + i;
+
+                float U[3], W[3], u;
+                int bi;
+
+                if ((u = sol_test_file(nt, U, W, up, vary)) < nt)
+                {
+                    v_cpy(P, U);
+                    v_cpy(V, W);
+                    nt = u;
+                    hit = i;
+                    ball_idx = -1;
+                }
+
+                if ((u = sol_test_balls(nt, U, W, &bi, up, vary)) < nt)
+                {
+                    v_cpy(P, U);
+                    v_cpy(V, W);
+                    nt = u;
+                    hit = i;
+                    ball_idx = bi;
+                }
+            }
+        }
+        else
+            nt = tt;
+
+        sol_move_once(vary, cmd_func, nt);
+
+        if (nt < pt && hit >= 0)
+        {
+            if (ball_idx != -1)
+                d = sol_bounce_ball(vary->uv + hit, P, ball_idx, vary);
+            else
+                d = sol_bounce(vary->uv + hit, P, V, nt);
+
+            if (b < d)
+            {
+                b = d;
+
+                if (ui)
+                    *ui = hit;
+            }
+        }
+
+        tt -= nt;
+    }
+
+    for (i = 0; i < vary->uc; i++)
+    {
+        struct v_ball *up = vary->uv + i;
+        float a[3];
+
+        v_sub(a, up->v, vary->av[i]);
+
+        sol_pendulum(up, a, g, dt);
+    }
+
+    return b;
+}
+
 /*---------------------------------------------------------------------------*/
 
 void sol_init_sim(struct s_vary *vary)
@@ -13,6 +13,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "solid_vary.h"
 #include "common.h"
@@ -63,6 +64,272 @@ static void setup_mover(struct alloc *alloc, const struct s_vary *fp, int pi, in
     }
 }
 
+/*---------------------------------------------------------------------------*/
+
+#define INDEX_CELL 2.0f                 /* Minimum grid cell size            */
+#define INDEX_MAX  64                   /* Maximum grid cells per axis       */
+
+/*
+ * Index input: an entity position in mover space, and its radius.
+ */
+
+struct i_ent
+{
+    int   mi;
+    int   mj;
+    float p[3];
+    float r;
+};
+
+static int index_cell(const struct v_bucket *bp, const float *p)
+{
+    int x = (int) ((p[0] - bp->x0) / bp->k);
+    int z = (int) ((p[2] - bp->z0) / bp->k);
+
+    return MIN(z, bp->nz - 1) * bp->nx + MIN(x, bp->nx - 1);
+}
+
+static void index_load_bucket(struct v_bucket *bp,
+                              const struct i_ent *ev, int n)
+{
+    float x1 = 0.0f;
+    float z1 = 0.0f;
+    int   i, c = 0;
+
+    /* Find the extent of the entities in this bucket. */
+
+    for (i = 0; i < n; i++)
+        if (ev[i].mi == bp->mi && ev[i].mj == bp->mj)
+        {
+            if (c++ == 0)
+            {
+                bp->x0 = x1 = ev[i].p[0];
+                bp->z0 = z1 = ev[i].p[2];
+            }
+            else
+            {
+                bp->x0 = MIN(bp->x0, ev[i].p[0]); x1 = MAX(x1, ev[i].p[0]);
+                bp->z0 = MIN(bp->z0, ev[i].p[2]); z1 = MAX(z1, ev[i].p[2]);
+            }
+        }
+
+    /* Size the grid to cover it. */
+
+    bp->k  = MAX(INDEX_CELL, MAX(x1 - bp->x0, z1 - bp->z0) / (INDEX_MAX - 1));
+    bp->nx = (int) ((x1 - bp->x0) / bp->k) + 1;
+    bp->nz = (int) ((z1 - bp->z0) / bp->k) + 1;
+
+    /* Sort entity indices by cell. */
+
+    bp->cv = (int *) calloc(bp->nx * bp->nz + 1, sizeof (int));
+    bp->ev = (int *) calloc(c, sizeof (int));
+
+    if (bp->cv && bp->ev)
+    {
+        for (i = 0; i < n; i++)
+            if (ev[i].mi == bp->mi && ev[i].mj == bp->mj)
+                bp->cv[index_cell(bp, ev[i].p) + 1]++;
+
+        for (i = 0; i < bp->nx * bp->nz; i++)
+            bp->cv[i + 1] += bp->cv[i];
+
+        for (i = n - 1; i >= 0; i--)
+            if (ev[i].mi == bp->mi && ev[i].mj == bp->mj)
+                bp->ev[--bp->cv[index_cell(bp, ev[i].p) + 1]] = i;
+    }
+    else
+    {
+        bp->nx = 0;
+        bp->nz = 0;
+    }
+}
+
+static void index_load(struct v_index *ix, const struct i_ent *ev, int n)
+{
+    int i, j;
+
+    memset(ix, 0, sizeof (*ix));
+
+    if (n <= 0)
+        return;
+
+    ix->qv = (int *) calloc(n, sizeof (int));
+    ix->sv = (int *) calloc(n, sizeof (int));
+    ix->bv = (struct v_bucket *) calloc(n, sizeof (struct v_bucket));
+
+    if (!(ix->qv && ix->sv && ix->bv))
+        return;
+
+    ix->ec = n;
+
+    /* Find each distinct mover pair and the largest radius. */
+
+    for (i = 0; i < n; i++)
+    {
+        for (j = 0; j < ix->bc; j++)
+            if (ix->bv[j].mi == ev[i].mi && ix->bv[j].mj == ev[i].mj)
+                break;
+
+        if (j == ix->bc)
+        {
+            ix->bv[j].mi = ev[i].mi;
+            ix->bv[j].mj = ev[i].mj;
+            ix->bc++;
+        }
+
+        ix->r = MAX(ix->r, ev[i].r);
+    }
+
+    for (j = 0; j < ix->bc; j++)
+        index_load_bucket(ix->bv + j, ev, n);
+}
+
+static void index_free(struct v_index *ix)
+{
+    int j;
+
+    for (j = 0; j < ix->bc; j++)
+    {
+        free(ix->bv[j].cv);
+        free(ix->bv[j].ev);
+    }
+
+    free(ix->bv);
+    free(ix->qv);
+    free(ix->sv);
+
+    memset(ix, 0, sizeof (*ix));
+}
+
+/*
+ * Build indices of all trigger entities.
+ */
+static void sol_load_index(struct s_vary *fp)
+{
+    const struct s_base *base = fp->base;
+
+    struct i_ent *ev;
+    int i, n = MAX(MAX(fp->hc, fp->zc), MAX(fp->jc, fp->xc));
+
+    if (n && (ev = (struct i_ent *) calloc(n, sizeof (*ev))))
+    {
+        for (i = 0; i < fp->hc; i++)
+        {
+            ev[i].mi = fp->hv[i].mi;
+            ev[i].mj = fp->hv[i].mj;
+            ev[i].r  = 0.0f;
+            v_cpy(ev[i].p, fp->hv[i].p);
+        }
+        index_load(&fp->item_index, ev, fp->hc);
+
+        for (i = 0; i < fp->zc; i++)
+        {
+            ev[i].mi = fp->zv[i].mi;
+            ev[i].mj = fp->zv[i].mj;
+            ev[i].r  = base->zv[i].r;
+            v_cpy(ev[i].p, base->zv[i].p);
+        }
+        index_load(&fp->goal_index, ev, fp->zc);
+
+        for (i = 0; i < fp->jc; i++)
+        {
+            ev[i].mi = fp->jv[i].mi;
+            ev[i].mj = fp->jv[i].mj;
+            ev[i].r  = base->jv[i].r;
+            v_cpy(ev[i].p, base->jv[i].p);
+        }
+        index_load(&fp->jump_index, ev, fp->jc);
+
+        for (i = 0; i < fp->xc; i++)
+        {
+            ev[i].mi = fp->xv[i].mi;
+            ev[i].mj = fp->xv[i].mj;
+            ev[i].r  = base->xv[i].r;
+            v_cpy(ev[i].p, base->xv[i].p);
+        }
+        index_load(&fp->swch_index, ev, fp->xc);
+
+        free(ev);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Append mover MI to the order after all movers its paths ride on.
+ */
+static void order_move(struct s_vary *fp, unsigned char *mark, int *n, int mi)
+{
+    int pi, k;
+
+    if (mi < 0 || mi >= fp->mc || mark[mi])
+        return;
+
+    mark[mi] = 1;
+
+    /* Visit every path this mover can reach. */
+
+    for (pi = fp->mv[mi].pi, k = 0;
+         pi >= 0 && pi < fp->pc && k < fp->pc;
+         pi = fp->base->pv[pi].pi, k++)
+    {
+        order_move(fp, mark, n, fp->pv[pi].mi);
+        order_move(fp, mark, n, fp->pv[pi].mj);
+    }
+
+    fp->mo[(*n)++] = mi;
+}
+
+static void free_ahead(struct s_vary *fp)
+{
+    if (fp->ahead)
+    {
+        free(fp->ahead->pos);
+        free(fp->ahead->rot);
+        free(fp->ahead->done);
+        free(fp->ahead);
+    }
+
+    free(fp->mo);
+
+    fp->ahead = NULL;
+    fp->mo    = NULL;
+}
+
+/*
+ * Sort movers parent-first and allocate the look-ahead transform table.
+ */
+static void sol_load_ahead(struct s_vary *fp)
+{
+    unsigned char *mark;
+    int i, n = 0;
+
+    if (fp->mc == 0)
+        return;
+
+    fp->mo    = (int *) calloc(fp->mc, sizeof (int));
+    fp->ahead = (struct v_ahead *) calloc(1, sizeof (struct v_ahead));
+
+    if (fp->mo && fp->ahead && (mark = (unsigned char *) calloc(fp->mc, 1)))
+    {
+        for (i = 0; i < fp->mc; i++)
+            order_move(fp, mark, &n, i);
+
+        free(mark);
+
+        fp->ahead->pos  = (struct vec3 *)   calloc(fp->mc, sizeof (struct vec3));
+        fp->ahead->rot  = (struct vec4 *)   calloc(fp->mc, sizeof (struct vec4));
+        fp->ahead->done = (unsigned char *) calloc(fp->mc, 1);
+
+        if (fp->ahead->pos && fp->ahead->rot && fp->ahead->done)
+            return;
+    }
+
+    free_ahead(fp);
+}
+
+/*---------------------------------------------------------------------------*/
+
 int sol_load_vary(struct s_vary *fp, struct s_base *base)
 {
     struct alloc mover_alloc;
@@ -231,11 +498,21 @@ int sol_load_vary(struct s_vary *fp, struct s_base *base)
         }
     }
 
+    sol_load_ahead(fp);
+    sol_load_index(fp);
+
     return 1;
 }
 
 void sol_free_vary(struct s_vary *fp)
 {
+    free_ahead(fp);
+
+    index_free(&fp->item_index);
+    index_free(&fp->goal_index);
+    index_free(&fp->jump_index);
+    index_free(&fp->swch_index);
+
     free(fp->pv);
     free(fp->bv);
     free(fp->mv);
@@ -243,6 +520,7 @@ void sol_free_vary(struct s_vary *fp)
     free(fp->xv);
     free(fp->zv);
     free(fp->uv);
+    free(fp->av);
 
     memset(fp, 0, sizeof (*fp));
 }
@@ -278,6 +556,9 @@ int is_move_dirty(const struct s_vary *vary, int mi)
 void set_move_dirty(const struct s_vary *vary, int mi, unsigned int dirty)
 {
     vary->mv[mi].dirty = !!dirty;
+
+    if (dirty && vary->ahead)
+        vary->ahead->valid = 0;
 }
 
 /*---------------------------------------------------------------------------*/
@@ -482,6 +763,57 @@ void sol_lerp_apply(struct s_lerp *fp, float a)
     }
 }
 
+/*
+ * Capture the varying state as the current interpolation target. This
+ * serves simulations that step the varying state directly instead of
+ * through the command stream.
+ */
+void sol_lerp_store(struct s_lerp *fp)
+{
+    int i;
+
+    for (i = 0; i < fp->mc; i++)
+    {
+        fp->mv[i][CURR].t  = fp->vary->mv[i].t;
+        fp->mv[i][CURR].pi = fp->vary->mv[i].pi;
+    }
+
+    for (i = 0; i < fp->uc; i++)
+    {
+        e_cpy(fp->uv[i][CURR].e, fp->vary->uv[i].e);
+        v_cpy(fp->uv[i][CURR].p, fp->vary->uv[i].p);
+        e_cpy(fp->uv[i][CURR].E, fp->vary->uv[i].E);
+
+        fp->uv[i][CURR].r = fp->vary->uv[i].r;
+    }
+}
+
+/*
+ * Restore the varying state exactly to the current interpolation target,
+ * undoing the effect of sol_lerp_apply.
+ */
+void sol_lerp_reset(struct s_lerp *fp)
+{
+    int i;
+
+    for (i = 0; i < fp->mc; i++)
+    {
+        fp->vary->mv[i].t  = fp->mv[i][CURR].t;
+        fp->vary->mv[i].pi = fp->mv[i][CURR].pi;
+
+        set_move_dirty(fp->vary, i, 1u);
+    }
+
+    for (i = 0; i < fp->uc; i++)
+    {
+        e_cpy(fp->vary->uv[i].e, fp->uv[i][CURR].e);
+        v_cpy(fp->vary->uv[i].p, fp->uv[i][CURR].p);
+        e_cpy(fp->vary->uv[i].E, fp->uv[i][CURR].E);
+
+        fp->vary->uv[i].r = fp->uv[i][CURR].r;
+    }
+}
+
 int sol_load_lerp(struct s_lerp *fp, struct s_vary *vary)
 {
     int i;
@@ -116,6 +116,53 @@ struct v_ball
     float mass;                                /* mass                       */
 };
 
+/*
+ * Spatial index of trigger entities. Entities that ride the same movers
+ * share a bucket, and each bucket is a uniform grid on the XZ plane of
+ * its mover space, so a query transforms the ball once per bucket.
+ */
+
+struct v_bucket
+{
+    int mi;
+    int mj;
+
+    float x0, z0;                              /* grid origin                */
+    float k;                                   /* cell size                  */
+    int   nx, nz;                              /* grid dimensions            */
+
+    int *cv;                                   /* cell offsets into ev       */
+    int *ev;                                   /* entity indices by cell     */
+};
+
+struct v_index
+{
+    int bc;
+    int ec;
+
+    float r;                                   /* largest entity radius      */
+
+    struct v_bucket *bv;
+
+    int *qv;                                   /* query results              */
+    int *sv;                                   /* query stamp by entity      */
+    int  stamp;
+};
+
+/*
+ * Mover transforms at a single time step ahead of the current time.
+ */
+
+struct v_ahead
+{
+    float dt;                                  /* time step                  */
+    int   valid;                               /* table matches movers       */
+
+    struct vec3   *pos;
+    struct vec4   *rot;
+    unsigned char *done;                       /* entry computed             */
+};
+
 struct s_vary
 {
     struct s_base *base;
@@ -140,9 +187,26 @@ struct s_vary
     struct v_bill *rv;
     struct v_ball *uv;
 
+    /* Movers in parent-first order, and their transforms at t + dt. */
+
+    int *mo;
+    struct v_ahead *ahead;
+
+    /* Trigger entity indices. */
+
+    struct v_index item_index;
+    struct v_index goal_index;
+    struct v_index jump_index;
+    struct v_index swch_index;
+
     /* Accumulator for tracking time in integer milliseconds. */
 
     float ms_accum;
+
+    /* Scratch space for sol_step_all, one vector per ball. */
+
+    float (*av)[3];
+    int ac;
 };
 
 /*---------------------------------------------------------------------------*/
@@ -194,6 +258,8 @@ void sol_free_lerp(struct s_lerp *);
 
 void sol_lerp_copy(struct s_lerp *);
 void sol_lerp_apply(struct s_lerp *, float);
+void sol_lerp_store(struct s_lerp *);
+void sol_lerp_reset(struct s_lerp *);
 int  sol_lerp_cmd(struct s_lerp *, struct cmd_state *, const union cmd *);
 
 /*---------------------------------------------------------------------------*/
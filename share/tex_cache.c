@@ -0,0 +1,433 @@
+/*
+ * Copyright (C) 2003-2010 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tex_cache.h"
+#include "image_cache.h"
+#include "image.h"
+#include "config.h"
+#include "common.h"
+#include "pool.h"
+#include "log.h"
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * GUI images are kept as textures after their last user lets go, so that
+ * a screen shown again, or a selection moved back and forth, does not
+ * decode the same file over and over. Unused textures are dropped least
+ * recently used first once the total passes the configured budget.
+ *
+ * Images expected to be shown next may be decoded ahead of time on a
+ * worker thread. The upload to GL happens on the main thread, when the
+ * image is first asked for.
+ */
+
+#define TEX_CACHE_MAX   64              /* Most images held at once          */
+#define TEX_CACHE_QUEUE 8               /* Most images waiting for a decode  */
+
+enum
+{
+    ENTRY_FREE = 0,
+    ENTRY_QUEUED,                       /* Waiting for the worker            */
+    ENTRY_DECODED,                      /* Waiting for the upload            */
+    ENTRY_READY
+};
+
+struct entry
+{
+    char   path[MAXSTR];
+    int    state;
+    int    refs;
+    int    size;                        /* Bytes, all mipmap levels          */
+    Uint32 used;                        /* Tick of the last use              */
+    int    k, max, mips;                /* Load parameters, see cache_params */
+
+    unsigned int prefetched:1;
+
+    struct mipmap mm;
+    GLuint o;
+};
+
+struct job
+{
+    struct entry *e;
+
+    char path[MAXSTR];
+    int  k, max, mips;
+};
+
+static struct entry cache[TEX_CACHE_MAX];
+static Uint32       cache_tick;
+
+static void cache_func(void *);
+
+static struct worker cache_worker = { "tex_cache", cache_func, 0 };
+
+static int hit_count;
+static int prefetch_count;
+static int miss_count;
+static int evict_count;
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Load parameters as for make_image_from_file with IF_MIPMAP.
+ */
+static void cache_params(int *k, int *max, int *mips)
+{
+    *k    = config_get_d(CONFIG_TEXTURES);
+    *max  = gli.max_texture_size;
+    *mips = config_get_d(CONFIG_MIPMAP);
+}
+
+static int mipmap_size(const struct mipmap *mm)
+{
+    int i, n = 0;
+
+    for (i = 0; i < mm->n; i++)
+        n += mm->w[i] * mm->h[i] * mm->b;
+
+    return n;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Find the entry for PATH loaded with the current parameters. A change
+ * of texture quality or mipmapping leaves older entries to be evicted.
+ */
+static struct entry *cache_find(const char *path)
+{
+    int k, max, mips, i;
+
+    cache_params(&k, &max, &mips);
+
+    for (i = 0; i < TEX_CACHE_MAX; i++)
+        if (cache[i].state != ENTRY_FREE && strcmp(cache[i].path, path) == 0 &&
+            cache[i].k == k && cache[i].max == max && cache[i].mips == mips)
+            return cache + i;
+
+    return NULL;
+}
+
+static void cache_drop(struct entry *e)
+{
+    if (e->o)
+        glDeleteTextures(1, &e->o);
+
+    if (e->state == ENTRY_DECODED)
+        mipmap_free(&e->mm);
+
+    memset(e, 0, sizeof (*e));
+}
+
+/*
+ * Return the least recently used entry that may be dropped.
+ */
+static struct entry *cache_lru(void)
+{
+    struct entry *e = NULL;
+    int i;
+
+    for (i = 0; i < TEX_CACHE_MAX; i++)
+        if ((cache[i].state == ENTRY_READY ||
+             cache[i].state == ENTRY_DECODED) && cache[i].refs == 0)
+            if (!e || cache[i].used < e->used)
+                e = cache + i;
+
+    return e;
+}
+
+/*
+ * Drop unused entries until the total is within the budget.
+ */
+static void cache_trim(void)
+{
+    const int max = config_get_d(CONFIG_IMAGE_CACHE) * 1024 * 1024;
+
+    struct entry *e;
+    int i, n = 0;
+
+    for (i = 0; i < TEX_CACHE_MAX; i++)
+        n += cache[i].size;
+
+    while (n > max && (e = cache_lru()))
+    {
+        n -= e->size;
+        cache_drop(e);
+        evict_count++;
+    }
+}
+
+/*
+ * Claim an entry for PATH, dropping the least recently used if all are
+ * taken. Return NULL if all are in use.
+ */
+static struct entry *cache_alloc(const char *path)
+{
+    struct entry *e = NULL;
+    int i;
+
+    for (i = 0; i < TEX_CACHE_MAX && !e; i++)
+        if (cache[i].state == ENTRY_FREE)
+            e = cache + i;
+
+    if (!e && (e = cache_lru()))
+    {
+        cache_drop(e);
+        evict_count++;
+    }
+
+    if (e)
+    {
+        SAFECPY(e->path, path);
+        cache_params(&e->k, &e->max, &e->mips);
+        e->used = ++cache_tick;
+    }
+    return e;
+}
+
+static void cache_upload(struct entry *e)
+{
+    if (e->mm.n)
+    {
+        e->o = make_texture_mipmap(&e->mm);
+        mipmap_free(&e->mm);
+    }
+    e->state = ENTRY_READY;
+}
+
+/*
+ * Finish a pending entry. Return false, dropping the entry, if it could
+ * not be loaded.
+ */
+static int cache_ready(struct entry *e)
+{
+    while (e->state == ENTRY_QUEUED)
+        worker_wait(&cache_worker);
+
+    if (e->state == ENTRY_DECODED)
+        cache_upload(e);
+
+    if (e->o)
+        return 1;
+
+    cache_drop(e);
+    return 0;
+}
+
+static int cache_load(struct entry *e)
+{
+    if (mipmap_load(&e->mm, e->path, e->k, e->max, e->mips))
+    {
+        e->size  = mipmap_size(&e->mm);
+        e->state = ENTRY_DECODED;
+
+        cache_upload(e);
+    }
+    return e->o != 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void cache_func(void *data)
+{
+    struct job *j = data;
+    struct mipmap mm;
+
+    if (!mipmap_load(&mm, j->path, j->k, j->max, j->mips))
+        memset(&mm, 0, sizeof (mm));
+
+    /* Queued entries are not dropped, so this one is still ours. */
+
+    worker_lock(&cache_worker);
+    {
+        j->e->mm    = mm;
+        j->e->size  = mipmap_size(&mm);
+        j->e->state = ENTRY_DECODED;
+    }
+    worker_unlock(&cache_worker);
+
+    free(j);
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Return a texture of the named image, from the cache if possible. The
+ * texture must be given back with tex_cache_put.
+ */
+GLuint tex_cache_get(const char *path)
+{
+    struct entry *e;
+    GLuint o = 0;
+    int full = 0;
+
+    if (!path || !*path)
+        return 0;
+
+    if (!config_get_d(CONFIG_IMAGE_CACHE))
+        return make_image_from_file(path, IF_MIPMAP);
+
+    worker_lock(&cache_worker);
+    {
+        if ((e = cache_find(path)) && cache_ready(e))
+        {
+            if (e->prefetched)
+                prefetch_count++;
+
+            hit_count++;
+        }
+        else if ((e = cache_alloc(path)))
+        {
+            if (!cache_load(e))
+            {
+                cache_drop(e);
+                e = NULL;
+            }
+            miss_count++;
+        }
+        else full = 1;
+
+        if (e)
+        {
+            e->refs      += 1;
+            e->used       = ++cache_tick;
+            e->prefetched = 0;
+
+            o = e->o;
+
+            cache_trim();
+        }
+    }
+    worker_unlock(&cache_worker);
+
+    /* With every entry in use, give out a texture of its own. */
+
+    if (full)
+    {
+        o = make_image_from_file(path, IF_MIPMAP);
+        miss_count++;
+    }
+    return o;
+}
+
+/*
+ * Give back a texture from tex_cache_get.
+ */
+void tex_cache_put(GLuint o)
+{
+    int i;
+
+    if (!o)
+        return;
+
+    worker_lock(&cache_worker);
+    {
+        for (i = 0; i < TEX_CACHE_MAX; i++)
+            if (cache[i].state == ENTRY_READY && cache[i].o == o)
+                break;
+
+        if (i < TEX_CACHE_MAX)
+        {
+            cache[i].refs -= 1;
+            cache_trim();
+        }
+        else glDeleteTextures(1, &o);
+    }
+    worker_unlock(&cache_worker);
+}
+
+/*
+ * Start decoding the named image in the background, if it is not cached
+ * already.
+ */
+void tex_cache_prefetch(const char *path)
+{
+    struct entry *e;
+    struct job *j = NULL;
+
+    if (!path || !*path || !config_get_d(CONFIG_IMAGE_CACHE))
+        return;
+
+    /* Without the file system lock, only the main thread may read. */
+
+    if (!pool_ready() || !worker_start(&cache_worker, 1))
+        return;
+
+    worker_lock(&cache_worker);
+    {
+        if ((e = cache_find(path)))
+            e->used = ++cache_tick;
+
+        else if (cache_worker.queued < TEX_CACHE_QUEUE &&
+                 (j = malloc(sizeof (*j))))
+        {
+            if ((e = cache_alloc(path)))
+            {
+                e->state      = ENTRY_QUEUED;
+                e->prefetched = 1;
+
+                j->e    = e;
+                j->k    = e->k;
+                j->max  = e->max;
+                j->mips = e->mips;
+                SAFECPY(j->path, path);
+            }
+            else
+            {
+                free(j);
+                j = NULL;
+            }
+        }
+    }
+    worker_unlock(&cache_worker);
+
+    if (j)
+        worker_put(&cache_worker, j);
+}
+
+/*
+ * Stop the worker, delete all cached textures, and log the hit rate.
+ */
+void tex_cache_free(void)
+{
+    int i, n = 0;
+
+    worker_stop(&cache_worker, free);
+
+    for (i = 0; i < TEX_CACHE_MAX; i++)
+    {
+        n += cache[i].size;
+        cache_drop(cache + i);
+    }
+
+    if (hit_count || miss_count)
+        log_printf("Images: %d hits (%d prefetched), %d misses, "
+                   "%d evicted, %d KB cached, %d%% hit rate\n",
+                   hit_count, prefetch_count, miss_count, evict_count,
+                   n / 1024, hit_count * 100 / (hit_count + miss_count));
+
+    hit_count      = 0;
+    prefetch_count = 0;
+    miss_count     = 0;
+    evict_count    = 0;
+}
+
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,15 @@
+#ifndef TEX_CACHE_H
+#define TEX_CACHE_H
+
+#include "glext.h"
+
+/*---------------------------------------------------------------------------*/
+
+GLuint tex_cache_get(const char *);
+void   tex_cache_put(GLuint);
+void   tex_cache_prefetch(const char *);
+void   tex_cache_free(void);
+
+/*---------------------------------------------------------------------------*/
+
+#endif
@@ -27,6 +27,7 @@
 #include "gui.h"
 #include "hmd.h"
 #include "log.h"
+#include "frustum.h"
 
 extern const char TITLE[];
 extern const char ICON[];
@@ -94,6 +95,7 @@ void video_snap(const char *path)
 
 static SDL_Window    *window;
 static SDL_GLContext  context;
+static int            hidden;
 
 static void set_window_title(const char *title)
 {
@@ -219,6 +221,16 @@ void video_quit(void)
     hmd_free();
 }
 
+/*
+ * Keep the next window off screen, for rendering that is only read back.
+ */
+void video_set_hidden(int h)
+{
+    hidden = h;
+}
+
+static void video_pace_init(int);
+
 int video_mode(int f, int w, int h)
 {
     int stereo  = config_get_d(CONFIG_STEREO)      ? 1 : 0;
@@ -260,14 +272,14 @@ int video_mode(int f, int w, int h)
     /* Try to set the currently specified mode. */
 
     log_printf("Creating a window (%dx%d, %s)\n",
-               w, h, (f ? "fullscreen" : "windowed"));
+               w, h, (hidden ? "hidden" : (f ? "fullscreen" : "windowed")));
 
     window = SDL_CreateWindow("", X, Y, w, h,
                               SDL_WINDOW_OPENGL |
                               (highdpi ? SDL_WINDOW_ALLOW_HIGHDPI : 0) |
 #ifndef __EMSCRIPTEN__
-                              (f ? SDL_WINDOW_FULLSCREEN_DESKTOP : 0) |
-                              SDL_WINDOW_RESIZABLE |
+                              (f && !hidden ? SDL_WINDOW_FULLSCREEN_DESKTOP : 0) |
+                              (hidden ? SDL_WINDOW_HIDDEN : SDL_WINDOW_RESIZABLE) |
 #endif
 			      0);
 
@@ -315,6 +327,8 @@ int video_mode(int f, int w, int h)
 
         SDL_GL_SetSwapInterval(vsync);
 
+        video_pace_init(vsync);
+
         if (!glext_init())
             return 0;
 
@@ -402,15 +416,110 @@ static int   fps    = 0;
 static int   last   = 0;
 static int   ticks  = 0;
 static int   frames = 0;
+static int   late   = 0;
+static int   drops  = 0;
 
 int  video_perf(void)
 {
     return fps;
 }
 
+/*
+ * Frame pacing. A frame rate limit sets a frame budget, and the main
+ * loop sleeps away whatever remains of the budget after a swap. With
+ * vsync, the display refresh sets the budget instead. Frames that run
+ * over their budget are counted as late, and each whole budget they
+ * run over is counted as a dropped frame.
+ */
+
+static int    pace_limit;               /* Frame rate limit (0 = none)       */
+static int    pace_hz;                  /* Display refresh with vsync        */
+static Uint64 pace_next;                /* Deadline of the current frame     */
+static Uint64 pace_last;                /* Time of the previous swap         */
+
+static void video_pace_init(int vsync)
+{
+    SDL_DisplayMode mode;
+
+    pace_hz = 0;
+
+    if (vsync && SDL_GetWindowDisplayMode(window, &mode) == 0)
+        pace_hz = mode.refresh_rate;
+
+    pace_next = 0;
+    pace_last = SDL_GetPerformanceCounter();
+}
+
+/*
+ * Sleep until the given performance counter value. SDL_Delay has at best
+ * millisecond granularity and often oversleeps by a millisecond or so,
+ * so sleep coarsely until close to the deadline, then yield until it.
+ */
+static void video_wait(Uint64 until)
+{
+    const Uint64 f = SDL_GetPerformanceFrequency();
+    Uint64 now;
+
+    while ((now = SDL_GetPerformanceCounter()) < until)
+    {
+        Uint64 n = (until - now) * 1000 / f;
+
+        SDL_Delay(n > 2 ? (Uint32) (n - 2) : 0);
+    }
+}
+
+void video_pace(int limit)
+{
+    pace_limit = limit;
+}
+
+static void video_pace_swap(void)
+{
+    const Uint64 f = SDL_GetPerformanceFrequency();
+
+    Uint64 budget = 0;
+    Uint64 now;
+
+    if (pace_limit > 0)
+        budget = f / pace_limit;
+    else if (pace_hz > 0)
+        budget = f / pace_hz;
+
+#ifndef __EMSCRIPTEN__
+    /* Sleep away the remaining budget of a rate-limited frame. */
+
+    if (pace_limit > 0)
+    {
+        now = SDL_GetPerformanceCounter();
+
+        /* Resynchronize if the deadline is a whole frame behind. */
+
+        if (pace_next + budget < now)
+            pace_next = now + budget;
+        else
+        {
+            video_wait(pace_next);
+            pace_next += budget;
+        }
+    }
+#endif
+
+    now = SDL_GetPerformanceCounter();
+
+    /* Count late and dropped frames against the budget. */
+
+    if (budget && now - pace_last > budget + budget / 8)
+    {
+        late  += 1;
+        drops += (int) ((now - pace_last) / budget) - 1;
+    }
+
+    pace_last = now;
+}
+
 void video_swap(void)
 {
-    int dt;
+    int dt, drawn, culled;
 
     if (hmd_stat())
         hmd_swap();
@@ -421,6 +530,8 @@ void video_swap(void)
 
     SDL_GL_SwapWindow(window);
 
+    video_pace_swap();
+
     /* Accumulate time passed and frames rendered. */
 
     dt = (int) SDL_GetTicks() - last;
@@ -444,15 +555,22 @@ void video_swap(void)
         fps = (int) ((c - k < k - f) ? c : f);
         ms  = (float) ticks / (float) frames;
 
-        /* Reset the counters for the next update. */
+        /* Collect culling stats, average objects per frame. */
 
-        frames = 0;
-        ticks  = 0;
+        frustum_stats(&drawn, &culled);
 
         /* Output statistics if configured. */
 
         if (config_get_d(CONFIG_STATS))
-            fprintf(stdout, "%4d %8.4f\n", fps, (double) ms);
+            fprintf(stdout, "%4d %8.4f %4d %4d %6d %6d\n", fps, (double) ms,
+                    late, drops, drawn / frames, culled / frames);
+
+        /* Reset the counters for the next update. */
+
+        frames = 0;
+        ticks  = 0;
+        late   = 0;
+        drops  = 0;
     }
 }
 
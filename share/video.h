@@ -33,9 +33,11 @@ void video_quit(void);
 /*---------------------------------------------------------------------------*/
 
 int  video_mode(int, int, int);
+void video_set_hidden(int);
 
 void video_snap(const char *);
 int  video_perf(void);
+void video_pace(int);
 void video_swap(void);
 
 void video_show_cursor(void);
@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2026 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+#include <SDL.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "fetch.h"
+#include "common.h"
+#include "fs.h"
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Download from file: URLs in a scratch directory, so that no network is
+ * needed. Usage: fetch_test <absolute directory>
+ */
+
+#define TEST_SIZE 100000
+
+static int  test_done;
+static int  test_success;
+static char test_hash[SHA256_HEX];
+
+static int failures;
+
+static void done_func(void *data, void *extra_data)
+{
+    struct fetch_done *dn = extra_data;
+
+    test_success = dn->success;
+    SAFECPY(test_hash, dn->sha256);
+    test_done = 1;
+}
+
+/*
+ * Wait for the transfer to finish and return whether it succeeded.
+ */
+static int wait_fetch(unsigned int id)
+{
+    Uint32 t0 = SDL_GetTicks();
+    SDL_Event e;
+
+    if (!id)
+        return 0;
+
+    while (!test_done && SDL_GetTicks() - t0 < 10000)
+    {
+        while (SDL_PollEvent(&e))
+            if (e.type == FETCH_EVENT)
+                fetch_handle_event(e.user.data1);
+
+        SDL_Delay(10);
+    }
+    return test_done && test_success;
+}
+
+static int fetch(const char *url, const char *dst, const char *sha256)
+{
+    struct fetch_callback callback = { NULL, done_func, NULL };
+
+    test_done    = 0;
+    test_success = 0;
+    test_hash[0] = 0;
+
+    if (sha256)
+        return wait_fetch(fetch_file_resume(url, dst, sha256, callback));
+    else
+        return wait_fetch(fetch_file(url, dst, callback));
+}
+
+/*
+ * Write the first N bytes of the test data to PATH, or N other bytes.
+ */
+static void write_data(const char *path, int n, int garbage)
+{
+    fs_file fp;
+    int i;
+
+    if ((fp = fs_open_write(path)))
+    {
+        for (i = 0; i < n; i++)
+            fs_putc(garbage ? 0xff : (i * 7) & 0xff, fp);
+
+        fs_close(fp);
+    }
+}
+
+static void check(int ok, const char *what)
+{
+    printf("%s: %s\n", ok ? "PASS" : "FAIL", what);
+
+    if (!ok)
+        failures++;
+}
+
+/*---------------------------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+{
+    char url[MAXSTR];
+    char hash[SHA256_HEX];
+
+    if (argc != 2)
+    {
+        fprintf(stderr, "Usage: %s <absolute directory>\n", argv[0]);
+        return 1;
+    }
+
+    if (SDL_Init(SDL_INIT_EVENTS) == -1 || !fs_init(argv[0]) ||
+        !fs_set_write_dir(argv[1]) || !fs_add_path(argv[1]))
+    {
+        fprintf(stderr, "Failure to initialize\n");
+        return 1;
+    }
+
+    write_data("source.bin", TEST_SIZE, 0);
+    sha256_file("source.bin", hash);
+
+    SAFECPY(url, "file://");
+    SAFECAT(url, argv[1]);
+    SAFECAT(url, "/source.bin");
+
+    fetch_enable(1);
+
+    fs_remove("whole.bin");
+    check(fetch(url, "whole.bin", hash) &&
+          fs_size("whole.bin") == TEST_SIZE &&
+          strcmp(test_hash, hash) == 0, "whole file matches its hash");
+
+    write_data("part.bin", TEST_SIZE / 3, 0);
+    check(fetch(url, "part.bin", hash) &&
+          fs_size("part.bin") == TEST_SIZE, "partial file is resumed");
+
+    write_data("stale.bin", TEST_SIZE / 3, 1);
+    check(!fetch(url, "stale.bin", hash) &&
+          !fs_exists("stale.bin"), "stale partial file is removed");
+
+    write_data("over.bin", TEST_SIZE * 2, 0);
+    check(!fetch(url, "over.bin", hash) &&
+          !fs_exists("over.bin"), "oversized partial file is removed");
+
+    check(fetch(url, "plain.bin", NULL) &&
+          fs_size("plain.bin") == TEST_SIZE, "plain download");
+
+    SAFECAT(url, ".missing");
+    check(!fetch(url, "missing.bin", NULL), "missing source fails");
+
+    fetch_enable(0);
+
+    fs_remove("source.bin");
+    fs_remove("whole.bin");
+    fs_remove("part.bin");
+    fs_remove("plain.bin");
+    fs_remove("missing.bin");
+
+    fs_quit();
+    SDL_Quit();
+
+    return failures ? 1 : 0;
+}
+
+/*---------------------------------------------------------------------------*/